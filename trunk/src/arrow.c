@@ -0,0 +1,683 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   arrow.c contains functions which write Apache Arrow IPC files
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for assert() */
+#include <assert.h>
+
+/* for fprintf()
+ *     NULL constant
+ **/
+#include <stdio.h>
+
+/* for malloc()
+ *     realloc()
+ *     free()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memcpy()
+ *     memset()
+ *     strlen()
+ **/
+#include <string.h>
+
+#include "arrow.h"
+
+
+/*
+ * Metadata of Arrow IPC files is stored as flatbuffers. Only few
+ * tables are needed, so they are encoded here by hand instead of using
+ * flatbuffers compiler. Buffer is built from start to end: parent
+ * table is written first and offsets to child objects are patched when
+ * child is written (offsets in flatbuffers should point forward).
+ */
+
+/** Magic string at start and end of Arrow file */
+#define ARROW_MAGIC "ARROW1"
+
+/** Marker which precedes each message */
+#define ARROW_CONTINUATION 0xFFFFFFFFU
+
+/** MetadataVersion::V5 */
+#define ARROW_METADATA_V5 4
+
+/** MessageHeader values */
+#define ARROW_HEADER_SCHEMA       1
+#define ARROW_HEADER_RECORD_BATCH 3
+
+/** Type values */
+#define ARROW_TYPE_INT     2
+#define ARROW_TYPE_UTF8    5
+#define ARROW_TYPE_DECIMAL 7
+#define ARROW_TYPE_DATE    8
+
+/** Count of columns in file */
+#define ARROW_COLUMNS 6
+
+/** Number of column "currency", the only one with null values */
+#define ARROW_CURRENCY_COLUMN 4
+
+/** Count of buffers in record batch: validity bitmaps for all columns,
+ * offsets and data for strings, data for other columns */
+#define ARROW_BUFFERS 15
+
+/** Round up to multiple of 8 */
+#define ALIGN8(n) (((n) + 7) & ~(size_t)7)
+
+
+/** Flatbuffer under construction */
+struct fbb {
+  unsigned char *buf;  /**< data */
+  size_t         len;  /**< count of used bytes */
+  size_t         size; /**< size of allocated memory */
+};
+
+
+/** Reserve zeroed space in flatbuffer and return its position */
+static size_t
+fb_reserve(struct fbb *b, size_t n)
+{
+  size_t pos = b->len;
+
+  if (b->len + n > b->size) {
+      while (b->len + n > b->size) {
+        b->size = (b->size == 0) ? 1024 : b->size * 2;
+      }
+      b->buf = realloc(b->buf, b->size);
+      if (b->buf == NULL) {
+          fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+          exit(EXIT_FAILURE);
+      }
+  }
+
+  memset(b->buf + pos, 0, n);
+  b->len += n;
+
+  return pos;
+}
+
+
+/** Pad flatbuffer to multiple of align */
+static void
+fb_align(struct fbb *b, size_t align)
+{
+  if (b->len % align != 0) {
+      fb_reserve(b, align - b->len % align);
+  }
+}
+
+
+/** Store little-endian scalar of given size at position */
+static void
+fb_put(struct fbb *b, size_t pos, uint64_t value, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++) {
+    b->buf[pos + i] = (unsigned char)(value >> (8 * i));
+  }
+}
+
+
+/** Store offset from position to target (target should be later) */
+static void
+fb_offset(struct fbb *b, size_t pos, size_t target)
+{
+  assert(target > pos);
+  fb_put(b, pos, target - pos, 4);
+}
+
+
+/**
+ * Write table with given sizes of fields.
+ *
+ * Vtable is written just before table. Fields are placed from largest
+ * to smallest so they are naturally aligned. Field with zero size is
+ * absent.
+ *
+ * @param b flatbuffer
+ * @param nfields count of fields
+ * @param sizes sizes of fields (0, 1, 2, 4 or 8)
+ * @param pos positions of fields (output)
+ *
+ * @return position of table
+ **/
+static size_t
+fb_table(struct fbb *b, int nfields, const size_t *sizes, size_t *pos)
+{
+  size_t off[8]; /* offsets of fields in table */
+  size_t tsize;  /* size of table */
+  size_t vsize;  /* size of vtable */
+  size_t vt, tbl;
+  size_t s;
+  int    i;
+
+  assert(nfields <= 8);
+
+  tsize = 4; /* offset to vtable */
+  for (i = 0; i < nfields; i++) {
+    off[i] = 0;
+  }
+  for (s = 8; s >= 1; s /= 2) {
+    for (i = 0; i < nfields; i++) {
+      if (sizes[i] == s) {
+          tsize = (tsize + s - 1) & ~(s - 1);
+          off[i] = tsize;
+          tsize += s;
+      }
+    }
+  }
+
+  vsize = 4 + 2 * (size_t)nfields;
+  fb_align(b, 2);
+  vt = fb_reserve(b, vsize);
+  fb_align(b, 8);
+  tbl = fb_reserve(b, tsize);
+
+  fb_put(b, vt, vsize, 2);
+  fb_put(b, vt + 2, tsize, 2);
+  for (i = 0; i < nfields; i++) {
+    fb_put(b, vt + 4 + 2 * (size_t)i, off[i], 2);
+    pos[i] = tbl + off[i];
+  }
+
+  /* signed offset from table to vtable */
+  fb_put(b, tbl, (uint32_t)(tbl - vt), 4);
+
+  return tbl;
+}
+
+
+/**
+ * Write vector header. Elements should be written just after it.
+ *
+ * @return position of first element
+ **/
+static size_t
+fb_vector(struct fbb *b, size_t n, size_t elem_size, size_t elem_align)
+{
+  size_t pos;
+
+  fb_align(b, 4);
+  while ((b->len + 4) % elem_align != 0) {
+    fb_reserve(b, 4);
+  }
+
+  pos = fb_reserve(b, 4 + n * elem_size);
+  fb_put(b, pos, n, 4);
+
+  return pos + 4;
+}
+
+
+/** Write string and return its position */
+static size_t
+fb_string(struct fbb *b, const char *str)
+{
+  size_t len = strlen(str);
+  size_t pos;
+
+  fb_align(b, 4);
+  pos = fb_reserve(b, 4 + len + 1);
+  fb_put(b, pos, len, 4);
+  memcpy(b->buf + pos + 4, str, len);
+
+  return pos;
+}
+
+
+/** Write type of column and patch offset to him */
+static void
+fb_type(struct fbb *b, size_t at, int type)
+{
+  size_t sizes[3] = { 0, 0, 0 };
+  size_t pos[3], tbl;
+
+  switch (type) {
+      case ARROW_TYPE_INT:
+          sizes[0] = 4; sizes[1] = 1; /* bitWidth, is_signed */
+          tbl = fb_table(b, 2, sizes, pos);
+          fb_put(b, pos[0], 32, 4);
+          fb_put(b, pos[1], 0, 1);
+          break;
+      case ARROW_TYPE_DECIMAL:
+          sizes[0] = sizes[1] = sizes[2] = 4; /* precision, scale, bitWidth */
+          tbl = fb_table(b, 3, sizes, pos);
+          fb_put(b, pos[0], 18, 4);
+          fb_put(b, pos[1], 2, 4);
+          fb_put(b, pos[2], 128, 4);
+          break;
+      case ARROW_TYPE_DATE:
+          sizes[0] = 2; /* unit */
+          tbl = fb_table(b, 1, sizes, pos);
+          fb_put(b, pos[0], 0, 2); /* DateUnit::DAY */
+          break;
+      default: /* ARROW_TYPE_UTF8 */
+          tbl = fb_table(b, 0, sizes, pos);
+          break;
+  }
+
+  fb_offset(b, at, tbl);
+}
+
+
+/** Write schema of file and return its position */
+static size_t
+fb_schema(struct fbb *b)
+{
+  static const char *const names[ARROW_COLUMNS] = {
+    "sign", "date", "category", "amount", "currency", "comment"
+  };
+  static const int types[ARROW_COLUMNS] = {
+    ARROW_TYPE_UTF8, ARROW_TYPE_DATE, ARROW_TYPE_INT,
+    ARROW_TYPE_DECIMAL, ARROW_TYPE_UTF8, ARROW_TYPE_UTF8
+  };
+  /* name, nullable, type_type, type, dictionary, children */
+  static const size_t field_sizes[6] = { 4, 1, 1, 4, 0, 4 };
+  size_t sizes[2], pos[2], fpos[6];
+  size_t tbl, vec, field;
+  uint16_t one = 1;
+  int i;
+
+  sizes[0] = 2; /* endianness */
+  sizes[1] = 4; /* fields */
+  tbl = fb_table(b, 2, sizes, pos);
+  /* Endianness: Little = 0, Big = 1 */
+  fb_put(b, pos[0], (*(unsigned char *)&one == 1) ? 0 : 1, 2);
+
+  vec = fb_vector(b, ARROW_COLUMNS, 4, 4);
+  fb_offset(b, pos[1], vec - 4);
+
+  for (i = 0; i < ARROW_COLUMNS; i++) {
+    field = fb_table(b, 6, field_sizes, fpos);
+    fb_offset(b, vec + 4 * (size_t)i, field);
+    fb_put(b, fpos[1], (i == ARROW_CURRENCY_COLUMN), 1);
+    fb_put(b, fpos[2], (uint64_t)types[i], 1);
+    fb_offset(b, fpos[0], fb_string(b, names[i]));
+    fb_type(b, fpos[3], types[i]);
+    fb_offset(b, fpos[5], fb_vector(b, 0, 4, 4) - 4);
+  }
+
+  return tbl;
+}
+
+
+/**
+ * Write flatbuffer as encapsulated message and free it.
+ *
+ * @return size of metadata with prefix
+ **/
+static int32_t
+write_message(struct outbuf *ob, struct fbb *b)
+{
+  uint32_t prefix[2];
+  size_t   padded;
+
+  padded = ALIGN8(b->len);
+
+  prefix[0] = ARROW_CONTINUATION;
+  prefix[1] = (uint32_t)padded;
+  outbuf_write(ob, prefix, sizeof(prefix));
+  outbuf_write(ob, b->buf, b->len);
+  outbuf_zero(ob, padded - b->len);
+
+  free(b->buf);
+
+  return (int32_t)(sizeof(prefix) + padded);
+}
+
+
+/**
+ * Start message: write root offset and Message table.
+ *
+ * @return position of field "header"
+ **/
+static size_t
+fb_message(struct fbb *b, int header_type, int64_t bodylen)
+{
+  /* version, header_type, header, bodyLength */
+  static const size_t sizes[4] = { 2, 1, 4, 8 };
+  size_t pos[4], root, tbl;
+
+  root = fb_reserve(b, 4);
+  tbl = fb_table(b, 4, sizes, pos);
+  fb_offset(b, root, tbl);
+
+  fb_put(b, pos[0], ARROW_METADATA_V5, 2);
+  fb_put(b, pos[1], (uint64_t)header_type, 1);
+  fb_put(b, pos[3], (uint64_t)bodylen, 8);
+
+  return pos[2];
+}
+
+
+/**
+ * Initialize writer and write header of file.
+ *
+ * @param aw writer
+ * @param ob output
+ **/
+void
+arrow_open(struct arrow_writer *aw, struct outbuf *ob)
+{
+  struct fbb b;
+  size_t header;
+  char magic[8];
+
+  assert(aw != NULL);
+  assert(ob != NULL);
+
+  memset(aw, 0, sizeof(*aw));
+  aw->ob = ob;
+
+  aw->signs           = malloc(ARROW_BATCH_ROWS);
+  aw->dates           = malloc(ARROW_BATCH_ROWS * sizeof(int32_t));
+  aw->categories      = malloc(ARROW_BATCH_ROWS * sizeof(uint32_t));
+  aw->amounts         = malloc(ARROW_BATCH_ROWS * sizeof(int64_t));
+  aw->currencies      = malloc(ARROW_BATCH_ROWS * sizeof(uint32_t));
+  aw->comment_offsets = malloc((ARROW_BATCH_ROWS + 1) * sizeof(int32_t));
+  aw->comments_size   = 64 * 1024;
+  aw->comments        = malloc(aw->comments_size);
+  if (aw->signs == NULL || aw->dates == NULL || aw->categories == NULL ||
+      aw->amounts == NULL || aw->currencies == NULL ||
+      aw->comment_offsets == NULL || aw->comments == NULL) {
+      fprintf(stderr, "malloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+  aw->comment_offsets[0] = 0;
+
+  memset(magic, 0, sizeof(magic));
+  memcpy(magic, ARROW_MAGIC, strlen(ARROW_MAGIC));
+  outbuf_write(ob, magic, sizeof(magic));
+
+  memset(&b, 0, sizeof(b));
+  header = fb_message(&b, ARROW_HEADER_SCHEMA, 0);
+  fb_offset(&b, header, fb_schema(&b));
+  write_message(ob, &b);
+}
+
+
+/** Write column data padded to multiple of 8 */
+static void
+write_buffer(struct outbuf *ob, const void *data, size_t len)
+{
+  outbuf_write(ob, data, len);
+  outbuf_zero(ob, ALIGN8(len) - len);
+}
+
+
+/**
+ * Write collected records as record batch.
+ *
+ * @param aw writer
+ **/
+static void
+arrow_flush(struct arrow_writer *aw)
+{
+  struct fbb b;
+  size_t   lens[ARROW_BUFFERS]; /* sizes of buffers */
+  size_t   sizes[3], pos[3], header, tbl, vec, off, i;
+  int64_t  bodylen;
+  int64_t  high;
+  int32_t  offset;
+  uint16_t one = 1;
+  uint32_t code;
+  unsigned char bits;
+  struct arrow_block *block;
+  size_t   n = aw->rows;
+  size_t   nulls;
+
+  nulls = 0;
+  for (i = 0; i < n; i++) {
+    nulls += (aw->currencies[i] == 0);
+  }
+
+  /* validity bitmaps are empty when there are no null values */
+  lens[0]  = 0; lens[1]  = (n + 1) * 4; lens[2]  = n;           /* sign */
+  lens[3]  = 0; lens[4]  = n * 4;                               /* date */
+  lens[5]  = 0; lens[6]  = n * 4;                               /* category */
+  lens[7]  = 0; lens[8]  = n * 16;                              /* amount */
+  lens[9]  = (nulls > 0) ? (n + 7) / 8 : 0;                     /* currency */
+  lens[10] = (n + 1) * 4; lens[11] = (n - nulls) * 3;
+  lens[12] = 0; lens[13] = (n + 1) * 4;                         /* comment */
+  lens[14] = (size_t)aw->comment_offsets[n];
+
+  bodylen = 0;
+  for (i = 0; i < ARROW_BUFFERS; i++) {
+    bodylen += (int64_t)ALIGN8(lens[i]);
+  }
+
+  memset(&b, 0, sizeof(b));
+  sizes[0] = 8; /* length */
+  sizes[1] = 4; /* nodes */
+  sizes[2] = 4; /* buffers */
+  header = fb_message(&b, ARROW_HEADER_RECORD_BATCH, bodylen);
+  tbl = fb_table(&b, 3, sizes, pos);
+  fb_offset(&b, header, tbl);
+  fb_put(&b, pos[0], n, 8);
+
+  /* struct FieldNode { length: long; null_count: long; } */
+  vec = fb_vector(&b, ARROW_COLUMNS, 16, 8);
+  fb_offset(&b, pos[1], vec - 4);
+  for (i = 0; i < ARROW_COLUMNS; i++) {
+    fb_put(&b, vec + 16 * i, n, 8);
+  }
+  fb_put(&b, vec + 16 * ARROW_CURRENCY_COLUMN + 8, nulls, 8);
+
+  /* struct Buffer { offset: long; length: long; } */
+  vec = fb_vector(&b, ARROW_BUFFERS, 16, 8);
+  fb_offset(&b, pos[2], vec - 4);
+  for (i = 0, off = 0; i < ARROW_BUFFERS; i++) {
+    fb_put(&b, vec + 16 * i, off, 8);
+    fb_put(&b, vec + 16 * i + 8, lens[i], 8);
+    off += ALIGN8(lens[i]);
+  }
+
+  block = realloc(aw->blocks, (aw->nblocks + 1) * sizeof(*block));
+  if (block == NULL) {
+      fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+  aw->blocks = block;
+  block += aw->nblocks++;
+  block->offset  = (int64_t)aw->ob->written;
+  block->metalen = write_message(aw->ob, &b);
+  block->bodylen = bodylen;
+
+  /* body: column by column */
+  for (offset = 0; offset <= (int32_t)n; offset++) {
+    outbuf_write(aw->ob, &offset, sizeof(offset));
+  }
+  outbuf_zero(aw->ob, ALIGN8(lens[1]) - lens[1]);
+  write_buffer(aw->ob, aw->signs, n);
+  write_buffer(aw->ob, aw->dates, lens[4]);
+  write_buffer(aw->ob, aw->categories, lens[6]);
+  for (i = 0; i < n; i++) {
+    /* decimal128: two 64-bit words in native order */
+    high = (aw->amounts[i] < 0) ? -1 : 0;
+    if (*(unsigned char *)&one == 1) {
+        outbuf_write(aw->ob, &aw->amounts[i], 8);
+        outbuf_write(aw->ob, &high, 8);
+    } else {
+        outbuf_write(aw->ob, &high, 8);
+        outbuf_write(aw->ob, &aw->amounts[i], 8);
+    }
+  }
+
+  /* currency: bitmap of codes, offsets and three letters of each code */
+  if (lens[9] > 0) {
+      for (i = 0; i < n; i += 8) {
+        bits = 0;
+        for (off = i; off < n && off < i + 8; off++) {
+          bits |= (unsigned char)((aw->currencies[off] != 0) << (off - i));
+        }
+        outbuf_putc(aw->ob, (char)bits);
+      }
+      outbuf_zero(aw->ob, ALIGN8(lens[9]) - lens[9]);
+  }
+  offset = 0;
+  for (i = 0; i <= n; i++) {
+    outbuf_write(aw->ob, &offset, sizeof(offset));
+    if (i < n && aw->currencies[i] != 0) {
+        offset += 3;
+    }
+  }
+  outbuf_zero(aw->ob, ALIGN8(lens[10]) - lens[10]);
+  for (i = 0; i < n; i++) {
+    code = aw->currencies[i];
+    if (code != 0) {
+        outbuf_putc(aw->ob, (char)(code >> 16));
+        outbuf_putc(aw->ob, (char)(code >> 8));
+        outbuf_putc(aw->ob, (char)code);
+    }
+  }
+  outbuf_zero(aw->ob, ALIGN8(lens[11]) - lens[11]);
+
+  write_buffer(aw->ob, aw->comment_offsets, lens[13]);
+  write_buffer(aw->ob, aw->comments, lens[14]);
+
+  aw->rows = 0;
+}
+
+
+/**
+ * Add record to current batch.
+ *
+ * Batch is written when it is full. Bytes of comment which are not
+ * valid UTF-8 are replaced by U+FFFD, because Arrow strings are UTF-8.
+ *
+ * @param aw writer
+ * @param rec record
+ **/
+void
+arrow_append(struct arrow_writer *aw, const struct record *rec)
+{
+  size_t len, valid, need, used;
+
+  assert(aw != NULL);
+  assert(rec != NULL);
+
+  len   = strlen(rec->comment);
+  valid = utf8_valid_len(rec->comment, len);
+  need  = valid + (len - valid) * UTF8_REPLACEMENT_LEN;
+  used  = (size_t)aw->comment_offsets[aw->rows];
+
+  if (aw->rows == ARROW_BATCH_ROWS ||
+      (aw->rows > 0 && used + need > ARROW_BATCH_COMMENTS)) {
+      arrow_flush(aw);
+      used = 0;
+  }
+
+  if (used + need > aw->comments_size) {
+      while (used + need > aw->comments_size) {
+        aw->comments_size *= 2;
+      }
+      aw->comments = realloc(aw->comments, aw->comments_size);
+      if (aw->comments == NULL) {
+          fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+          exit(EXIT_FAILURE);
+      }
+  }
+
+  aw->signs[aw->rows]      = rec->sign;
+  aw->dates[aw->rows]      = (int32_t)date_to_days(rec->year, rec->month, rec->day);
+  aw->categories[aw->rows] = (uint32_t)rec->category;
+  aw->amounts[aw->rows]    = rec->amount;
+  aw->currencies[aw->rows] = rec->currency;
+  memcpy(aw->comments + used, rec->comment, valid);
+  len = valid + utf8_repair(aw->comments + used + valid, rec->comment + valid,
+                            len - valid);
+  aw->rows++;
+  aw->comment_offsets[aw->rows] = (int32_t)(used + len);
+}
+
+
+/**
+ * Write last batch and footer of file and free memory.
+ *
+ * @param aw writer
+ **/
+void
+arrow_close(struct arrow_writer *aw)
+{
+  /* version, schema, dictionaries, recordBatches */
+  static const size_t sizes[4] = { 2, 4, 4, 4 };
+  struct fbb b;
+  size_t   pos[4], root, tbl, vec, i;
+  uint32_t eos[2];
+  int32_t  footer_len;
+  char     magic[6];
+
+  assert(aw != NULL);
+
+  if (aw->rows > 0) {
+      arrow_flush(aw);
+  }
+
+  /* end of stream */
+  eos[0] = ARROW_CONTINUATION;
+  eos[1] = 0;
+  outbuf_write(aw->ob, eos, sizeof(eos));
+
+  memset(&b, 0, sizeof(b));
+  root = fb_reserve(&b, 4);
+  tbl = fb_table(&b, 4, sizes, pos);
+  fb_offset(&b, root, tbl);
+  fb_put(&b, pos[0], ARROW_METADATA_V5, 2);
+  fb_offset(&b, pos[1], fb_schema(&b));
+  fb_offset(&b, pos[2], fb_vector(&b, 0, 24, 8) - 4);
+
+  /* struct Block { offset: long; metaDataLength: int; bodyLength: long; } */
+  vec = fb_vector(&b, aw->nblocks, 24, 8);
+  fb_offset(&b, pos[3], vec - 4);
+  for (i = 0; i < aw->nblocks; i++) {
+    fb_put(&b, vec + 24 * i, (uint64_t)aw->blocks[i].offset, 8);
+    fb_put(&b, vec + 24 * i + 8, (uint32_t)aw->blocks[i].metalen, 4);
+    fb_put(&b, vec + 24 * i + 16, (uint64_t)aw->blocks[i].bodylen, 8);
+  }
+
+  footer_len = (int32_t)b.len;
+  outbuf_write(aw->ob, b.buf, b.len);
+  outbuf_write(aw->ob, &footer_len, sizeof(footer_len));
+  memcpy(magic, ARROW_MAGIC, sizeof(magic));
+  outbuf_write(aw->ob, magic, sizeof(magic));
+  free(b.buf);
+
+  free(aw->signs);
+  free(aw->dates);
+  free(aw->categories);
+  free(aw->amounts);
+  free(aw->currencies);
+  free(aw->comment_offsets);
+  free(aw->comments);
+  free(aw->blocks);
+}
+
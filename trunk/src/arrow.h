@@ -0,0 +1,87 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   arrow.h contains prototypes for functions which write Apache Arrow IPC files
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef ARROW_H
+#define ARROW_H
+
+/* for size_t type */
+#include <stddef.h>
+
+/* for int32_t and int64_t types */
+#include <stdint.h>
+
+/* for struct record */
+#include "common.h"
+#include "outbuf.h"
+
+
+/** Count of records in one record batch */
+#define ARROW_BATCH_ROWS 65536
+
+/** Maximal size of comments in one record batch */
+#define ARROW_BATCH_COMMENTS (256 * 1024 * 1024)
+
+/** Location of record batch in file. Used for footer of file. */
+struct arrow_block {
+  int64_t offset;    /**< offset of message in file */
+  int32_t metalen;   /**< size of message metadata with prefix */
+  int64_t bodylen;   /**< size of message body */
+};
+
+/**
+ * Writer of Arrow IPC file.
+ *
+ * Records are collected in columns and written as record batches of
+ * \ref ARROW_BATCH_ROWS records. File has columns \c sign (utf8),
+ * \c date (date32), \c category (uint32), \c amount (decimal128 with
+ * scale 2), \c currency (utf8, null for amounts without currency code)
+ * and \c comment (utf8).
+ **/
+struct arrow_writer {
+  struct outbuf *ob;          /**< output */
+  size_t    rows;             /**< count of records in current batch */
+  char     *signs;            /**< column "sign" */
+  int32_t  *dates;            /**< column "date" (days since 01.01.1970) */
+  uint32_t *categories;       /**< column "category" */
+  int64_t  *amounts;          /**< column "amount" (in hundredths) */
+  uint32_t *currencies;       /**< column "currency" (packed codes or 0) */
+  int32_t  *comment_offsets;  /**< offsets of comments */
+  char     *comments;         /**< data of comments */
+  size_t    comments_size;    /**< size of buffer for comments */
+  struct arrow_block *blocks; /**< written record batches */
+  size_t    nblocks;          /**< count of written record batches */
+};
+
+
+void arrow_open(struct arrow_writer *aw, struct outbuf *ob);
+void arrow_append(struct arrow_writer *aw, const struct record *rec);
+void arrow_close(struct arrow_writer *aw);
+
+#endif /* ARROW_H */
+
@@ -0,0 +1,611 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   balance.c contains functions which work with balance checkpoints
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for open()
+ *     fstat()
+ **/
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* for flock() */
+#include <sys/file.h>
+
+/* for assert() */
+#include <assert.h>
+
+/* for open() */
+#include <fcntl.h>
+
+/* for pread()
+ *     write()
+ *     fsync()
+ *     close()
+ *     unlink()
+ **/
+#include <unistd.h>
+
+/* for printf()
+ *     fprintf()
+ *     perror()
+ *     rename()
+ *     NULL constant
+ **/
+#include <stdio.h>
+
+/* for malloc()
+ *     realloc()
+ *     free()
+ *     mkstemp()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memcmp()
+ *     memcpy()
+ *     memmove()
+ *     memset()
+ **/
+#include <string.h>
+
+#include "balance.h"
+#include "datafile.h"
+
+
+/** Magic string at start of checkpoint file */
+#define BALANCE_MAGIC "OFMB"
+
+/** Current version of checkpoint file format */
+#define BALANCE_VERSION 3
+
+/** Suffix of temporary file which will be renamed to checkpoint file */
+#define BALANCE_TMP_SUFFIX ".bal.XXXXXX"
+
+
+/**
+ * Initialize empty list of entries.
+ *
+ * @param bal entries
+ **/
+void
+balance_init(struct balance *bal)
+{
+  assert(bal != NULL);
+
+  bal->entries = NULL;
+  bal->count   = 0;
+  bal->alloc   = 0;
+}
+
+
+/**
+ * Free memory which was allocated for entries.
+ *
+ * @param bal entries
+ **/
+void
+balance_free(struct balance *bal)
+{
+  assert(bal != NULL);
+
+  free(bal->entries);
+  balance_init(bal);
+}
+
+
+/**
+ * Reserve memory for entries.
+ *
+ * @param bal entries
+ * @param count count of entries
+ **/
+static void
+balance_reserve(struct balance *bal, size_t count)
+{
+  if (count <= bal->alloc) {
+      return;
+  }
+
+  while (bal->alloc < count) {
+    bal->alloc = (bal->alloc == 0) ? 64 : bal->alloc * 2;
+  }
+  bal->entries = realloc(bal->entries, bal->alloc * sizeof(struct balance_entry));
+  if (bal->entries == NULL) {
+      fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+}
+
+
+/**
+ * Add record to changes of totals by days.
+ *
+ * Function finds entry for day of record with binary search and
+ * creates new one if it does not exist. Records usually come in order
+ * of days, so new entry is usually appended to the end.
+ *
+ * @param changes changes by days
+ * @param rec record
+ **/
+void
+balance_add(struct balance *changes, const struct record *rec)
+{
+  struct balance_entry *entry;
+  size_t  low, high, mid;
+  int32_t day;
+
+  assert(changes != NULL);
+  assert(rec != NULL);
+
+  day = (int32_t)date_to_days(rec->year, rec->month, rec->day);
+
+  /* search first entry which is not less than day */
+  low  = 0;
+  high = changes->count;
+  if (high > 0 && changes->entries[high - 1].day < day) {
+      low = high;
+  }
+  while (low < high) {
+    mid = low + (high - low) / 2;
+    if (changes->entries[mid].day < day) {
+        low = mid + 1;
+    } else {
+        high = mid;
+    }
+  }
+
+  if (low == changes->count || changes->entries[low].day != day) {
+      balance_reserve(changes, changes->count + 1);
+      entry = &changes->entries[low];
+      memmove(entry + 1, entry,
+              (changes->count - low) * sizeof(struct balance_entry));
+      changes->count++;
+
+      memset(entry, 0, sizeof(*entry));
+      entry->day = day;
+  }
+
+  entry = &changes->entries[low];
+  if (rec->sign == '-') {
+      entry->costs  += rec->amount;
+  } else {
+      entry->profit += rec->amount;
+  }
+  if (rec->currency != 0) {
+      entry->currency = 1;
+  }
+}
+
+
+/**
+ * Apply changes by days to checkpoints.
+ *
+ * Both lists are sorted by day, so they are merged in one pass: each
+ * checkpoint gets sum of all changes up to his day, and new
+ * checkpoints are created for days which had no records.
+ *
+ * @param bal checkpoints (will be replaced)
+ * @param changes changes by days
+ **/
+static void
+balance_merge(struct balance *bal, const struct balance *changes)
+{
+  struct balance merged;
+  struct balance_entry *out;
+  const struct balance_entry *old, *chg;
+  size_t  i, j;
+  int64_t profit, costs;         /* sum of changes so far */
+  int64_t old_profit, old_costs; /* last checkpoint before changes */
+  uint32_t currency, old_currency; /* currency codes were met */
+
+  balance_init(&merged);
+  balance_reserve(&merged, bal->count + changes->count);
+
+  profit = costs = old_profit = old_costs = 0;
+  currency = old_currency = 0;
+  for (i = j = 0; i < bal->count || j < changes->count; merged.count++) {
+    out = &merged.entries[merged.count];
+    old = (i < bal->count) ? &bal->entries[i] : NULL;
+    chg = (j < changes->count) ? &changes->entries[j] : NULL;
+
+    if (chg != NULL && (old == NULL || chg->day <= old->day)) {
+        profit   += chg->profit;
+        costs    += chg->costs;
+        currency |= chg->currency;
+        j++;
+    }
+    if (old != NULL && (chg == NULL || old->day <= chg->day)) {
+        old_profit   = old->profit;
+        old_costs    = old->costs;
+        old_currency = old->currency;
+        i++;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->day    = (old != NULL && (chg == NULL || old->day <= chg->day)) ?
+                  old->day : chg->day;
+    out->profit = old_profit + profit;
+    out->costs  = old_costs + costs;
+    out->currency = old_currency | currency;
+  }
+
+  balance_free(bal);
+  *bal = merged;
+}
+
+
+/**
+ * Read checkpoint file header and check that it describes data file:
+ * size, modification time (with nanoseconds where system keeps them)
+ * and inode should be the same.
+ *
+ * @param fd descriptor of checkpoint file
+ * @param st statistics about data file
+ * @param hdr header (output)
+ *
+ * @retval 0 file is broken or stale
+ * @retval 1 file is actual
+ **/
+static int
+balance_check(int fd, const struct stat *st, struct balance_header *hdr)
+{
+  struct stat bal_st;
+
+  return pread(fd, hdr, sizeof(*hdr), 0) == (ssize_t)sizeof(*hdr) &&
+         memcmp(hdr->magic, BALANCE_MAGIC, sizeof(hdr->magic)) == 0 &&
+         hdr->version == BALANCE_VERSION &&
+         hdr->dbsize  == (int64_t)st->st_size &&
+         hdr->dbmtime == (int64_t)st->st_mtime &&
+         hdr->dbnsec  == STAT_MTIME_NSEC(st) &&
+         hdr->dbino   == (int64_t)st->st_ino &&
+         fstat(fd, &bal_st) == 0 &&
+         (size_t)bal_st.st_size ==
+             sizeof(*hdr) + hdr->count * sizeof(struct balance_entry);
+}
+
+
+/**
+ * Open checkpoint file if it is actual.
+ *
+ * @param dbfile path to data file
+ * @param st statistics about data file
+ * @param hdr header (output)
+ *
+ * @return descriptor of checkpoint file or -1 when file does not exist,
+ * is broken or stale
+ **/
+static int
+balance_open(const char *dbfile, const struct stat *st,
+             struct balance_header *hdr)
+{
+  char *path;
+  int   fd;
+
+  path = get_side_file_path(dbfile, BALANCE_SUFFIX);
+  if (path == NULL) {
+      return -1;
+  }
+
+  fd = open(path, O_RDONLY);
+  free(path);
+  if (fd == -1) {
+      return -1;
+  }
+
+  if (!balance_check(fd, st, hdr)) {
+      close(fd);
+      return -1;
+  }
+
+  return fd;
+}
+
+
+/**
+ * Load all checkpoints.
+ *
+ * @param bal checkpoints, should be empty
+ * @param dbfile path to data file
+ * @param st statistics about data file
+ *
+ * @retval 0 checkpoint file does not exist, is broken or stale
+ * @retval 1 checkpoints were loaded
+ **/
+static int
+balance_load(struct balance *bal, const char *dbfile, const struct stat *st)
+{
+  struct balance_header hdr;
+  size_t size;
+  int    fd, ok;
+
+  fd = balance_open(dbfile, st, &hdr);
+  if (fd == -1) {
+      return 0;
+  }
+
+  balance_reserve(bal, hdr.count);
+  size = hdr.count * sizeof(struct balance_entry);
+  ok = (size == 0 ||
+        pread(fd, bal->entries, size, sizeof(hdr)) == (ssize_t)size);
+  bal->count = ok ? hdr.count : 0;
+
+  close(fd);
+
+  return ok;
+}
+
+
+/**
+ * Save checkpoints to checkpoint file.
+ *
+ * Checkpoints are written to temporary file which then renamed to
+ * checkpoint file. Errors are not fatal because checkpoints will be
+ * rebuilt when they are absent or stale.
+ *
+ * @param bal checkpoints
+ * @param dbfile path to data file
+ * @param st statistics about data file which is described by checkpoints
+ * @param verbose level of verbose
+ **/
+static void
+balance_save(const struct balance *bal, const char *dbfile,
+             const struct stat *st, unsigned int verbose)
+{
+  struct balance_header hdr;
+  char   *tmppath, *path;
+  size_t  size;
+  int     fd, ok;
+
+  if (verbose >= 2) {
+      printf("--> %s\n", _("Writing balance checkpoints"));
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, BALANCE_MAGIC, sizeof(hdr.magic));
+  hdr.version = BALANCE_VERSION;
+  hdr.count   = (uint32_t)bal->count;
+  hdr.dbsize  = (int64_t)st->st_size;
+  hdr.dbmtime = (int64_t)st->st_mtime;
+  hdr.dbnsec  = STAT_MTIME_NSEC(st);
+  hdr.dbino   = (int64_t)st->st_ino;
+
+  path    = get_side_file_path(dbfile, BALANCE_SUFFIX);
+  tmppath = get_side_file_path(dbfile, BALANCE_TMP_SUFFIX);
+  if (path == NULL || tmppath == NULL) {
+      free(path);
+      free(tmppath);
+      return;
+  }
+
+  fd = mkstemp(tmppath);
+  if (fd == -1) {
+      perror("mkstemp");
+      free(path);
+      free(tmppath);
+      return;
+  }
+
+  size = bal->count * sizeof(struct balance_entry);
+  ok = write(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+       (size == 0 || write(fd, bal->entries, size) == (ssize_t)size);
+  if (!ok) {
+      perror("write");
+  }
+
+  if (ok && fsync(fd) == -1) {
+      perror("fsync");
+      ok = 0;
+  }
+
+  if (close(fd) == -1) {
+      perror("close");
+      ok = 0;
+  }
+
+  if (ok && rename(tmppath, path) == -1) {
+      perror("rename");
+      ok = 0;
+  }
+
+  if (!ok) {
+      unlink(tmppath);
+  }
+
+  free(path);
+  free(tmppath);
+}
+
+
+/**
+ * Update checkpoints after records were appended to data file.
+ *
+ * Checkpoints are updated only when they described data file before
+ * appending. Otherwise nothing is done: checkpoints will be rebuilt at
+ * next query.
+ *
+ * @param dbfile path to data file
+ * @param before statistics about data file before appending
+ * @param after statistics about data file after appending
+ * @param changes totals of appended records by days
+ * @param verbose level of verbose
+ **/
+void
+balance_append(const char *dbfile, const struct stat *before,
+               const struct stat *after, const struct balance *changes,
+               unsigned int verbose)
+{
+  struct balance bal;
+
+  assert(dbfile != NULL);
+  assert(before != NULL);
+  assert(after != NULL);
+  assert(changes != NULL);
+
+  balance_init(&bal);
+  if (balance_load(&bal, dbfile, before)) {
+      balance_merge(&bal, changes);
+      balance_save(&bal, dbfile, after, verbose);
+  }
+  balance_free(&bal);
+}
+
+
+/** Callback for \ref scan_datafile() which accounts each record. */
+static void
+balance_rebuild_handler(const struct record *rec, void *data)
+{
+  balance_add((struct balance *)data, rec);
+}
+
+
+/**
+ * Find last checkpoint which is not later than day.
+ *
+ * Checkpoints are searched with binary search right in file, so only
+ * logarithmic count of entries is read.
+ *
+ * @param fd descriptor of checkpoint file
+ * @param count count of entries in file
+ * @param day number of day
+ * @param entry checkpoint (output, zero when all checkpoints are later)
+ *
+ * @retval 0 error occurs
+ * @retval 1 checkpoint was found
+ **/
+static int
+balance_search(int fd, size_t count, long day, struct balance_entry *entry)
+{
+  struct balance_entry cur;
+  size_t low, high, mid;
+
+  memset(entry, 0, sizeof(*entry));
+
+  /* search first entry which is later than day */
+  low  = 0;
+  high = count;
+  while (low < high) {
+    mid = low + (high - low) / 2;
+    if (pread(fd, &cur, sizeof(cur),
+              (off_t)(sizeof(struct balance_header) + mid * sizeof(cur))) !=
+        (ssize_t)sizeof(cur)) {
+        return 0;
+    }
+    if (cur.day <= day) {
+        low = mid + 1;
+        *entry = cur;
+    } else {
+        high = mid;
+    }
+  }
+
+  return 1;
+}
+
+
+/**
+ * Get totals of all records up to and including given day.
+ *
+ * Checkpoint file is rebuilt when it is absent or stale. If data file
+ * cannot be read then function will quit from program with failure
+ * exit code.
+ *
+ * @param dbfile path to data file
+ * @param day number of day (see \ref date_to_days())
+ * @param profit sum of profits (output)
+ * @param costs sum of costs (output)
+ * @param verbose level of verbose
+ *
+ * @retval 0 totals are ready
+ * @retval 1 some records up to day have currency codes, so totals mix
+ * currencies
+ **/
+int
+balance_as_of(const char *dbfile, long day, long long *profit,
+              long long *costs, unsigned int verbose)
+{
+  struct balance_header hdr;
+  struct balance_entry entry;
+  struct balance bal, changes;
+  struct stat st;
+  int fd, balfd, found;
+
+  assert(dbfile != NULL);
+  assert(profit != NULL);
+  assert(costs != NULL);
+
+  fd = open(dbfile, O_RDONLY);
+  if (fd == -1) {
+      fprintf(stderr, "%s: %s\n", _("Failed to open file"), dbfile);
+      perror("open");
+      exit(EXIT_FAILURE);
+  }
+
+  /* data file should not be changed while checkpoints are rebuilt */
+  if (flock(fd, LOCK_SH) == -1 || fstat(fd, &st) == -1) {
+      perror("flock");
+      exit(EXIT_FAILURE);
+  }
+
+  found = 0;
+  balfd = balance_open(dbfile, &st, &hdr);
+  if (balfd != -1) {
+      found = balance_search(balfd, hdr.count, day, &entry);
+      close(balfd);
+  }
+
+  if (!found) {
+      if (verbose >= 1) {
+          printf("-> %s\n", _("Rebuilding balance checkpoints..."));
+      }
+
+      balance_init(&changes);
+      scan_datafile(dbfile, verbose, balance_rebuild_handler, &changes);
+
+      balance_init(&bal);
+      balance_merge(&bal, &changes);
+      balance_free(&changes);
+
+      balance_save(&bal, dbfile, &st, verbose);
+
+      memset(&entry, 0, sizeof(entry));
+      for (found = 0; (size_t)found < bal.count &&
+                      bal.entries[found].day <= day; found++) {
+        entry = bal.entries[found];
+      }
+      balance_free(&bal);
+  }
+
+  /* closing of file also drops lock */
+  close(fd);
+
+  *profit = entry.profit;
+  *costs  = entry.costs;
+
+  return entry.currency != 0;
+}
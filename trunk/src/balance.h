@@ -0,0 +1,93 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   balance.h contains prototypes for functions which work with balance checkpoints
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef BALANCE_H
+#define BALANCE_H
+
+/* for struct stat */
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* for size_t type */
+#include <stddef.h>
+
+/* for uint32_t, int32_t and int64_t types */
+#include <stdint.h>
+
+/* for struct record */
+#include "common.h"
+
+
+/** Suffix of file with balance checkpoints. It lives near data file. */
+#define BALANCE_SUFFIX ".bal"
+
+/**
+ * Totals for one day.
+ *
+ * In checkpoint file entry contains totals of all records up to and
+ * including the day. Entries are sorted by day and stored after \ref
+ * balance_header, one entry for each day which has records.
+ **/
+struct balance_entry {
+  int32_t  day;      /**< number of day (see \ref date_to_days()) */
+  uint32_t currency; /**< nonzero if some records have currency codes */
+  int64_t  profit;   /**< sum of profits in hundredths */
+  int64_t  costs;    /**< sum of costs in hundredths */
+};
+
+/** Header of checkpoint file. */
+struct balance_header {
+  char     magic[4]; /**< always "OFMB" */
+  uint32_t version;  /**< version of file format */
+  uint32_t count;    /**< count of entries after header */
+  uint32_t reserved; /**< not used, always zero */
+  int64_t  dbsize;   /**< size of data file described by checkpoints */
+  int64_t  dbmtime;  /**< modification time of that data file */
+  int64_t  dbnsec;   /**< nanoseconds of that modification time */
+  int64_t  dbino;    /**< inode of that data file */
+};
+
+/** Entries sorted by day loaded to memory. */
+struct balance {
+  struct balance_entry *entries; /**< entries sorted by day */
+  size_t                count;   /**< count of used entries */
+  size_t                alloc;   /**< count of allocated entries */
+};
+
+
+void balance_init(struct balance *bal);
+void balance_free(struct balance *bal);
+void balance_add(struct balance *changes, const struct record *rec);
+void balance_append(const char *dbfile, const struct stat *before,
+                    const struct stat *after, const struct balance *changes,
+                    unsigned int verbose);
+int  balance_as_of(const char *dbfile, long day, long long *profit,
+                   long long *costs, unsigned int verbose);
+
+#endif /* BALANCE_H */
@@ -0,0 +1,558 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   batch.c contains functions which read data file by batches
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for open() */
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* for assert() */
+#include <assert.h>
+
+/* for open() */
+#include <fcntl.h>
+
+/* for close() */
+#include <unistd.h>
+
+/* for errno variable */
+#include <errno.h>
+
+/* for printf()
+ *     fprintf()
+ *     perror()
+ *     NULL constant
+ **/
+#include <stdio.h>
+
+/* for malloc()
+ *     realloc()
+ *     free()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memchr()
+ *     memmove()
+ **/
+#include <string.h>
+
+/* for time()
+ *     localtime_r()
+ **/
+#include <time.h>
+
+#include "batch.h"
+#include "checksum.h"
+#include "common.h"
+#include "datafile.h"
+#include "reader.h"
+
+
+/** Initial size of buffer for data file */
+#define BATCH_BUFFER_SIZE (1024 * 1024)
+
+/** Check that character is digit (without locale lookup) */
+#define IS_DIGIT(c) ((unsigned char)((c) - '0') < 10)
+
+/** Check that character is capital latin letter */
+#define IS_UPPER(c) ((unsigned char)((c) - 'A') < 26)
+
+
+/**
+ * Get current date as number yyyymmdd.
+ *
+ * Date is got once per reading of data file instead of once per
+ * record.
+ *
+ * @return today or maximal value if date is unknown
+ **/
+static unsigned long
+today_key(void)
+{
+  time_t    unix_time;
+  struct tm local_tm;
+
+  unix_time = time(NULL);
+  if (unix_time == (time_t)-1 || localtime_r(&unix_time, &local_tm) == NULL) {
+      return (unsigned long)-1;
+  }
+
+  return (unsigned long)(local_tm.tm_year + 1900) * 10000UL +
+         (unsigned long)(local_tm.tm_mon + 1) * 100UL +
+         (unsigned long)local_tm.tm_mday;
+}
+
+
+/**
+ * Validate and decode string into row of batch.
+ *
+ * This is fast path for usual records: all checks are done in one pass
+ * over string. Function accepts only strings which are accepted by
+ * \ref is_string_confirm_to_format() and \ref decode_record(), all
+ * other strings (including rare valid ones) are rejected and should be
+ * checked by those functions. That promise is checked by program
+ * difftest (see parser_check.c).
+ *
+ * @param s string (null-terminated)
+ * @param len length of string
+ * @param today current date as number yyyymmdd
+ * @param b batch
+ * @param row number of row
+ *
+ * @retval 0 string is rejected
+ * @retval 1 record was decoded
+ **/
+int
+batch_decode_fast(const char *s, size_t len, unsigned long today,
+                  struct record_batch *b, size_t row)
+{
+  const char *p, *start;
+  unsigned long day, month, year, category;
+  int64_t amount;
+  int digits;
+
+  if (len < 18 ||
+      (s[0] != '+' && s[0] != '-') || s[1] != '|' || s[12] != '|' ||
+      s[4] != '.' || s[7] != '.' ||
+      !IS_DIGIT(s[2]) || !IS_DIGIT(s[3]) || !IS_DIGIT(s[5]) ||
+      !IS_DIGIT(s[6]) || !IS_DIGIT(s[8]) || !IS_DIGIT(s[9]) ||
+      !IS_DIGIT(s[10]) || !IS_DIGIT(s[11])) {
+      return 0;
+  }
+
+  day   = (unsigned long)((s[2] - '0') * 10 + (s[3] - '0'));
+  month = (unsigned long)((s[5] - '0') * 10 + (s[6] - '0'));
+  year  = (unsigned long)((s[8] - '0') * 1000 + (s[9] - '0') * 100 +
+                          (s[10] - '0') * 10 + (s[11] - '0'));
+
+  /* rare dates (leap days and dates in future) are left for full check */
+  if (month == 0 || month > 12 || day == 0 ||
+      day > days_in_month[0][month] || year == 0 ||
+      year * 10000UL + month * 100UL + day > today) {
+      return 0;
+  }
+
+  /* category: up to 9 digits, longer ones are left for full check */
+  category = 0;
+  for (p = start = s + 13; IS_DIGIT(*p) && p - start < 9; p++) {
+    category = category * 10 + (unsigned long)(*p - '0');
+  }
+  if (p == start || *p != '|') {
+      return 0;
+  }
+
+  /* amount: integer part, up to 15 digits */
+  amount = 0;
+  for (start = ++p; IS_DIGIT(*p) && p - start < 15; p++) {
+    amount = amount * 10 + (*p - '0');
+  }
+  digits = (int)(p - start);
+  if (IS_DIGIT(*p)) {
+      return 0;
+  }
+  amount *= 100;
+
+  /* amount: fractional part, third digit rounds */
+  if (*p == '.' || *p == ',') {
+      p++;
+      if (IS_DIGIT(*p)) {
+          amount += (*p++ - '0') * 10;
+          digits++;
+          if (IS_DIGIT(*p)) {
+              amount += *p++ - '0';
+              if (IS_DIGIT(*p) && *p >= '5') {
+                  amount++;
+              }
+          }
+      }
+  }
+  if (digits == 0) {
+      return 0;
+  }
+
+  /* rest of amount */
+  while (IS_DIGIT(*p) || *p == '.' || *p == ',') {
+    p++;
+  }
+  b->currency[row] = 0;
+  if (*p == ' ' && IS_UPPER(p[1]) && IS_UPPER(p[2]) && IS_UPPER(p[3])) {
+      b->currency[row] = CURRENCY_CODE(p[1], p[2], p[3]);
+      p += 4;
+  }
+  if (*p != '|') {
+      return 0;
+  }
+
+  b->amount[row]   = amount;
+  b->negative[row] = -(int64_t)(s[0] == '-');
+  b->category[row] = category;
+  b->year[row]     = (uint16_t)year;
+  b->month[row]    = (uint8_t)month;
+  b->day[row]      = (uint8_t)day;
+  b->comment[row]  = p + 1;
+
+  return 1;
+}
+
+
+/**
+ * Prepare buffers for reading of data files.
+ *
+ * Buffers are reused for all files which are read with the scanner.
+ * Current date is got here once, so it is same for all files.
+ *
+ * @param s scanner (output)
+ * @param read_ahead nonzero when file should be read ahead by \ref reader
+ **/
+void
+batch_scanner_init(struct batch_scanner *s, int read_ahead)
+{
+  assert(s != NULL);
+
+  s->batch = malloc(sizeof(*s->batch));
+  s->size  = BATCH_BUFFER_SIZE;
+  s->buf   = malloc(s->size);
+  if (s->batch == NULL || s->buf == NULL) {
+      fprintf(stderr, "malloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+
+  s->today      = today_key();
+  s->read_ahead = read_ahead;
+  s->error      = 0;
+  s->fails      = 0;
+}
+
+
+/**
+ * Free buffers of scanner.
+ *
+ * @param s scanner
+ **/
+void
+batch_scanner_free(struct batch_scanner *s)
+{
+  assert(s != NULL);
+
+  free(s->buf);
+  free(s->batch);
+}
+
+
+/**
+ * Read data file by batches of lines and pass decoded records to
+ * handler.
+ *
+ * File is read with \ref reader_read(), which keeps several reads in
+ * flight. Work is done in stages over batch of \ref BATCH_LINES lines:
+ * first line boundaries are found in big buffer, then strings are validated
+ * and decoded into columns of \ref record_batch. Strings rejected by
+ * fast decoder are collected in selection vector and are checked by
+ * \ref is_string_confirm_to_format(), so messages about wrong lines
+ * are the same as in \ref scan_datafile(). Then batch is passed to
+ * handler, which may process columns without branches.
+ *
+ * Unlike \ref scan_datafile_batch() function doesn't quit from program
+ * when file can't be opened or has too many wrong lines, so caller may
+ * continue with other files.
+ *
+ * @param s scanner
+ * @param dbfile path to data file
+ * @param verbose level of verbose
+ * @param handler function which will be called for each batch
+ * @param data pointer which will be passed to handler
+ * @param count count of valid records in data file (output)
+ *
+ * @return \ref BATCH_OK on success, \ref BATCH_OPEN_FAILED (errno is
+ * saved in scanner) or \ref BATCH_WRONG_LINES on failure
+ **/
+batch_status
+batch_scan(struct batch_scanner *s, const char *dbfile, unsigned int verbose,
+           batch_handler handler, void *data, unsigned long *count)
+{
+  struct record_batch *b;
+  struct record rec;
+  struct reader reader;
+
+  /* strings of current batch */
+  char         *lines[BATCH_LINES];
+  size_t        lens[BATCH_LINES];
+  unsigned long linenos[BATCH_LINES];
+
+  /* selection vector for rejected strings */
+  uint16_t rejected[BATCH_LINES];
+  size_t   nrejected;
+
+  char     *nl;
+  size_t    len, pos, n, i, j;
+  ssize_t   rret; /* for storage reader_read() return value */
+  long long bufoffset; /* offset of buffer in data file */
+  unsigned long lineno, record_count;
+  int fd, eof, fails, dead;
+  batch_status status;
+
+  assert(s != NULL);
+  assert(dbfile != NULL);
+  assert(handler != NULL);
+  assert(count != NULL);
+
+  if (verbose >= 1) {
+      printf("-> %s (%s)\n", _("Open data file"), dbfile);
+  }
+
+  fd = open(dbfile, O_RDONLY);
+  if (fd == -1) {
+      s->error = errno;
+      return BATCH_OPEN_FAILED;
+  }
+
+  if (verbose >= 1) {
+      printf("-> %s\n", _("Reading data..."));
+  }
+
+  b = s->batch;
+
+  /* disk reads ahead while batches are decoded */
+  reader_open(&reader, fd, s->read_ahead);
+  if (verbose >= 2) {
+      printf("--> %s: %s\n", _("Way of reading"),
+             reader.backend == READER_URING  ? "io_uring" :
+             reader.backend == READER_THREAD ? "pread" : "read");
+  }
+
+  len = 0;
+  bufoffset = 0LL;
+  lineno = record_count = 0UL;
+  fails = 0;
+  eof = 0;
+  status = BATCH_OK;
+
+  while (!eof && status == BATCH_OK) {
+    /* fill buffer, one byte is reserved for terminator of last line */
+    if (len == s->size - 1) {
+        s->size *= 2;
+        s->buf = realloc(s->buf, s->size);
+        if (s->buf == NULL) {
+            fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+            exit(EXIT_FAILURE);
+        }
+    }
+    rret = reader_read(&reader, s->buf + len, s->size - 1 - len);
+    eof  = (rret == 0);
+    len += (size_t)rret;
+
+    pos = 0;
+    for (;;) {
+      /* stage 1: find boundaries of lines */
+      for (n = 0; n < BATCH_LINES && pos < len; pos = (size_t)(nl - s->buf) + 1) {
+        nl = memchr(s->buf + pos, '\n', len - pos);
+        if (nl == NULL) {
+            if (!eof) {
+                break;
+            }
+            /* last line without newline */
+            nl = s->buf + len;
+        }
+        *nl = '\0';
+        lineno++;
+
+        /* skip empty lines */
+        if (nl == s->buf + pos) {
+            continue;
+        }
+
+        /* checksum is not a part of comment */
+        lines[n] = s->buf + pos;
+        lens[n]  = checksum_strip(lines[n], (size_t)(nl - s->buf) - pos);
+
+        if (verbose >= 3) {
+            printf("---> %lu: '%s'\n", lineno, lines[n]);
+        }
+
+        linenos[n] = lineno;
+        b->offset[n] = bufoffset + (long long)pos;
+        n++;
+      }
+
+      if (n == 0) {
+          break;
+      }
+
+      /* stage 2: decode columns, route rejected strings aside */
+      nrejected = 0;
+      for (i = 0; i < n; i++) {
+        if (!batch_decode_fast(lines[i], lens[i], s->today, b, i)) {
+            rejected[nrejected++] = (uint16_t)i;
+        }
+      }
+
+      /* full check for rejected strings */
+      dead = 0;
+      for (j = 0; j < nrejected; j++) {
+        i = rejected[j];
+
+        if (fails == MAX_WRONG_LINES) {
+            break;
+        }
+
+        if (!is_string_confirm_to_format(lines[i], linenos[i])) {
+            fails++;
+            b->comment[i] = NULL;
+            dead++;
+            continue;
+        }
+        if (!decode_record(lines[i], &rec)) {
+            fprintf(stderr, "%lu: %s\n", linenos[i], _("Cannot decode record"));
+            fails++;
+            b->comment[i] = NULL;
+            dead++;
+            continue;
+        }
+
+        b->amount[i]   = rec.amount;
+        b->negative[i] = -(int64_t)(rec.sign == '-');
+        b->currency[i] = rec.currency;
+        b->category[i] = rec.category;
+        b->year[i]     = (uint16_t)rec.year;
+        b->month[i]    = (uint8_t)rec.month;
+        b->day[i]      = (uint8_t)rec.day;
+        b->comment[i]  = rec.comment;
+      }
+
+      /* any string after too many wrong lines stops reading */
+      if (fails == MAX_WRONG_LINES &&
+          (j < nrejected || nrejected == 0 || rejected[nrejected - 1] < n - 1)) {
+          status = BATCH_WRONG_LINES;
+          break;
+      }
+
+      /* remove wrong strings from columns */
+      if (dead > 0) {
+          for (i = j = 0; i < n; i++) {
+            if (b->comment[i] == NULL) {
+                continue;
+            }
+            b->amount[j]   = b->amount[i];
+            b->negative[j] = b->negative[i];
+            b->currency[j] = b->currency[i];
+            b->category[j] = b->category[i];
+            b->year[j]     = b->year[i];
+            b->month[j]    = b->month[i];
+            b->day[j]      = b->day[i];
+            b->comment[j]  = b->comment[i];
+            b->offset[j]   = b->offset[i];
+            j++;
+          }
+          n = j;
+      }
+
+      /* stage 3: handler processes columns */
+      b->count = n;
+      record_count += n;
+      if (n > 0) {
+          handler(b, data);
+      }
+    }
+
+    /* keep incomplete line for next reading */
+    if (pos > len) {
+        pos = len;
+    }
+    memmove(s->buf, s->buf + pos, len - pos);
+    bufoffset += (long long)pos;
+    len -= pos;
+  }
+
+  reader_close(&reader);
+  if (close(fd) == -1) {
+      perror("close");
+  }
+
+  s->fails = (unsigned long)fails;
+
+  if (status != BATCH_OK) {
+      return status;
+  }
+
+  if (verbose >= 1) {
+      printf(_("-> Reads %lu strings"), lineno);
+      if (lineno > record_count)
+          printf(_(" and %lu records"), record_count);
+      printf(" %s\n", _("from data file"));
+  }
+
+  *count = record_count;
+
+  return BATCH_OK;
+}
+
+
+/**
+ * Read data file by batches of lines and pass decoded records to
+ * handler.
+ *
+ * This is \ref batch_scan() with buffers for one file. If file can't
+ * be opened or too many wrong lines was found then function will quit
+ * from program with failure exit code.
+ *
+ * @param dbfile path to data file
+ * @param verbose level of verbose
+ * @param handler function which will be called for each batch
+ * @param data pointer which will be passed to handler
+ *
+ * @return count of valid records in data file
+ **/
+unsigned long
+scan_datafile_batch(const char *dbfile, unsigned int verbose,
+                    batch_handler handler, void *data)
+{
+  struct batch_scanner s;
+  unsigned long record_count;
+  batch_status status;
+
+  batch_scanner_init(&s, 1);
+  status = batch_scan(&s, dbfile, verbose, handler, data, &record_count);
+  batch_scanner_free(&s);
+
+  switch (status) {
+      case BATCH_OPEN_FAILED:
+          fprintf(stderr, "%s: %s\n", _("Failed to open file"), dbfile);
+          errno = s.error;
+          perror("open");
+          exit(EXIT_FAILURE);
+      case BATCH_WRONG_LINES:
+          fprintf(stderr, _("Too many wrong lines in database. Exit.\n"));
+          exit(EXIT_FAILURE);
+      default:
+          break;
+  }
+
+  return record_count;
+}
@@ -0,0 +1,105 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   batch.h contains prototypes for functions which read data file by batches
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+/* for size_t type */
+#include <stddef.h>
+
+/* for int64_t and uint*_t types */
+#include <stdint.h>
+
+
+/** Count of lines in one batch */
+#define BATCH_LINES 1024
+
+/**
+ * Decoded records in columnar form.
+ *
+ * Only valid records are kept in batch, so handler may process columns
+ * without checks.
+ **/
+struct record_batch {
+  size_t        count;                 /**< count of records */
+  int64_t       amount[BATCH_LINES];   /**< amounts in hundredths */
+  int64_t       negative[BATCH_LINES]; /**< -1 for costs and 0 for profits */
+  unsigned long category[BATCH_LINES]; /**< numbers of categories */
+  uint32_t      currency[BATCH_LINES]; /**< currencies or 0 */
+  uint16_t      year[BATCH_LINES];     /**< years */
+  uint8_t       month[BATCH_LINES];    /**< months */
+  uint8_t       day[BATCH_LINES];      /**< days of month */
+  const char   *comment[BATCH_LINES];  /**< comments (null-terminated) */
+  long long     offset[BATCH_LINES];   /**< offsets of strings in data file */
+};
+
+/**
+ * Function which will be called for each batch of records.
+ *
+ * @param batch decoded records
+ * @param data pointer which was passed to \ref scan_datafile_batch()
+ **/
+typedef void (*batch_handler)(const struct record_batch *batch, void *data);
+
+/** Results of \ref batch_scan() */
+typedef enum {
+  BATCH_OK,          /**< file was read */
+  BATCH_OPEN_FAILED, /**< file can't be opened */
+  BATCH_WRONG_LINES  /**< too many wrong lines in file */
+} batch_status;
+
+/**
+ * Buffers for reading of data files.
+ *
+ * Scanner may be used for many files one after another, so buffers are
+ * allocated only once. Each thread should have own scanner.
+ **/
+struct batch_scanner {
+  struct record_batch *batch;      /**< decoded records */
+  char                *buf;        /**< buffer for strings */
+  size_t               size;       /**< size of buffer */
+  unsigned long        today;      /**< current date as yyyymmdd */
+  int                  read_ahead; /**< read files ahead */
+  int                  error;      /**< errno of last failed open() */
+  unsigned long        fails;      /**< count of wrong lines in last file */
+};
+
+
+void batch_scanner_init(struct batch_scanner *s, int read_ahead);
+void batch_scanner_free(struct batch_scanner *s);
+batch_status batch_scan(struct batch_scanner *s, const char *dbfile,
+                        unsigned int verbose, batch_handler handler,
+                        void *data, unsigned long *count);
+unsigned long scan_datafile_batch(const char *dbfile, unsigned int verbose,
+                                  batch_handler handler, void *data);
+int batch_decode_fast(const char *s, size_t len, unsigned long today,
+                      struct record_batch *b, size_t row);
+
+#endif /* BATCH_H */
+
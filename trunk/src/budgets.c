@@ -0,0 +1,321 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   budgets.c contains functions which check monthly budgets of categories
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for assert() */
+#include <assert.h>
+
+/* for fprintf()
+ *     fopen()
+ *     getline()
+ *     fclose()
+ *     perror()
+ *     FILE and NULL constants
+ **/
+#include <stdio.h>
+
+/* for realloc()
+ *     free()
+ *     qsort()
+ *     bsearch()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memset()
+ *     strchr()
+ **/
+#include <string.h>
+
+#include "budgets.h"
+
+
+/** Check that character is digit (without locale lookup) */
+#define IS_DIGIT(c) ((unsigned char)((c) - '0') < 10)
+
+
+/**
+ * Print error in budgets file and quit from program.
+ *
+ * @param filename name of file
+ * @param lineno number of line
+ * @param msg message
+ **/
+static void
+budgets_error(const char *filename, unsigned long lineno, const char *msg)
+{
+  fprintf(stderr, "%s:%lu: %s\n", filename, lineno, msg);
+  exit(EXIT_FAILURE);
+}
+
+
+/**
+ * Parse number of category.
+ *
+ * @param str string (up to separator '|')
+ * @param category number (output)
+ *
+ * @return pointer after separator or NULL for wrong number
+ **/
+static const char *
+parse_category(const char *str, unsigned long *category)
+{
+  const char *p;
+
+  *category = 0UL;
+  for (p = str; IS_DIGIT(*p) && p - str < 9; p++) {
+    *category = *category * 10 + (unsigned long)(*p - '0');
+  }
+
+  return (p == str || *p != '|') ? NULL : p + 1;
+}
+
+
+/**
+ * Parse amount: digits with optional point or comma and up to two
+ * digits after it.
+ *
+ * @param str string
+ * @param amount amount in hundredths (output)
+ *
+ * @retval 0 wrong amount
+ * @retval 1 amount was parsed
+ **/
+static int
+parse_amount(const char *str, int64_t *amount)
+{
+  const char *p;
+  int digits;
+
+  *amount = 0;
+  for (p = str; IS_DIGIT(*p) && p - str < 15; p++) {
+    *amount = *amount * 10 + (*p - '0');
+  }
+  if (p == str) {
+      return 0;
+  }
+  *amount *= 100;
+
+  if (*p == '.' || *p == ',') {
+      for (p++, digits = 0; IS_DIGIT(*p) && digits < 2; p++, digits++) {
+        *amount += (*p - '0') * (digits == 0 ? 10 : 1);
+      }
+  }
+
+  return *p == '\0';
+}
+
+
+/** Order of budgets: by category, year and month */
+static int
+compare_budgets(const void *a, const void *b)
+{
+  const struct budget *x = a, *y = b;
+
+  if (x->category != y->category) {
+      return (x->category < y->category) ? -1 : 1;
+  }
+  if (x->year != y->year) {
+      return (x->year < y->year) ? -1 : 1;
+  }
+  if (x->month != y->month) {
+      return (x->month < y->month) ? -1 : 1;
+  }
+  return 0;
+}
+
+
+/**
+ * Load budgets from file.
+ *
+ * Empty lines and lines which start with '#' are skipped. On error
+ * function quits from program.
+ *
+ * @param budgets budgets (output)
+ * @param filename name of file
+ **/
+void
+budgets_load(struct budgets *budgets, const char *filename)
+{
+  struct budget *b;
+  FILE   *fp;
+  char   *line = NULL;
+  size_t  line_size = 0;
+  ssize_t len;
+  unsigned long lineno;
+  const char *p;
+  size_t  i;
+
+  assert(budgets != NULL);
+  assert(filename != NULL);
+
+  memset(budgets, 0, sizeof(*budgets));
+
+  fp = fopen(filename, "r");
+  if (fp == NULL) {
+      fprintf(stderr, "%s: %s\n", _("Failed to open file"), filename);
+      perror("fopen");
+      exit(EXIT_FAILURE);
+  }
+
+  for (lineno = 1; (len = getline(&line, &line_size, fp)) != -1; lineno++) {
+    if (len > 0 && line[len - 1] == '\n') {
+        line[--len] = '\0';
+    }
+    if (len == 0 || line[0] == '#') {
+        continue;
+    }
+
+    budgets->items = realloc(budgets->items,
+                             (budgets->count + 1) * sizeof(struct budget));
+    if (budgets->items == NULL) {
+        fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+        exit(EXIT_FAILURE);
+    }
+    b = &budgets->items[budgets->count];
+    b->year  = 0;
+    b->month = 0;
+
+    /* optional month */
+    p = line;
+    if (len > 8 && line[2] == '.' && line[7] == '|') {
+        if (!IS_DIGIT(line[0]) || !IS_DIGIT(line[1]) ||
+            !IS_DIGIT(line[3]) || !IS_DIGIT(line[4]) ||
+            !IS_DIGIT(line[5]) || !IS_DIGIT(line[6])) {
+            budgets_error(filename, lineno, _("Budget should look like [mm.yyyy|]category|amount"));
+        }
+        b->month = (unsigned int)((line[0] - '0') * 10 + (line[1] - '0'));
+        b->year  = (unsigned int)((line[3] - '0') * 1000 + (line[4] - '0') * 100 +
+                                  (line[5] - '0') * 10 + (line[6] - '0'));
+        if (!is_valid_date(b->year, b->month, 1)) {
+            budgets_error(filename, lineno, _("Invalid number of month"));
+        }
+        p = line + 8;
+    }
+
+    p = parse_category(p, &b->category);
+    if (p == NULL || !parse_amount(p, &b->limit)) {
+        budgets_error(filename, lineno, _("Budget should look like [mm.yyyy|]category|amount"));
+    }
+
+    budgets->count++;
+  }
+
+  free(line);
+  if (fclose(fp) != 0) {
+      perror("fclose");
+  }
+
+  qsort(budgets->items, budgets->count, sizeof(struct budget), compare_budgets);
+  for (i = 1; i < budgets->count; i++) {
+    if (compare_budgets(&budgets->items[i - 1], &budgets->items[i]) == 0) {
+        fprintf(stderr, "%s: %s: %lu\n", filename, _("Budget is defined twice"),
+                budgets->items[i].category);
+        exit(EXIT_FAILURE);
+    }
+  }
+}
+
+
+/**
+ * Free budgets.
+ *
+ * @param budgets budgets
+ **/
+void
+budgets_free(struct budgets *budgets)
+{
+  assert(budgets != NULL);
+
+  free(budgets->items);
+  memset(budgets, 0, sizeof(*budgets));
+}
+
+
+/**
+ * Check that cost does not exceed budget of its category and month.
+ *
+ * Costs of month are taken from summary of data file, so check doesn't
+ * read records. Exchange rates are not used, so costs with currency
+ * codes cannot be compared with budget.
+ *
+ * @param budgets budgets
+ * @param sum summary of data file without record
+ * @param rec new record
+ * @param spent costs of month with record (output)
+ * @param limit budget of month (output)
+ *
+ * @retval 0 record is profit, category has no budget or budget is enough
+ * @retval 1 budget is exceeded
+ * @retval -1 record or costs of month have currency codes
+ **/
+int
+budgets_check(const struct budgets *budgets, const struct summary *sum,
+              const struct record *rec, int64_t *spent, int64_t *limit)
+{
+  const struct summary_entry *entry;
+  const struct budget *found;
+  struct budget key;
+
+  assert(budgets != NULL);
+  assert(sum != NULL);
+  assert(rec != NULL);
+  assert(spent != NULL);
+  assert(limit != NULL);
+
+  if (rec->sign != '-') {
+      return 0;
+  }
+
+  /* budget for this month, then budget for every month */
+  key.category = rec->category;
+  key.year     = rec->year;
+  key.month    = rec->month;
+  found = bsearch(&key, budgets->items, budgets->count,
+                  sizeof(struct budget), compare_budgets);
+  if (found == NULL) {
+      key.year  = 0;
+      key.month = 0;
+      found = bsearch(&key, budgets->items, budgets->count,
+                      sizeof(struct budget), compare_budgets);
+      if (found == NULL) {
+          return 0;
+      }
+  }
+
+  entry = summary_find(sum, rec->year, rec->month, rec->category);
+  if (rec->currency != 0 || (entry != NULL && entry->currency)) {
+      return -1;
+  }
+
+  *limit = found->limit;
+  *spent = ((entry != NULL) ? entry->costs : 0) + rec->amount;
+
+  return *spent > *limit;
+}
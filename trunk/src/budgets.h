@@ -0,0 +1,73 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   budgets.h contains prototypes for functions which check monthly budgets of categories
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef BUDGETS_H
+#define BUDGETS_H
+
+/* for size_t type */
+#include <stddef.h>
+
+/* for int64_t type */
+#include <stdint.h>
+
+/* for struct record */
+#include "common.h"
+
+/* for struct summary */
+#include "summary.h"
+
+
+/** Limit of costs for category in month */
+struct budget {
+  unsigned long category; /**< number of category */
+  unsigned int  year;     /**< year or 0 for every month */
+  unsigned int  month;    /**< month or 0 for every month */
+  int64_t       limit;    /**< limit in hundredths */
+};
+
+/**
+ * Budgets loaded from file.
+ *
+ * Line <tt>category|amount</tt> sets limit for every month and line
+ * <tt>mm.yyyy|category|amount</tt> sets limit for one month. Budgets
+ * are sorted by (category, year, month), so limit is found with binary
+ * search.
+ **/
+struct budgets {
+  struct budget *items; /**< sorted budgets */
+  size_t         count; /**< count of budgets */
+};
+
+
+void budgets_load(struct budgets *budgets, const char *filename);
+void budgets_free(struct budgets *budgets);
+int  budgets_check(const struct budgets *budgets, const struct summary *sum,
+                   const struct record *rec, int64_t *spent, int64_t *limit);
+
+#endif /* BUDGETS_H */
@@ -0,0 +1,549 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   checksum.c contains functions which work with checksums of records
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for open() */
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* for flock() */
+#include <sys/file.h>
+
+/* for assert() */
+#include <assert.h>
+
+/* for open() */
+#include <fcntl.h>
+
+/* for close() */
+#include <unistd.h>
+
+/* for pthread_once() */
+#include <pthread.h>
+
+/* for printf()
+ *     fprintf()
+ *     perror()
+ *     NULL constant
+ **/
+#include <stdio.h>
+
+/* for malloc()
+ *     realloc()
+ *     free()
+ *     getenv()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memchr()
+ *     memcpy()
+ *     memmove()
+ *     strcmp()
+ **/
+#include <string.h>
+
+/* for ispunct() */
+#include <ctype.h>
+
+#include "checksum.h"
+#include "common.h"
+#include "reader.h"
+
+/* CRC32C instruction of SSE4.2 is used when processor has him */
+#if defined(HAVE_NMMINTRIN_H) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#  define CRC32C_SSE42
+   /* for _mm_crc32_*() */
+#  include <nmmintrin.h>
+#endif
+
+
+/** Environment variable which forces table implementation (for testing) */
+#define CHECKSUM_ENV "OPENFM_CRC32C"
+
+/** Initial size of buffer for data file */
+#define VERIFY_BUFFER_SIZE (1024 * 1024)
+
+/** Reversed polynomial of CRC32C (Castagnoli) */
+#define CRC32C_POLY 0x82F63B78U
+
+
+/** Tables for slicing-by-8 implementation */
+static uint32_t crc32c_table[8][256];
+
+/** Implementation which is chosen at first call of \ref crc32c() */
+static uint32_t (*crc32c_impl)(uint32_t crc, const unsigned char *p, size_t len);
+
+/** Guard for \ref crc32c_init() */
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+
+/**
+ * Update CRC32C with table lookups, eight bytes per step.
+ *
+ * @param crc current value (not inverted)
+ * @param p data
+ * @param len size of data
+ *
+ * @return new value
+ **/
+static uint32_t
+crc32c_sw(uint32_t crc, const unsigned char *p, size_t len)
+{
+  while (len >= 8) {
+    crc ^= (uint32_t)p[0] | (uint32_t)p[1] << 8 |
+           (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    crc = crc32c_table[7][crc & 0xFF] ^
+          crc32c_table[6][(crc >> 8) & 0xFF] ^
+          crc32c_table[5][(crc >> 16) & 0xFF] ^
+          crc32c_table[4][crc >> 24] ^
+          crc32c_table[3][p[4]] ^
+          crc32c_table[2][p[5]] ^
+          crc32c_table[1][p[6]] ^
+          crc32c_table[0][p[7]];
+    p   += 8;
+    len -= 8;
+  }
+
+  while (len-- > 0) {
+    crc = crc32c_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+  }
+
+  return crc;
+}
+
+
+#ifdef CRC32C_SSE42
+/**
+ * Update CRC32C with instruction of SSE4.2.
+ *
+ * @param crc current value (not inverted)
+ * @param p data
+ * @param len size of data
+ *
+ * @return new value
+ **/
+static uint32_t __attribute__((target("sse4.2")))
+crc32c_hw(uint32_t crc, const unsigned char *p, size_t len)
+{
+#ifdef __x86_64__
+  uint64_t crc64 = crc;
+  uint64_t word;
+
+  while (len >= 8) {
+    memcpy(&word, p, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+    p   += 8;
+    len -= 8;
+  }
+  crc = (uint32_t)crc64;
+#else
+  uint32_t word;
+
+  while (len >= 4) {
+    memcpy(&word, p, 4);
+    crc = _mm_crc32_u32(crc, word);
+    p   += 4;
+    len -= 4;
+  }
+#endif
+
+  while (len-- > 0) {
+    crc = _mm_crc32_u8(crc, *p++);
+  }
+
+  return crc;
+}
+#endif /* CRC32C_SSE42 */
+
+
+/**
+ * Build tables and choose implementation of CRC32C.
+ *
+ * Instruction of SSE4.2 is used when processor supports him, unless
+ * variable OPENFM_CRC32C has value "table".
+ **/
+static void
+crc32c_init(void)
+{
+  uint32_t crc;
+  int i, j;
+#ifdef CRC32C_SSE42
+  const char *force;
+#endif
+
+  for (i = 0; i < 256; i++) {
+    crc = (uint32_t)i;
+    for (j = 0; j < 8; j++) {
+      crc = (crc >> 1) ^ (CRC32C_POLY & (0U - (crc & 1U)));
+    }
+    crc32c_table[0][i] = crc;
+  }
+  for (i = 0; i < 256; i++) {
+    for (j = 1; j < 8; j++) {
+      crc32c_table[j][i] = (crc32c_table[j - 1][i] >> 8) ^
+                           crc32c_table[0][crc32c_table[j - 1][i] & 0xFF];
+    }
+  }
+
+  crc32c_impl = crc32c_sw;
+
+#ifdef CRC32C_SSE42
+  force = getenv(CHECKSUM_ENV);
+  if ((force == NULL || strcmp(force, "table") != 0) &&
+      __builtin_cpu_supports("sse4.2")) {
+      crc32c_impl = crc32c_hw;
+  }
+#endif
+}
+
+
+/**
+ * Calculate CRC32C (Castagnoli) of data.
+ *
+ * @param crc value for previous data or 0
+ * @param data data
+ * @param len size of data
+ *
+ * @return CRC32C
+ **/
+uint32_t
+crc32c(uint32_t crc, const void *data, size_t len)
+{
+  assert(data != NULL || len == 0);
+
+  pthread_once(&crc32c_once, crc32c_init);
+
+  return ~crc32c_impl(~crc, data, len);
+}
+
+
+/**
+ * Find checksum suffix of record.
+ *
+ * Suffix is "|~" and CRC32C of the rest of string as 8 lowercase hex
+ * digits. Strings without suffix are valid records too.
+ *
+ * @param line string without newline
+ * @param len length of string
+ * @param stored checksum from suffix (output, may be NULL)
+ *
+ * @retval 0 string has no suffix
+ * @retval 1 string has suffix
+ **/
+int
+checksum_split(const char *line, size_t len, uint32_t *stored)
+{
+  const char *p;
+  uint32_t value;
+  int i;
+
+  assert(line != NULL);
+
+  if (len < CHECKSUM_SUFFIX_LEN) {
+      return 0;
+  }
+
+  p = line + len - CHECKSUM_SUFFIX_LEN;
+  if (p[0] != '|' || p[1] != '~') {
+      return 0;
+  }
+
+  value = 0U;
+  for (i = 2; i < CHECKSUM_SUFFIX_LEN; i++) {
+    if (p[i] >= '0' && p[i] <= '9') {
+        value = value << 4 | (uint32_t)(p[i] - '0');
+    } else if (p[i] >= 'a' && p[i] <= 'f') {
+        value = value << 4 | (uint32_t)(p[i] - 'a' + 10);
+    } else {
+        return 0;
+    }
+  }
+
+  if (stored != NULL) {
+      *stored = value;
+  }
+
+  return 1;
+}
+
+
+/**
+ * Cut checksum suffix from null-terminated string.
+ *
+ * Used by readers of data file, so suffix doesn't become part of
+ * comment.
+ *
+ * @param line string without newline
+ * @param len length of string
+ *
+ * @return length of string without suffix
+ **/
+size_t
+checksum_strip(char *line, size_t len)
+{
+  if (checksum_split(line, len, NULL)) {
+      len -= CHECKSUM_SUFFIX_LEN;
+      line[len] = '\0';
+  }
+
+  return len;
+}
+
+
+/**
+ * Build checksum suffix for record.
+ *
+ * @param suffix buffer for \ref CHECKSUM_SUFFIX_LEN bytes (output, not
+ * null-terminated)
+ * @param line record without newline
+ * @param len length of record
+ **/
+void
+checksum_format(char *suffix, const char *line, size_t len)
+{
+  static const char hex[] = "0123456789abcdef";
+  uint32_t crc;
+  int i;
+
+  assert(suffix != NULL);
+  assert(line != NULL);
+
+  crc = crc32c(0U, line, len);
+
+  suffix[0] = '|';
+  suffix[1] = '~';
+  for (i = CHECKSUM_SUFFIX_LEN - 1; i >= 2; i--) {
+    suffix[i] = hex[crc & 0xF];
+    crc >>= 4;
+  }
+}
+
+
+/** Check that character is lowercase hex digit of checksum suffix */
+#define IS_SUFFIX_HEX(c) \
+    (((c) >= '0' && (c) <= '9') || ((c) >= 'a' && (c) <= 'f'))
+
+/**
+ * Check that string ends with damaged checksum suffix.
+ *
+ * Suffix is damaged when "|~" is followed by something else than 8 hex
+ * digits, or when 8 hex digits follow "~" with wrong separator or
+ * "|" with punctuation instead of "~". Such strings are corrupted
+ * records, not records without checksum.
+ *
+ * @param line string without newline
+ * @param len length of string
+ *
+ * @retval 0 string has no suffix or suffix is fine
+ * @retval 1 suffix is damaged
+ **/
+static int
+checksum_damaged(const char *line, size_t len)
+{
+  const char *p;
+  int i;
+
+  if (len < CHECKSUM_SUFFIX_LEN || checksum_split(line, len, NULL)) {
+      return 0;
+  }
+
+  p = line + len - CHECKSUM_SUFFIX_LEN;
+  if (p[0] == '|' && p[1] == '~') {
+      return 1;
+  }
+
+  for (i = 2; i < CHECKSUM_SUFFIX_LEN; i++) {
+    if (!IS_SUFFIX_HEX(p[i])) {
+        return 0;
+    }
+  }
+
+  return p[1] == '~' || (p[0] == '|' && ispunct((unsigned char)p[1]));
+}
+
+
+/**
+ * Print range of corrupted lines.
+ *
+ * @param first first line of range
+ * @param last last line of range
+ **/
+static void
+print_range(unsigned long first, unsigned long last)
+{
+  if (first == last) {
+      printf("%s %lu\n", _("Corrupted lines:"), first);
+  } else {
+      printf("%s %lu-%lu\n", _("Corrupted lines:"), first, last);
+  }
+}
+
+
+/**
+ * Check checksums of all records in data file.
+ *
+ * Strings are not validated or decoded: only checksum suffix is found
+ * and compared with CRC32C of string, so data file is checked at speed
+ * of reading. Ranges of consecutive corrupted strings are printed as
+ * they are found, then totals are printed. Strings without suffix
+ * can't be checked and are only counted, but strings with damaged
+ * suffix (see checksum_damaged()) are corrupted.
+ *
+ * If data file can't be read then function will quit from program with
+ * failure exit code.
+ *
+ * @param dbfile path to data file
+ * @param verbose level of verbose
+ *
+ * @return count of corrupted strings
+ **/
+unsigned long
+verify_datafile(const char *dbfile, unsigned int verbose)
+{
+  struct reader reader;
+  char    *buf, *line, *nl;
+  size_t   size, len, pos;
+  ssize_t  rret; /* for storage reader_read() return value */
+  uint32_t stored;
+  unsigned long lineno, lines, unchecked, corrupted;
+  unsigned long first, last; /* current range of corrupted lines */
+  int fd, eof;
+
+  assert(dbfile != NULL);
+
+  if (verbose >= 1) {
+      printf("-> %s (%s)\n", _("Open data file"), dbfile);
+  }
+
+  fd = open(dbfile, O_RDONLY);
+  if (fd == -1) {
+      fprintf(stderr, "%s: %s\n", _("Failed to open file"), dbfile);
+      perror("open");
+      exit(EXIT_FAILURE);
+  }
+
+  /* records which are appended now are not checked */
+  if (flock(fd, LOCK_SH) == -1) {
+      perror("flock");
+      exit(EXIT_FAILURE);
+  }
+
+  size = VERIFY_BUFFER_SIZE;
+  buf  = malloc(size);
+  if (buf == NULL) {
+      fprintf(stderr, "malloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+
+  reader_open(&reader, fd, 1);
+
+  len = 0;
+  lineno = lines = unchecked = corrupted = 0UL;
+  first = last = 0UL;
+  eof = 0;
+
+  while (!eof) {
+    if (len == size) {
+        size *= 2;
+        buf = realloc(buf, size);
+        if (buf == NULL) {
+            fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+            exit(EXIT_FAILURE);
+        }
+    }
+    rret = reader_read(&reader, buf + len, size - len);
+    eof  = (rret == 0);
+    len += (size_t)rret;
+
+    for (pos = 0; pos < len; pos = (size_t)(nl - buf) + 1) {
+      line = buf + pos;
+      nl = memchr(line, '\n', len - pos);
+      if (nl == NULL) {
+          if (!eof) {
+              break;
+          }
+          /* last line without newline */
+          nl = buf + len;
+      }
+      lineno++;
+
+      /* skip empty lines */
+      if (nl == line) {
+          continue;
+      }
+      lines++;
+
+      if (!checksum_split(line, (size_t)(nl - line), &stored)) {
+          if (!checksum_damaged(line, (size_t)(nl - line))) {
+              unchecked++;
+              continue;
+          }
+      } else if (crc32c(0U, line, (size_t)(nl - line) -
+                        CHECKSUM_SUFFIX_LEN) == stored) {
+          continue;
+      }
+
+      corrupted++;
+      if (last != 0UL && last == lineno - 1) {
+          last = lineno;
+          continue;
+      }
+      if (last != 0UL) {
+          print_range(first, last);
+      }
+      first = last = lineno;
+    }
+
+    /* keep incomplete line for next reading */
+    if (pos > len) {
+        pos = len;
+    }
+    memmove(buf, buf + pos, len - pos);
+    len -= pos;
+  }
+
+  if (last != 0UL) {
+      print_range(first, last);
+  }
+
+  reader_close(&reader);
+  free(buf);
+
+  /* closing of file also drops lock */
+  if (close(fd) == -1) {
+      perror("close");
+  }
+
+  printf(_("Checked: %lu lines, %lu without checksum, %lu corrupted\n"),
+         lines, unchecked, corrupted);
+
+  return corrupted;
+}
@@ -0,0 +1,50 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   checksum.h contains prototypes for functions which work with checksums of records
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+/* for size_t type */
+#include <stddef.h>
+
+/* for uint32_t type */
+#include <stdint.h>
+
+
+/** Length of checksum suffix of record: "|~" and 8 hex digits */
+#define CHECKSUM_SUFFIX_LEN 10
+
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t len);
+int      checksum_split(const char *line, size_t len, uint32_t *stored);
+size_t   checksum_strip(char *line, size_t len);
+void     checksum_format(char *suffix, const char *line, size_t len);
+unsigned long verify_datafile(const char *dbfile, unsigned int verbose);
+
+#endif /* CHECKSUM_H */
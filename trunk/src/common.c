@@ -36,22 +36,9 @@
 /* for assert() */
 #include <assert.h>
 
-/* for stat()
- *     fcntl()
- *     write()
- *     fsync()
- *     close()
- **/
+/* for stat() */
 #include <unistd.h>
 
-#if 0
-/* for add_record_to_file() */
-/* for open()
- *     fcntl()
- **/
-#include <fcntl.h>
-#endif /* 0 */
-
 /* for isdigit() */
 #include <ctype.h>
 
@@ -61,19 +48,17 @@
  **/
 #include <stdio.h>
 
-#if 0
-/* for add_record_to_file() */
-/* for exit() */
+/* for malloc() */
 #include <stdlib.h>
-#endif /* 0 */
 
 /* for strlen()
  *     strchr()
+ *     memcpy()
  * */
 #include <string.h>
 
 /* for time()
- *     localtime()
+ *     localtime_r()
  *     __isleap macros
  **/
 #include <time.h>
@@ -99,6 +84,33 @@
 /* for gettext&co stuff */
 #include "common.h"
 
+/* NLS is defined in config.h, which is included by common.h */
+#ifdef NLS
+   /* for setlocale() */
+   #include <locale.h>
+
+#endif /* NLS */
+
+
+/** Floor of division, also for negative dividend */
+#define FLOOR_DIV(a, b) ((a) >= 0 ? (a) / (b) : ((a) - (b) + 1) / (b))
+
+/** Number of day 01.01.1970 counted from 01.01.0001 */
+#define DAYS_BEFORE_EPOCH 719162L
+
+
+/** Count of days in month for usual (0) and leap (1) years */
+const unsigned char days_in_month[2][13] = {
+  { 0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 },
+  { 0, 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 }
+};
+
+/** Count of days before month for usual (0) and leap (1) years */
+static const unsigned short days_before_month[2][13] = {
+  { 0, 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 },
+  { 0, 0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335 }
+};
+
 
 /**
  * Print error message with number of line when error was found.
@@ -109,6 +121,9 @@
 #define PRINTLN(msg) \
     fprintf(stderr, "%lu: %s\n", lineno, _(msg))
 
+/** Check that character is capital latin letter (without locale) */
+#define IS_CAPITAL(c) ((c) >= 'A' && (c) <= 'Z')
+
 /** Likewise \ref PRINTLN but have one digital argument */
 #define PRINTLN1(msg, arg) \
     fprintf(stderr, "%lu: %s: %d\n", lineno, _(msg), arg)
@@ -135,8 +150,11 @@
  * -# sign -- should be '+' or '-' only. It is says to program: costs
  *    or profit.
  * -# date in format \c "dd.mm.yyyy"
- * -# category should be in numerical format
- * -# amount of profit/costs (depends on first field)
+ * -# category should be in numerical format and not more than
+ *    \ref CATEGORY_MAX
+ * -# amount of profit/costs (depends on first field) with integer
+ *    part not more than \ref AMOUNT_MAX, optionally followed by space
+ *    and three capital letters of currency code
  * -# comment
  *
  * @param str string which would be checked
@@ -156,13 +174,17 @@ is_string_confirm_to_format(const char *str, unsigned long lineno)
   int day;   /* day gets from string */
   int month; /* month gets from string */
   int year;  /* year gets from string */
+  int leap;  /* 1 for February of leap year */
 
   time_t unix_time;      /* current time in unix format (seconds since 01.01.1970) */
+  struct tm  local_tm;   /* storage for local_time */
   struct tm *local_time; /* current time in local-time format */
 
   char *sep_cat;    /* point to separator after 3rd field */
   char *sep_amount; /* point to separator after 4th field */
+  const char *currency; /* point to currency code or separator */
   const char *i;
+  unsigned long long value; /* value of number field */
 
   assert(str != NULL);
 
@@ -197,20 +219,47 @@ is_string_confirm_to_format(const char *str, unsigned long lineno)
   }
 
   /* check category: should consist of digitals only */
+  value = 0ULL;
   for (i = str+13; i < sep_cat; i++) {
     if (!isdigit(*i)) {
         PRINTLN("Third field should consist of digitals only!");
         return 0;
     }
+    value = value * 10 + (unsigned long long)(*i - '0');
+    if (value > CATEGORY_MAX) {
+        PRINTLN("Category is too large!");
+        return 0;
+    }
+  }
+
+  /* check currency: space and three capital letters */
+  currency = sep_amount;
+  for (i = sep_cat+1; i < sep_amount && *i != ' '; i++)
+    ;
+  if (i < sep_amount) {
+      if (sep_amount - i != 4 ||
+          !IS_CAPITAL(i[1]) || !IS_CAPITAL(i[2]) || !IS_CAPITAL(i[3])) {
+          PRINTLN("Currency should be three capital letters after space!");
+          return 0;
+      }
+      currency = i;
   }
 
   /* check amount: should consist of digitals or point/comma only */
-  for (i = sep_cat+1; i < sep_amount; i++) {
+  for (i = sep_cat+1; i < currency; i++) {
     if ((!isdigit(*i)) && *i != '.' && *i != ',') {
         PRINTLN("Fourth field should consist of digitals and point or comma only!");
         return 0;
     }
   }
+  value = 0ULL;
+  for (i = sep_cat+1; i < currency && isdigit(*i); i++) {
+    value = value * 10 + (unsigned long long)(*i - '0');
+    if (value > AMOUNT_MAX) {
+        PRINTLN("Amount is too large!");
+        return 0;
+    }
+  }
 
   /* check date: should consist of digitals only */
   if (!(isdigit(str[2] ) && isdigit(str[3] ) && /* check day */
@@ -252,19 +301,15 @@ is_string_confirm_to_format(const char *str, unsigned long lineno)
       return 0;
    }
 
-  /* check day of months */
-  if (month == 2) {
-      /* if it is leap year */
-      if (ISLEAP(year) && day > 29) {
+  /* check day of months, leap year matters only for February */
+  leap = month == 2 && ISLEAP(year);
+  if ((unsigned int)day > days_in_month[leap][month]) {
+      if (leap) {
           PRINTLN2("Invalid day of month in leap year", day, month);
-          return 0;
-      }
-
-      /* other months */
-      if ((month == 4 || month == 6 || month == 9 || month == 11) && day > 30) {
+      } else {
           PRINTLN2("Invalid day of month", day, month);
-          return 0;
       }
+      return 0;
   }
 
   /* if date is in the future */
@@ -272,7 +317,8 @@ is_string_confirm_to_format(const char *str, unsigned long lineno)
   if (unix_time == (time_t)-1) {
       perror("time");
   } else {
-    local_time = localtime(&unix_time);
+    /* localtime_r() because function is called from worker threads */
+    local_time = localtime_r(&unix_time, &local_tm);
     if (local_time == NULL) {
         fprintf(stderr, "localtime: %s\n", _("error occurs"));
     } else {
@@ -340,105 +386,298 @@ is_file_exist_and_regular(const char *filename, unsigned int verbose)
 }
 
 
-#if 0
-/* This function not used now, but will be used later */
+
 /**
- * Open file and add record.
+ * Decode string of data file into record.
  *
- * Function open file and append string to him. If file does not
- * exists then he will be created with permissions 0600. For locking
- * uses fcntl() function.
+ * Function extracts all fields from string which already passed
+ * \ref is_string_confirm_to_format() checks. Amount is converted to
+ * hundredths: both point and comma are accepted as decimal separator,
+ * third digit after separator is used for rounding and all other
+ * digits are ignored. Limits of the check (\ref CATEGORY_MAX and
+ * \ref AMOUNT_MAX) keep both numbers from overflow.
+ *
+ * @param str string which would be decoded
+ * @param rec struct where result will be stored
+ *
+ * @retval 0 category or amount does not contain any digit
+ * @retval 1 record was decoded
  *
- * @param filename name of file
- * @param record string for writing
- * @param verbose level of verbose
  **/
-void
-add_record_to_file(const char *filename, const char *record, unsigned int verbose)
+int
+decode_record(const char *str, struct record *rec)
 {
-  int fd;       /* file descriptor retured by open() */
-  int ret;      /* for storage close(), fcntl() and fsync() return values */
-  ssize_t wret; /* for storage write() return value */
-  struct flock lock; /* need for fcntl() function */
-
-  assert(filename != NULL);
-  assert(record != NULL);
+  const char *i;
+  int digits; /* count of digits in current field */
 
-  if (verbose >= 1) {
-      printf("-> %s (%s)\n", _("Open data file"), filename);
+  assert(str != NULL);
+  assert(rec != NULL);
+
+  rec->sign  = str[0];
+  rec->day   = (str[2] - '0') * 10 + (str[3] - '0');
+  rec->month = (str[5] - '0') * 10 + (str[6] - '0');
+  rec->year  = (str[8]  - '0') * 1000 +
+               (str[9]  - '0') * 100  +
+               (str[10] - '0') * 10   +
+               (str[11] - '0');
+
+  /* category */
+  rec->category = 0UL;
+  for (i = str+13, digits = 0; *i != '|'; i++, digits++) {
+    rec->category = rec->category * 10 + (*i - '0');
+  }
+  if (digits == 0) {
+      return 0;
   }
 
-  /* open file for append data */
-  fd = open(filename, O_WRONLY|O_CREAT|O_APPEND, S_IRUSR|S_IWUSR);
-  if (fd == -1) {
-      perror("open");
-      exit(EXIT_FAILURE);
+  /* amount: integer part */
+  rec->amount = 0LL;
+  for (i++, digits = 0; isdigit(*i); i++, digits++) {
+    rec->amount = rec->amount * 10 + (*i - '0');
+  }
+  rec->amount *= 100;
+
+  /* amount: fractional part */
+  if (*i == '.' || *i == ',') {
+      i++;
+      if (isdigit(*i)) {
+          rec->amount += (*i++ - '0') * 10;
+          digits++;
+          if (isdigit(*i)) {
+              rec->amount += (*i++ - '0');
+              if (isdigit(*i) && *i >= '5') {
+                  rec->amount++;
+              }
+          }
+      }
+  }
+  if (digits == 0) {
+      return 0;
   }
 
-  if (verbose >= 2) {
-      printf("--> %s\n", _("Lock file"));
+  /* skip rest of amount, currency code is the last */
+  i = strchr(i, '|');
+  assert(i != NULL);
+  rec->currency = 0;
+  if (i[-4] == ' ') {
+      rec->currency = CURRENCY_CODE(i[-3], i[-2], i[-1]);
   }
 
-  lock.l_type   = F_WRLCK;  /* lock for write */
-  lock.l_whence = SEEK_END; /* begin lock from end of file */
-  lock.l_start  = 0;        /* start lock from 0 byte */
-  lock.l_len    = 0;        /* lock from end of file and to the end %) */
+  rec->comment = i + 1;
+  rec->offset  = -1LL;
 
-  ret = fcntl(fd, F_SETLK, &lock);
-  if (ret == -1 ) {
-      fprintf(stderr, "fcntl: %s\n", _("cannot lock file for writing"));
-      perror("fcntl");
-      exit(EXIT_FAILURE);
-  }
+  return 1;
+}
 
-  if (verbose >= 2) {
-      printf("--> %s\n", _("Writing data"));
-  }
 
-  /* write data */
-  /* @todo:
-   * - strlen() can return NULL
-   **/
-  wret = write(fd, record, strlen(record)*sizeof(char));
-  if (wret == -1) {
-      perror("write");
-      exit(EXIT_FAILURE);
+/**
+ * Check that date exists in calendar.
+ *
+ * @param year year
+ * @param month month
+ * @param day day of month
+ *
+ * @retval 0 date doesn't exist
+ * @retval 1 date is valid
+ **/
+int
+is_valid_date(unsigned int year, unsigned int month, unsigned int day)
+{
+  return year > 0 && month >= 1 && month <= 12 && day >= 1 &&
+         day <= days_in_month[month == 2 && ISLEAP(year)][month];
+}
+
+
+/**
+ * Convert date to number of day.
+ *
+ * Days are counted from 01.01.1970 (like in unix time) using
+ * proleptic Gregorian calendar, so dates before 1970 have negative
+ * numbers. Days of full years are counted by formula and days of
+ * current year are taken from table.
+ *
+ * @param year year
+ * @param month month (1-12)
+ * @param day day of month (1-31)
+ *
+ * @return number of day
+ **/
+long
+date_to_days(unsigned int year, unsigned int month, unsigned int day)
+{
+  long y;
+
+  assert(month >= 1 && month <= 12);
+
+  y = (long)year - 1;
+
+  return y * 365 + FLOOR_DIV(y, 4) - FLOOR_DIV(y, 100) + FLOOR_DIV(y, 400) +
+         days_before_month[ISLEAP(year) != 0][month] + (long)day - 1 -
+         DAYS_BEFORE_EPOCH;
+}
+
+
+/**
+ * Convert number of day to date.
+ *
+ * Function is inverse of \ref date_to_days() for years from 1.
+ *
+ * @param days number of day
+ * @param year year (output)
+ * @param month month (output)
+ * @param day day of month (output)
+ **/
+void
+days_to_date(long days, unsigned int *year, unsigned int *month,
+             unsigned int *day)
+{
+  long y, doy;
+  unsigned int m;
+  int leap;
+
+  assert(year != NULL && month != NULL && day != NULL);
+
+  /* 146097 days in 400 years, estimate is corrected by one year */
+  y = FLOOR_DIV((days + DAYS_BEFORE_EPOCH) * 400, 146097) + 1;
+  if (y < 1) {
+      y = 1;
+  }
+  while (y > 1 && date_to_days((unsigned int)y, 1, 1) > days) {
+    y--;
   }
+  while (date_to_days((unsigned int)y + 1, 1, 1) <= days) {
+    y++;
+  }
+
+  doy  = days - date_to_days((unsigned int)y, 1, 1);
+  leap = ISLEAP(y) != 0;
+  for (m = 1; m < 12 && days_before_month[leap][m + 1] <= doy; m++)
+    ;
+
+  *year  = (unsigned int)y;
+  *month = m;
+  *day   = (unsigned int)(doy - days_before_month[leap][m]) + 1;
+}
+
+
+/**
+ * Build path to file which lives near data file.
+ *
+ * Function appends suffix to name of data file. Used for all auxiliary
+ * files (summary, indexes and so on) which belong to data file.
+ *
+ * @warning Don't forget to free memory after! Use free() for that.
+ *
+ * @param dbfile path to data file
+ * @param suffix suffix of auxiliary file (for example ".sum")
+ *
+ * @return path to auxiliary file or NULL if memory cannot be allocated
+ **/
+char *
+get_side_file_path(const char *dbfile, const char *suffix)
+{
+  size_t dblen, suflen;
+  char  *path;
+
+  assert(dbfile != NULL);
+  assert(suffix != NULL);
 
-  if (verbose >= 2) {
-      printf("--> %s\n", _("Unlock file"));
+  dblen  = strlen(dbfile);
+  suflen = strlen(suffix);
+
+  path = malloc(dblen + suflen + 1);
+  if (path == NULL) {
+      fprintf(stderr, "malloc: %s\n", _("cannot allocate memory"));
+      return NULL;
   }
 
-  /* reset lock */
-  lock.l_type = F_UNLCK;
-  ret = fcntl(fd, F_SETLK, &lock);
-  if (ret == -1) {
-      fprintf(stderr, "fcntl: %s\n", _("cannot unlock file"));
-      perror("fcntl");
-      exit(EXIT_FAILURE);
+  memcpy(path, dbfile, dblen);
+  memcpy(path + dblen, suffix, suflen + 1);
+
+  return path;
+}
+
+
+#ifdef NLS
+/** Nonzero when localization is turned on */
+static int nls_ready = 0;
+
+/** Nonzero when messages should not be translated */
+static int nls_disabled = 0;
+
+
+/**
+ * Set settings for using gettext() functions.
+ *
+ * Function just calls setlocale() and textdomain(). Those functions
+ * needs for correct work gettext() functions. Does nothing if
+ * translation was turned off by \ref nls_disable() or localization is
+ * already turned on.
+ *
+ * @note setlocale() is not thread-safe, so function should be called
+ * by main thread before starting of other threads.
+ **/
+void
+nls_init(void)
+{
+  char *locale = NULL; /* for storage setlocale() return value */
+  char *domain = NULL; /* for storage textdomain() return value */
+
+  if (nls_disabled || nls_ready) {
+      return;
   }
+  nls_ready = 1;
 
-  if (verbose >= 2) {
-      printf("--> %s\n", _("Flushing data to disk"));
+  /* set locale according to the environment variables */
+  locale = setlocale(LC_ALL, "");
+  if (locale == NULL) {
+      fprintf(stderr, "setlocale: cannot set locale according to the"
+              "environment variables! Using \"C\" locale by default.\n");
   }
 
-  /* flush data */
-  ret = fsync(fd);
-  if (ret == -1) {
-      perror("fsync");
+  /* set domain name for gettext() */
+  domain = textdomain("openfm");
+  if (domain == NULL) {
+      perror("textdomain");
   }
 
-  if (verbose >= 2) {
-      printf("--> %s\n", _("Close file"));
+}
+
+
+/**
+ * Translate message.
+ *
+ * Messages printed while command line is parsed turn localization on
+ * by themselves; otherwise it is turned on by \ref nls_init() before
+ * starting of threads. Function may be called from several threads
+ * only after \ref nls_init().
+ *
+ * @param msgid message in English
+ *
+ * @return translated message
+ **/
+char *
+nls_gettext(const char *msgid)
+{
+  if (nls_disabled) {
+      return (char *)msgid;
   }
 
-  /* close file */
-  ret = close(fd);
-  if (ret == -1) {
-      perror("close");
-      exit(EXIT_FAILURE);
+  if (!nls_ready) {
+      nls_init();
   }
 
+  return gettext(msgid);
 }
-#endif /* 0 */
 
+
+/**
+ * Turn off translation of messages. Should be called before
+ * \ref nls_init().
+ **/
+void
+nls_disable(void)
+{
+  nls_disabled = 1;
+}
+#endif /* NLS */
@@ -32,26 +32,79 @@
 
 #include <config.h>
 
+/* for uint32_t type */
+#include <stdint.h>
+
 #ifdef NLS
    /* for textdomain()
     *     gettext()
     **/
    #include <libintl.h>
 
-   /** Redefine gettext() functions to be more short. */
-   #define _(str) gettext(str)
+   /** Redefine gettext() functions to be more short. Localization is
+    *  turned on by \ref nls_init(). */
+   #define _(str) nls_gettext(str)
+
+   char *nls_gettext(const char *msgid);
+   void  nls_init(void);
+   void  nls_disable(void);
 #else /* no NLS */
    #define _(str) str
+   #define nls_init()
+   #define nls_disable()
 #endif /* NLS */
 
 
-int  is_string_confirm_to_format(const char *str, unsigned long lineno);
-int  is_file_exist_and_regular(const char *filename, unsigned int verbose);
+/** Pack three capital letters of currency code into number */
+#define CURRENCY_CODE(a, b, c) \
+    (((uint32_t)(unsigned char)(a) << 16) | \
+     ((uint32_t)(unsigned char)(b) << 8) | (uint32_t)(unsigned char)(c))
+
+/** Nanoseconds of modification time from struct stat (zero when system
+ *  keeps only seconds) */
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+   #define STAT_MTIME_NSEC(st) ((int64_t)(st)->st_mtim.tv_nsec)
+#else
+   #define STAT_MTIME_NSEC(st) ((int64_t)0)
+#endif
+
+/** Maximal number of category. Summary, budgets and exports keep
+ *  category in 32 bits, so larger numbers are wrong. */
+#define CATEGORY_MAX UINT32_MAX
+
+/** Maximal integer part of amount (15 digits). Amount in hundredths
+ *  and totals of many records still fit in 64 bits. */
+#define AMOUNT_MAX 999999999999999ULL
+
+/** Decoded record of data file.
+ *
+ * Filled by \ref decode_record() from string which already passed
+ * \ref is_string_confirm_to_format() checks.
+ **/
+struct record {
+  char          sign;     /**< '+' for profit and '-' for costs */
+  unsigned int  day;      /**< day of month (1-31) */
+  unsigned int  month;    /**< month (1-12) */
+  unsigned int  year;     /**< year */
+  unsigned long category; /**< number of category (up to \ref CATEGORY_MAX) */
+  long long     amount;   /**< amount in hundredths (cents) */
+  uint32_t      currency; /**< currency (see \ref CURRENCY_CODE()) or 0 */
+  const char   *comment;  /**< points to comment inside decoded string */
+  long long     offset;   /**< offset of string in data file (if known) */
+};
+
+
+/** Count of days in month: days_in_month[leap][month] */
+extern const unsigned char days_in_month[2][13];
 
-#if 0
-/* This function not used now, but will be used later */
-void add_record_to_file(const char *filename, const char *record, unsigned int verbose);
-#endif /* 0 */
+int   is_string_confirm_to_format(const char *str, unsigned long lineno);
+int   decode_record(const char *str, struct record *rec);
+int   is_valid_date(unsigned int year, unsigned int month, unsigned int day);
+long  date_to_days(unsigned int year, unsigned int month, unsigned int day);
+void  days_to_date(long days, unsigned int *year, unsigned int *month,
+                   unsigned int *day);
+int   is_file_exist_and_regular(const char *filename, unsigned int verbose);
+char *get_side_file_path(const char *dbfile, const char *suffix);
 
 #endif /* COMMON_H */
 
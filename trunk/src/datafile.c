@@ -0,0 +1,641 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   datafile.c contains functions which read and write data file
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for open()
+ *     stat()
+ *     fstat()
+ *     fchmod()
+ **/
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* for flock() */
+#include <sys/file.h>
+
+/* for assert() */
+#include <assert.h>
+
+/* for open() */
+#include <fcntl.h>
+
+/* for write()
+ *     pread()
+ *     fsync()
+ *     dup()
+ *     unlink()
+ *     close()
+ **/
+#include <unistd.h>
+
+/* for printf()
+ *     fprintf()
+ *     fopen()
+ *     fdopen()
+ *     getline()
+ *     ferror()
+ *     fclose()
+ *     rename()
+ *     perror()
+ *     FILE and NULL constants
+ **/
+#include <stdio.h>
+
+/* for exit()
+ *     mkstemp()
+ *     free()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memchr() */
+#include <string.h>
+
+#include "datafile.h"
+#include "checksum.h"
+#include "summary.h"
+#include "index.h"
+#include "balance.h"
+
+
+/**
+ * Read data file and pass each valid record to handler.
+ *
+ * Function open data file and read him string by string. Length of
+ * strings is not limited: one buffer is used for all strings and it
+ * grows when longer string is found. Each string would be checked with
+ * \ref is_string_confirm_to_format() function and decoded with \ref
+ * decode_record(). If too many wrong lines was found then function will
+ * quit from program with failure exit code.
+ *
+ * @param dbfile path to data file
+ * @param verbose level of verbose
+ * @param handler function which will be called for each record
+ * @param data pointer which will be passed to handler
+ *
+ * @return count of valid records in data file
+ **/
+unsigned long
+scan_datafile(const char *dbfile, unsigned int verbose,
+              record_handler handler, void *data)
+{
+  FILE *fp;
+  int   ret; /* for storage fclose() return value */
+
+  struct record rec;
+
+  /* current line from file */
+  char  *curline;
+  size_t curline_size; /* size of buffer for line */
+  ssize_t len;         /* length of current line */
+
+  /* counter for lines in file */
+  unsigned long lineno;
+
+  /* counter for records in file */
+  unsigned long record_count;
+
+  /* counter for wrong lines in file */
+  int fails;
+
+  /* offset of current line in file */
+  long long offset, next_offset;
+
+  assert(dbfile != NULL);
+  assert(handler != NULL);
+
+  if (verbose >= 1) {
+      printf("-> %s (%s)\n", _("Open data file"), dbfile);
+  }
+
+  /* open data file */
+  fp = fopen(dbfile, "r");
+  if (fp == NULL) {
+      fprintf(stderr, "%s: %s\n", _("Failed to open file"), dbfile);
+      perror("fopen");
+      exit(EXIT_FAILURE);
+  }
+
+  if (verbose >= 1) {
+      printf("-> %s\n", _("Reading data..."));
+  }
+
+  curline = NULL;
+  curline_size = 0;
+
+  lineno = 0UL;
+  record_count = 0UL;
+  fails  = 0;
+  next_offset = 0LL;
+
+  /* read and parse data file */
+  while ((len = getline(&curline, &curline_size, fp)) != -1) {
+    lineno++;
+    offset = next_offset;
+    next_offset += len;
+
+    /* kill trailing newline */
+    if (len > 0 && curline[len - 1] == '\n') {
+        curline[--len] = '\0';
+    }
+
+    /* skip empty lines */
+    if (len == 0) {
+        continue;
+    }
+
+    /* checksum is not a part of comment */
+    len = (ssize_t)checksum_strip(curline, (size_t)len);
+
+    if (verbose >= 3) {
+        printf("---> %lu: '%s'\n", lineno, curline);
+    }
+
+    if (fails == MAX_WRONG_LINES) {
+        fprintf(stderr, _("Too many wrong lines in database. Exit.\n"));
+        exit(EXIT_FAILURE);
+    }
+
+    if (!is_string_confirm_to_format(curline, lineno)) {
+        fails++;
+        continue;
+    }
+
+    if (!decode_record(curline, &rec)) {
+        fprintf(stderr, "%lu: %s\n", lineno, _("Cannot decode record"));
+        fails++;
+        continue;
+    }
+
+    record_count++;
+
+    rec.offset = offset;
+    handler(&rec, data);
+
+  } /* end for getline() */
+
+  if (ferror(fp)) {
+      perror("getline");
+      exit(EXIT_FAILURE);
+  }
+
+  /* free memory for input lines */
+  free(curline);
+
+  /* close data file */
+  ret = fclose(fp);
+  if (ret != 0) {
+     perror("fclose");
+  }
+
+  /**
+   * @todo
+   * - Deal with plural forms. Use ngettext()
+   **/
+  if (verbose >= 1) {
+      printf(_("-> Reads %lu strings"), lineno);
+      if (lineno > record_count)
+          printf(_(" and %lu records"), record_count);
+      printf(" %s\n", _("from data file"));
+  }
+
+  return record_count;
+}
+
+
+/**
+ * Write whole buffer to file descriptor.
+ *
+ * Function repeats write() until all data will be written. If error
+ * occurs then function will quit from program with failure exit code.
+ *
+ * @param fd file descriptor
+ * @param buf data for writing
+ * @param len size of data
+ **/
+static void
+write_all(int fd, const char *buf, size_t len)
+{
+  ssize_t wret; /* for storage write() return value */
+
+  while (len > 0) {
+    wret = write(fd, buf, len);
+    if (wret == -1) {
+        perror("write");
+        exit(EXIT_FAILURE);
+    }
+    buf += wret;
+    len -= (size_t)wret;
+  }
+}
+
+
+/**
+ * Open data file and lock him for writing.
+ *
+ * Data file may be replaced by \ref rewrite_datafile() while we wait
+ * for lock. In this case lock is taken again for new file.
+ *
+ * @note For locking uses flock() instead of fcntl(), because fcntl()
+ * locks are released when process closes any descriptor of the file,
+ * including one which is used for rebuilding summary.
+ *
+ * @param dbfile path to data file
+ * @param flags flags for open()
+ * @param st statistics about locked file (output)
+ * @param verbose level of verbose
+ *
+ * @return file descriptor
+ **/
+static int
+open_and_lock(const char *dbfile, int flags, struct stat *st,
+              unsigned int verbose)
+{
+  struct stat path_st;
+  int fd;  /* file descriptor retured by open() */
+  int ret; /* for storage flock() return value */
+
+  for (;;) {
+    fd = open(dbfile, flags, S_IRUSR|S_IWUSR);
+    if (fd == -1) {
+        fprintf(stderr, "%s: %s\n", _("Failed to open file"), dbfile);
+        perror("open");
+        exit(EXIT_FAILURE);
+    }
+
+    if (verbose >= 2) {
+        printf("--> %s\n", _("Lock file"));
+    }
+
+    ret = flock(fd, LOCK_EX);
+    if (ret == -1) {
+        fprintf(stderr, "flock: %s\n", _("cannot lock file for writing"));
+        perror("flock");
+        exit(EXIT_FAILURE);
+    }
+
+    ret = fstat(fd, st);
+    if (ret == -1) {
+        perror("fstat");
+        exit(EXIT_FAILURE);
+    }
+
+    /* check that file was not replaced */
+    if (stat(dbfile, &path_st) == 0 &&
+        path_st.st_dev == st->st_dev && path_st.st_ino == st->st_ino) {
+        return fd;
+    }
+
+    close(fd);
+  }
+}
+
+
+/**
+ * Unlock and close data file.
+ *
+ * @param fd file descriptor
+ * @param verbose level of verbose
+ **/
+static void
+unlock_and_close(int fd, unsigned int verbose)
+{
+  int ret; /* for storage close() and flock() return values */
+
+  if (verbose >= 2) {
+      printf("--> %s\n", _("Unlock file"));
+  }
+
+  /* reset lock */
+  ret = flock(fd, LOCK_UN);
+  if (ret == -1) {
+      fprintf(stderr, "flock: %s\n", _("cannot unlock file"));
+      perror("flock");
+      exit(EXIT_FAILURE);
+  }
+
+  if (verbose >= 2) {
+      printf("--> %s\n", _("Close file"));
+  }
+
+  /* close file */
+  ret = close(fd);
+  if (ret == -1) {
+      perror("close");
+      exit(EXIT_FAILURE);
+  }
+}
+
+
+/**
+ * Open data file and append records.
+ *
+ * Function open data file and append strings to him. If file does not
+ * exists then he will be created with permissions 0600. All strings
+ * should be already checked with \ref is_string_confirm_to_format()
+ * and each of them should end with newline.
+ *
+ * Summary file (see \ref summary.h) is updated while data file is still
+ * locked, so summary always describes whole data file. If process dies
+ * between those two steps then summary will be stale and will be
+ * rebuilt at next access. The same is true for index of comments (see
+ * \ref index.h) and balance checkpoints (see \ref balance.h).
+ *
+ * @param dbfile path to data file
+ * @param lines strings for writing
+ * @param len size of strings
+ * @param verbose level of verbose
+ **/
+void
+append_to_datafile(const char *dbfile, const char *lines, size_t len,
+                   unsigned int verbose)
+{
+  append_checked_to_datafile(dbfile, lines, len, verbose, NULL, NULL);
+}
+
+
+/**
+ * Open data file and append records if they pass check.
+ *
+ * Likewise \ref append_to_datafile(), but before writing \p check is
+ * called with summary of data file. Data file is locked already, so
+ * nobody can append records between check and writing.
+ *
+ * @param dbfile path to data file
+ * @param lines strings for writing
+ * @param len size of strings
+ * @param verbose level of verbose
+ * @param check function which checks new strings or NULL
+ * @param data pointer which is passed to \p check
+ *
+ * @retval 0 check failed, nothing was written
+ * @retval 1 strings were appended
+ **/
+int
+append_checked_to_datafile(const char *dbfile, const char *lines, size_t len,
+                           unsigned int verbose, append_check check,
+                           void *data)
+{
+  int fd;  /* file descriptor retured by open() */
+  int ret; /* for storage fsync() return value */
+  struct stat st, before;
+  struct summary sum;
+  struct balance changes;
+  struct record rec;
+  const char *line, *end;
+  char last; /* last byte of data file */
+  long long base; /* offset of first new string */
+
+  assert(dbfile != NULL);
+  assert(lines != NULL);
+
+  if (verbose >= 1) {
+      printf("-> %s (%s)\n", _("Open data file"), dbfile);
+  }
+
+  /* open file for append data */
+  fd = open_and_lock(dbfile, O_RDWR|O_CREAT|O_APPEND, &st, verbose);
+
+  /* get summary for data without new records */
+  summary_init(&sum);
+  if (!summary_load(&sum, dbfile, &st)) {
+      summary_rebuild(&sum, dbfile, verbose);
+  }
+
+  if (check != NULL && !check(&sum, lines, len, data)) {
+      summary_free(&sum);
+      unlock_and_close(fd, verbose);
+      return 0;
+  }
+
+  if (verbose >= 2) {
+      printf("--> %s\n", _("Writing data"));
+  }
+
+  /* don't glue new record to last line without newline */
+  base = (long long)st.st_size;
+  if (st.st_size > 0) {
+      if (pread(fd, &last, 1, st.st_size - 1) == 1 && last != '\n') {
+          write_all(fd, "\n", 1);
+          base++;
+      }
+  }
+  before = st;
+
+  write_all(fd, lines, len);
+
+  if (verbose >= 2) {
+      printf("--> %s\n", _("Flushing data to disk"));
+  }
+
+  /* flush data */
+  ret = fsync(fd);
+  if (ret == -1) {
+      perror("fsync");
+  }
+
+  /* account new records */
+  balance_init(&changes);
+  for (line = lines; line < lines + len; line = end + 1) {
+    end = memchr(line, '\n', (size_t)(lines + len - line));
+    assert(end != NULL);
+    if (decode_record(line, &rec)) {
+        summary_add(&sum, &rec);
+        balance_add(&changes, &rec);
+    }
+  }
+
+  ret = fstat(fd, &st);
+  if (ret == -1) {
+      perror("fstat");
+  } else {
+      summary_save(&sum, dbfile, &st, verbose);
+      index_append(dbfile, &before, &st, lines, len, base, verbose);
+      balance_append(dbfile, &before, &st, &changes, verbose);
+  }
+  summary_free(&sum);
+  balance_free(&changes);
+
+  unlock_and_close(fd, verbose);
+
+  return 1;
+}
+
+
+
+/**
+ * Replace records of data file.
+ *
+ * Function reads locked data file and writes each string to temporary
+ * file: valid records are passed to rewriter, other strings are copied
+ * as is. Then temporary file replaces data file and summary is
+ * rebuilt while new file is locked. If error occurs then function will
+ * quit from program with failure exit code and data file stays
+ * untouched.
+ *
+ * @param dbfile path to data file
+ * @param verbose level of verbose
+ * @param rewriter function which writes record (without newline)
+ * @param data pointer which will be passed to rewriter
+ **/
+void
+rewrite_datafile(const char *dbfile, unsigned int verbose,
+                 record_rewriter rewriter, void *data)
+{
+  struct stat   st;
+  struct summary sum;
+  struct record rec;
+  struct outbuf ob;
+  FILE   *fp;
+  char   *tmppath;
+  char   *curline = NULL;
+  size_t  curline_size = 0;
+  ssize_t len;
+  size_t  reclen, start;
+  char    suffix[CHECKSUM_SUFFIX_LEN];
+  uint32_t stored;
+  unsigned long lineno;
+  int     fd, tmpfd, checked;
+
+  assert(dbfile != NULL);
+  assert(rewriter != NULL);
+
+  fd = open_and_lock(dbfile, O_RDWR, &st, verbose);
+
+  /* use copy of descriptor, so fclose() will not drop the lock */
+  fp = fdopen(dup(fd), "r");
+  if (fp == NULL) {
+      perror("fdopen");
+      exit(EXIT_FAILURE);
+  }
+
+  tmppath = get_side_file_path(dbfile, ".XXXXXX");
+  if (tmppath == NULL) {
+      exit(EXIT_FAILURE);
+  }
+  tmpfd = mkstemp(tmppath);
+  if (tmpfd == -1) {
+      perror("mkstemp");
+      exit(EXIT_FAILURE);
+  }
+  if (fchmod(tmpfd, st.st_mode & 07777) == -1) {
+      perror("fchmod");
+  }
+  /* new file replaces data file by rename(), so it should be locked
+   * before anybody can open it by name */
+  if (flock(tmpfd, LOCK_EX) == -1) {
+      perror("flock");
+      unlink(tmppath);
+      exit(EXIT_FAILURE);
+  }
+
+  if (verbose >= 2) {
+      printf("--> %s\n", _("Writing data"));
+  }
+
+  outbuf_init(&ob, tmpfd, OUTBUF_SIZE);
+
+  for (lineno = 1; (len = getline(&curline, &curline_size, fp)) != -1; lineno++) {
+    if (len > 0 && curline[len - 1] == '\n') {
+        curline[--len] = '\0';
+    }
+
+    /* corrupted record is kept as is, so it will be found by
+     * "openfm verify" later */
+    reclen  = (size_t)len;
+    checked = checksum_split(curline, (size_t)len, &stored);
+    if (checked) {
+        reclen -= CHECKSUM_SUFFIX_LEN;
+        if (crc32c(0U, curline, reclen) != stored) {
+            outbuf_write(&ob, curline, (size_t)len);
+            outbuf_putc(&ob, '\n');
+            continue;
+        }
+        curline[reclen] = '\0';
+    }
+
+    if (reclen > 0 && is_string_confirm_to_format(curline, lineno) &&
+        decode_record(curline, &rec)) {
+        /* new string should stay in buffer for checksum */
+        outbuf_reserve(&ob, reclen + REWRITE_MAX_GROWTH + CHECKSUM_SUFFIX_LEN + 1);
+        start = ob.len;
+        rewriter(&rec, curline, &ob, data);
+        assert(ob.len >= start && ob.len - start <= reclen + REWRITE_MAX_GROWTH);
+        if (checked) {
+            checksum_format(suffix, ob.buf + start, ob.len - start);
+            outbuf_write(&ob, suffix, CHECKSUM_SUFFIX_LEN);
+        }
+    } else {
+        if (checked) {
+            curline[reclen] = '|';
+        }
+        outbuf_write(&ob, curline, (size_t)len);
+    }
+    outbuf_putc(&ob, '\n');
+  }
+
+  if (ferror(fp)) {
+      perror("getline");
+      unlink(tmppath);
+      exit(EXIT_FAILURE);
+  }
+
+  free(curline);
+  fclose(fp);
+
+  outbuf_free(&ob);
+
+  if (verbose >= 2) {
+      printf("--> %s\n", _("Flushing data to disk"));
+  }
+
+  if (fsync(tmpfd) == -1) {
+      perror("fsync");
+      unlink(tmppath);
+      exit(EXIT_FAILURE);
+  }
+
+  if (rename(tmppath, dbfile) == -1) {
+      perror("rename");
+      unlink(tmppath);
+      exit(EXIT_FAILURE);
+  }
+  free(tmppath);
+
+  /* records were changed, so summary should be built again; new data
+   * file is still locked, so nobody can append to it meanwhile */
+  summary_init(&sum);
+  summary_rebuild(&sum, dbfile, verbose);
+  if (fstat(tmpfd, &st) == 0) {
+      summary_save(&sum, dbfile, &st, verbose);
+  }
+  summary_free(&sum);
+
+  unlock_and_close(tmpfd, verbose);
+  unlock_and_close(fd, verbose);
+}
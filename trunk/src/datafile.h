@@ -0,0 +1,96 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   datafile.h contains prototypes for functions which read and write data file
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef DATAFILE_H
+#define DATAFILE_H
+
+/* for size_t type */
+#include <stddef.h>
+
+/* for struct record */
+#include "common.h"
+#include "outbuf.h"
+
+/* for struct summary */
+#include "summary.h"
+
+
+/** Maximal count of wrong lines.\ If more then exit from program */
+#define MAX_WRONG_LINES 5
+
+/**
+ * Function which will be called for each valid record of data file.
+ *
+ * @param rec decoded record
+ * @param data pointer which was passed to \ref scan_datafile()
+ **/
+typedef void (*record_handler)(const struct record *rec, void *data);
+
+/**
+ * Function which checks new strings for \ref append_checked_to_datafile().
+ *
+ * @param sum summary of data file without new strings
+ * @param lines new strings (each ends with newline)
+ * @param len size of strings
+ * @param data pointer which was passed to \ref append_checked_to_datafile()
+ *
+ * @return nonzero if strings may be appended
+ **/
+typedef int (*append_check)(const struct summary *sum, const char *lines,
+                            size_t len, void *data);
+
+/** Maximal count of bytes which rewriter may add to string */
+#define REWRITE_MAX_GROWTH 32
+
+/**
+ * Function which writes valid record for \ref rewrite_datafile().
+ *
+ * New string should not be longer than old one by more than \ref
+ * REWRITE_MAX_GROWTH bytes.
+ *
+ * @param rec decoded record
+ * @param line string of data file with record (without newline)
+ * @param ob output for new string (newline is added after)
+ * @param data pointer which was passed to \ref rewrite_datafile()
+ **/
+typedef void (*record_rewriter)(const struct record *rec, const char *line,
+                                struct outbuf *ob, void *data);
+
+unsigned long scan_datafile(const char *dbfile, unsigned int verbose,
+                            record_handler handler, void *data);
+void append_to_datafile(const char *dbfile, const char *lines, size_t len,
+                        unsigned int verbose);
+int  append_checked_to_datafile(const char *dbfile, const char *lines,
+                                size_t len, unsigned int verbose,
+                                append_check check, void *data);
+void rewrite_datafile(const char *dbfile, unsigned int verbose,
+                      record_rewriter rewriter, void *data);
+
+#endif /* DATAFILE_H */
+
@@ -0,0 +1,486 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   difftest.c contains differential tester for parser of records
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/*
+ * Tester generates strings of data file (usual records, leap days,
+ * wrong days of month, dates in future, comma decimals, long amounts
+ * and categories, currency codes, checksum suffixes, missing
+ * separators) and mutates some of them. Each string is checked by
+ * \ref parser_check_line(). Then strings which full check accepts are
+ * written to temporary data file and totals of \ref scan_datafile()
+ * and \ref scan_datafile_batch() are compared.
+ *
+ * Usage: difftest [-n count] [-s seed] [-v]
+ */
+
+/* for getopt()
+ *     close()
+ *     unlink()
+ **/
+#include <unistd.h>
+
+/* for printf()
+ *     fprintf()
+ *     fdopen()
+ *     fwrite()
+ *     fclose()
+ *     freopen()
+ *     perror()
+ *     sprintf()
+ *     FILE and NULL constants
+ **/
+#include <stdio.h>
+
+/* for strtoul()
+ *     mkstemp()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memset()
+ *     memmove()
+ *     memchr()
+ *     memcmp()
+ *     strlen()
+ **/
+#include <string.h>
+
+/* for crc32c()
+ *     checksum_format()
+ **/
+#include "checksum.h"
+
+/* for scan_datafile() */
+#include "datafile.h"
+
+#include "parser_check.h"
+
+
+/** Maximal length of generated string */
+#define LINE_MAX_LEN 256
+
+/** Totals which are compared after reading of data file */
+struct totals {
+  unsigned long records;    /**< count of records */
+  long long     profit;     /**< sum of profits */
+  long long     costs;      /**< sum of costs */
+  unsigned long dates;      /**< sum of dates as yyyymmdd */
+  unsigned long categories; /**< sum of categories */
+  unsigned long currencies; /**< sum of currencies */
+  unsigned long comments;   /**< sum of CRC32C of comments */
+};
+
+/** State of pseudo-random generator (xorshift64) */
+static uint64_t random_state;
+
+
+/**
+ * Get next pseudo-random number.
+ *
+ * @param n upper bound
+ *
+ * @return number in [0, n)
+ **/
+static unsigned long
+uniform(unsigned long n)
+{
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 7;
+  random_state ^= random_state << 17;
+
+  return (unsigned long)(random_state >> 11) % n;
+}
+
+
+/**
+ * Append random digits.
+ *
+ * @param p output
+ * @param count count of digits
+ *
+ * @return end of output
+ **/
+static char *
+put_digits(char *p, unsigned long count)
+{
+  while (count-- > 0) {
+    *p++ = (char)('0' + uniform(10));
+  }
+
+  return p;
+}
+
+
+/**
+ * Write date of string (dd.mm.yyyy and separator).
+ *
+ * @param p output
+ * @param today current date as yyyymmdd
+ *
+ * @return end of output
+ **/
+static char *
+put_date(char *p, unsigned long today)
+{
+  static const unsigned int leap_years[] = {
+    1600, 1900, 1996, 2000, 2004, 2005, 2006, 2023, 2024, 2100
+  };
+  static const unsigned int short_months[] = { 2, 4, 6, 9, 11 };
+  unsigned int day, month, year;
+  char sep;
+
+  year  = (unsigned int)(today / 10000UL);
+  month = (unsigned int)(today / 100UL % 100UL);
+  day   = (unsigned int)(today % 100UL);
+  sep   = '.';
+
+  switch (uniform(10)) {
+    case 0: /* leap day */
+      year  = leap_years[uniform(sizeof(leap_years) / sizeof(leap_years[0]))];
+      month = 2;
+      day   = 29;
+      break;
+    case 1: /* end of short month */
+      year  = 1990 + (unsigned int)uniform(30);
+      month = short_months[uniform(5)];
+      day   = 29 + (unsigned int)uniform(3);
+      break;
+    case 2: /* today or in future */
+      switch (uniform(4)) {
+        case 0: break;
+        case 1: day++; break;
+        case 2: month++; break;
+        default: year++; break;
+      }
+      break;
+    case 3: /* out of range */
+      day   = (unsigned int)uniform(2) * 32;
+      month = (unsigned int)uniform(14);
+      year  = (unsigned int)uniform(2) * 10000U;
+      break;
+    case 4: /* wrong separator */
+      sep   = "/-, "[uniform(4)];
+      /* FALLTHROUGH */
+    default: /* usual date */
+      year  = 1990 + (unsigned int)uniform(30);
+      month = 1 + (unsigned int)uniform(12);
+      day   = 1 + (unsigned int)uniform(31);
+      break;
+  }
+
+  p += sprintf(p, "%02u%c%02u%c%04u|", day % 100, sep, month % 100, sep,
+               year % 10000);
+
+  return p;
+}
+
+
+/**
+ * Generate string of data file.
+ *
+ * @param line output (at least \ref LINE_MAX_LEN bytes)
+ * @param today current date as yyyymmdd
+ *
+ * @return length of string
+ **/
+static size_t
+generate_line(char *line, unsigned long today)
+{
+  static const char *currencies[] = {
+    " USD", " EUR", " usd", " US", "  EUR", "RUB", " RUBL"
+  };
+  static const char alphabet[] = "0123456789|.,+- ABZaz~";
+  char *p, *sep;
+  unsigned long i, count;
+  size_t len;
+
+  p = line;
+  *p++ = uniform(50) == 0 ? '*' : "+-"[uniform(2)];
+  *p++ = '|';
+  p = put_date(p, today);
+
+  /* category */
+  switch (uniform(20)) {
+    case 0:  break;
+    case 1:  p = put_digits(p, 9); break;
+    case 2:  p = put_digits(p, 10 + uniform(12)); break;
+    case 3:  *p++ = 'x'; break;
+    default: p = put_digits(p, 1 + uniform(4)); break;
+  }
+  *p++ = '|';
+
+  /* amount */
+  switch (uniform(20)) {
+    case 0:  break;
+    case 1:  p = put_digits(p, 15); break;
+    case 2:  p = put_digits(p, 16 + uniform(5)); break;
+    default: p = put_digits(p, uniform(7)); break;
+  }
+  if (uniform(2) == 0) {
+      *p++ = ".,"[uniform(2)];
+      p = put_digits(p, uniform(5));
+      if (uniform(20) == 0) {
+          *p++ = '.';
+          p = put_digits(p, uniform(3));
+      }
+  }
+  if (uniform(8) == 0) {
+      p += sprintf(p, "%s", currencies[uniform(7)]);
+  }
+  *p++ = '|';
+
+  /* comment */
+  count = uniform(20);
+  for (i = 0; i < count; i++) {
+    *p++ = uniform(10) == 0 ? '|' : (char)(' ' + uniform(95));
+  }
+  len = (size_t)(p - line);
+
+  /* missing separator */
+  if (uniform(20) == 0) {
+      sep = memchr(line, '|', len);
+      for (i = uniform(4); sep != NULL && i > 0; i--) {
+        sep = memchr(sep + 1, '|', len - (size_t)(sep + 1 - line));
+      }
+      if (sep != NULL) {
+          memmove(sep, sep + 1, len - (size_t)(sep + 1 - line));
+          len--;
+      }
+  }
+
+  /* checksum suffix, valid or not */
+  if (uniform(5) == 0) {
+      checksum_format(line + len, line, len);
+      if (uniform(4) == 0) {
+          line[len + 2 + uniform(CHECKSUM_SUFFIX_LEN - 2)] = 'f';
+      }
+      len += CHECKSUM_SUFFIX_LEN;
+  }
+
+  /* mutations */
+  if (uniform(4) == 0) {
+      for (count = 1 + uniform(3); count > 0; count--) {
+        i = uniform(len + 1);
+        switch (uniform(3)) {
+          case 0: /* replace */
+            if (i < len) {
+                line[i] = alphabet[uniform(sizeof(alphabet) - 1)];
+            }
+            break;
+          case 1: /* insert */
+            if (len + 1 < LINE_MAX_LEN) {
+                memmove(line + i + 1, line + i, len - i);
+                line[i] = uniform(8) == 0 ? (char)(1 + uniform(255)) :
+                          alphabet[uniform(sizeof(alphabet) - 1)];
+                if (line[i] == '\n') {
+                    line[i] = '|';
+                }
+                len++;
+            }
+            break;
+          default: /* delete */
+            if (i < len) {
+                memmove(line + i, line + i + 1, len - i - 1);
+                len--;
+            }
+            break;
+        }
+      }
+  }
+
+  return len;
+}
+
+
+/**
+ * Add record to totals.
+ *
+ * @param t totals
+ * @param negative nonzero for costs
+ * @param amount amount
+ * @param year year
+ * @param month month
+ * @param day day
+ * @param category category
+ * @param currency currency
+ * @param comment comment
+ **/
+static void
+add_to_totals(struct totals *t, int negative, long long amount,
+              unsigned int year, unsigned int month, unsigned int day,
+              unsigned long category, uint32_t currency, const char *comment)
+{
+  t->records++;
+  if (negative) {
+      t->costs += amount;
+  } else {
+      t->profit += amount;
+  }
+  t->dates      += year * 10000UL + month * 100UL + day;
+  t->categories += category;
+  t->currencies += currency;
+  t->comments   += crc32c(0U, comment, strlen(comment));
+}
+
+
+/**
+ * Handler of \ref scan_datafile() which adds record to totals.
+ *
+ * @param rec record
+ * @param data totals
+ **/
+static void
+reference_total(const struct record *rec, void *data)
+{
+  add_to_totals(data, rec->sign == '-', rec->amount, rec->year, rec->month,
+                rec->day, rec->category, rec->currency, rec->comment);
+}
+
+
+/**
+ * Handler of \ref scan_datafile_batch() which adds records to totals.
+ *
+ * @param b batch
+ * @param data totals
+ **/
+static void
+batch_total(const struct record_batch *b, void *data)
+{
+  size_t i;
+
+  for (i = 0; i < b->count; i++) {
+    add_to_totals(data, b->negative[i] != 0, (long long)b->amount[i],
+                  b->year[i], b->month[i], b->day[i], b->category[i],
+                  b->currency[i], b->comment[i]);
+  }
+}
+
+
+/**
+ * Generate strings, compare checks and totals of data file.
+ **/
+int
+main(int argc, char **argv)
+{
+  struct parser_check pc;
+  struct totals reference, batch;
+  char line[LINE_MAX_LEN + CHECKSUM_SUFFIX_LEN + 1];
+  char path[] = "/tmp/openfm-difftest.XXXXXX";
+  unsigned long count, seed, i;
+  unsigned long results[PARSER_MISMATCH + 1];
+  unsigned int verbose;
+  parser_result r;
+  size_t len;
+  FILE *fp;
+  int fd, opt;
+
+  count   = 100000UL;
+  seed    = 1UL;
+  verbose = 0;
+  while ((opt = getopt(argc, argv, "n:s:v")) != -1) {
+    switch (opt) {
+      case 'n':
+        count = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        seed = strtoul(optarg, NULL, 10);
+        break;
+      case 'v':
+        verbose++;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-n count] [-s seed] [-v]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  /* full check reports each wrong string */
+  if (verbose == 0 && freopen("/dev/null", "w", stderr) == NULL) {
+      perror("freopen");
+      return EXIT_FAILURE;
+  }
+
+  random_state = (uint64_t)seed * 0x9E3779B97F4A7C15ULL + 1;
+
+  fd = mkstemp(path);
+  if (fd == -1 || (fp = fdopen(fd, "w")) == NULL) {
+      perror("mkstemp");
+      return EXIT_FAILURE;
+  }
+
+  parser_check_init(&pc);
+  memset(results, 0, sizeof(results));
+  memset(&reference, 0, sizeof(reference));
+  memset(&batch, 0, sizeof(batch));
+
+  for (i = 0; i < count; i++) {
+    len = generate_line(line, pc.scanner.today);
+    r = parser_check_line(&pc, line, len, NULL);
+    results[r]++;
+    if (r == PARSER_FAST || r == PARSER_SLOW) {
+        line[len] = '\n';
+        fwrite(line, 1, len + 1, fp);
+    }
+  }
+  parser_check_free(&pc);
+
+  if (fclose(fp) != 0) {
+      perror("fclose");
+      unlink(path);
+      return EXIT_FAILURE;
+  }
+
+  scan_datafile(path, 0, reference_total, &reference);
+  scan_datafile_batch(path, 0, batch_total, &batch);
+  unlink(path);
+
+  printf("Seed %lu: %lu strings, %lu by fast path, %lu by full check, "
+         "%lu rejected, %lu mismatches\n", seed, count,
+         results[PARSER_FAST], results[PARSER_SLOW],
+         results[PARSER_REJECTED], results[PARSER_MISMATCH]);
+
+  if (memcmp(&reference, &batch, sizeof(reference)) != 0) {
+      printf("Totals of data file differ:\n"
+             "  full:  %lu records, profit %lld, costs %lld, dates %lu, "
+             "categories %lu, currencies %lu, comments %lu\n"
+             "  batch: %lu records, profit %lld, costs %lld, dates %lu, "
+             "categories %lu, currencies %lu, comments %lu\n",
+             reference.records, reference.profit, reference.costs,
+             reference.dates, reference.categories, reference.currencies,
+             reference.comments,
+             batch.records, batch.profit, batch.costs,
+             batch.dates, batch.categories, batch.currencies,
+             batch.comments);
+      return EXIT_FAILURE;
+  }
+  printf("Totals of data file are equal: %lu records\n", reference.records);
+
+  return results[PARSER_MISMATCH] == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
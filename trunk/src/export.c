@@ -0,0 +1,250 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   export.c contains functions which export data file
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for assert() */
+#include <assert.h>
+
+/* for STDOUT_FILENO constant */
+#include <unistd.h>
+
+/* for NULL constant */
+#include <stdio.h>
+
+/* for strcmp()
+ *     strcspn()
+ **/
+#include <string.h>
+
+#include "export.h"
+#include "datafile.h"
+#include "outbuf.h"
+#include "arrow.h"
+
+
+/**
+ * Get format by name.
+ *
+ * @param name name of format ("csv", "jsonl" or "arrow")
+ * @param format format (output)
+ *
+ * @retval 0 unknown format
+ * @retval 1 format was found
+ **/
+int
+parse_export_format(const char *name, export_format *format)
+{
+  assert(name != NULL);
+  assert(format != NULL);
+
+  if (strcmp(name, "csv") == 0) {
+      *format = EXPORT_CSV;
+  } else if (strcmp(name, "jsonl") == 0) {
+      *format = EXPORT_JSONL;
+  } else if (strcmp(name, "arrow") == 0) {
+      *format = EXPORT_ARROW;
+  } else {
+      return 0;
+  }
+
+  return 1;
+}
+
+
+/** Write date of record in ISO 8601 format (yyyy-mm-dd) */
+static void
+write_iso_date(struct outbuf *ob, const struct record *rec)
+{
+  char date[10];
+
+  date[0] = (char)('0' + rec->year / 1000);
+  date[1] = (char)('0' + rec->year / 100 % 10);
+  date[2] = (char)('0' + rec->year / 10 % 10);
+  date[3] = (char)('0' + rec->year % 10);
+  date[4] = '-';
+  date[5] = (char)('0' + rec->month / 10);
+  date[6] = (char)('0' + rec->month % 10);
+  date[7] = '-';
+  date[8] = (char)('0' + rec->day / 10);
+  date[9] = (char)('0' + rec->day % 10);
+
+  outbuf_write(ob, date, sizeof(date));
+}
+
+
+/** Write currency code of record (three letters) */
+static void
+write_currency(struct outbuf *ob, const struct record *rec)
+{
+  char code[3];
+
+  code[0] = (char)(rec->currency >> 16);
+  code[1] = (char)(rec->currency >> 8);
+  code[2] = (char)rec->currency;
+
+  outbuf_write(ob, code, sizeof(code));
+}
+
+
+/**
+ * Callback for \ref scan_datafile() which writes record as CSV.
+ *
+ * Field "currency" is empty for amounts without currency code.
+ **/
+static void
+export_csv(const struct record *rec, void *data)
+{
+  struct outbuf *ob = data;
+  const char *str;
+  size_t len;
+
+  outbuf_putc(ob, rec->sign);
+  outbuf_putc(ob, ',');
+  write_iso_date(ob, rec);
+  outbuf_putc(ob, ',');
+  outbuf_uint(ob, rec->category);
+  outbuf_putc(ob, ',');
+  outbuf_money(ob, rec->amount);
+  outbuf_putc(ob, ',');
+  if (rec->currency != 0) {
+      write_currency(ob, rec);
+  }
+  outbuf_puts(ob, ",\"");
+
+  /* comment is always quoted, quotes inside him are doubled */
+  for (str = rec->comment; ; str += len + 1) {
+    len = strcspn(str, "\"");
+    outbuf_write(ob, str, len);
+    if (str[len] == '\0') {
+        break;
+    }
+    outbuf_puts(ob, "\"\"");
+  }
+
+  outbuf_puts(ob, "\"\n");
+}
+
+
+/**
+ * Callback for \ref scan_datafile() which writes record as JSON object.
+ *
+ * Field "currency" is null for amounts without currency code.
+ **/
+static void
+export_jsonl(const struct record *rec, void *data)
+{
+  struct outbuf *ob = data;
+
+  outbuf_puts(ob, "{\"sign\":\"");
+  outbuf_putc(ob, rec->sign);
+  outbuf_puts(ob, "\",\"date\":\"");
+  write_iso_date(ob, rec);
+  outbuf_puts(ob, "\",\"category\":");
+  outbuf_uint(ob, rec->category);
+  outbuf_puts(ob, ",\"amount\":");
+  outbuf_money(ob, rec->amount);
+  if (rec->currency != 0) {
+      outbuf_puts(ob, ",\"currency\":\"");
+      write_currency(ob, rec);
+      outbuf_puts(ob, "\",\"comment\":\"");
+  } else {
+      outbuf_puts(ob, ",\"currency\":null,\"comment\":\"");
+  }
+  outbuf_json_string(ob, rec->comment);
+  outbuf_puts(ob, "\"}\n");
+}
+
+
+/** Callback for \ref scan_datafile() which adds record to Arrow file */
+static void
+export_arrow(const struct record *rec, void *data)
+{
+  arrow_append((struct arrow_writer *)data, rec);
+}
+
+
+/**
+ * Export data file to standard output.
+ *
+ * Records are streamed from \ref scan_datafile() to buffered writer,
+ * so whole data file is never kept in memory (except current record
+ * batch for Arrow format).
+ *
+ * @param dbfile path to data file
+ * @param verbose level of verbose
+ * @param format output format
+ * @param filter only matched records are exported (may be NULL)
+ **/
+void
+export_datafile(const char *dbfile, unsigned int verbose, export_format format,
+                const struct filter *filter)
+{
+  struct outbuf ob;
+  struct arrow_writer aw;
+  struct filter_chain chain;
+  record_handler handler;
+  void *data;
+
+  assert(dbfile != NULL);
+
+  outbuf_init(&ob, STDOUT_FILENO, OUTBUF_SIZE);
+
+  handler = export_csv;
+  data    = &ob;
+
+  switch (format) {
+      case EXPORT_CSV:
+          outbuf_puts(&ob, "sign,date,category,amount,currency,comment\n");
+          break;
+      case EXPORT_JSONL:
+          handler = export_jsonl;
+          break;
+      case EXPORT_ARROW:
+          arrow_open(&aw, &ob);
+          handler = export_arrow;
+          data    = &aw;
+          break;
+  }
+
+  if (filter != NULL) {
+      chain.filter  = filter;
+      chain.handler = handler;
+      chain.data    = data;
+      handler = filter_handler;
+      data    = &chain;
+  }
+
+  scan_datafile(dbfile, verbose, handler, data);
+
+  if (format == EXPORT_ARROW) {
+      arrow_close(&aw);
+  }
+
+  outbuf_free(&ob);
+}
+
@@ -0,0 +1,45 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   export.h contains prototypes for functions which export data file
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef EXPORT_H
+#define EXPORT_H
+
+/* for struct filter */
+#include "filter.h"
+
+/** Formats for action "export" */
+typedef enum {EXPORT_CSV, EXPORT_JSONL, EXPORT_ARROW} export_format;
+
+
+int  parse_export_format(const char *name, export_format *format);
+void export_datafile(const char *dbfile, unsigned int verbose, export_format format,
+                     const struct filter *filter);
+
+#endif /* EXPORT_H */
+
@@ -0,0 +1,595 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   filter.c contains functions which compile and apply filters
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for assert() */
+#include <assert.h>
+
+/* for fprintf()
+ *     NULL constant
+ **/
+#include <stdio.h>
+
+/* for realloc()
+ *     free()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for strlen()
+ *     strncasecmp()
+ **/
+#include <string.h>
+#include <strings.h>
+
+/* for isalpha()
+ *     isalnum()
+ *     isdigit()
+ *     isspace()
+ **/
+#include <ctype.h>
+
+#include "filter.h"
+
+
+/** Maximal depth of stack with results (bits of machine word) */
+#define FILTER_MAX_DEPTH 64
+
+/** Bits of \ref filter_insn accept field */
+#define ACCEPT_LESS    1
+#define ACCEPT_EQUAL   2
+#define ACCEPT_GREATER 4
+
+/** Names of fields */
+static const struct {
+  const char  *name;
+  filter_field field;
+} fields[] = {
+  { "date",     FILTER_DATE     },
+  { "year",     FILTER_YEAR     },
+  { "month",    FILTER_MONTH    },
+  { "day",      FILTER_DAY      },
+  { "category", FILTER_CATEGORY },
+  { "amount",   FILTER_AMOUNT   },
+  { "sign",     FILTER_SIGN     },
+  { NULL,       FILTER_NFIELDS  }
+};
+
+/** Operators of comparison */
+static const struct {
+  const char   *name;
+  unsigned char accept;
+} operators[] = {
+  /* two-character operators should be checked first */
+  { "<=", ACCEPT_LESS | ACCEPT_EQUAL    },
+  { ">=", ACCEPT_GREATER | ACCEPT_EQUAL },
+  { "!=", ACCEPT_LESS | ACCEPT_GREATER  },
+  { "==", ACCEPT_EQUAL                  },
+  { "=",  ACCEPT_EQUAL                  },
+  { "<",  ACCEPT_LESS                   },
+  { ">",  ACCEPT_GREATER                },
+  { NULL, 0                             }
+};
+
+/** State of parser */
+struct parser {
+  struct filter *filter; /**< compiled filter */
+  const char    *pos;    /**< current position in expression */
+  int            depth;  /**< depth of stack after emitted code */
+};
+
+
+/** Report error in filter and quit from program */
+static void
+filter_error(const struct parser *p, const char *msg)
+{
+  if (*p->pos == '\0') {
+      fprintf(stderr, "%s: %s: %s\n", _("Wrong filter"), msg,
+              _("unexpected end of expression"));
+  } else {
+      fprintf(stderr, "%s: %s: '%s'\n", _("Wrong filter"), msg, p->pos);
+  }
+  exit(EXIT_FAILURE);
+}
+
+
+/** Allocate memory or quit from program */
+static void *
+xrealloc(void *ptr, size_t size)
+{
+  ptr = realloc(ptr, size);
+  if (ptr == NULL) {
+      fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+  return ptr;
+}
+
+
+/**
+ * Append instruction to filter.
+ *
+ * @param p parser
+ * @param op opcode
+ * @param field field of record
+ * @param accept accepted results of comparison
+ * @param value value for comparison
+ * @param count count of values
+ **/
+static void
+emit(struct parser *p, filter_opcode op, filter_field field,
+     unsigned char accept, int64_t value, uint32_t count)
+{
+  struct filter *f = p->filter;
+  struct filter_insn *insn;
+
+  if (f->ncode == f->alloc) {
+      f->alloc = f->alloc * 2 + 16;
+      f->code  = xrealloc(f->code, f->alloc * sizeof(*f->code));
+  }
+
+  insn = &f->code[f->ncode++];
+  insn->op       = (unsigned char)op;
+  insn->field    = (unsigned char)field;
+  insn->accept   = accept;
+  insn->reserved = 0;
+  insn->count    = count;
+  insn->value    = value;
+
+  if (op == FILTER_CMP || op == FILTER_IN) {
+      f->fields |= 1U << field;
+      if (++p->depth > FILTER_MAX_DEPTH) {
+          filter_error(p, _("Expression is too complex"));
+      }
+  } else if (op != FILTER_NOT) {
+      p->depth--;
+  }
+}
+
+
+/** Skip spaces in expression */
+static void
+skip_spaces(struct parser *p)
+{
+  while (isspace((unsigned char)*p->pos)) {
+    p->pos++;
+  }
+}
+
+
+/**
+ * Check that expression continues with given character and skip him.
+ *
+ * @retval 0 other character follows
+ * @retval 1 character was skipped
+ **/
+static int
+accept_char(struct parser *p, char c)
+{
+  skip_spaces(p);
+  if (*p->pos != c) {
+      return 0;
+  }
+  p->pos++;
+  return 1;
+}
+
+
+/**
+ * Check that expression continues with given keyword (in any case)
+ * and skip him.
+ *
+ * @retval 0 other word follows
+ * @retval 1 keyword was skipped
+ **/
+static int
+accept_word(struct parser *p, const char *word)
+{
+  size_t len = strlen(word);
+
+  skip_spaces(p);
+  if (strncasecmp(p->pos, word, len) != 0 ||
+      isalnum((unsigned char)p->pos[len])) {
+      return 0;
+  }
+  p->pos += len;
+  return 1;
+}
+
+
+/**
+ * Read unsigned number.
+ *
+ * @param s current position (will be moved after number)
+ * @param max maximal value
+ * @param value number (output)
+ *
+ * @retval 0 there are no digits or number is too big
+ * @retval 1 number was read
+ **/
+static int
+read_number(const char **s, int64_t max, int64_t *value)
+{
+  const char *p = *s;
+
+  if (!isdigit((unsigned char)*p)) {
+      return 0;
+  }
+
+  for (*value = 0; isdigit((unsigned char)*p); p++) {
+    *value = *value * 10 + (*p - '0');
+    if (*value > max) {
+        return 0;
+    }
+  }
+
+  *s = p;
+  return 1;
+}
+
+
+/**
+ * Read value for field.
+ *
+ * Date is written as dd.mm.yyyy, amount as number with optional point
+ * and two digits, sign as '+' or '-'. Other fields are numbers.
+ *
+ * @param p parser
+ * @param field field of record
+ *
+ * @return value in the same units as field of record
+ **/
+static int64_t
+parse_value(struct parser *p, filter_field field)
+{
+  const char *s;
+  int64_t value, day, month, year, frac;
+
+  skip_spaces(p);
+  s = p->pos;
+
+  switch (field) {
+      case FILTER_SIGN:
+          if (*s != '+' && *s != '-') {
+              filter_error(p, _("Sign should be '+' or '-'"));
+          }
+          value = (*s == '-') ? -1 : 1;
+          s++;
+          break;
+
+      case FILTER_DATE:
+          if (!read_number(&s, 31, &day) || *s++ != '.' ||
+              !read_number(&s, 12, &month) || *s++ != '.' ||
+              !read_number(&s, 9999, &year) ||
+              !is_valid_date((unsigned)year, (unsigned)month, (unsigned)day)) {
+              filter_error(p, _("Date should look like dd.mm.yyyy"));
+          }
+          value = date_to_days((unsigned)year, (unsigned)month, (unsigned)day);
+          break;
+
+      case FILTER_AMOUNT:
+          if (!read_number(&s, INT64_MAX / 100 - 1, &value)) {
+              filter_error(p, _("Wrong value"));
+          }
+          value *= 100;
+          if (*s == '.') {
+              s++;
+              if (!isdigit((unsigned char)*s)) {
+                  filter_error(p, _("Wrong value"));
+              }
+              frac = (*s++ - '0') * 10;
+              if (isdigit((unsigned char)*s)) {
+                  frac += *s++ - '0';
+              }
+              value += frac;
+          }
+          break;
+
+      default:
+          if (!read_number(&s, INT64_MAX / 10 - 1, &value)) {
+              filter_error(p, _("Wrong value"));
+          }
+          break;
+  }
+
+  /* value should be followed by separator */
+  if (isalnum((unsigned char)*s) || *s == '.') {
+      filter_error(p, _("Wrong value"));
+  }
+
+  p->pos = s;
+  return value;
+}
+
+
+static void parse_or(struct parser *p);
+
+
+/**
+ * Parse comparison or expression in parentheses.
+ *
+ * @param p parser
+ **/
+static void
+parse_primary(struct parser *p)
+{
+  struct filter *f = p->filter;
+  size_t i, first;
+
+  if (accept_char(p, '(')) {
+      parse_or(p);
+      if (!accept_char(p, ')')) {
+          filter_error(p, _("Expected ')'"));
+      }
+      return;
+  }
+
+  for (i = 0; fields[i].name != NULL; i++) {
+    if (accept_word(p, fields[i].name)) {
+        break;
+    }
+  }
+  if (fields[i].name == NULL) {
+      filter_error(p, _("Unknown field"));
+  }
+
+  /* list of values */
+  if (accept_word(p, "in")) {
+      if (!accept_char(p, '(')) {
+          filter_error(p, _("Expected '('"));
+      }
+      first = f->nvalues;
+      do {
+        if (f->nvalues == f->valloc) {
+            f->valloc = f->valloc * 2 + 16;
+            f->values = xrealloc(f->values, f->valloc * sizeof(*f->values));
+        }
+        f->values[f->nvalues++] = parse_value(p, fields[i].field);
+      } while (accept_char(p, ','));
+      if (!accept_char(p, ')')) {
+          filter_error(p, _("Expected ')'"));
+      }
+      emit(p, FILTER_IN, fields[i].field, 0, (int64_t)first,
+           (uint32_t)(f->nvalues - first));
+      return;
+  }
+
+  /* comparison */
+  skip_spaces(p);
+  for (first = 0; operators[first].name != NULL; first++) {
+    if (strncmp(p->pos, operators[first].name,
+                strlen(operators[first].name)) == 0) {
+        break;
+    }
+  }
+  if (operators[first].name == NULL) {
+      filter_error(p, _("Expected operator"));
+  }
+  p->pos += strlen(operators[first].name);
+
+  emit(p, FILTER_CMP, fields[i].field, operators[first].accept,
+       parse_value(p, fields[i].field), 0);
+}
+
+
+/** Parse negation */
+static void
+parse_not(struct parser *p)
+{
+  if (accept_word(p, "not")) {
+      parse_not(p);
+      emit(p, FILTER_NOT, FILTER_NFIELDS, 0, 0, 0);
+  } else {
+      parse_primary(p);
+  }
+}
+
+
+/** Parse conjunction */
+static void
+parse_and(struct parser *p)
+{
+  parse_not(p);
+  while (accept_word(p, "and")) {
+    parse_not(p);
+    emit(p, FILTER_AND, FILTER_NFIELDS, 0, 0, 0);
+  }
+}
+
+
+/** Parse disjunction */
+static void
+parse_or(struct parser *p)
+{
+  parse_and(p);
+  while (accept_word(p, "or")) {
+    parse_and(p);
+    emit(p, FILTER_OR, FILTER_NFIELDS, 0, 0, 0);
+  }
+}
+
+
+/**
+ * Compile filter expression.
+ *
+ * Expression consists of comparisons like <tt>amount > 500</tt> or
+ * <tt>category in (12,14)</tt> joined by "and", "or", "not" and
+ * parentheses. Fields are date, year, month, day, category, amount and
+ * sign. If expression is wrong then function will quit from program
+ * with failure exit code.
+ *
+ * @param filter compiled filter (output)
+ * @param expr expression
+ **/
+void
+filter_compile(struct filter *filter, const char *expr)
+{
+  struct parser p;
+
+  assert(filter != NULL);
+  assert(expr != NULL);
+
+  filter->code    = NULL;
+  filter->ncode   = 0;
+  filter->alloc   = 0;
+  filter->values  = NULL;
+  filter->nvalues = 0;
+  filter->valloc  = 0;
+  filter->fields  = 0;
+
+  p.filter = filter;
+  p.pos    = expr;
+  p.depth  = 0;
+
+  parse_or(&p);
+
+  skip_spaces(&p);
+  if (*p.pos != '\0') {
+      filter_error(&p, _("Unexpected text"));
+  }
+
+  assert(p.depth == 1);
+}
+
+
+/**
+ * Check that record matches filter.
+ *
+ * Fields of record are loaded once, then program is executed. Results
+ * of comparisons are computed without branches and are pushed as bits
+ * to machine word. Amount with currency code can't be compared with
+ * number, so on such records filter by amount quits from program with
+ * failure exit code.
+ *
+ * @param filter compiled filter
+ * @param rec record
+ *
+ * @retval 0 record doesn't match
+ * @retval 1 record matches
+ **/
+int
+filter_match(const struct filter *filter, const struct record *rec)
+{
+  const struct filter_insn *insn, *end;
+  const int64_t *val, *vend;
+  int64_t  v[FILTER_NFIELDS];
+  uint64_t stack = 0, bit;
+  int      cmp;
+
+  assert(filter != NULL);
+  assert(rec != NULL);
+
+  /* conversion of date is the only expensive field */
+  v[FILTER_DATE] = 0;
+  if (filter->fields & (1U << FILTER_DATE)) {
+      v[FILTER_DATE] = date_to_days(rec->year, rec->month, rec->day);
+  }
+  v[FILTER_YEAR]     = rec->year;
+  v[FILTER_MONTH]    = rec->month;
+  v[FILTER_DAY]      = rec->day;
+  v[FILTER_CATEGORY] = (int64_t)rec->category;
+  v[FILTER_AMOUNT]   = rec->amount;
+  if (rec->currency != 0 && (filter->fields & (1U << FILTER_AMOUNT))) {
+      fprintf(stderr, "%s\n",
+              _("Filter by amount cannot be used with currency codes"));
+      exit(EXIT_FAILURE);
+  }
+  v[FILTER_SIGN]     = 1 - 2 * (rec->sign == '-');
+
+  end = filter->code + filter->ncode;
+  for (insn = filter->code; insn < end; insn++) {
+    switch (insn->op) {
+        case FILTER_CMP:
+            cmp = (v[insn->field] > insn->value) - (v[insn->field] < insn->value);
+            stack = (stack << 1) | ((insn->accept >> (cmp + 1)) & 1);
+            break;
+        case FILTER_IN:
+            bit  = 0;
+            val  = filter->values + insn->value;
+            vend = val + insn->count;
+            for (; val < vend; val++) {
+              bit |= (uint64_t)(v[insn->field] == *val);
+            }
+            stack = (stack << 1) | bit;
+            break;
+        case FILTER_AND:
+            bit = stack & 1;
+            stack >>= 1;
+            stack &= bit | ~(uint64_t)1;
+            break;
+        case FILTER_OR:
+            bit = stack & 1;
+            stack >>= 1;
+            stack |= bit;
+            break;
+        case FILTER_NOT:
+            stack ^= 1;
+            break;
+    }
+  }
+
+  return (int)(stack & 1);
+}
+
+
+/**
+ * Handler for \ref scan_datafile() which passes matched records to
+ * other handler.
+ *
+ * @param rec record
+ * @param data pointer to struct filter_chain
+ **/
+void
+filter_handler(const struct record *rec, void *data)
+{
+  const struct filter_chain *chain = data;
+
+  if (filter_match(chain->filter, rec)) {
+      chain->handler(rec, chain->data);
+  }
+}
+
+
+/**
+ * Free memory which was allocated for filter.
+ *
+ * @param filter compiled filter
+ **/
+void
+filter_free(struct filter *filter)
+{
+  assert(filter != NULL);
+
+  free(filter->code);
+  free(filter->values);
+  filter->code   = NULL;
+  filter->values = NULL;
+  filter->ncode  = filter->nvalues = 0;
+}
+
@@ -0,0 +1,112 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   filter.h contains prototypes for functions which compile and apply filters
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef FILTER_H
+#define FILTER_H
+
+/* for size_t type */
+#include <stddef.h>
+
+/* for int64_t type */
+#include <stdint.h>
+
+/* for struct record and record_handler type */
+#include "common.h"
+#include "datafile.h"
+
+
+/** Fields of record which may be used in filter */
+typedef enum {
+  FILTER_DATE,     /**< date as number of days */
+  FILTER_YEAR,     /**< year */
+  FILTER_MONTH,    /**< month */
+  FILTER_DAY,      /**< day of month */
+  FILTER_CATEGORY, /**< number of category */
+  FILTER_AMOUNT,   /**< amount in hundredths */
+  FILTER_SIGN,     /**< 1 for profit and -1 for cost */
+  FILTER_NFIELDS   /**< count of fields */
+} filter_field;
+
+/** Instructions of compiled filter */
+typedef enum {
+  FILTER_CMP, /**< push result of comparison of field with value */
+  FILTER_IN,  /**< push 1 if field equals to one of values */
+  FILTER_AND, /**< replace two top results by their conjunction */
+  FILTER_OR,  /**< replace two top results by their disjunction */
+  FILTER_NOT  /**< invert top result */
+} filter_opcode;
+
+/**
+ * One instruction of compiled filter.
+ *
+ * Comparison is done without branching on operator: \c accept has bit 0
+ * for "less", bit 1 for "equal" and bit 2 for "greater", so "<=" is 3
+ * and "!=" is 5.
+ **/
+struct filter_insn {
+  unsigned char op;     /**< see \ref filter_opcode */
+  unsigned char field;  /**< see \ref filter_field */
+  unsigned char accept; /**< accepted results of comparison */
+  unsigned char reserved; /**< not used, always zero */
+  uint32_t      count;  /**< count of values for FILTER_IN */
+  int64_t       value;  /**< value or number of first value for FILTER_IN */
+};
+
+/**
+ * Compiled filter.
+ *
+ * Expression is compiled into program in reverse polish notation.
+ * Results of comparisons are kept as bits of one machine word, so
+ * evaluation doesn't touch memory except record fields.
+ **/
+struct filter {
+  struct filter_insn *code;    /**< instructions */
+  size_t              ncode;   /**< count of instructions */
+  size_t              alloc;   /**< count of allocated instructions */
+  int64_t            *values;  /**< values for FILTER_IN instructions */
+  size_t              nvalues; /**< count of values */
+  size_t              valloc;  /**< count of allocated values */
+  unsigned            fields;  /**< bit mask of used fields */
+};
+
+/** Data for \ref filter_handler() */
+struct filter_chain {
+  const struct filter *filter;  /**< filter */
+  record_handler       handler; /**< function for matched records */
+  void                *data;    /**< pointer which is passed to handler */
+};
+
+
+void filter_compile(struct filter *filter, const char *expr);
+int  filter_match(const struct filter *filter, const struct record *rec);
+void filter_handler(const struct record *rec, void *data);
+void filter_free(struct filter *filter);
+
+#endif /* FILTER_H */
+
@@ -0,0 +1,180 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   fuzz_parser.c contains harness for fuzzing of parser of records
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/*
+ * Harness feeds every line of input to \ref parser_check_line() and
+ * aborts when fast path and full check disagree.
+ *
+ * With libFuzzer:
+ *   make fuzz_parser CC=clang \
+ *        CFLAGS="-g -O1 -fsanitize=fuzzer,address -DFUZZ_LIBFUZZER"
+ *   ./fuzz_parser -close_fd_mask=2 corpus/
+ *
+ * With AFL (input file or stdin):
+ *   make fuzz_parser CC=afl-gcc
+ *   afl-fuzz -i corpus -o findings ./fuzz_parser @@
+ *
+ * Full check prints errors for wrong strings to stderr, so stderr is
+ * closed (-close_fd_mask=2) or redirected to /dev/null.
+ */
+
+/* for uint8_t type */
+#include <stdint.h>
+
+/* for fprintf()
+ *     fopen()
+ *     fread()
+ *     fclose()
+ *     perror()
+ *     FILE and NULL constants
+ **/
+#include <stdio.h>
+
+/* for realloc()
+ *     free()
+ *     abort()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memchr() */
+#include <string.h>
+
+#include "parser_check.h"
+
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+
+/**
+ * Check all lines of input.
+ *
+ * @param data input
+ * @param size size of input
+ *
+ * @return always 0
+ **/
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  static struct parser_check pc;
+  static int ready = 0;
+  const char *p, *end, *nl;
+
+  if (!ready) {
+      parser_check_init(&pc);
+      ready = 1;
+  }
+
+  p   = (const char *)data;
+  end = p + size;
+  while (p < end) {
+    nl = memchr(p, '\n', (size_t)(end - p));
+    if (nl == NULL) {
+        nl = end;
+    }
+    if (parser_check_line(&pc, p, (size_t)(nl - p), NULL) == PARSER_MISMATCH) {
+        abort();
+    }
+    p = nl + 1;
+  }
+
+  return 0;
+}
+
+
+#ifndef FUZZ_LIBFUZZER
+/**
+ * Read whole file.
+ *
+ * @param fp file
+ * @param size size of data (output)
+ *
+ * @return data (should be freed)
+ **/
+static uint8_t *
+read_all(FILE *fp, size_t *size)
+{
+  uint8_t *data, *tmp;
+  size_t capacity, n;
+
+  data = NULL;
+  capacity = *size = 0;
+  do {
+    if (*size == capacity) {
+        capacity = capacity == 0 ? 4096 : capacity * 2;
+        tmp = realloc(data, capacity);
+        if (tmp == NULL) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        data = tmp;
+    }
+    n = fread(data + *size, 1, capacity - *size, fp);
+    *size += n;
+  } while (n > 0);
+
+  return data;
+}
+
+
+/**
+ * Check files from command line or stdin.
+ **/
+int
+main(int argc, char **argv)
+{
+  FILE *fp;
+  uint8_t *data;
+  size_t size;
+  int i;
+
+  if (argc < 2) {
+      data = read_all(stdin, &size);
+      LLVMFuzzerTestOneInput(data, size);
+      free(data);
+      return EXIT_SUCCESS;
+  }
+
+  for (i = 1; i < argc; i++) {
+    fp = fopen(argv[i], "rb");
+    if (fp == NULL) {
+        perror(argv[i]);
+        return EXIT_FAILURE;
+    }
+    data = read_all(fp, &size);
+    fclose(fp);
+    LLVMFuzzerTestOneInput(data, size);
+    free(data);
+  }
+
+  return EXIT_SUCCESS;
+}
+#endif /* FUZZ_LIBFUZZER */
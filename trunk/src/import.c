@@ -0,0 +1,691 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   import.c contains functions which import bank statements
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for fstat() */
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* for assert() */
+#include <assert.h>
+
+/* for pthread_create()
+ *     pthread_join()
+ **/
+#include <pthread.h>
+
+/* for sysconf() */
+#include <unistd.h>
+
+/* for printf()
+ *     fprintf()
+ *     snprintf()
+ *     fopen()
+ *     fread()
+ *     fclose()
+ *     perror()
+ *     NULL constant
+ **/
+#include <stdio.h>
+
+/* for malloc()
+ *     realloc()
+ *     free()
+ *     strtol()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for strlen()
+ *     strchr()
+ *     strncmp()
+ *     memchr()
+ *     memcpy()
+ **/
+#include <string.h>
+
+/* for isdigit()
+ *     isspace()
+ **/
+#include <ctype.h>
+
+#include "import.h"
+#include "datafile.h"
+#include "checksum.h"
+
+
+/** Maximal count of columns in statement */
+#define IMPORT_MAX_COLUMNS 64
+
+/** Maximal count of threads */
+#define IMPORT_MAX_JOBS 64
+
+
+/** Part of statement which is converted by one thread */
+struct import_job {
+  const struct import_map *map; /**< mapping of columns */
+  const struct rules *rules;    /**< rules for categories or NULL */
+  char          *start;         /**< first byte of part */
+  char          *end;           /**< byte after last byte of part */
+  unsigned long  lineno;        /**< number of first line of part */
+  char          *out;           /**< converted records */
+  size_t         len;           /**< size of converted records */
+  size_t         size;          /**< size of allocated memory */
+  unsigned long  records;       /**< count of converted records */
+  unsigned long  fails;         /**< count of wrong lines */
+  int            checksum;      /**< append checksums to records */
+};
+
+
+/**
+ * Parse mapping of columns.
+ *
+ * Mapping looks like \c "date=1,amount=3,comment=2,skip=1,sep=;".
+ * Columns \c date and \c amount are mandatory. Separator may be given
+ * as one character or as word \c "tab".
+ *
+ * @param spec string with mapping
+ * @param map mapping (output)
+ *
+ * @retval 0 mapping is wrong
+ * @retval 1 mapping was parsed
+ **/
+int
+parse_import_map(const char *spec, struct import_map *map)
+{
+  const char *key, *value, *next;
+  size_t keylen, valuelen;
+  char  *endptr;
+  long   num;
+  int   *field;
+
+  assert(spec != NULL);
+  assert(map != NULL);
+
+  memset(map, 0, sizeof(*map));
+  map->sep = ',';
+
+  for (key = spec; *key != '\0'; key = next) {
+    next = strchr(key, ',');
+    if (next == NULL) {
+        next = key + strlen(key);
+    }
+
+    value = memchr(key, '=', (size_t)(next - key));
+    if (value == NULL) {
+        return 0;
+    }
+    keylen   = (size_t)(value - key);
+    value++;
+    valuelen = (size_t)(next - value);
+
+    if (*next == ',') {
+        next++;
+    }
+
+    if (keylen == 3 && strncmp(key, "sep", 3) == 0) {
+        if (valuelen == 1) {
+            map->sep = value[0];
+        } else if (valuelen == 3 && strncmp(value, "tab", 3) == 0) {
+            map->sep = '\t';
+        } else {
+            return 0;
+        }
+        continue;
+    }
+
+    if (valuelen == 0 || !isdigit((unsigned char)value[0])) {
+        return 0;
+    }
+    num = strtol(value, &endptr, 10);
+    if (endptr != value + valuelen || num > IMPORT_MAX_COLUMNS) {
+        return 0;
+    }
+
+    if (keylen == 4 && strncmp(key, "date", 4) == 0) {
+        field = &map->date;
+    } else if (keylen == 6 && strncmp(key, "amount", 6) == 0) {
+        field = &map->amount;
+    } else if (keylen == 4 && strncmp(key, "sign", 4) == 0) {
+        field = &map->sign;
+    } else if (keylen == 8 && strncmp(key, "category", 8) == 0) {
+        field = &map->category;
+    } else if (keylen == 7 && strncmp(key, "comment", 7) == 0) {
+        field = &map->comment;
+    } else if (keylen == 4 && strncmp(key, "skip", 4) == 0) {
+        map->skip = (int)num;
+        continue;
+    } else {
+        return 0;
+    }
+
+    if (num == 0) {
+        return 0;
+    }
+    *field = (int)num;
+  }
+
+  return map->date != 0 && map->amount != 0;
+}
+
+
+/**
+ * Split line of statement to fields.
+ *
+ * Fields may be quoted with '"' (quote inside quoted field is
+ * doubled). Line is modified: quotes are removed and each field is
+ * terminated by '\\0'. Spaces around fields are removed.
+ *
+ * @return count of fields
+ **/
+static int
+split_fields(char *line, char sep, char **fields)
+{
+  char *src, *dst, *last;
+  int   n;
+
+  src = line;
+  for (n = 0; n < IMPORT_MAX_COLUMNS; n++) {
+    while (*src == ' ' || *src == '\t') {
+      if (*src == sep) {
+          break;
+      }
+      src++;
+    }
+
+    fields[n] = dst = last = src;
+
+    if (*src == '"') {
+        for (src++; *src != '\0'; src++) {
+          if (*src == '"') {
+              if (src[1] != '"') {
+                  src++;
+                  break;
+              }
+              src++;
+          }
+          *dst++ = *src;
+        }
+        last = dst;
+    }
+
+    for (; *src != '\0' && *src != sep; src++) {
+      *dst++ = *src;
+      if (!isspace((unsigned char)*src)) {
+          last = dst;
+      }
+    }
+
+    if (*src == '\0') {
+        *last = '\0';
+        return n + 1;
+    }
+
+    src++;
+    *last = '\0';
+  }
+
+  return n;
+}
+
+
+/**
+ * Convert date to format of data file.
+ *
+ * Dates in formats \c "dd.mm.yyyy", \c "dd/mm/yyyy" and \c
+ * "yyyy-mm-dd" are understood.
+ *
+ * @param str date from statement
+ * @param out buffer for 10 characters of result
+ *
+ * @retval 0 unknown format of date
+ * @retval 1 date was converted
+ **/
+static int
+convert_date(const char *str, char *out)
+{
+  unsigned int n[3];
+  char sep1, sep2;
+  int  len;
+
+  if (sscanf(str, "%u%c%u%c%u%n", &n[0], &sep1, &n[1], &sep2, &n[2], &len) != 5 ||
+      str[len] != '\0' || sep1 != sep2) {
+      return 0;
+  }
+
+  if (sep1 == '-' && n[0] > 31) {
+      /* yyyy-mm-dd */
+      snprintf(out, 11, "%02u.%02u.%04u", n[2] % 100, n[1] % 100, n[0] % 10000);
+  } else if (sep1 == '.' || sep1 == '/') {
+      /* dd.mm.yyyy */
+      snprintf(out, 11, "%02u.%02u.%04u", n[0] % 100, n[1] % 100, n[2] % 10000);
+  } else {
+      return 0;
+  }
+
+  return 1;
+}
+
+
+/**
+ * Convert amount to format of data file.
+ *
+ * Sign is taken from amount. Last point or comma followed by one or two
+ * digits is decimal separator, all other points, commas and spaces are
+ * treated as thousands separators.
+ *
+ * @param str amount from statement
+ * @param sign sign of amount (output)
+ * @param out buffer for result, should be not smaller than str
+ *
+ * @retval 0 amount does not contain digits or contains wrong characters
+ * @retval 1 amount was converted
+ **/
+static int
+convert_amount(const char *str, char *sign, char *out)
+{
+  const char *i, *decimal;
+  int digits;
+
+  *sign = '+';
+  if (*str == '-' || *str == '+') {
+      *sign = *str++;
+  }
+
+  /* search for decimal separator */
+  decimal = NULL;
+  for (i = str; *i != '\0'; i++) {
+    if (*i == '.' || *i == ',') {
+        decimal = i;
+    } else if (!isdigit((unsigned char)*i) && *i != ' ') {
+        return 0;
+    }
+  }
+  if (decimal != NULL && (i - decimal - 1 < 1 || i - decimal - 1 > 2)) {
+      decimal = NULL;
+  }
+
+  digits = 0;
+  for (i = str; *i != '\0'; i++) {
+    if (isdigit((unsigned char)*i)) {
+        *out++ = *i;
+        digits++;
+    } else if (i == decimal) {
+        *out++ = '.';
+    }
+  }
+  *out = '\0';
+
+  return digits > 0;
+}
+
+
+/** Make sure that job can store len more bytes */
+static void
+job_reserve(struct import_job *job, size_t len)
+{
+  if (job->len + len > job->size) {
+      while (job->len + len > job->size) {
+        job->size = (job->size == 0) ? 64 * 1024 : job->size * 2;
+      }
+      job->out = realloc(job->out, job->size);
+      if (job->out == NULL) {
+          fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+          exit(EXIT_FAILURE);
+      }
+  }
+}
+
+
+/**
+ * Convert one line of statement.
+ *
+ * Record is appended to output of job and checked with \ref
+ * is_string_confirm_to_format().
+ *
+ * @retval 0 line cannot be converted
+ * @retval 1 line was converted
+ **/
+static int
+convert_line(struct import_job *job, char *line, unsigned long lineno)
+{
+  const struct import_map *map = job->map;
+  char  *fields[IMPORT_MAX_COLUMNS];
+  char   date[11];
+  char   category_buf[24];
+  long   matched;
+  char   sign;
+  char  *amount;
+  const char *category, *comment;
+  size_t len;
+  int    n;
+  char  *rec;
+
+  n = split_fields(line, map->sep, fields);
+  if (map->date > n || map->amount > n || map->sign > n ||
+      map->category > n || map->comment > n) {
+      fprintf(stderr, "%lu: %s\n", lineno, _("Not enough columns"));
+      return 0;
+  }
+
+  if (!convert_date(fields[map->date - 1], date)) {
+      fprintf(stderr, "%lu: %s: %s\n", lineno, _("Unknown format of date"),
+              fields[map->date - 1]);
+      return 0;
+  }
+
+  /* amount is converted in place */
+  amount = fields[map->amount - 1];
+  if (!convert_amount(amount, &sign, amount)) {
+      fprintf(stderr, "%lu: %s: %s\n", lineno, _("Wrong amount"), amount);
+      return 0;
+  }
+
+  if (map->sign != 0) {
+      sign = (fields[map->sign - 1][0] == '-' ||
+              fields[map->sign - 1][0] == 'D' ||
+              fields[map->sign - 1][0] == 'd') ? '-' : '+';
+  }
+
+  category = (map->category != 0) ? fields[map->category - 1] : "";
+  comment  = (map->comment  != 0) ? fields[map->comment  - 1] : "";
+
+  /* category which is not given in statement is found by rules */
+  if (*category == '\0') {
+      matched = (job->rules != NULL) ? rules_match(job->rules, comment) : -1;
+      if (matched >= 0) {
+          snprintf(category_buf, sizeof(category_buf), "%ld", matched);
+          category = category_buf;
+      } else {
+          category = "0";
+      }
+  }
+
+  /* "s|dd.mm.yyyy|" + category + "|" + amount + "|" + comment + "\0" */
+  len = 13 + strlen(category) + 1 + strlen(amount) + 1 + strlen(comment) + 1;
+  job_reserve(job, len + CHECKSUM_SUFFIX_LEN);
+
+  rec = job->out + job->len;
+  snprintf(rec, len, "%c|%s|%s|%s|%s", sign, date, category, amount, comment);
+
+  if (!is_string_confirm_to_format(rec, lineno)) {
+      return 0;
+  }
+
+  if (job->checksum) {
+      checksum_format(rec + len - 1, rec, len - 1);
+      len += CHECKSUM_SUFFIX_LEN;
+  }
+
+  /* replace terminating '\0' by newline */
+  job->len += len;
+  job->out[job->len - 1] = '\n';
+
+  return 1;
+}
+
+
+/**
+ * Convert part of statement. Used as start routine of thread.
+ *
+ * @param arg job
+ *
+ * @return NULL
+ **/
+static void *
+import_worker(void *arg)
+{
+  struct import_job *job = arg;
+  unsigned long lineno;
+  char *line, *eol;
+
+  lineno = job->lineno;
+  for (line = job->start; line < job->end; line = eol + 1, lineno++) {
+    eol = memchr(line, '\n', (size_t)(job->end - line));
+    if (eol == NULL) {
+        eol = job->end;
+    }
+    *eol = '\0';
+
+    if (eol > line && eol[-1] == '\r') {
+        eol[-1] = '\0';
+    }
+
+    /* skip headers and empty lines */
+    if (lineno <= (unsigned long)job->map->skip || *line == '\0') {
+        continue;
+    }
+
+    if (convert_line(job, line, lineno)) {
+        job->records++;
+    } else {
+        job->fails++;
+    }
+  }
+
+  return NULL;
+}
+
+
+/**
+ * Read whole file to memory.
+ *
+ * If error occurs then function will quit from program with failure
+ * exit code.
+ *
+ * @warning Don't forget to free memory after! Use free() for that.
+ *
+ * @param filename name of file
+ * @param size size of file (output)
+ *
+ * @return content of file
+ **/
+static char *
+read_whole_file(const char *filename, size_t *size)
+{
+  FILE  *fp;
+  struct stat st;
+  char  *buf;
+
+  fp = fopen(filename, "r");
+  if (fp == NULL) {
+      fprintf(stderr, "%s: %s\n", _("Failed to open file"), filename);
+      perror("fopen");
+      exit(EXIT_FAILURE);
+  }
+
+  if (fstat(fileno(fp), &st) == -1) {
+      perror("fstat");
+      exit(EXIT_FAILURE);
+  }
+
+  *size = (size_t)st.st_size;
+  buf = malloc(*size + 1);
+  if (buf == NULL) {
+      fprintf(stderr, "malloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+
+  if (fread(buf, 1, *size, fp) != *size) {
+      perror("fread");
+      exit(EXIT_FAILURE);
+  }
+  buf[*size] = '\0';
+
+  if (fclose(fp) != 0) {
+      perror("fclose");
+  }
+
+  return buf;
+}
+
+
+/**
+ * Import bank statement to data file.
+ *
+ * Statement is read to memory and divided to parts by lines. Parts are
+ * converted by worker threads and each converted record is checked
+ * with \ref is_string_confirm_to_format(). If all lines was converted
+ * then records are appended to data file at once with \ref
+ * append_to_datafile(). Otherwise nothing is imported and function
+ * will quit from program with failure exit code.
+ *
+ * Records without category get category from rules (if rules are
+ * given) or category 0.
+ *
+ * @param dbfile path to data file
+ * @param filename name of file with statement
+ * @param map mapping of statement columns
+ * @param rules compiled rules or NULL
+ * @param jobs count of threads (0 for count of processors)
+ * @param checksum nonzero when checksums should be appended to records
+ * @param verbose level of verbose
+ **/
+void
+import_statement(const char *dbfile, const char *filename,
+                 const struct import_map *map,
+                 const struct rules *rules, int jobs, int checksum,
+                 unsigned int verbose)
+{
+  struct import_job job[IMPORT_MAX_JOBS];
+  pthread_t thread[IMPORT_MAX_JOBS];
+  char   *buf, *pos, *split, *out;
+  size_t  size, len;
+  unsigned long lineno, records, fails;
+  int     i, ret;
+
+  assert(dbfile != NULL);
+  assert(filename != NULL);
+  assert(map != NULL);
+
+  buf = read_whole_file(filename, &size);
+
+  if (jobs <= 0) {
+      jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if ((size_t)jobs > size / IMPORT_MIN_CHUNK) {
+      jobs = (int)(size / IMPORT_MIN_CHUNK);
+  }
+  if (jobs > IMPORT_MAX_JOBS) {
+      jobs = IMPORT_MAX_JOBS;
+  }
+  if (jobs < 1) {
+      jobs = 1;
+  }
+
+  if (verbose >= 1) {
+      printf("-> %s %d\n", _("Count of threads for import:"), jobs);
+  }
+
+  /* divide statement to parts on line boundaries */
+  lineno = 1UL;
+  pos = buf;
+  for (i = 0; i < jobs; i++) {
+    memset(&job[i], 0, sizeof(job[i]));
+    job[i].map    = map;
+    job[i].rules  = rules;
+    job[i].start  = pos;
+    job[i].lineno = lineno;
+    job[i].checksum = checksum;
+
+    split = buf + size / (size_t)jobs * (size_t)(i + 1);
+    if (i == jobs - 1 || split < pos) {
+        split = buf + size;
+    } else {
+        split = memchr(split, '\n', (size_t)(buf + size - split));
+        split = (split == NULL) ? buf + size : split + 1;
+    }
+    job[i].end = split;
+
+    /* count lines for numbering of next part */
+    for (; pos < split; lineno++) {
+      pos = memchr(pos, '\n', (size_t)(split - pos));
+      if (pos == NULL) {
+          pos = split;
+      } else {
+          pos++;
+      }
+    }
+  }
+
+  for (i = 1; i < jobs; i++) {
+    ret = pthread_create(&thread[i], NULL, import_worker, &job[i]);
+    if (ret != 0) {
+        fprintf(stderr, "pthread_create: %s\n", _("error occurs"));
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  import_worker(&job[0]);
+
+  for (i = 1; i < jobs; i++) {
+    pthread_join(thread[i], NULL);
+  }
+
+  /* join results */
+  records = fails = 0UL;
+  len = 0;
+  for (i = 0; i < jobs; i++) {
+    records += job[i].records;
+    fails   += job[i].fails;
+    len     += job[i].len;
+  }
+
+  if (fails > 0) {
+      fprintf(stderr, _("%lu wrong lines in statement. Nothing was imported.\n"),
+              fails);
+      exit(EXIT_FAILURE);
+  }
+
+  out = job[0].out;
+  if (jobs > 1) {
+      out = realloc(out, len + 1);
+      if (out == NULL) {
+          fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+          exit(EXIT_FAILURE);
+      }
+      for (i = 1, size = job[0].len; i < jobs; i++) {
+        memcpy(out + size, job[i].out, job[i].len);
+        size += job[i].len;
+        free(job[i].out);
+      }
+  }
+
+  if (len > 0) {
+      append_to_datafile(dbfile, out, len, verbose);
+  }
+
+  if (verbose >= 1) {
+      printf(_("-> Imported %lu records\n"), records);
+  }
+
+  free(out);
+  free(buf);
+}
+
@@ -0,0 +1,65 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   import.h contains prototypes for functions which import bank statements
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef IMPORT_H
+#define IMPORT_H
+
+/* for struct rules */
+#include "rules.h"
+
+/** Default mapping of columns for action "import" */
+#define IMPORT_DEFAULT_MAP "date=1,amount=2,comment=3"
+
+/** Minimal size of statement part which is converted by one thread */
+#define IMPORT_MIN_CHUNK (64 * 1024)
+
+/**
+ * Mapping of statement columns to fields of record.
+ *
+ * Columns are numbered from 1. Zero means that column is absent.
+ **/
+struct import_map {
+  int  date;     /**< column with date */
+  int  amount;   /**< column with amount (negative amount means costs) */
+  int  sign;     /**< column with sign ("-" or "D..." means costs) */
+  int  category; /**< column with category */
+  int  comment;  /**< column with comment */
+  int  skip;     /**< count of lines at start (headers) which are skipped */
+  char sep;      /**< separator of columns */
+};
+
+
+int  parse_import_map(const char *spec, struct import_map *map);
+void import_statement(const char *dbfile, const char *filename,
+                      const struct import_map *map,
+                      const struct rules *rules, int jobs, int checksum,
+                      unsigned int verbose);
+
+#endif /* IMPORT_H */
+
@@ -0,0 +1,1254 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   index.c contains functions which maintain full-text index of comments
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for open()
+ *     fstat()
+ **/
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* for flock() */
+#include <sys/file.h>
+
+/* for assert() */
+#include <assert.h>
+
+/* for open() */
+#include <fcntl.h>
+
+/* for pread()
+ *     pwrite()
+ *     ftruncate()
+ *     fsync()
+ *     close()
+ *     unlink()
+ **/
+#include <unistd.h>
+
+/* for printf()
+ *     fprintf()
+ *     perror()
+ *     rename()
+ *     fdopen()
+ *     fseeko()
+ *     getline()
+ *     fclose()
+ *     NULL constant
+ **/
+#include <stdio.h>
+
+/* for malloc()
+ *     realloc()
+ *     free()
+ *     qsort()
+ *     mkstemp()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memcmp()
+ *     memcpy()
+ *     memset()
+ *     strcmp()
+ **/
+#include <string.h>
+
+#include "index.h"
+#include "common.h"
+#include "checksum.h"
+
+
+/** Magic string at start of index file */
+#define INDEX_MAGIC "OFMI"
+
+/** Current version of index file format */
+#define INDEX_VERSION 1
+
+/** Suffix of temporary file which will be renamed to index file */
+#define INDEX_TMP_SUFFIX ".idx.XXXXXX"
+
+/** Initial size of hash table for words */
+#define INDEX_HASH_SIZE 1024
+
+/** Check that byte may be part of word (UTF-8 bytes are kept as is) */
+#define IS_WORD_BYTE(c) \
+    (((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z') || \
+     ((c) >= '0' && (c) <= '9') || (c) >= 0x80)
+
+
+/** Growable array of bytes. */
+struct bytes {
+  unsigned char *buf;  /**< data */
+  size_t         len;  /**< size of data */
+  size_t         size; /**< size of allocated memory */
+};
+
+/** Word with postings which are collected in memory. */
+struct index_term {
+  char        *text;  /**< word (null-terminated) */
+  size_t       len;   /**< length of word */
+  uint64_t     count; /**< count of records with this word */
+  uint64_t     last;  /**< offset of last record */
+  struct bytes post;  /**< delta-encoded offsets of records */
+};
+
+/** Words of records which are collected in memory. */
+struct index_builder {
+  struct index_term *terms;    /**< words in order of appearance */
+  size_t             nterms;   /**< count of words */
+  size_t             alloc;    /**< count of allocated words */
+  size_t            *hash;     /**< number of word + 1 or 0 for empty slot */
+  size_t             hashsize; /**< size of hash table (power of 2) */
+};
+
+/** Word which was read from segment. */
+struct index_entry {
+  const unsigned char *text;    /**< word (not null-terminated) */
+  size_t               len;     /**< length of word */
+  uint64_t             count;   /**< count of records */
+  uint64_t             last;    /**< offset of last record */
+  const unsigned char *post;    /**< postings */
+  size_t               postlen; /**< size of postings */
+};
+
+/** Sorted offsets of records. */
+struct offsets {
+  uint64_t *items; /**< offsets */
+  size_t    count; /**< count of used items */
+  size_t    alloc; /**< count of allocated items */
+};
+
+
+/**
+ * Allocate memory or quit from program.
+ *
+ * @param ptr old pointer or NULL
+ * @param size new size
+ *
+ * @return pointer to memory
+ **/
+static void *
+xrealloc(void *ptr, size_t size)
+{
+  ptr = realloc(ptr, size);
+  if (ptr == NULL) {
+      perror("realloc");
+      exit(EXIT_FAILURE);
+  }
+
+  return ptr;
+}
+
+
+/**
+ * Append data to array of bytes.
+ *
+ * @param b array of bytes
+ * @param data data for appending
+ * @param len size of data
+ **/
+static void
+bytes_put(struct bytes *b, const void *data, size_t len)
+{
+  if (b->len + len > b->size) {
+      b->size = b->size * 2 + len + 16;
+      b->buf = xrealloc(b->buf, b->size);
+  }
+  memcpy(b->buf + b->len, data, len);
+  b->len += len;
+}
+
+
+/**
+ * Append number in varint format: 7 bits per byte, high bit means that
+ * more bytes follow.
+ *
+ * @param b array of bytes
+ * @param value number
+ **/
+static void
+bytes_varint(struct bytes *b, uint64_t value)
+{
+  unsigned char tmp[10];
+  size_t len = 0;
+
+  while (value >= 0x80) {
+    tmp[len++] = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  tmp[len++] = (unsigned char)value;
+
+  bytes_put(b, tmp, len);
+}
+
+
+/**
+ * Read number in varint format.
+ *
+ * @param pos current position (will be moved after number)
+ * @param end end of data
+ * @param value number (output)
+ *
+ * @retval 0 data is truncated or number is too long
+ * @retval 1 number was read
+ **/
+static int
+read_varint(const unsigned char **pos, const unsigned char *end,
+            uint64_t *value)
+{
+  const unsigned char *p = *pos;
+  unsigned shift = 0;
+
+  *value = 0;
+  while (p < end && shift < 64) {
+    *value |= (uint64_t)(*p & 0x7f) << shift;
+    if ((*p++ & 0x80) == 0) {
+        *pos = p;
+        return 1;
+    }
+    shift += 7;
+  }
+
+  return 0;
+}
+
+
+/**
+ * Find next word in text.
+ *
+ * Word is sequence of latin letters, digits and non-ASCII bytes. Text
+ * ends with null or newline character or at given end. Words are lowercased (for latin letters only) and truncated to \ref
+ * INDEX_MAX_TOKEN bytes. Words shorter than \ref INDEX_MIN_TOKEN are
+ * skipped.
+ *
+ * @param text text (will be moved after word)
+ * @param end end of text or NULL
+ * @param word buffer for word with size INDEX_MAX_TOKEN + 1
+ *
+ * @return length of word or 0 if there are no more words
+ **/
+static size_t
+next_token(const char **text, const char *end, char *word)
+{
+  const unsigned char *p = (const unsigned char *)*text;
+  size_t len;
+
+  for (;;) {
+    while ((const char *)p != end && *p != '\0' && *p != '\n' &&
+           !IS_WORD_BYTE(*p)) {
+      p++;
+    }
+    if ((const char *)p == end || *p == '\0' || *p == '\n') {
+        *text = (const char *)p;
+        return 0;
+    }
+
+    for (len = 0; (const char *)p != end && IS_WORD_BYTE(*p); p++) {
+      if (len < INDEX_MAX_TOKEN) {
+          word[len++] = (*p >= 'A' && *p <= 'Z') ? (char)(*p - 'A' + 'a') : (char)*p;
+      }
+    }
+    word[len] = '\0';
+
+    if (len >= INDEX_MIN_TOKEN) {
+        *text = (const char *)p;
+        return len;
+    }
+  }
+}
+
+
+/**
+ * Calculate hash of word (FNV-1a).
+ *
+ * @param text word
+ * @param len length of word
+ *
+ * @return hash
+ **/
+static size_t
+hash_token(const char *text, size_t len)
+{
+  uint32_t h = 2166136261U;
+
+  while (len-- > 0) {
+    h ^= (unsigned char)*text++;
+    h *= 16777619U;
+  }
+
+  return (size_t)h;
+}
+
+
+/**
+ * Initialize empty builder.
+ *
+ * @param ib builder
+ **/
+static void
+builder_init(struct index_builder *ib)
+{
+  ib->terms    = NULL;
+  ib->nterms   = 0;
+  ib->alloc    = 0;
+  ib->hashsize = INDEX_HASH_SIZE;
+  ib->hash     = xrealloc(NULL, ib->hashsize * sizeof(size_t));
+  memset(ib->hash, 0, ib->hashsize * sizeof(size_t));
+}
+
+
+/**
+ * Free memory which was allocated for builder.
+ *
+ * @param ib builder
+ **/
+static void
+builder_free(struct index_builder *ib)
+{
+  size_t i;
+
+  for (i = 0; i < ib->nterms; i++) {
+    free(ib->terms[i].text);
+    free(ib->terms[i].post.buf);
+  }
+  free(ib->terms);
+  free(ib->hash);
+}
+
+
+/**
+ * Find word in builder or add new one.
+ *
+ * @param ib builder
+ * @param text word
+ * @param len length of word
+ *
+ * @return word
+ **/
+static struct index_term *
+builder_term(struct index_builder *ib, const char *text, size_t len)
+{
+  struct index_term *term;
+  size_t slot, i;
+
+  slot = hash_token(text, len) & (ib->hashsize - 1);
+  while (ib->hash[slot] != 0) {
+    term = &ib->terms[ib->hash[slot] - 1];
+    if (term->len == len && memcmp(term->text, text, len) == 0) {
+        return term;
+    }
+    slot = (slot + 1) & (ib->hashsize - 1);
+  }
+
+  if (ib->nterms == ib->alloc) {
+      ib->alloc = ib->alloc * 2 + 64;
+      ib->terms = xrealloc(ib->terms, ib->alloc * sizeof(*ib->terms));
+  }
+
+  term = &ib->terms[ib->nterms++];
+  term->text = xrealloc(NULL, len + 1);
+  memcpy(term->text, text, len + 1);
+  term->len   = len;
+  term->count = 0;
+  term->last  = 0;
+  term->post.buf  = NULL;
+  term->post.len  = 0;
+  term->post.size = 0;
+  ib->hash[slot] = ib->nterms;
+
+  /* keep hash table at most half full */
+  if (ib->nterms * 2 > ib->hashsize) {
+      free(ib->hash);
+      ib->hashsize *= 2;
+      ib->hash = xrealloc(NULL, ib->hashsize * sizeof(size_t));
+      memset(ib->hash, 0, ib->hashsize * sizeof(size_t));
+      for (i = 0; i < ib->nterms; i++) {
+        slot = hash_token(ib->terms[i].text, ib->terms[i].len) & (ib->hashsize - 1);
+        while (ib->hash[slot] != 0) {
+          slot = (slot + 1) & (ib->hashsize - 1);
+        }
+        ib->hash[slot] = i + 1;
+      }
+  }
+
+  return &ib->terms[ib->nterms - 1];
+}
+
+
+/**
+ * Add words of comment to builder. Records should be added in order of
+ * increasing offsets.
+ *
+ * @param ib builder
+ * @param comment comment of record
+ * @param end end of comment or NULL
+ * @param offset offset of record in data file
+ **/
+static void
+builder_add(struct index_builder *ib, const char *comment, const char *end,
+            uint64_t offset)
+{
+  struct index_term *term;
+  char   word[INDEX_MAX_TOKEN + 1];
+  size_t len;
+
+  while ((len = next_token(&comment, end, word)) > 0) {
+    term = builder_term(ib, word, len);
+
+    /* word repeats in the same record */
+    if (term->count > 0 && term->last == offset) {
+        continue;
+    }
+
+    bytes_varint(&term->post, term->count > 0 ? offset - term->last : offset);
+    term->last = offset;
+    term->count++;
+  }
+}
+
+
+/**
+ * Handler for \ref scan_datafile() which adds record to builder.
+ *
+ * @param rec record
+ * @param data builder
+ **/
+static void
+builder_add_record(const struct record *rec, void *data)
+{
+  builder_add(data, rec->comment, NULL, (uint64_t)rec->offset);
+}
+
+
+/**
+ * Compare words for qsort().
+ **/
+static int
+compare_terms(const void *a, const void *b)
+{
+  return strcmp(((const struct index_term *)a)->text,
+                ((const struct index_term *)b)->text);
+}
+
+
+/**
+ * Write one word of segment.
+ *
+ * @param b segment data
+ * @param text word
+ * @param len length of word
+ * @param count count of records
+ * @param last offset of last record
+ * @param post postings
+ * @param postlen size of postings
+ **/
+static void
+put_entry(struct bytes *b, const void *text, size_t len, uint64_t count,
+          uint64_t last, const void *post, size_t postlen)
+{
+  bytes_varint(b, len);
+  bytes_put(b, text, len);
+  bytes_varint(b, count);
+  bytes_varint(b, last);
+  bytes_varint(b, postlen);
+  bytes_put(b, post, postlen);
+}
+
+
+/**
+ * Make segment from words of builder. Words are sorted, so builder
+ * cannot be used for adding after this call.
+ *
+ * @param ib builder
+ * @param seg segment data (output)
+ *
+ * @return count of words
+ **/
+static uint32_t
+builder_segment(struct index_builder *ib, struct bytes *seg)
+{
+  struct index_term *term;
+  size_t i;
+
+  qsort(ib->terms, ib->nterms, sizeof(*ib->terms), compare_terms);
+
+  for (i = 0; i < ib->nterms; i++) {
+    term = &ib->terms[i];
+    put_entry(seg, term->text, term->len, term->count, term->last,
+              term->post.buf, term->post.len);
+  }
+
+  return (uint32_t)ib->nterms;
+}
+
+
+/**
+ * Read one word of segment.
+ *
+ * @param pos current position (will be moved after word)
+ * @param end end of segment
+ * @param entry word (output)
+ *
+ * @retval 0 segment is damaged
+ * @retval 1 word was read
+ **/
+static int
+read_entry(const unsigned char **pos, const unsigned char *end,
+           struct index_entry *entry)
+{
+  uint64_t len, postlen;
+
+  if (!read_varint(pos, end, &len) || len > (uint64_t)(end - *pos)) {
+      return 0;
+  }
+  entry->text = *pos;
+  entry->len  = (size_t)len;
+  *pos += len;
+
+  if (!read_varint(pos, end, &entry->count) ||
+      !read_varint(pos, end, &entry->last) ||
+      !read_varint(pos, end, &postlen) ||
+      postlen > (uint64_t)(end - *pos)) {
+      return 0;
+  }
+  entry->post    = *pos;
+  entry->postlen = (size_t)postlen;
+  *pos += postlen;
+
+  return 1;
+}
+
+
+/**
+ * Compare words of segments.
+ **/
+static int
+compare_entries(const struct index_entry *a, const struct index_entry *b)
+{
+  int ret;
+
+  ret = memcmp(a->text, b->text, a->len < b->len ? a->len : b->len);
+  if (ret != 0) {
+      return ret;
+  }
+
+  return (a->len > b->len) - (a->len < b->len);
+}
+
+
+/**
+ * Merge two segments. All records of new segment should follow records
+ * of old segment, so postings of the same word are concatenated:
+ * only first delta of new postings is changed.
+ *
+ * @param old older segment
+ * @param oldlen size of older segment
+ * @param new newer segment
+ * @param newlen size of newer segment
+ * @param out merged segment (output)
+ *
+ * @return count of words or -1 if segment is damaged
+ **/
+static long
+merge_segments(const unsigned char *old, size_t oldlen,
+               const unsigned char *new, size_t newlen, struct bytes *out)
+{
+  const unsigned char *a = old, *aend = old + oldlen;
+  const unsigned char *b = new, *bend = new + newlen;
+  const unsigned char *post;
+  struct index_entry ea, eb;
+  struct bytes tmp = { NULL, 0, 0 };
+  uint64_t first;
+  int has_a, has_b, cmp;
+  long nterms = 0;
+
+  has_a = a < aend && read_entry(&a, aend, &ea);
+  has_b = b < bend && read_entry(&b, bend, &eb);
+
+  while (has_a || has_b) {
+    cmp = !has_a ? 1 : !has_b ? -1 : compare_entries(&ea, &eb);
+
+    if (cmp < 0) {
+        put_entry(out, ea.text, ea.len, ea.count, ea.last, ea.post, ea.postlen);
+    } else if (cmp > 0) {
+        put_entry(out, eb.text, eb.len, eb.count, eb.last, eb.post, eb.postlen);
+    } else {
+        /* first posting of newer segment is absolute offset */
+        post = eb.post;
+        if (!read_varint(&post, eb.post + eb.postlen, &first) || first <= ea.last) {
+            free(tmp.buf);
+            return -1;
+        }
+        tmp.len = 0;
+        bytes_put(&tmp, ea.post, ea.postlen);
+        bytes_varint(&tmp, first - ea.last);
+        bytes_put(&tmp, post, (size_t)(eb.post + eb.postlen - post));
+        put_entry(out, ea.text, ea.len, ea.count + eb.count, eb.last,
+                  tmp.buf, tmp.len);
+    }
+    nterms++;
+
+    if (cmp <= 0) {
+        has_a = a < aend;
+        if (has_a && !read_entry(&a, aend, &ea)) {
+            free(tmp.buf);
+            return -1;
+        }
+    }
+    if (cmp >= 0) {
+        has_b = b < bend;
+        if (has_b && !read_entry(&b, bend, &eb)) {
+            free(tmp.buf);
+            return -1;
+        }
+    }
+  }
+
+  free(tmp.buf);
+
+  return nterms;
+}
+
+
+/**
+ * Check that header of index describes given data file.
+ *
+ * @param hdr header of index file
+ * @param st statistics about data file
+ *
+ * @retval 0 index is damaged or stale
+ * @retval 1 index is valid
+ **/
+static int
+header_is_valid(const struct index_header *hdr, const struct stat *st)
+{
+  return memcmp(hdr->magic, INDEX_MAGIC, 4) == 0 &&
+         hdr->version == INDEX_VERSION &&
+         hdr->dbsize  == (int64_t)st->st_size &&
+         hdr->dbmtime == (int64_t)st->st_mtime &&
+         hdr->dbino   == (int64_t)st->st_ino;
+}
+
+
+/**
+ * Fill header of index file.
+ *
+ * @param hdr header (output)
+ * @param nsegments count of segments
+ * @param st statistics about data file
+ **/
+static void
+header_fill(struct index_header *hdr, uint32_t nsegments,
+            const struct stat *st)
+{
+  memset(hdr, 0, sizeof(*hdr));
+  memcpy(hdr->magic, INDEX_MAGIC, 4);
+  hdr->version   = INDEX_VERSION;
+  hdr->nsegments = nsegments;
+  hdr->dbsize    = (int64_t)st->st_size;
+  hdr->dbmtime   = (int64_t)st->st_mtime;
+  hdr->dbino     = (int64_t)st->st_ino;
+}
+
+
+/**
+ * Read whole buffer from file descriptor at given position.
+ *
+ * @param fd file descriptor
+ * @param buf buffer for data
+ * @param len size of data
+ * @param offset position in file
+ *
+ * @retval 0 error occurs or file is too short
+ * @retval 1 all data was read
+ **/
+static int
+pread_all(int fd, void *buf, size_t len, off_t offset)
+{
+  ssize_t rret; /* for storage pread() return value */
+  char   *pos = buf;
+
+  while (len > 0) {
+    rret = pread(fd, pos, len, offset);
+    if (rret <= 0) {
+        return 0;
+    }
+    pos    += rret;
+    len    -= (size_t)rret;
+    offset += rret;
+  }
+
+  return 1;
+}
+
+
+/**
+ * Write whole buffer to file descriptor at given position.
+ *
+ * @param fd file descriptor
+ * @param buf data for writing
+ * @param len size of data
+ * @param offset position in file
+ *
+ * @retval 0 error occurs
+ * @retval 1 all data was written
+ **/
+static int
+pwrite_all(int fd, const void *buf, size_t len, off_t offset)
+{
+  ssize_t wret; /* for storage pwrite() return value */
+  const char *pos = buf;
+
+  while (len > 0) {
+    wret = pwrite(fd, pos, len, offset);
+    if (wret == -1) {
+        perror("pwrite");
+        return 0;
+    }
+    pos    += wret;
+    len    -= (size_t)wret;
+    offset += wret;
+  }
+
+  return 1;
+}
+
+
+/**
+ * Build index for whole data file and save him.
+ *
+ * Index is written to temporary file which then replaces old index, so
+ * readers never see partially written file.
+ *
+ * @param dbfile path to data file
+ * @param st statistics about data file
+ * @param seg segment with all words (output)
+ * @param verbose level of verbose
+ **/
+static void
+index_rebuild(const char *dbfile, const struct stat *st, struct bytes *seg,
+              unsigned int verbose)
+{
+  struct index_builder ib;
+  struct index_header  hdr;
+  struct index_segment sh;
+  char *path, *tmppath;
+  int   fd;
+
+  if (verbose >= 2) {
+      printf("--> %s\n", _("Building index"));
+  }
+
+  builder_init(&ib);
+  scan_datafile(dbfile, verbose, builder_add_record, &ib);
+  seg->len = 0;
+  memset(&sh, 0, sizeof(sh));
+  sh.nterms = builder_segment(&ib, seg);
+  sh.size   = seg->len;
+  builder_free(&ib);
+
+  path    = get_side_file_path(dbfile, INDEX_SUFFIX);
+  tmppath = get_side_file_path(dbfile, INDEX_TMP_SUFFIX);
+  if (path == NULL || tmppath == NULL) {
+      free(path);
+      free(tmppath);
+      return;
+  }
+
+  fd = mkstemp(tmppath);
+  if (fd == -1) {
+      /* index is not required, so work without him */
+      perror("mkstemp");
+      free(path);
+      free(tmppath);
+      return;
+  }
+
+  header_fill(&hdr, 1, st);
+  if (!pwrite_all(fd, &hdr, sizeof(hdr), 0) ||
+      !pwrite_all(fd, &sh, sizeof(sh), sizeof(hdr)) ||
+      !pwrite_all(fd, seg->buf, seg->len, sizeof(hdr) + sizeof(sh)) ||
+      fsync(fd) == -1 || close(fd) == -1 ||
+      rename(tmppath, path) == -1) {
+      perror(_("Failed to save index"));
+      unlink(tmppath);
+  }
+
+  free(path);
+  free(tmppath);
+}
+
+
+/**
+ * Add new records to index.
+ *
+ * Function is called by \ref append_to_datafile() while data file is
+ * locked. Words of new records are written as new segment at the end
+ * of index file. Then while previous segment is not much bigger than
+ * the last one, they are merged. Header is written last, so if process
+ * dies before that then index stays stale and will be rebuilt.
+ *
+ * If index does not exist or does not describe data file without new
+ * records then nothing is done: index will be rebuilt by \ref
+ * search_datafile() when it will be needed.
+ *
+ * @param dbfile path to data file
+ * @param before statistics about data file without new records
+ * @param after statistics about data file with new records
+ * @param lines new strings (each ends with newline)
+ * @param len size of strings
+ * @param base offset of first new string in data file
+ * @param verbose level of verbose
+ **/
+void
+index_append(const char *dbfile, const struct stat *before,
+             const struct stat *after, const char *lines, size_t len,
+             long long base, unsigned int verbose)
+{
+  struct index_builder ib;
+  struct index_header  hdr;
+  struct index_segment sh;
+  struct record rec;
+  struct bytes  seg = { NULL, 0, 0 };
+  struct bytes  merged;
+  unsigned char *prev;
+  const char *line, *end, *stop;
+  off_t   *positions = NULL;
+  uint64_t *sizes = NULL;
+  off_t    pos;
+  uint32_t n, i;
+  long     nterms;
+  char    *path;
+  int      fd;
+
+  assert(dbfile != NULL);
+  assert(lines != NULL);
+
+  path = get_side_file_path(dbfile, INDEX_SUFFIX);
+  if (path == NULL) {
+      return;
+  }
+
+  fd = open(path, O_RDWR);
+  free(path);
+  if (fd == -1) {
+      return;
+  }
+  if (!pread_all(fd, &hdr, sizeof(hdr), 0) || !header_is_valid(&hdr, before)) {
+      close(fd);
+      return;
+  }
+
+  if (verbose >= 2) {
+      printf("--> %s\n", _("Updating index"));
+  }
+
+  /* find positions of segments */
+  n = hdr.nsegments;
+  positions = xrealloc(NULL, (n + 1) * sizeof(*positions));
+  sizes     = xrealloc(NULL, (n + 1) * sizeof(*sizes));
+  pos = sizeof(hdr);
+  for (i = 0; i < n; i++) {
+    if (!pread_all(fd, &sh, sizeof(sh), pos)) {
+        break;
+    }
+    positions[i] = pos;
+    sizes[i]     = sh.size;
+    pos += sizeof(sh) + sh.size;
+  }
+
+  /* index file is damaged */
+  if (i < n) {
+      close(fd);
+      free(positions);
+      free(sizes);
+      return;
+  }
+
+  /* segment for new records */
+  builder_init(&ib);
+  for (line = lines; line < lines + len; line = end + 1) {
+    end = memchr(line, '\n', (size_t)(lines + len - line));
+    assert(end != NULL);
+    if (decode_record(line, &rec)) {
+        /* checksum is not a part of comment */
+        stop = end;
+        if (checksum_split(line, (size_t)(end - line), NULL)) {
+            stop -= CHECKSUM_SUFFIX_LEN;
+        }
+        builder_add(&ib, rec.comment, stop, (uint64_t)(base + (line - lines)));
+    }
+  }
+  nterms = (long)builder_segment(&ib, &seg);
+  builder_free(&ib);
+
+  /* merge small segments at the end of file */
+  while (n > 0 && sizes[n - 1] <= 2 * (uint64_t)seg.len) {
+    prev = xrealloc(NULL, sizes[n - 1] + 1);
+    if (!pread_all(fd, prev, (size_t)sizes[n - 1], positions[n - 1] + sizeof(sh))) {
+        free(prev);
+        break;
+    }
+
+    merged.buf  = NULL;
+    merged.len  = 0;
+    merged.size = 0;
+    nterms = merge_segments(prev, (size_t)sizes[n - 1], seg.buf, seg.len, &merged);
+    free(prev);
+    if (nterms < 0) {
+        /* index file is damaged, so leave him stale */
+        free(merged.buf);
+        close(fd);
+        free(positions);
+        free(sizes);
+        free(seg.buf);
+        return;
+    }
+
+    free(seg.buf);
+    seg = merged;
+    n--;
+  }
+
+  /* write segment instead of merged ones */
+  pos = n > 0 ? positions[n - 1] + (off_t)sizeof(sh) + (off_t)sizes[n - 1]
+              : (off_t)sizeof(hdr);
+  memset(&sh, 0, sizeof(sh));
+  sh.nterms = (uint32_t)nterms;
+  sh.size   = seg.len;
+
+  header_fill(&hdr, n + 1, after);
+  if (!pwrite_all(fd, &sh, sizeof(sh), pos) ||
+      !pwrite_all(fd, seg.buf, seg.len, pos + sizeof(sh)) ||
+      ftruncate(fd, pos + sizeof(sh) + seg.len) == -1 ||
+      fsync(fd) == -1 ||
+      !pwrite_all(fd, &hdr, sizeof(hdr), 0)) {
+      perror(_("Failed to save index"));
+  }
+
+  if (close(fd) == -1) {
+      perror("close");
+  }
+
+  free(positions);
+  free(sizes);
+  free(seg.buf);
+}
+
+
+/**
+ * Append offset to sorted list.
+ *
+ * @param list list of offsets
+ * @param offset offset
+ **/
+static void
+offsets_add(struct offsets *list, uint64_t offset)
+{
+  if (list->count == list->alloc) {
+      list->alloc = list->alloc * 2 + 64;
+      list->items = xrealloc(list->items, list->alloc * sizeof(uint64_t));
+  }
+  list->items[list->count++] = offset;
+}
+
+
+/**
+ * Find offsets of records which contain word.
+ *
+ * Segments are searched from oldest to newest, so offsets are sorted.
+ *
+ * @param segs segments of index (after header)
+ * @param nsegments count of segments
+ * @param end end of index
+ * @param word word
+ * @param len length of word
+ * @param list found offsets (output)
+ *
+ * @retval 0 index is damaged
+ * @retval 1 search was completed
+ **/
+static int
+find_term(const unsigned char *segs, uint32_t nsegments,
+          const unsigned char *end, const char *word, size_t len,
+          struct offsets *list)
+{
+  struct index_segment sh;
+  struct index_entry entry, key;
+  const unsigned char *pos, *segend, *post, *postend;
+  uint64_t delta, offset;
+  uint32_t i;
+  int cmp;
+
+  key.text = (const unsigned char *)word;
+  key.len  = len;
+
+  for (i = 0; i < nsegments; i++) {
+    if ((size_t)(end - segs) < sizeof(sh)) {
+        return 0;
+    }
+    memcpy(&sh, segs, sizeof(sh));
+    pos = segs + sizeof(sh);
+    if (sh.size > (uint64_t)(end - pos)) {
+        return 0;
+    }
+    segend = pos + sh.size;
+    segs   = segend;
+
+    /* words are sorted, so stop at first greater word */
+    while (pos < segend) {
+      if (!read_entry(&pos, segend, &entry)) {
+          return 0;
+      }
+      cmp = compare_entries(&entry, &key);
+      if (cmp > 0) {
+          break;
+      }
+      if (cmp < 0) {
+          continue;
+      }
+
+      post    = entry.post;
+      postend = entry.post + entry.postlen;
+      offset  = 0;
+      while (post < postend) {
+        if (!read_varint(&post, postend, &delta)) {
+            return 0;
+        }
+        offset += delta;
+        offsets_add(list, offset);
+      }
+      break;
+    }
+  }
+
+  return 1;
+}
+
+
+/**
+ * Leave in first list only offsets which are present in second one.
+ *
+ * @param list first list (will be changed)
+ * @param other second list
+ **/
+static void
+offsets_intersect(struct offsets *list, const struct offsets *other)
+{
+  size_t i = 0, j = 0, k = 0;
+
+  while (i < list->count && j < other->count) {
+    if (list->items[i] < other->items[j]) {
+        i++;
+    } else if (list->items[i] > other->items[j]) {
+        j++;
+    } else {
+        list->items[k++] = list->items[i++];
+        j++;
+    }
+  }
+  list->count = k;
+}
+
+
+/**
+ * Find records whose comments contain all given words.
+ *
+ * Function takes shared lock on data file, so records are not changed
+ * while they are read. If index is stale then it is rebuilt. Each
+ * found record is read from data file at offset from index and passed
+ * to handler.
+ *
+ * @param dbfile path to data file
+ * @param terms words for search
+ * @param nterms count of words
+ * @param verbose level of verbose
+ * @param handler function which will be called for each found record
+ * @param data pointer which will be passed to handler
+ *
+ * @return count of found records
+ **/
+unsigned long
+search_datafile(const char *dbfile, char **terms, int nterms,
+                unsigned int verbose, record_handler handler, void *data)
+{
+  struct index_header  hdr;
+  struct index_segment sh;
+  struct stat   st, idxst;
+  struct record rec;
+  struct bytes  index = { NULL, 0, 0 };
+  struct bytes  seg   = { NULL, 0, 0 };
+  struct offsets found = { NULL, 0, 0 };
+  struct offsets other = { NULL, 0, 0 };
+  const unsigned char *segs, *end;
+  const char *text;
+  uint32_t nsegments;
+  char    word[INDEX_MAX_TOKEN + 1];
+  char   *path;
+  char   *curline = NULL;
+  size_t  curline_size = 0;
+  size_t  len, i;
+  ssize_t linelen;
+  unsigned long count = 0;
+  int     fd, idxfd, nwords, t, ok;
+  FILE   *fp;
+
+  assert(dbfile != NULL);
+  assert(terms != NULL);
+  assert(handler != NULL);
+
+  if (verbose >= 1) {
+      printf("-> %s (%s)\n", _("Open data file"), dbfile);
+  }
+
+  fd = open(dbfile, O_RDONLY);
+  if (fd == -1) {
+      fprintf(stderr, "%s: %s\n", _("Failed to open file"), dbfile);
+      perror("open");
+      exit(EXIT_FAILURE);
+  }
+
+  if (flock(fd, LOCK_SH) == -1 || fstat(fd, &st) == -1) {
+      perror("flock");
+      exit(EXIT_FAILURE);
+  }
+
+  /* load index */
+  ok = 0;
+  path = get_side_file_path(dbfile, INDEX_SUFFIX);
+  if (path != NULL) {
+      idxfd = open(path, O_RDONLY);
+      free(path);
+      if (idxfd != -1) {
+          if (fstat(idxfd, &idxst) == 0 && idxst.st_size >= (off_t)sizeof(hdr)) {
+              index.len = (size_t)idxst.st_size;
+              index.buf = xrealloc(NULL, index.len);
+              ok = pread_all(idxfd, index.buf, index.len, 0);
+          }
+          close(idxfd);
+      }
+  }
+
+  if (ok) {
+      memcpy(&hdr, index.buf, sizeof(hdr));
+      ok = header_is_valid(&hdr, &st);
+  }
+
+  if (ok) {
+      segs      = index.buf + sizeof(hdr);
+      end       = index.buf + index.len;
+      nsegments = hdr.nsegments;
+  } else {
+      index_rebuild(dbfile, &st, &seg, verbose);
+
+      /* use built segment without reading file again */
+      free(index.buf);
+      memset(&hdr, 0, sizeof(hdr));
+      index.buf = NULL;
+      index.len = 0;
+      memset(&sh, 0, sizeof(sh));
+      sh.size = seg.len;
+      bytes_put(&index, &sh, sizeof(sh));
+      bytes_put(&index, seg.buf, seg.len);
+      free(seg.buf);
+      segs      = index.buf;
+      end       = index.buf + index.len;
+      nsegments = 1;
+  }
+
+  if (verbose >= 2) {
+      printf("--> %s\n", _("Searching in index"));
+  }
+
+  /* intersect offsets of all words */
+  nwords = 0;
+  for (t = 0; t < nterms; t++) {
+    text = terms[t];
+    while ((len = next_token(&text, NULL, word)) > 0) {
+      other.count = 0;
+      if (!find_term(segs, nsegments, end, word, len,
+                     nwords == 0 ? &found : &other)) {
+          fprintf(stderr, "%s\n", _("Index is damaged"));
+          exit(EXIT_FAILURE);
+      }
+      if (nwords > 0) {
+          offsets_intersect(&found, &other);
+      }
+      nwords++;
+    }
+  }
+  free(other.items);
+  free(index.buf);
+
+  if (nwords == 0) {
+      fprintf(stderr, "%s\n", _("No words for search"));
+      exit(EXIT_FAILURE);
+  }
+
+  /* read found records */
+  fp = fdopen(fd, "r");
+  if (fp == NULL) {
+      perror("fdopen");
+      exit(EXIT_FAILURE);
+  }
+
+  for (i = 0; i < found.count; i++) {
+    if (fseeko(fp, (off_t)found.items[i], SEEK_SET) == -1) {
+        perror("fseeko");
+        exit(EXIT_FAILURE);
+    }
+    linelen = getline(&curline, &curline_size, fp);
+    if (linelen <= 0) {
+        continue;
+    }
+    if (curline[linelen - 1] == '\n') {
+        curline[--linelen] = '\0';
+    }
+    checksum_strip(curline, (size_t)linelen);
+
+    if (!is_string_confirm_to_format(curline, 0UL) ||
+        !decode_record(curline, &rec)) {
+        continue;
+    }
+    rec.offset = (long long)found.items[i];
+
+    handler(&rec, data);
+    count++;
+  }
+
+  free(curline);
+  free(found.items);
+
+  /* closing of file also drops lock */
+  fclose(fp);
+
+  return count;
+}
+
@@ -0,0 +1,98 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   index.h contains prototypes for functions which maintain full-text index
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef INDEX_H
+#define INDEX_H
+
+/* for struct stat */
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* for size_t type */
+#include <stddef.h>
+
+/* for uint*_t and int64_t types */
+#include <stdint.h>
+
+/* for record_handler type */
+#include "datafile.h"
+
+
+/** Suffix of index file. It lives near data file. */
+#define INDEX_SUFFIX ".idx"
+
+/** Minimal length of indexed word */
+#define INDEX_MIN_TOKEN 2
+
+/** Maximal length of indexed word (longer words are truncated) */
+#define INDEX_MAX_TOKEN 64
+
+/**
+ * Header of index file.
+ *
+ * Index file consists of header and segments. Each call of \ref
+ * append_to_datafile() adds segment for new records, and small
+ * segments at the end of file are merged, so count of segments stays
+ * logarithmic in count of records.
+ **/
+struct index_header {
+  char     magic[4];  /**< always "OFMI" */
+  uint32_t version;   /**< version of file format */
+  uint32_t nsegments; /**< count of segments after header */
+  uint32_t reserved;  /**< not used, always zero */
+  int64_t  dbsize;    /**< size of data file described by index */
+  int64_t  dbmtime;   /**< modification time of that data file */
+  int64_t  dbino;     /**< inode of that data file */
+};
+
+/**
+ * Header of segment.
+ *
+ * Segment contains words sorted in lexicographical order. Each word is
+ * stored as varint length, bytes of word, varint count of records,
+ * varint offset of last record, varint size of postings and postings:
+ * offsets of records in data file, delta-encoded and stored as
+ * varints.
+ **/
+struct index_segment {
+  uint32_t nterms;   /**< count of words */
+  uint32_t reserved; /**< not used, always zero */
+  uint64_t size;     /**< size of segment data after header */
+};
+
+
+void index_append(const char *dbfile, const struct stat *before,
+                  const struct stat *after, const char *lines, size_t len,
+                  long long base, unsigned int verbose);
+unsigned long search_datafile(const char *dbfile, char **terms, int nterms,
+                              unsigned int verbose, record_handler handler,
+                              void *data);
+
+#endif /* INDEX_H */
+
@@ -0,0 +1,551 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   ledgers.c contains functions which compute statistics of many data files
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for pthread_*() */
+#include <pthread.h>
+
+/* for assert() */
+#include <assert.h>
+
+/* for sysconf()
+ *     STDOUT_FILENO constant
+ **/
+#include <unistd.h>
+
+/* for printf()
+ *     fprintf()
+ *     fopen()
+ *     fread()
+ *     ferror()
+ *     fclose()
+ *     fflush()
+ *     perror()
+ *     NULL constant
+ **/
+#include <stdio.h>
+
+/* for malloc()
+ *     realloc()
+ *     free()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memchr()
+ *     memcpy()
+ *     memset()
+ *     strerror()
+ **/
+#include <string.h>
+
+#include "ledgers.h"
+#include "common.h"
+#include "batch.h"
+#include "outbuf.h"
+
+
+/** Maximal count of threads */
+#define LEDGERS_MAX_JOBS 64
+
+/** Size of one reading of list of files */
+#define LEDGERS_READ_SIZE (64 * 1024)
+
+
+/** Data file from list and its statistics */
+struct ledger {
+  const char   *path;   /**< path to data file */
+  long long     plus;   /**< sum of profits */
+  long long     minus;  /**< sum of costs */
+  batch_status  status; /**< result of reading */
+  int           error;  /**< errno when file can't be opened */
+  int           done;   /**< statistics is ready */
+  const struct rates *rates; /**< exchange rates or NULL */
+  int           no_rate; /**< some records have unknown exchange rate */
+};
+
+/**
+ * Deque with indexes of data files.
+ *
+ * Owner takes files from head, other threads steal from tail when their
+ * deques are empty.
+ **/
+struct ledger_deque {
+  pthread_mutex_t lock;  /**< protects head and tail */
+  size_t         *items; /**< indexes of data files */
+  size_t          head;  /**< next item for owner */
+  size_t          tail;  /**< end of items */
+};
+
+/** Thread pool and its shared state */
+struct ledger_pool {
+  struct ledger      *ledgers; /**< data files in order of list */
+  size_t              count;   /**< count of data files */
+  int                 jobs;    /**< count of threads */
+  struct ledger_deque deques[LEDGERS_MAX_JOBS]; /**< one deque per thread */
+  pthread_mutex_t     out_lock; /**< protects output and fields below */
+  size_t              next;    /**< next data file for output */
+  unsigned long       failed;  /**< count of failed data files */
+  struct outbuf       ob;      /**< output */
+  int                 json;    /**< write JSON instead of TSV */
+};
+
+/** Argument of worker thread */
+struct ledger_worker {
+  struct ledger_pool *pool; /**< pool */
+  int                 id;   /**< number of own deque */
+};
+
+
+/**
+ * Read list of data files.
+ *
+ * List contains one path per line, empty lines are skipped. If error
+ * occurs then function will quit from program with failure exit code.
+ *
+ * @warning Don't forget to free memory after! Use free() for buffer
+ * (returned by this function) and for list of ledgers.
+ *
+ * @param listfile name of file with list
+ * @param ledgers list of ledgers (output)
+ * @param count count of ledgers (output)
+ *
+ * @return buffer with paths which are referenced by ledgers
+ **/
+static char *
+read_list(const char *listfile, struct ledger **ledgers, size_t *count)
+{
+  FILE   *fp;
+  char   *buf, *pos, *nl;
+  size_t  size, len, n, allocated;
+
+  fp = fopen(listfile, "r");
+  if (fp == NULL) {
+      fprintf(stderr, "%s: %s\n", _("Failed to open file"), listfile);
+      perror("fopen");
+      exit(EXIT_FAILURE);
+  }
+
+  len  = 0;
+  size = LEDGERS_READ_SIZE;
+  buf  = malloc(size + 1);
+  if (buf == NULL) {
+      fprintf(stderr, "malloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+
+  while ((n = fread(buf + len, 1, size - len, fp)) > 0) {
+    len += n;
+    if (len == size) {
+        size *= 2;
+        buf = realloc(buf, size + 1);
+        if (buf == NULL) {
+            fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+            exit(EXIT_FAILURE);
+        }
+    }
+  }
+  if (ferror(fp)) {
+      perror("fread");
+      exit(EXIT_FAILURE);
+  }
+  fclose(fp);
+  buf[len] = '\0';
+
+  allocated = 0;
+  *ledgers  = NULL;
+  *count    = 0;
+  for (pos = buf; pos < buf + len; pos = nl + 1) {
+    nl = memchr(pos, '\n', (size_t)(buf + len - pos));
+    if (nl == NULL) {
+        nl = buf + len;
+    }
+    *nl = '\0';
+
+    if (nl == pos) {
+        continue;
+    }
+
+    if (*count == allocated) {
+        allocated = (allocated == 0) ? 64 : allocated * 2;
+        *ledgers  = realloc(*ledgers, allocated * sizeof(**ledgers));
+        if (*ledgers == NULL) {
+            fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+            exit(EXIT_FAILURE);
+        }
+    }
+    memset(&(*ledgers)[*count], 0, sizeof(**ledgers));
+    (*ledgers)[*count].path = pos;
+    (*count)++;
+  }
+
+  return buf;
+}
+
+
+/**
+ * Take next data file for worker.
+ *
+ * Worker takes data files from head of own deque. When own deque is
+ * empty then worker steals half of data files from tail of deque of
+ * other worker, so threads which got small files help threads which
+ * got large ones.
+ *
+ * @param pool pool
+ * @param id number of worker
+ * @param index index of data file (output)
+ *
+ * @return nonzero when data file was taken, 0 when all work is done
+ **/
+static int
+take_ledger(struct ledger_pool *pool, int id, size_t *index)
+{
+  struct ledger_deque *own = &pool->deques[id];
+  struct ledger_deque *victim;
+  size_t n, half;
+  int i;
+
+  pthread_mutex_lock(&own->lock);
+  if (own->head < own->tail) {
+      *index = own->items[own->head++];
+      pthread_mutex_unlock(&own->lock);
+      return 1;
+  }
+  pthread_mutex_unlock(&own->lock);
+
+  for (i = 1; i < pool->jobs; i++) {
+    victim = &pool->deques[(id + i) % pool->jobs];
+
+    pthread_mutex_lock(&victim->lock);
+    n = victim->tail - victim->head;
+    if (n == 0) {
+        pthread_mutex_unlock(&victim->lock);
+        continue;
+    }
+    half = (n + 1) / 2;
+    victim->tail -= half;
+    /* own deque is empty, so nobody reads his items now */
+    memcpy(own->items, victim->items + victim->tail, half * sizeof(size_t));
+    pthread_mutex_unlock(&victim->lock);
+
+    *index = own->items[0];
+
+    pthread_mutex_lock(&own->lock);
+    own->head = 1;
+    own->tail = half;
+    pthread_mutex_unlock(&own->lock);
+
+    return 1;
+  }
+
+  return 0;
+}
+
+
+/**
+ * Write result line for data file.
+ *
+ * TSV line contains path, profit, costs, balance and error; JSON line
+ * is one object. Error is "open" when file can't be opened and
+ * "format" when file has too many wrong lines. Also message about
+ * error is printed to stderr.
+ *
+ * @param pool pool
+ * @param l data file
+ **/
+static void
+write_ledger(struct ledger_pool *pool, const struct ledger *l)
+{
+  struct outbuf *ob = &pool->ob;
+  const char *error;
+
+  error = NULL;
+  switch (l->status) {
+      case BATCH_OPEN_FAILED:
+          error = "open";
+          fprintf(stderr, "%s: %s: %s\n",
+                  _("Failed to open file"), l->path, strerror(l->error));
+          break;
+      case BATCH_WRONG_LINES:
+          error = "format";
+          fprintf(stderr, "%s: %s\n",
+                  l->path, _("Too many wrong lines in data file"));
+          break;
+      default:
+          if (l->no_rate) {
+              error = "rate";
+              fprintf(stderr, "%s: %s\n", l->path, (l->rates != NULL) ?
+                      _("No exchange rate") :
+                      _("Amounts with currency codes need option --rates"));
+          }
+          break;
+  }
+  if (error != NULL) {
+      pool->failed++;
+  }
+
+  if (pool->json) {
+      outbuf_puts(ob, "{\"file\":\"");
+      outbuf_json_string(ob, l->path);
+      if (error != NULL) {
+          outbuf_puts(ob, "\",\"error\":\"");
+          outbuf_write(ob, error, strlen(error));
+          outbuf_puts(ob, "\"}\n");
+          return;
+      }
+      outbuf_puts(ob, "\",\"profit\":");
+      outbuf_money(ob, l->plus);
+      outbuf_puts(ob, ",\"costs\":");
+      outbuf_money(ob, l->minus);
+      outbuf_puts(ob, ",\"balance\":");
+      outbuf_money(ob, l->plus - l->minus);
+      outbuf_puts(ob, "}\n");
+      return;
+  }
+
+  outbuf_write(ob, l->path, strlen(l->path));
+  if (error != NULL) {
+      outbuf_puts(ob, "\t\t\t\t");
+      outbuf_write(ob, error, strlen(error));
+      outbuf_putc(ob, '\n');
+      return;
+  }
+  outbuf_putc(ob, '\t');
+  outbuf_money(ob, l->plus);
+  outbuf_putc(ob, '\t');
+  outbuf_money(ob, l->minus);
+  outbuf_putc(ob, '\t');
+  outbuf_money(ob, l->plus - l->minus);
+  outbuf_puts(ob, "\t\n");
+}
+
+
+/**
+ * Mark data file as done and write results which are ready.
+ *
+ * Results are written in order of list: result of data file waits
+ * until results of all previous files are written.
+ *
+ * @param pool pool
+ * @param index index of data file
+ **/
+static void
+finish_ledger(struct ledger_pool *pool, size_t index)
+{
+  pthread_mutex_lock(&pool->out_lock);
+
+  pool->ledgers[index].done = 1;
+  while (pool->next < pool->count && pool->ledgers[pool->next].done) {
+    write_ledger(pool, &pool->ledgers[pool->next]);
+    pool->next++;
+  }
+
+  pthread_mutex_unlock(&pool->out_lock);
+}
+
+
+/**
+ * Callback for \ref batch_scan() which sums profits and costs.
+ *
+ * Amounts are converted to one currency when exchange rates are given.
+ * Without exchange rates data file with currency codes gets no totals.
+ **/
+static void
+sum_ledger(const struct record_batch *batch, void *data)
+{
+  struct ledger *l = data;
+  int64_t converted[BATCH_LINES];
+  const int64_t *amount;
+  int64_t plus, minus;
+  size_t  i;
+
+  if (rates_convert_batch(l->rates, batch, converted) < batch->count) {
+      l->no_rate = 1;
+  }
+  amount = converted;
+  if (l->no_rate) {
+      return;
+  }
+
+  plus = minus = 0;
+  for (i = 0; i < batch->count; i++) {
+    minus += amount[i] & batch->negative[i];
+    plus  += amount[i] & ~batch->negative[i];
+  }
+
+  l->plus  += plus;
+  l->minus += minus;
+}
+
+
+/**
+ * Worker thread.
+ *
+ * Worker has own buffers which are reused for all data files read by
+ * him. Files are read without read ahead because pool already keeps
+ * all processors busy.
+ *
+ * @param arg pointer to \ref ledger_worker
+ *
+ * @return NULL
+ **/
+static void *
+ledger_worker(void *arg)
+{
+  struct ledger_worker *w = arg;
+  struct ledger_pool *pool = w->pool;
+  struct batch_scanner s;
+  struct ledger *l;
+  unsigned long count;
+  size_t index;
+
+  batch_scanner_init(&s, 0);
+
+  while (take_ledger(pool, w->id, &index)) {
+    l = &pool->ledgers[index];
+    l->status = batch_scan(&s, l->path, 0, sum_ledger, l, &count);
+    l->error  = s.error;
+    finish_ledger(pool, index);
+  }
+
+  batch_scanner_free(&s);
+
+  return NULL;
+}
+
+
+/**
+ * Compute statistics for each data file from list.
+ *
+ * Data files are distributed to worker threads by turn, so results for
+ * the beginning of list are ready first. One result line per data file
+ * is written to stdout in order of list as soon as it is ready: TSV
+ * (with header) or JSON object per line. Data files which can't be read
+ * don't stop processing of others.
+ *
+ * @param listfile name of file with list of data files
+ * @param jobs count of threads (0 for count of processors)
+ * @param json nonzero for JSON output
+ * @param rates exchange rates for amounts with currency or NULL
+ * @param verbose level of verbose
+ *
+ * @return count of data files which can't be read or converted
+ **/
+unsigned long
+summarize_ledgers(const char *listfile, int jobs, int json,
+                  const struct rates *rates, unsigned int verbose)
+{
+  struct ledger_pool   pool;
+  struct ledger_worker worker[LEDGERS_MAX_JOBS];
+  pthread_t thread[LEDGERS_MAX_JOBS];
+  char   *buf;
+  size_t  i, capacity;
+  int     j, ret;
+
+  assert(listfile != NULL);
+
+  buf = read_list(listfile, &pool.ledgers, &pool.count);
+
+  if (jobs <= 0) {
+      jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if ((size_t)jobs > pool.count) {
+      jobs = (int)pool.count;
+  }
+  if (jobs > LEDGERS_MAX_JOBS) {
+      jobs = LEDGERS_MAX_JOBS;
+  }
+  if (jobs < 1) {
+      jobs = 1;
+  }
+
+  if (verbose >= 1) {
+      printf("-> %s %d\n", _("Count of threads for batch:"), jobs);
+  }
+
+  /* deal data files to deques by turn */
+  capacity = (pool.count + (size_t)jobs - 1) / (size_t)jobs;
+  pool.jobs = jobs;
+  for (j = 0; j < jobs; j++) {
+    pool.deques[j].items = malloc((capacity + 1) * sizeof(size_t));
+    if (pool.deques[j].items == NULL) {
+        fprintf(stderr, "malloc: %s\n", _("cannot allocate memory"));
+        exit(EXIT_FAILURE);
+    }
+    pool.deques[j].head = pool.deques[j].tail = 0;
+    pthread_mutex_init(&pool.deques[j].lock, NULL);
+  }
+  for (i = 0; i < pool.count; i++) {
+    pool.deques[i % (size_t)jobs].items[pool.deques[i % (size_t)jobs].tail++] = i;
+    pool.ledgers[i].rates = rates;
+  }
+
+  pthread_mutex_init(&pool.out_lock, NULL);
+  pool.next   = 0;
+  pool.failed = 0UL;
+  pool.json   = json;
+
+  /* messages which were printed with printf() should go first */
+  fflush(stdout);
+  outbuf_init(&pool.ob, STDOUT_FILENO, OUTBUF_SIZE);
+  if (!json) {
+      outbuf_puts(&pool.ob, "file\tprofit\tcosts\tbalance\terror\n");
+  }
+
+  for (j = 0; j < jobs; j++) {
+    worker[j].pool = &pool;
+    worker[j].id   = j;
+  }
+
+  for (j = 1; j < jobs; j++) {
+    ret = pthread_create(&thread[j], NULL, ledger_worker, &worker[j]);
+    if (ret != 0) {
+        fprintf(stderr, "pthread_create: %s\n", _("error occurs"));
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  ledger_worker(&worker[0]);
+
+  for (j = 1; j < jobs; j++) {
+    pthread_join(thread[j], NULL);
+  }
+
+  outbuf_free(&pool.ob);
+
+  pthread_mutex_destroy(&pool.out_lock);
+  for (j = 0; j < jobs; j++) {
+    pthread_mutex_destroy(&pool.deques[j].lock);
+    free(pool.deques[j].items);
+  }
+  free(pool.ledgers);
+  free(buf);
+
+  return pool.failed;
+}
@@ -29,20 +29,31 @@
 
 /* for getpwuid()
  *     getuid()
+ *     stat()
  **/
 #include <sys/types.h>
 
+/* for stat() */
+#include <sys/stat.h>
+
+/* for time()
+ *     localtime()
+ *     localtime_r()
+ **/
+#include <time.h>
+
 /* for assert() */
 #include <assert.h>
 
 /* for getpwuid() */
 #include <pwd.h>
 
-/* for getuid()
- *     getopt()
- **/
+/* for getuid() */
 #include <unistd.h>
 
+/* for getopt_long() */
+#include <getopt.h>
+
 /* for errno variable */
 #include <errno.h>
 
@@ -63,6 +74,8 @@
  *     calloc()
  *     free()
  *     getenv()
+ *     atoi()
+ *     strtoul()
  *     EXIT_* constants
  **/
 #include <stdlib.h>
@@ -70,40 +83,51 @@
 /* for strlen()
  *     strdup()
  *     strchr()
+ *     strspn()
  **/
 #include <string.h>
 
-/* for LINE_MAX constant */
-#include <limits.h>
-
-/** Use self-defined value if POSIX2 is not supported */
-#ifndef LINE_MAX
-   #define LINE_MAX 2048
-#endif
-
 /* Also includes config.h and other headers which needs for gettext
  * support */
 #include "common.h"
-
-#ifdef NLS
-   /* for setlocale() */
-   #include <locale.h>
-#endif /* NLS */
+#include "datafile.h"
+#include "summary.h"
+#include "export.h"
+#include "import.h"
+#include "rules.h"
+#include "index.h"
+#include "filter.h"
+#include "batch.h"
+#include "ledgers.h"
+#include "checksum.h"
+#include "balance.h"
+#include "spill.h"
+#include "rates.h"
+#include "schedule.h"
+#include "budgets.h"
+#include "snapshot.h"
+#include "trend.h"
+#include "outbuf.h"
 
 
 /** Name of data file */
 #define DATA_FILE "finance.db"
 
-/** Maximal count of wrong lines.\ If more then exit from program */
-#define MAX_WRONG_LINES 5
+/** Environment variable with path to data file */
+#define DATA_FILE_ENV "OPENFM_DB"
 
 
 /* struct and enumerations with program settings */
 /** Possible actions */
-typedef enum {NONE, ADD, SHOW} actions;
+typedef enum {NONE, ADD, SHOW, EXPORT, IMPORT, RECATEGORIZE, SEARCH,
+              BATCH, VERIFY, MATERIALIZE, UNSHARE} actions;
+
+/** Formats for results of actions "show" and default statistics */
+typedef enum {OUTPUT_TEXT, OUTPUT_JSON, OUTPUT_TSV} output_format;
 
 /** Arguments for \ref actions */
-typedef enum {COST, PROFIT, CATEGORY, BALANCE, FULLSTAT} arguments;
+typedef enum {COST, PROFIT, CATEGORY, BALANCE, FULLSTAT, TREND,
+              FORECAST} arguments;
 
 /** Program settings.
  *
@@ -115,26 +139,61 @@ struct settings {
   arguments    arg;     /**< see description for \ref arguments */
   char        *dbfile;  /**< full path to data file */
   unsigned int verbose; /**< level of verbose */
+  char       **params;  /**< parameters which follow argument of action */
+  int          nparams; /**< count of parameters */
+  export_format format; /**< format for action "export" */
+  struct import_map map; /**< mapping of columns for action "import" */
+  int          jobs;    /**< count of threads (0 for count of processors) */
+  char        *rulesfile; /**< file with rules for categories or NULL */
+  char        *filter;  /**< filter for records or NULL */
+  int          porcelain; /**< machine mode: no localization and lookups */
+  output_format output; /**< format for statistics */
+  int          checksum; /**< append checksums to new records */
+  int          as_of_set; /**< statistics only up to \ref as_of day */
+  long         as_of;   /**< last day for statistics (see \ref date_to_days()) */
+  size_t       memory_limit; /**< memory for totals in bytes (0 for no limit) */
+  char        *ratesfile; /**< file with exchange rates or NULL */
+  int          until_set; /**< \ref until was given */
+  long         until;   /**< last day for action "materialize" */
+  char        *budgetsfile; /**< file with budgets for action "add" or NULL */
+  int          budget_refuse; /**< refuse costs over budget (else warn) */
+  int          shared;  /**< use snapshot in shared memory (see \ref snapshot.h) */
+};
+
+/** State of check of budget for \ref check_budget() */
+struct budget_check {
+  const struct budgets *budgets; /**< budgets */
+  int                   refuse;  /**< nonzero to refuse record */
 };
 
 
 /* Prototypes */
-static  int parse_cmd_line(int argc, char **argv, unsigned int *verbose);
+static  int parse_cmd_line(int argc, char **argv, struct settings *ofm);
 static void analyze_arguments(struct settings *ofm, int argc, char **argv, int start);
-static char *get_path_to_datafile(unsigned int verbose);
+static char *get_path_to_datafile(unsigned int verbose, int porcelain);
 static void read_and_parse_datafile(const struct settings *ofm);
-
-#ifdef NLS
-static void turn_on_localization(void);
-#endif /* NLS */
-
+static void add_record(const struct settings *ofm);
+static void show_statistics(const struct settings *ofm);
+static void import_datafile(const struct settings *ofm);
+static void recategorize(const struct settings *ofm);
+static void search_records(const struct settings *ofm);
+static void export_records(const struct settings *ofm);
+static void summarize_list(const struct settings *ofm);
+static void verify_records(const struct settings *ofm);
+static int  check_budget(const struct summary *sum, const char *lines,
+                         size_t len, void *data);
+static void materialize_records(const struct settings *ofm);
+static void unshare_datafile(const struct settings *ofm);
+
+static void write_amounts(output_format format, const char *const *keys,
+                          const long long *amounts, size_t n);
 
 /**
  * Prepare to work.
  *
  * Function do all preparations for work with data. This includes
- * setup localization, set default values for base variables and parse
- * command line arguments and options.
+ * set default values for base variables and parse command line
+ * arguments and options.
  *
  * @param ofm struct with program settings
  * @param argc program arguments counter
@@ -152,12 +211,8 @@ prepare(struct settings *ofm, int argc, char **argv)
   assert(argc > 0);
   assert(argv != NULL);
 
-#ifdef NLS
-  turn_on_localization();
-#endif /* NLS */
-
   /* look at command line options */
-  opt_num = parse_cmd_line(argc, argv, &ofm->verbose);
+  opt_num = parse_cmd_line(argc, argv, ofm);
 
   assert(opt_num > 0);
 
@@ -166,9 +221,9 @@ prepare(struct settings *ofm, int argc, char **argv)
       analyze_arguments(ofm, argc, argv, opt_num);
   }
 
-  /* if user does not give data file */
-  if (ofm->dbfile == NULL) {
-      ofm->dbfile = get_path_to_datafile(ofm->verbose);
+  /* if user does not give data file (action "batch" doesn't use him) */
+  if (ofm->dbfile == NULL && ofm->act != BATCH) {
+      ofm->dbfile = get_path_to_datafile(ofm->verbose, ofm->porcelain);
   }
 
 }
@@ -195,27 +250,76 @@ main(int argc, char **argv)
  ofm.act     = NONE; /* no actions should be perform by default */
  ofm.verbose = 0;    /* no verbose by default */
  ofm.dbfile  = NULL;
+ ofm.params  = NULL;
+ ofm.nparams = 0;
+ ofm.format  = EXPORT_CSV;
+ ofm.jobs    = 0;
+ ofm.rulesfile = NULL;
+ ofm.filter  = NULL;
+ ofm.porcelain = 0;
+ ofm.output  = OUTPUT_TEXT;
+ ofm.checksum = 0;
+ ofm.as_of_set = 0;
+ ofm.as_of   = 0;
+ ofm.memory_limit = 0;
+ ofm.ratesfile = NULL;
+ ofm.until_set = 0;
+ ofm.until   = 0;
+ ofm.budgetsfile = NULL;
+ ofm.budget_refuse = 0;
+ ofm.shared  = 0;
+ parse_import_map(IMPORT_DEFAULT_MAP, &ofm.map);
 
  prepare(&ofm, argc, argv);
 
+ /* setlocale() is not thread-safe, so localization is turned on
+  * before actions start their threads (unless --porcelain is given) */
+ nls_init();
+
  switch (ofm.act) {
      case NONE:
          /* read datafile, parse him and print statistics */
          read_and_parse_datafile(&ofm);
          break;
-     /**
-      * @todo
-      * - implement action "add"
-      **/
      case ADD:
-         fprintf(stderr, "Action \"add\" not implemented yet!\n");
+         /* append record to datafile */
+         add_record(&ofm);
          break;
-     /**
-      * @todo
-      * - implement action "show"
-      **/
      case SHOW:
-         fprintf(stderr, "Action \"show\" not implemented yet!\n");
+         /* print statistics from summary */
+         show_statistics(&ofm);
+         break;
+     case EXPORT:
+         /* write all records to stdout */
+         export_records(&ofm);
+         break;
+     case IMPORT:
+         /* convert statement and append records to datafile */
+         import_datafile(&ofm);
+         break;
+     case RECATEGORIZE:
+         /* assign categories by rules */
+         recategorize(&ofm);
+         break;
+     case SEARCH:
+         /* print records with given words in comment */
+         search_records(&ofm);
+         break;
+     case BATCH:
+         /* print statistics for each data file from list */
+         summarize_list(&ofm);
+         break;
+     case VERIFY:
+         /* check checksums of records */
+         verify_records(&ofm);
+         break;
+     case MATERIALIZE:
+         /* append due recurring records to datafile */
+         materialize_records(&ofm);
+         break;
+     case UNSHARE:
+         /* remove snapshot of datafile from shared memory */
+         unshare_datafile(&ofm);
          break;
      default:
          fprintf(stderr, "Unknown action!\n");
@@ -246,8 +350,23 @@ print_help(const char *progname)
          "Usage: %s [option] [file]\n"
          "  -v\tenable verbose mode\n"
          "  -V\tprint version and exit\n"
-         "  -h\tprint this help and exit\n"),
-         progname, progname);
+         "  -h\tprint this help and exit\n"
+         "  -j N\tuse N threads\n"
+         "  --format FMT\tformat for action \"export\": csv, jsonl or arrow\n"
+         "  --map SPEC\tcolumns for action \"import\" (default: %s)\n"
+         "  --rules FILE\trules for categories (for \"import\" and \"recategorize\")\n"
+         "  --filter EXPR\tuse only matched records (for \"show\" and \"export\")\n"
+         "  --porcelain\tmachine mode: messages are not translated\n"
+         "  --output FMT\tformat for statistics: text, json or tsv\n"
+         "  --checksum\tadd checksums to new records (for \"add\" and \"import\")\n"
+         "  --as-of DATE\ttotals up to date dd.mm.yyyy (for \"show\")\n"
+         "  --memory-limit SIZE\tmemory for totals, like 64M (for \"show\")\n"
+         "  --rates FILE\texchange rates for amounts with currency codes\n"
+         "  --until DATE\tlast day for action \"materialize\" (default: today)\n"
+         "  --budgets FILE\tmonthly budgets of categories (for \"add\")\n"
+         "  --over-budget MODE\twarn (default) or refuse costs over budget\n"
+         "  --shared\tshare decoded records with other processes\n"),
+         progname, progname, IMPORT_DEFAULT_MAP);
 
   exit(EXIT_SUCCESS);
 }
@@ -277,6 +396,48 @@ print_version(const char *progname)
 }
 
 
+/**
+ * Parse size in bytes.
+ *
+ * Size is a number with optional suffix K, M or G (powers of 1024).
+ *
+ * @param str string with size
+ * @param size size in bytes (output)
+ *
+ * @retval 0 string is not a size or size is zero
+ * @retval 1 size was parsed
+ **/
+static int
+parse_size(const char *str, size_t *size)
+{
+  unsigned long value;
+  char *end;
+  int   shift;
+
+  if (*str < '0' || *str > '9') {
+      return 0;
+  }
+
+  errno = 0;
+  value = strtoul(str, &end, 10);
+  switch (*end) {
+      case 'K': case 'k': shift = 10; end++; break;
+      case 'M': case 'm': shift = 20; end++; break;
+      case 'G': case 'g': shift = 30; end++; break;
+      default:            shift = 0;  break;
+  }
+
+  if (errno != 0 || *end != '\0' || value == 0 ||
+      value > ((size_t)-1 >> shift)) {
+      return 0;
+  }
+
+  *size = (size_t)value << shift;
+
+  return 1;
+}
+
+
 /**
  * Parse command line options.
  *
@@ -285,23 +446,146 @@ print_version(const char *progname)
  *
  * @param argc program arguments counter
  * @param argv list of program arguments
- * @param verbose level of verbose
+ * @param ofm struct with program settings
  *
  * @return number of first non-option element in argv
  **/
 static int
-parse_cmd_line(int argc, char **argv, unsigned int *verbose)
+parse_cmd_line(int argc, char **argv, struct settings *ofm)
 {
+  static const struct option long_options[] = {
+    { "format", required_argument, NULL, 'f' },
+    { "jobs",   required_argument, NULL, 'j' },
+    { "map",    required_argument, NULL, 'm' },
+    { "rules",  required_argument, NULL, 'r' },
+    { "filter", required_argument, NULL, 'F' },
+    { "porcelain", no_argument,     NULL, 'p' },
+    { "output", required_argument, NULL, 'o' },
+    { "checksum", no_argument,     NULL, 'c' },
+    { "as-of",  required_argument, NULL, 'a' },
+    { "memory-limit", required_argument, NULL, 'M' },
+    { "rates",  required_argument, NULL, 'x' },
+    { "until",  required_argument, NULL, 'u' },
+    { "budgets", required_argument, NULL, 'b' },
+    { "over-budget", required_argument, NULL, 'B' },
+    { "shared", no_argument,       NULL, 'S' },
+    { NULL,     0,                 NULL,  0  }
+  };
   int option;
+  unsigned int day, month, year;
+  char extra;
 
   assert(argc > 0);
   assert(argv != NULL);
+  assert(ofm != NULL);
 
-  while ((option = getopt(argc, argv, "vVh")) != -1) {
+  while ((option = getopt_long(argc, argv, "vVhj:", long_options, NULL)) != -1) {
     switch (option) {
 
       case 'v': /* enable verbose mode */
-        (*verbose)++;
+        ofm->verbose++;
+        break;
+
+      case 'j': /* count of threads */
+        ofm->jobs = atoi(optarg);
+        if (ofm->jobs <= 0) {
+            fprintf(stderr, "%s: %s\n", _("Wrong count of threads"), optarg);
+            exit(EXIT_FAILURE);
+        }
+        break;
+
+      case 'm': /* mapping of columns for import */
+        if (!parse_import_map(optarg, &ofm->map)) {
+            fprintf(stderr, "%s: %s\n", _("Wrong mapping of columns"), optarg);
+            exit(EXIT_FAILURE);
+        }
+        break;
+
+      case 'r': /* rules for categories */
+        ofm->rulesfile = optarg;
+        break;
+
+      case 'x': /* exchange rates */
+        ofm->ratesfile = optarg;
+        break;
+
+      case 'b': /* budgets of categories */
+        ofm->budgetsfile = optarg;
+        break;
+
+      case 'B': /* what to do with costs over budget */
+        if (strcmp(optarg, "warn") == 0) {
+            ofm->budget_refuse = 0;
+        } else if (strcmp(optarg, "refuse") == 0) {
+            ofm->budget_refuse = 1;
+        } else {
+            fprintf(stderr, "%s: %s\n", _("Unknown mode"), optarg);
+            exit(EXIT_FAILURE);
+        }
+        break;
+
+      case 'F': /* filter for records */
+        ofm->filter = optarg;
+        break;
+
+      case 'o': /* format for statistics */
+        if (strcmp(optarg, "text") == 0) {
+            ofm->output = OUTPUT_TEXT;
+        } else if (strcmp(optarg, "json") == 0) {
+            ofm->output = OUTPUT_JSON;
+        } else if (strcmp(optarg, "tsv") == 0) {
+            ofm->output = OUTPUT_TSV;
+        } else {
+            fprintf(stderr, "%s: %s\n", _("Unknown format"), optarg);
+            exit(EXIT_FAILURE);
+        }
+        break;
+
+      case 'c': /* checksums for new records */
+        ofm->checksum = 1;
+        break;
+
+      case 'S': /* snapshot in shared memory */
+        ofm->shared = 1;
+        break;
+
+      case 'a': /* last day for statistics */
+        if (sscanf(optarg, "%2u.%2u.%4u%c", &day, &month, &year, &extra) != 3 ||
+            !is_valid_date(year, month, day)) {
+            fprintf(stderr, "%s: %s\n", _("Date should look like dd.mm.yyyy"), optarg);
+            exit(EXIT_FAILURE);
+        }
+        ofm->as_of_set = 1;
+        ofm->as_of = date_to_days(year, month, day);
+        break;
+
+      case 'u': /* last day for recurring records */
+        if (sscanf(optarg, "%2u.%2u.%4u%c", &day, &month, &year, &extra) != 3 ||
+            !is_valid_date(year, month, day)) {
+            fprintf(stderr, "%s: %s\n", _("Date should look like dd.mm.yyyy"), optarg);
+            exit(EXIT_FAILURE);
+        }
+        ofm->until_set = 1;
+        ofm->until = date_to_days(year, month, day);
+        break;
+
+      case 'M': /* memory for totals */
+        if (!parse_size(optarg, &ofm->memory_limit)) {
+            fprintf(stderr, "%s: %s\n", _("Wrong memory limit"), optarg);
+            exit(EXIT_FAILURE);
+        }
+        break;
+
+      case 'p': /* machine mode */
+        ofm->porcelain = 1;
+        nls_disable();
+        break;
+
+      case 'f': /* format for export */
+        if (!parse_export_format(optarg, &ofm->format)) {
+            fprintf(stderr, "%s: %s\n", _("Unknown format"), optarg);
+            exit(EXIT_FAILURE);
+        }
         break;
 
       case 'V':
@@ -324,14 +608,42 @@ parse_cmd_line(int argc, char **argv, unsigned int *verbose)
     }
   }
 
-  if (*verbose >= 1) {
-      printf("-> %s %u\n", _("NOTE: Set verbose level to"), *verbose);
+  if (ofm->verbose >= 1) {
+      printf("-> %s %u\n", _("NOTE: Set verbose level to"), ofm->verbose);
   }
 
   return optind;
 }
 
 
+/**
+ * Use data file given by user.
+ *
+ * If file does not exist or is not regular then default data file will
+ * be used.
+ *
+ * @param ofm struct with program settings
+ * @param filename name of file
+ **/
+static void
+use_datafile(struct settings *ofm, const char *filename)
+{
+  assert(ofm != NULL);
+  assert(filename != NULL);
+
+  if (!is_file_exist_and_regular(filename, ofm->verbose)) {
+      fprintf(stderr, "%s\n", _("Using default data file..."));
+  } else {
+      ofm->dbfile = strdup(filename);
+      if (ofm->dbfile == NULL) {
+          fprintf(stderr, "strdup: %s\n%s\n",
+                  _("cannot allocate memory"),
+                  _("Using default data file..."));
+      }
+  }
+}
+
+
 /**
  * Parse command line arguments.
  *
@@ -339,9 +651,16 @@ parse_cmd_line(int argc, char **argv, unsigned int *verbose)
  *
  * Valid arguments for program are:
  *
- * <tt>add (cost|profit) $amount $comment</tt>\n
+ * <tt>add (cost|profit) $amount $category $comment</tt>\n
  * <tt>add cetegory $category</tt>\n
- * <tt>show (costs|profits|balance|fullstat|categories)</tt>
+ * <tt>show (costs|profits|balance|fullstat|categories)</tt>\n
+ * <tt>export [$file]</tt>\n
+ * <tt>import $statement</tt>\n
+ * <tt>recategorize [$file]</tt>\n
+ * <tt>search $word...</tt>\n
+ * <tt>batch $listfile</tt>\n
+ * <tt>verify [$file]</tt>\n
+ * <tt>materialize $definitions</tt>
  *
  * Also user can gives path to data file.
  *
@@ -371,26 +690,49 @@ analyze_arguments(struct settings *ofm, int argc, char **argv, int start)
   } else if (strcmp(argv[start], "show") == 0) {
       ofm->act = SHOW;
 
+  /* if action "export", "recategorize", "verify" or "unshare" was
+   * chosen. They have only optional data file */
+  } else if (strcmp(argv[start], "export") == 0 ||
+             strcmp(argv[start], "recategorize") == 0 ||
+             strcmp(argv[start], "verify") == 0 ||
+             strcmp(argv[start], "unshare") == 0) {
+      ofm->act = (argv[start][0] == 'e') ? EXPORT :
+                 (argv[start][0] == 'r') ? RECATEGORIZE :
+                 (argv[start][0] == 'v') ? VERIFY : UNSHARE;
+      if (argc - start > 1) {
+          use_datafile(ofm, argv[start + 1]);
+      }
+      return;
+
+  /* if action "import", "search", "batch" or "materialize" was chosen.
+   * They need file with statement, words for search, file with list of
+   * data files or file with recurring records */
+  } else if (strcmp(argv[start], "import") == 0 ||
+             strcmp(argv[start], "search") == 0 ||
+             strcmp(argv[start], "batch") == 0 ||
+             strcmp(argv[start], "materialize") == 0) {
+      ofm->act = (argv[start][0] == 'i') ? IMPORT :
+                 (argv[start][0] == 's') ? SEARCH :
+                 (argv[start][0] == 'b') ? BATCH : MATERIALIZE;
+      if (argc - start == 1) {
+          fprintf(stderr, "%s \"%s\"\n",
+                  _("Not enough arguments for action"), argv[start]);
+          exit(EXIT_FAILURE);
+      }
+      ofm->params  = argv + start + 1;
+      ofm->nparams = argc - start - 1;
+      return;
+
   /* if unknown action then interpret this as data file */
   } else {
       /* we not set ofm->act to NONE bacause it is done in main() */
-      if (!is_file_exist_and_regular(argv[start], ofm->verbose)) {
-          fprintf(stderr, "%s\n", _("Using default data file..."));
-      } else {
-          ofm->dbfile = strdup(argv[start]);
-          if (ofm->dbfile == NULL) {
-              fprintf(stderr, "strdup: %s\n%s\n",
-                      _("cannot allocate memory"),
-                      _("Using default data file..."));
-          }
-      }
+      use_datafile(ofm, argv[start]);
       return;
   } /* end check for first argument */
 
   if (argc - start == 1) {
       fprintf(stderr, "%s \"%s\"\n",
-              _("Not enough arguments for action"),
-              (ofm->act == ADD) ? "add" : "show");
+              _("Not enough arguments for action"), argv[start]);
       exit(EXIT_FAILURE);
   }
 
@@ -439,6 +781,14 @@ analyze_arguments(struct settings *ofm, int argc, char **argv, int start)
       } else if (strcmp(argv[start], "categories") == 0) {
           ofm->arg = CATEGORY;
 
+      /* if argument "trend" was given */
+      } else if (strcmp(argv[start], "trend") == 0) {
+          ofm->arg = TREND;
+
+      /* if argument "forecast" was given */
+      } else if (strcmp(argv[start], "forecast") == 0) {
+          ofm->arg = FORECAST;
+
       /* if unknown argument */
       } else {
           fprintf(stderr, "%s \"show\": %s\n",
@@ -449,12 +799,18 @@ analyze_arguments(struct settings *ofm, int argc, char **argv, int start)
   } /* end for actions */
 
 
-  /* when program was called as "openfm add (cost|profit|category)" */
-  if (ofm->act == ADD && argc - start == 1) {
+  /* when program was called as "openfm add (cost|profit|category)" or
+   * "openfm add (cost|profit) $amount [$category]"
+   **/
+  if (ofm->act == ADD &&
+      (argc - start == 1 || (ofm->arg != CATEGORY && argc - start < 4))) {
       fprintf(stderr, "%s \"add\"\n", _("Not enough arguments for action"));
       exit(EXIT_FAILURE);
   }
 
+  ofm->params  = argv + start + 1;
+  ofm->nparams = argc - start - 1;
+
 }
 
 
@@ -462,18 +818,21 @@ analyze_arguments(struct settings *ofm, int argc, char **argv, int start)
  * Get path to file with data that will be used by default.
  *
  * Function gets and returns path to data file which will be used by
- * default. Path is "$HOME/DATA_FILE". For name of file uses \ref DATA_FILE
- * macros which you can change. If error occurs then function will quit
- * from program with failure code exit.
+ * default. Path is taken from variable \ref DATA_FILE_ENV or is
+ * "$HOME/DATA_FILE". For name of file uses \ref DATA_FILE macros which
+ * you can change. If $HOME is not set then home directory is looked up
+ * in user database, except machine mode where it is an error. If error
+ * occurs then function will quit from program with failure code exit.
  *
  * @warning Don't forget to free memory after! Use free() for that.
  *
  * @param verbose level of verbose
+ * @param porcelain nonzero for machine mode
  *
  * @return path to default file with data
  **/
 static char *
-get_path_to_datafile(unsigned int verbose)
+get_path_to_datafile(unsigned int verbose, int porcelain)
 {
   char  *homedir;       /* path to home directory */
   char  *dbfile;        /* result path */
@@ -484,10 +843,25 @@ get_path_to_datafile(unsigned int verbose)
   struct passwd *user;  /* for storage getpwuid() return value */
   uid_t user_id;        /* for storage getuid() return value */
 
+  dbfile = getenv(DATA_FILE_ENV);
+  if (dbfile != NULL && *dbfile != '\0') {
+      dbfile = strdup(dbfile);
+      if (dbfile == NULL) {
+          fprintf(stderr, "strdup: %s\n", _("cannot allocate memory"));
+          exit(EXIT_FAILURE);
+      }
+      return dbfile;
+  }
+
   homedir = getenv("HOME");
   if (homedir == NULL) {
       fprintf(stderr, "getenv: %s\n", _("cannot get value for $HOME variable"));
 
+      /* lookup in user database may be slow (NSS, LDAP) */
+      if (porcelain) {
+          exit(EXIT_FAILURE);
+      }
+
       errno = 0;                /* set to zero as said in man page */
       user_id = getuid();       /* get uid */
       user = getpwuid(user_id); /* search data about user with this uid */
@@ -542,182 +916,1470 @@ get_path_to_datafile(unsigned int verbose)
 }
 
 
+/** Totals which are computed by \ref read_and_parse_datafile() */
+struct totals {
+  long long plus;  /**< sum of profits in hundredths */
+  long long minus; /**< sum of costs in hundredths */
+  const struct rates *rates; /**< exchange rates or NULL */
+};
+
+
 /**
- * Read file, parse him and print short statistics.
+ * Callback for \ref scan_datafile() which sums profits and costs.
  *
- * Function open data file and read him string by string. Each string
- * would be checked with \ref is_string_confirm_to_format() function.
- * As result will prints short statistics about user's money.
+ * Amounts with currency codes can't be summed without exchange rates,
+ * so function quits from program with failure exit code on them.
+ **/
+static void
+sum_record(const struct record *rec, void *data)
+{
+  struct totals *tot = data;
+
+  if (rec->currency != 0) {
+      rates_required();
+  }
+
+  if (rec->sign == '-') {
+      tot->minus += rec->amount;
+  } else {
+      tot->plus += rec->amount;
+  }
+}
+
+
+/**
+ * Callback for \ref scan_datafile_batch() which sums profits and costs.
  *
- * @param ofm struct with program settings
+ * Sign of record is used as mask, so loop has no branches and compiler
+ * may vectorize him. Amounts with currency codes are converted by
+ * column before summing (see \ref rates_convert_batch()); without
+ * exchange rates function quits from program on them.
  **/
 static void
-read_and_parse_datafile(const struct settings *ofm)
+sum_batch(const struct record_batch *batch, void *data)
 {
-  FILE *fp;
-  int   ret; /* for storage fclose() return value */
+  struct totals *tot = data;
+  int64_t converted[BATCH_LINES];
+  const int64_t *amount;
+  int64_t plus, minus;
+  size_t  i;
+
+  i = rates_convert_batch(tot->rates, batch, converted);
+  if (i < batch->count) {
+      if (tot->rates == NULL) {
+          rates_required();
+      }
+      rates_error(batch->currency[i], batch->year[i],
+                  batch->month[i], batch->day[i]);
+  }
+  amount = converted;
 
-  char  sign;
-  float plus, minus, curr;
+  plus = minus = 0;
+  for (i = 0; i < batch->count; i++) {
+    minus += amount[i] & batch->negative[i];
+    plus  += amount[i] & ~batch->negative[i];
+  }
+
+  tot->plus  += plus;
+  tot->minus += minus;
+}
 
-  /* current line from file */
-  char *curline;
 
-  /* for storage strchr() return value */
-  char *pos;
+/** Callback for \ref search_datafile() which prints and sums record. */
+static void
+print_record(const struct record *rec, void *data)
+{
+  /* record which can't be summed is not printed */
+  sum_record(rec, data);
 
-  /* counter for lines in file */
-  unsigned long lineno;
+  printf("%02u.%02u.%04u  %c  %10.2f  %8lu  %s\n",
+         rec->day, rec->month, rec->year, rec->sign,
+         rec->amount / 100.0, rec->category, rec->comment);
+}
 
-  /* counter for records in file */
-  unsigned long record_count;
 
-  /* counter for wrong lines in file */
-  int fails;
+/**
+ * Read file, parse him and print short statistics.
+ *
+ * Function reads data file with \ref scan_datafile_batch() function.
+ * With --shared records are taken from snapshot (see \ref
+ * snapshot_open()), whose totals are enough when no record has currency
+ * code.
+ * As result will prints short statistics about user's money.
+ *
+ * @param ofm struct with program settings
+ **/
+static void
+read_and_parse_datafile(const struct settings *ofm)
+{
+  static const char *const keys[] = { "profit", "costs", "balance" };
+  struct totals tot;
+  struct rates rates;
+  struct snapshot snap;
+  long long amounts[3];
 
   assert(ofm != NULL);
 
-  if (ofm->verbose >= 1) {
-      printf("-> %s (%s)\n", _("Open data file"), ofm->dbfile);
+  tot.plus = tot.minus = 0LL;
+  tot.rates = NULL;
+  if (ofm->ratesfile != NULL) {
+      rates_load(&rates, ofm->ratesfile);
+      tot.rates = &rates;
   }
 
-  /* open data file */
-  fp = fopen(ofm->dbfile, "r");
-  if (fp == NULL) {
-      fprintf(stderr, "%s: %s\n", _("Failed to open file"), ofm->dbfile);
-      perror("fopen");
-      exit(EXIT_FAILURE);
+  if (ofm->shared) {
+      snapshot_open(&snap, ofm->dbfile, ofm->verbose);
+      if (tot.rates != NULL || snap.hdr->currencies > 0) {
+          snapshot_scan(&snap, sum_batch, &tot);
+      } else {
+          tot.plus  = snap.hdr->profit;
+          tot.minus = snap.hdr->costs;
+      }
+      snapshot_close(&snap);
+  } else {
+      scan_datafile_batch(ofm->dbfile, ofm->verbose, sum_batch, &tot);
+  }
+
+  if (tot.rates != NULL) {
+      rates_free(&rates);
   }
 
   /* free memory for path to data file */
   free(ofm->dbfile);
 
-  if (ofm->verbose >= 1) {
-      printf("-> %s\n", _("Reading data..."));
+  if (ofm->output != OUTPUT_TEXT) {
+      amounts[0] = tot.plus;
+      amounts[1] = tot.minus;
+      amounts[2] = tot.plus - tot.minus;
+      write_amounts(ofm->output, keys, amounts, 3);
+      return;
   }
 
-  curline = calloc(LINE_MAX + 1, sizeof(char));
-  if (curline == NULL) {
-      fprintf(stderr, "calloc: %s\n", _("cannot allocate memory"));
-      exit(EXIT_FAILURE);
+  /* print short statistics */
+  printf(_("Finance statistics:\n"
+         "Profit:  %8.2f\n"
+         "Costs:   %8.2f\n" /* eight because point belongs to digital */
+         "Balance: %8.2f\n"),
+         tot.plus / 100.0, tot.minus / 100.0, (tot.plus - tot.minus) / 100.0);
+
+}
+
+
+/**
+ * Check new record against budget of its category.
+ *
+ * Function is called by \ref append_checked_to_datafile() while data
+ * file is locked. Costs of month are taken from summary, so check
+ * doesn't depend on size of data file.
+ *
+ * @param sum summary of data file
+ * @param lines new string
+ * @param len size of string
+ * @param data state of check (see \ref budget_check)
+ *
+ * @return nonzero if record may be appended
+ **/
+static int
+check_budget(const struct summary *sum, const char *lines, size_t len,
+             void *data)
+{
+  const struct budget_check *check = data;
+  struct record rec;
+  int64_t spent, limit;
+  int     exceeded;
+
+  (void)len;
+
+  if (!decode_record(lines, &rec)) {
+      return 1;
   }
 
-  plus = minus = 0.0;
-  lineno = 0UL;
-  record_count = 0UL;
-  fails  = 0;
+  exceeded = budgets_check(check->budgets, sum, &rec, &spent, &limit);
+  if (exceeded == 0) {
+      return 1;
+  }
+  /* costs in different currencies cannot be compared with budget */
+  if (exceeded == -1) {
+      fprintf(stderr, "%s: %lu, %02u.%04u\n",
+              _("Budget cannot be checked for amounts with currency codes"),
+              rec.category, rec.month, rec.year);
+      return 0;
+  }
+
+  fprintf(stderr, "%s: %lu, %02u.%04u: %.2f > %.2f\n",
+          _("Budget is exceeded"), rec.category, rec.month, rec.year,
+          (double)spent / 100.0, (double)limit / 100.0);
+
+  return !check->refuse;
+}
+
+
+/**
+ * Add record to data file.
+ *
+ * Function builds record from parameters of action "add" and current
+ * date, checks him with \ref is_string_confirm_to_format() and appends
+ * to data file with \ref append_to_datafile(). Comment is built from
+ * all parameters after category (joined with spaces). With --budgets
+ * costs are checked by \ref check_budget().
+ *
+ * @param ofm struct with program settings
+ **/
+static void
+add_record(const struct settings *ofm)
+{
+  const char *amount;
+  const char *category;
+  char   *line;
+  size_t  line_size;
+  size_t  len;
+  size_t  digits; /* length of amount without currency code */
+  int     i;
+  struct budgets budgets;
+  struct budget_check check;
+  int     appended;
+
+  time_t unix_time;
+  struct tm *local_time;
+
+  assert(ofm != NULL);
 
-  /* read and parse data file */
   /**
    * @todo
-   * - fgets() returns NULL also when error occurs. We should correct
-   *   handle this situation.
+   * - implement action "add category"
    **/
-  while (fgets(curline, LINE_MAX + 1, fp) != NULL) {
-    lineno++;
+  if (ofm->arg == CATEGORY) {
+      fprintf(stderr, "Action \"add category\" not implemented yet!\n");
+      return;
+  }
 
-    /* skip empty lines */
-    if (strlen(curline) == 1 && curline[0] == '\n') {
-        continue;
-    }
+  assert(ofm->nparams >= 3);
 
-    /* kill trailing newline */
-    pos = strchr(curline, '\n');
-    if (pos != NULL) {
-        *pos = '\0';
-    }
+  amount   = ofm->params[0];
+  category = ofm->params[1];
 
-    if (ofm->verbose >= 3) {
-        printf("---> %lu: '%s'\n", lineno, curline);
-    }
+  /* amount may be followed by currency code */
+  digits = strspn(amount, "0123456789.,");
+  if (digits == 0 || (amount[digits] != '\0' && amount[digits] != ' ')) {
+      fprintf(stderr, "%s: %s\n",
+              _("Amount should consist of digitals and point or comma only!"),
+              amount);
+      exit(EXIT_FAILURE);
+  }
+  if (amount[digits] == ' ' &&
+      (strspn(amount + digits + 1, "ABCDEFGHIJKLMNOPQRSTUVWXYZ") != 3 ||
+       amount[digits + 4] != '\0')) {
+      fprintf(stderr, "%s: %s\n",
+              _("Currency should be three capital letters after space!"),
+              amount);
+      exit(EXIT_FAILURE);
+  }
 
-    if (fails == MAX_WRONG_LINES) {
-        fprintf(stderr, _("Too many wrong lines in database. Exit.\n"));
-        exit(EXIT_FAILURE);
-    }
+  if (category[0] == '\0' || category[strspn(category, "0123456789")] != '\0') {
+      fprintf(stderr, "%s: %s\n",
+              _("Category should consist of digitals only!"), category);
+      exit(EXIT_FAILURE);
+  }
 
-    if (!is_string_confirm_to_format(curline, lineno)) {
-        fails++;
-        continue;
-    }
+  unix_time = time(NULL);
+  local_time = localtime(&unix_time);
+  if (local_time == NULL) {
+      fprintf(stderr, "localtime: %s\n", _("error occurs"));
+      exit(EXIT_FAILURE);
+  }
 
-    if (sscanf(curline, "%c|%*2u.%*2u.%*4u|%*u|%f|%*s", &sign, &curr) != 2) {
-        fprintf(stderr, "sscanf: %s\n", _("error occurs"));
-        fails++;
-        continue;
+  /* "s|dd.mm.yyyy|" + category + "|" + amount + "|" + comment +
+   * checksum + "\n\0" */
+  line_size = 13 + strlen(category) + 1 + strlen(amount) + 1 +
+              CHECKSUM_SUFFIX_LEN + 2;
+  for (i = 2; i < ofm->nparams; i++) {
+    if (strchr(ofm->params[i], '\n') != NULL) {
+        fprintf(stderr, "%s\n", _("Comment should not contain newline!"));
+        exit(EXIT_FAILURE);
     }
+    line_size += strlen(ofm->params[i]) + 1;
+  }
 
-    record_count++;
-
-    if (sign == '-') {
-        minus += curr;
-    } else {
-        plus += curr;
-    }
+  line = malloc(line_size);
+  if (line == NULL) {
+      fprintf(stderr, "malloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
 
-  } /* end for fgets() */
+  len = (size_t)sprintf(line, "%c|%02d.%02d.%04d|%s|%s|",
+                        (ofm->arg == COST) ? '-' : '+',
+                        local_time->tm_mday, local_time->tm_mon + 1,
+                        local_time->tm_year + 1900, category, amount);
+  for (i = 2; i < ofm->nparams; i++) {
+    len += (size_t)sprintf(line + len, (i == 2) ? "%s" : " %s", ofm->params[i]);
+  }
 
-  /* free memory for input lines */
-  free(curline);
+  if (!is_string_confirm_to_format(line, 0UL)) {
+      exit(EXIT_FAILURE);
+  }
 
-  /**
-   * @todo
-   * - Deal with plural forms. Use ngettext()
-   **/
-  if (ofm->verbose >= 1) {
-      printf(_("-> Reads %lu strings"), lineno);
-      if (lineno > record_count)
-          printf(_(" and %lu records"), record_count);
-      printf(" %s\n", _("from data file"));
+  if (ofm->checksum) {
+      checksum_format(line + len, line, len);
+      len += CHECKSUM_SUFFIX_LEN;
   }
 
-  /* print short statistics */
-  printf(_("Finance statistics:\n"
-         "Profit:  %8.2f\n"
-         "Costs:   %8.2f\n" /* eight because point belongs to digital */
-         "Balance: %8.2f\n"),
-         plus, minus, plus - minus);
+  line[len++] = '\n';
+  line[len]   = '\0';
 
-  /* close data file */
-  ret = fclose(fp);
-  if (ret != 0) {
-     perror("fclose");
+  if (ofm->budgetsfile == NULL) {
+      append_to_datafile(ofm->dbfile, line, len, ofm->verbose);
+  } else {
+      budgets_load(&budgets, ofm->budgetsfile);
+      check.budgets = &budgets;
+      check.refuse  = ofm->budget_refuse;
+      appended = append_checked_to_datafile(ofm->dbfile, line, len,
+                                            ofm->verbose, check_budget, &check);
+      budgets_free(&budgets);
+      if (!appended) {
+          fprintf(stderr, "%s\n", _("Record was not added"));
+          exit(EXIT_FAILURE);
+      }
   }
 
+  free(line);
+  free(ofm->dbfile);
+}
+
+
+/**
+ * Print amount in hundredths as money.
+ *
+ * @param title title of line
+ * @param amount amount in hundredths
+ **/
+static void
+print_amount(const char *title, long long amount)
+{
+  printf("%-9s%8.2f\n", title, amount / 100.0);
 }
 
 
 /**
- * Set settings for using gettext() functions.
+ * Join totals for each category.
  *
- * Function just calls setlocale() and textdomain(). Those functions
- * needs for correct work gettext() functions.
+ * Summary is sorted by month first, so totals for the same category
+ * are joined here.
+ *
+ * @warning Don't forget to free memory after! Use free() for that.
+ *
+ * @param sum summary
+ * @param ncat count of categories (output)
+ *
+ * @return totals for categories in order of first appearance
  **/
-#ifdef NLS
-void
-turn_on_localization(void)
+static struct summary_entry *
+join_categories(const struct summary *sum, size_t *ncat)
 {
-  char *locale = NULL; /* for storage setlocale() return value */
-  char *domain = NULL; /* for storage textdomain() return value */
+  struct summary_entry *cat; /* totals for categories */
+  size_t i, j;
 
-  /* set locale according to the environment variables */
-  locale = setlocale(LC_ALL, "");
-  if (locale == NULL) {
-      fprintf(stderr, "setlocale: cannot set locale according to the"
-              "environment variables! Using \"C\" locale by default.\n");
+  cat = malloc((sum->count + 1) * sizeof(*cat));
+  if (cat == NULL) {
+      fprintf(stderr, "malloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
   }
 
-  /* set domain name for gettext() */
-  domain = textdomain("openfm");
-  if (domain == NULL) {
-      perror("textdomain");
+  *ncat = 0;
+  for (i = 0; i < sum->count; i++) {
+    for (j = 0; j < *ncat && cat[j].category != sum->entries[i].category; j++)
+      ;
+    if (j == *ncat) {
+        cat[j] = sum->entries[i];
+        cat[j].profit = cat[j].costs = 0;
+        (*ncat)++;
+    }
+    cat[j].profit += sum->entries[i].profit;
+    cat[j].costs  += sum->entries[i].costs;
   }
 
+  return cat;
 }
-#endif /* NLS */
+
 
 /**
- * @mainpage Open Finance Manager
- * @section main
- * This is a documentation for OpenFM
+ * Print header of table with entries of summary.
+ *
+ * @param months nonzero when entries are totals for months
  **/
+static void
+print_entries_header(int months)
+{
+  if (months) {
+      printf("%-7s  %8s  %10s  %10s\n",
+             _("Month"), _("Category"), _("Profit"), _("Costs"));
+  } else {
+      printf("%8s  %10s  %10s\n", _("Category"), _("Profit"), _("Costs"));
+  }
+}
+
+
+/**
+ * Print entry of summary as row of table.
+ *
+ * @param entry entry
+ * @param months nonzero when year and month should be printed
+ **/
+static void
+print_entry(const struct summary_entry *entry, int months)
+{
+  if (months) {
+      printf("%02u.%04u  ", (unsigned)entry->month, (unsigned)entry->year);
+  }
+  printf("%8lu  %10.2f  %10.2f\n", (unsigned long)entry->category,
+         entry->profit / 100.0, entry->costs / 100.0);
+}
+
+
+/**
+ * Print totals for each category.
+ *
+ * @param sum summary
+ **/
+static void
+print_categories(const struct summary *sum)
+{
+  struct summary_entry *cat; /* totals for categories */
+  size_t ncat, j;
+
+  cat = join_categories(sum, &ncat);
+
+  print_entries_header(0);
+  for (j = 0; j < ncat; j++) {
+    print_entry(&cat[j], 0);
+  }
+
+  free(cat);
+}
+
+
+/**
+ * Print trend or forecast for each category.
+ *
+ * Trend has amount (profit minus costs) of category in each month and
+ * its averages over last 3, 6 and 12 months. Months where category has
+ * nothing to show are skipped. Forecast is for month after last one.
+ *
+ * @param ofm struct with program settings
+ * @param sum summary
+ **/
+static void
+print_trend(const struct settings *ofm, const struct summary *sum)
+{
+  struct trend t;
+  long long total, avg3, avg6, avg12;
+  unsigned int year, month;
+  size_t c, m;
+
+  trend_build(&t, sum);
+
+  if (ofm->arg == FORECAST) {
+      printf("%-7s  %8s  %10s\n", _("Month"), _("Category"), _("Forecast"));
+      trend_date(&t, t.nmonths, &year, &month);
+      for (c = 0; c < t.ncat; c++) {
+        printf("%02u.%04u  %8lu  %10.2f\n", month, year, t.categories[c],
+               trend_forecast(&t, c) / 100.0);
+      }
+      trend_free(&t);
+      return;
+  }
+
+  printf("%-7s  %8s  %10s  %10s  %10s  %10s\n", _("Month"), _("Category"),
+         _("Amount"), _("Avg 3"), _("Avg 6"), _("Avg 12"));
+  for (m = 0; m < t.nmonths; m++) {
+    trend_date(&t, m, &year, &month);
+    for (c = 0; c < t.ncat; c++) {
+      total = trend_total(&t, c, m);
+      avg3  = trend_average(&t, c, m, 3);
+      avg6  = trend_average(&t, c, m, 6);
+      avg12 = trend_average(&t, c, m, 12);
+      if (total == 0 && avg3 == 0 && avg6 == 0 && avg12 == 0) {
+          continue;
+      }
+      printf("%02u.%04u  %8lu  %10.2f  %10.2f  %10.2f  %10.2f\n",
+             month, year, t.categories[c], total / 100.0,
+             avg3 / 100.0, avg6 / 100.0, avg12 / 100.0);
+    }
+  }
+
+  trend_free(&t);
+}
+
+
+/**
+ * Prepare buffered writer for machine-readable output.
+ *
+ * @param ob buffered writer (output)
+ **/
+static void
+output_open(struct outbuf *ob)
+{
+  /* messages which were printed with printf() should go first */
+  fflush(stdout);
+  outbuf_init(ob, STDOUT_FILENO, OUTBUF_SIZE);
+}
+
+
+/**
+ * Write named amounts in machine-readable format.
+ *
+ * JSON format is one object, TSV format is one "key<TAB>value" line per
+ * amount. Amounts are written with two digits after point regardless of
+ * locale.
+ *
+ * @param format output format
+ * @param keys names of amounts
+ * @param amounts amounts in hundredths
+ * @param n count of amounts
+ **/
+static void
+write_amounts(output_format format, const char *const *keys,
+              const long long *amounts, size_t n)
+{
+  struct outbuf ob;
+  size_t i;
+
+  output_open(&ob);
+
+  for (i = 0; i < n; i++) {
+    if (format == OUTPUT_JSON) {
+        outbuf_putc(&ob, i == 0 ? '{' : ',');
+        outbuf_putc(&ob, '"');
+        outbuf_write(&ob, keys[i], strlen(keys[i]));
+        outbuf_puts(&ob, "\":");
+        outbuf_money(&ob, amounts[i]);
+    } else {
+        outbuf_write(&ob, keys[i], strlen(keys[i]));
+        outbuf_putc(&ob, '\t');
+        outbuf_money(&ob, amounts[i]);
+        outbuf_putc(&ob, '\n');
+    }
+  }
+
+  if (format == OUTPUT_JSON) {
+      outbuf_puts(&ob, "}\n");
+  }
+
+  outbuf_free(&ob);
+}
+
+
+/**
+ * Write start of entries of summary in machine-readable format.
+ *
+ * JSON format is one object with array of entries, TSV format is
+ * header and one line per entry.
+ *
+ * @param ob buffered writer
+ * @param format output format
+ * @param name name of array (for JSON)
+ * @param months nonzero when year and month should be written
+ **/
+static void
+write_entries_begin(struct outbuf *ob, output_format format,
+                    const char *name, int months)
+{
+  if (format == OUTPUT_JSON) {
+      outbuf_puts(ob, "{\"");
+      outbuf_write(ob, name, strlen(name));
+      outbuf_puts(ob, "\":[");
+  } else if (months) {
+      outbuf_puts(ob, "year\tmonth\tcategory\tprofit\tcosts\n");
+  } else {
+      outbuf_puts(ob, "category\tprofit\tcosts\n");
+  }
+}
+
+
+/**
+ * Write one entry of summary in machine-readable format.
+ *
+ * @param ob buffered writer
+ * @param format output format
+ * @param entry entry
+ * @param months nonzero when year and month should be written
+ * @param first nonzero for first entry
+ **/
+static void
+write_entry(struct outbuf *ob, output_format format,
+            const struct summary_entry *entry, int months, int first)
+{
+  if (format == OUTPUT_JSON) {
+      if (!first) {
+          outbuf_putc(ob, ',');
+      }
+      outbuf_putc(ob, '{');
+      if (months) {
+          outbuf_puts(ob, "\"year\":");
+          outbuf_uint(ob, entry->year);
+          outbuf_puts(ob, ",\"month\":");
+          outbuf_uint(ob, entry->month);
+          outbuf_putc(ob, ',');
+      }
+      outbuf_puts(ob, "\"category\":");
+      outbuf_uint(ob, entry->category);
+      outbuf_puts(ob, ",\"profit\":");
+      outbuf_money(ob, entry->profit);
+      outbuf_puts(ob, ",\"costs\":");
+      outbuf_money(ob, entry->costs);
+      outbuf_putc(ob, '}');
+  } else {
+      if (months) {
+          outbuf_uint(ob, entry->year);
+          outbuf_putc(ob, '\t');
+          outbuf_uint(ob, entry->month);
+          outbuf_putc(ob, '\t');
+      }
+      outbuf_uint(ob, entry->category);
+      outbuf_putc(ob, '\t');
+      outbuf_money(ob, entry->profit);
+      outbuf_putc(ob, '\t');
+      outbuf_money(ob, entry->costs);
+      outbuf_putc(ob, '\n');
+  }
+}
+
+
+/**
+ * Write end of entries of summary in machine-readable format.
+ *
+ * @param ob buffered writer
+ * @param format output format
+ **/
+static void
+write_entries_end(struct outbuf *ob, output_format format)
+{
+  if (format == OUTPUT_JSON) {
+      outbuf_puts(ob, "]}\n");
+  }
+}
+
+
+/**
+ * Write entries of summary in machine-readable format.
+ *
+ * @param format output format
+ * @param name name of array (for JSON)
+ * @param entries entries
+ * @param n count of entries
+ * @param months nonzero when year and month should be written
+ **/
+static void
+write_entries(output_format format, const char *name,
+              const struct summary_entry *entries, size_t n, int months)
+{
+  struct outbuf ob;
+  size_t i;
+
+  output_open(&ob);
+
+  write_entries_begin(&ob, format, name, months);
+  for (i = 0; i < n; i++) {
+    write_entry(&ob, format, &entries[i], months, i == 0);
+  }
+  write_entries_end(&ob, format);
+
+  outbuf_free(&ob);
+}
+
+
+/**
+ * Write trend or forecast in machine-readable format.
+ *
+ * Rows are the same as in \ref print_trend(). JSON format is one object
+ * with array "trend" or "forecast", TSV format is header and one line
+ * per row.
+ *
+ * @param ofm struct with program settings
+ * @param sum summary
+ **/
+static void
+write_trend(const struct settings *ofm, const struct summary *sum)
+{
+  static const char *const avg_keys[] = { "avg3", "avg6", "avg12" };
+  static const size_t windows[] = { 3, 6, 12 };
+  struct outbuf ob;
+  struct trend t;
+  long long amounts[4];
+  unsigned int year, month;
+  const char *name;
+  size_t c, m, last, count, i;
+  int json;
+
+  json = (ofm->output == OUTPUT_JSON);
+  name = (ofm->arg == FORECAST) ? "forecast" : "trend";
+  trend_build(&t, sum);
+  output_open(&ob);
+
+  if (json) {
+      outbuf_puts(&ob, "{\"");
+      outbuf_write(&ob, name, strlen(name));
+      outbuf_puts(&ob, "\":[");
+  } else if (ofm->arg == FORECAST) {
+      outbuf_puts(&ob, "year\tmonth\tcategory\tamount\n");
+  } else {
+      outbuf_puts(&ob, "year\tmonth\tcategory\tamount\tavg3\tavg6\tavg12\n");
+  }
+
+  /* forecast has only month after last one */
+  m    = (ofm->arg == FORECAST) ? t.nmonths : 0;
+  last = (ofm->arg == FORECAST) ? t.nmonths + 1 : t.nmonths;
+
+  count = 0;
+  for (; m < last; m++) {
+    trend_date(&t, m, &year, &month);
+    for (c = 0; c < t.ncat; c++) {
+      if (ofm->arg == FORECAST) {
+          amounts[0] = trend_forecast(&t, c);
+      } else {
+          amounts[0] = trend_total(&t, c, m);
+          for (i = 0; i < 3; i++) {
+            amounts[i + 1] = trend_average(&t, c, m, windows[i]);
+          }
+          if (amounts[0] == 0 && amounts[1] == 0 &&
+              amounts[2] == 0 && amounts[3] == 0) {
+              continue;
+          }
+      }
+
+      if (json) {
+          if (count > 0) {
+              outbuf_putc(&ob, ',');
+          }
+          outbuf_puts(&ob, "{\"year\":");
+          outbuf_uint(&ob, year);
+          outbuf_puts(&ob, ",\"month\":");
+          outbuf_uint(&ob, month);
+          outbuf_puts(&ob, ",\"category\":");
+          outbuf_uint(&ob, t.categories[c]);
+          outbuf_puts(&ob, ",\"amount\":");
+          outbuf_money(&ob, amounts[0]);
+          if (ofm->arg == TREND) {
+              for (i = 0; i < 3; i++) {
+                outbuf_puts(&ob, ",\"");
+                outbuf_write(&ob, avg_keys[i], strlen(avg_keys[i]));
+                outbuf_puts(&ob, "\":");
+                outbuf_money(&ob, amounts[i + 1]);
+              }
+          }
+          outbuf_putc(&ob, '}');
+      } else {
+          outbuf_uint(&ob, year);
+          outbuf_putc(&ob, '\t');
+          outbuf_uint(&ob, month);
+          outbuf_putc(&ob, '\t');
+          outbuf_uint(&ob, t.categories[c]);
+          for (i = 0; i < (ofm->arg == TREND ? 4U : 1U); i++) {
+            outbuf_putc(&ob, '\t');
+            outbuf_money(&ob, amounts[i]);
+          }
+          outbuf_putc(&ob, '\n');
+      }
+      count++;
+    }
+  }
+
+  if (json) {
+      outbuf_puts(&ob, "]}\n");
+  }
+
+  outbuf_free(&ob);
+  trend_free(&t);
+}
+
+
+/**
+ * Write result of action "show" in machine-readable format.
+ *
+ * @param ofm struct with program settings
+ * @param sum summary
+ * @param plus sum of profits
+ * @param minus sum of costs
+ **/
+static void
+write_statistics(const struct settings *ofm, const struct summary *sum,
+                 long long plus, long long minus)
+{
+  static const char *const profit_key[]  = { "profit" };
+  static const char *const costs_key[]   = { "costs" };
+  static const char *const balance_key[] = { "balance" };
+  struct summary_entry *cat;
+  long long amount;
+  size_t ncat;
+
+  switch (ofm->arg) {
+      case PROFIT:
+          write_amounts(ofm->output, profit_key, &plus, 1);
+          break;
+      case COST:
+          write_amounts(ofm->output, costs_key, &minus, 1);
+          break;
+      case BALANCE:
+          amount = plus - minus;
+          write_amounts(ofm->output, balance_key, &amount, 1);
+          break;
+      case CATEGORY:
+          cat = join_categories(sum, &ncat);
+          write_entries(ofm->output, "categories", cat, ncat, 0);
+          free(cat);
+          break;
+      case FULLSTAT:
+          write_entries(ofm->output, "months", sum->entries, sum->count, 1);
+          break;
+      case TREND:
+      case FORECAST:
+          write_trend(ofm, sum);
+          break;
+  }
+}
+
+
+/** Callback for \ref scan_datafile() which adds record to summary. */
+static void
+add_to_summary(const struct record *rec, void *data)
+{
+  summary_add(data, rec);
+}
+
+
+/**
+ * Read records for action "show".
+ *
+ * Amounts are converted to one currency when exchange rates are given,
+ * so filter sees converted amounts. Without exchange rates matched
+ * amounts with currency codes stop program (see \ref rates_handler()).
+ * With --shared records are taken from snapshot in shared memory.
+ *
+ * @param ofm struct with program settings
+ * @param rates exchange rates or NULL
+ * @param handler function which will be called for each record
+ * @param data pointer which will be passed to handler
+ **/
+static void
+scan_records(const struct settings *ofm, const struct rates *rates,
+             record_handler handler, void *data)
+{
+  struct filter filter;
+  struct filter_chain chain;
+  struct rates_chain convert;
+  struct snapshot snap;
+
+  /* without exchange rates only records which passed filter are
+   * checked, filter by amount checks records itself */
+  convert.rates = rates;
+  if (rates == NULL) {
+      convert.handler = handler;
+      convert.data    = data;
+      handler = rates_handler;
+      data    = &convert;
+  }
+
+  if (ofm->filter != NULL) {
+      filter_compile(&filter, ofm->filter);
+      chain.filter  = &filter;
+      chain.handler = handler;
+      chain.data    = data;
+      handler = filter_handler;
+      data    = &chain;
+  }
+
+  if (rates != NULL) {
+      convert.handler = handler;
+      convert.data    = data;
+      handler = rates_handler;
+      data    = &convert;
+  }
+
+  if (ofm->shared) {
+      snapshot_open(&snap, ofm->dbfile, ofm->verbose);
+      snapshot_scan_records(&snap, handler, data);
+      snapshot_close(&snap);
+  } else {
+      scan_datafile(ofm->dbfile, ofm->verbose, handler, data);
+  }
+
+  if (ofm->filter != NULL) {
+      filter_free(&filter);
+  }
+}
+
+
+/** State of action "show" with memory limit. */
+struct bounded_show {
+  const struct settings *ofm;   /**< program settings */
+  struct spill  categories;     /**< totals by categories */
+  struct spill  order;          /**< categories by first appearance */
+  struct outbuf ob;             /**< writer for machine-readable output */
+  size_t        count;          /**< count of written entries */
+  long long     plus, minus;    /**< totals of all entries */
+};
+
+
+/**
+ * Callback for \ref scan_datafile() which adds record to table.
+ *
+ * Output starts after all records are read, so amount with currency
+ * code stops program before it.
+ **/
+static void
+add_to_spill(const struct record *rec, void *data)
+{
+  if (rec->currency != 0) {
+      rates_required();
+  }
+
+  spill_add_record(data, rec);
+}
+
+
+/** Callback for \ref summary_scan() which checks currencies of entry. */
+static void
+check_currency(const struct summary_entry *entry, void *data)
+{
+  (void)data;
+
+  if (entry->currency) {
+      rates_required();
+  }
+}
+
+
+/**
+ * Start output of entries for action "show" with memory limit.
+ *
+ * @param bs state of action
+ **/
+static void
+bounded_begin(struct bounded_show *bs)
+{
+  int months = (bs->ofm->arg == FULLSTAT);
+
+  if (bs->ofm->output == OUTPUT_TEXT) {
+      print_entries_header(months);
+  } else {
+      output_open(&bs->ob);
+      write_entries_begin(&bs->ob, bs->ofm->output,
+                          months ? "months" : "categories", months);
+  }
+}
+
+
+/**
+ * Output entry for action "show" with memory limit.
+ *
+ * Output is started at first entry, so messages about spilling go
+ * before it.
+ **/
+static void
+bounded_output(const struct summary_entry *entry, void *data)
+{
+  struct bounded_show *bs = data;
+  int months = (bs->ofm->arg == FULLSTAT);
+
+  if (bs->count == 0) {
+      bounded_begin(bs);
+  }
+
+  if (bs->ofm->output == OUTPUT_TEXT) {
+      print_entry(entry, months);
+  } else {
+      write_entry(&bs->ob, bs->ofm->output, entry, months, bs->count == 0);
+  }
+  bs->count++;
+}
+
+
+/** Callback which moves totals of category to table sorted by appearance. */
+static void
+bounded_order(const struct summary_entry *entry, void *data)
+{
+  struct bounded_show *bs = data;
+
+  spill_add(&bs->order, entry);
+}
+
+
+/** Callback which accounts totals for month and category. */
+static void
+bounded_total(const struct summary_entry *entry, void *data)
+{
+  struct bounded_show *bs = data;
+
+  bs->plus  += entry->profit;
+  bs->minus += entry->costs;
+
+  if (bs->ofm->arg == FULLSTAT) {
+      bounded_output(entry, bs);
+  } else if (bs->ofm->arg == CATEGORY) {
+      spill_add(&bs->categories, entry);
+  }
+}
+
+
+/**
+ * Show statistics with memory limit.
+ *
+ * Summary file is read page by page. When it is absent or stale,
+ * records are aggregated in tables which are spilled to temporary
+ * files (see \ref spill.h) and summary file is not written. Totals for
+ * categories are aggregated by category and then sorted back by first
+ * month, so output is the same as without limit.
+ *
+ * Each of tables gets half of the limit: at most two of them are used
+ * at once.
+ *
+ * @param ofm struct with program settings
+ * @param rates exchange rates or NULL
+ **/
+static void
+show_bounded(const struct settings *ofm, const struct rates *rates)
+{
+  struct bounded_show bs;
+  struct spill records;
+  struct stat st;
+  size_t limit;
+
+  limit = ofm->memory_limit / 2;
+
+  memset(&bs, 0, sizeof(bs));
+  bs.ofm = ofm;
+  spill_init(&bs.categories, SPILL_BY_CATEGORY, limit, ofm->verbose);
+  spill_init(&bs.order, SPILL_BY_MONTH, limit, ofm->verbose);
+  spill_init(&records, SPILL_BY_MONTH, limit, ofm->verbose);
+
+  if (ofm->filter != NULL || rates != NULL) {
+      scan_records(ofm, rates, add_to_spill, &records);
+      spill_merge(&records, bounded_total, &bs);
+  } else {
+      if (stat(ofm->dbfile, &st) == -1) {
+          fprintf(stderr, "%s: %s\n", _("Failed to open file"), ofm->dbfile);
+          perror("stat");
+          exit(EXIT_FAILURE);
+      }
+      /* entries of summary file may mix currencies, so they are
+       * checked before output */
+      if (!summary_scan(ofm->dbfile, &st, check_currency, NULL) ||
+          !summary_scan(ofm->dbfile, &st, bounded_total, &bs)) {
+          scan_datafile(ofm->dbfile, ofm->verbose, add_to_spill, &records);
+          spill_merge(&records, bounded_total, &bs);
+      }
+  }
+  spill_free(&records);
+
+  if (ofm->arg == CATEGORY) {
+      spill_merge(&bs.categories, bounded_order, &bs);
+      spill_free(&bs.categories);
+      spill_merge(&bs.order, bounded_output, &bs);
+  }
+  spill_free(&bs.categories);
+  spill_free(&bs.order);
+
+  if (ofm->arg == CATEGORY || ofm->arg == FULLSTAT) {
+      /* table without entries still has header */
+      if (bs.count == 0) {
+          bounded_begin(&bs);
+      }
+      if (ofm->output != OUTPUT_TEXT) {
+          write_entries_end(&bs.ob, ofm->output);
+          outbuf_free(&bs.ob);
+      }
+      return;
+  }
+
+  if (ofm->output != OUTPUT_TEXT) {
+      /* summary is not needed for totals */
+      write_statistics(ofm, NULL, bs.plus, bs.minus);
+      return;
+  }
+
+  switch (ofm->arg) {
+      case PROFIT:
+          print_amount(_("Profit:"), bs.plus);
+          break;
+      case COST:
+          print_amount(_("Costs:"), bs.minus);
+          break;
+      default:
+          print_amount(_("Balance:"), bs.plus - bs.minus);
+          break;
+  }
+}
+
+
+/**
+ * Show statistics.
+ *
+ * Function answers to action "show" from summary (see \ref
+ * summary.h), so data file is read only when summary is absent or
+ * stale. When filter is given, statistics is collected from matched
+ * records of data file. Totals up to some date are taken from balance
+ * checkpoints (see \ref balance.h).
+ *
+ * @param ofm struct with program settings
+ **/
+static void
+show_statistics(const struct settings *ofm)
+{
+  struct summary sum;
+  struct rates rates, *convert;
+  const struct summary_entry *entry, *end;
+  long long plus, minus;
+
+  assert(ofm != NULL);
+
+  if (ofm->as_of_set &&
+      ofm->arg != PROFIT && ofm->arg != COST && ofm->arg != BALANCE) {
+      fprintf(stderr, "%s\n",
+              _("Option --as-of works only with profits, costs and balance"));
+      exit(EXIT_FAILURE);
+  }
+  if (ofm->as_of_set && ofm->filter != NULL) {
+      fprintf(stderr, "%s\n", _("Option --as-of cannot be used with --filter"));
+      exit(EXIT_FAILURE);
+  }
+
+  if (ofm->as_of_set && ofm->ratesfile != NULL) {
+      fprintf(stderr, "%s\n", _("Option --as-of cannot be used with --rates"));
+      exit(EXIT_FAILURE);
+  }
+
+  if (ofm->memory_limit != 0 && (ofm->arg == TREND || ofm->arg == FORECAST)) {
+      fprintf(stderr, "%s\n",
+              _("Option --memory-limit cannot be used with trend and forecast"));
+      exit(EXIT_FAILURE);
+  }
+
+  convert = NULL;
+  if (ofm->ratesfile != NULL) {
+      rates_load(&rates, ofm->ratesfile);
+      convert = &rates;
+  }
+
+  if (ofm->memory_limit != 0 && !ofm->as_of_set) {
+      show_bounded(ofm, convert);
+      if (convert != NULL) {
+          rates_free(convert);
+      }
+      free(ofm->dbfile);
+      return;
+  }
+
+  summary_init(&sum);
+  if (ofm->as_of_set) {
+      /* checkpoints are enough, summary stays empty */
+  } else if (ofm->filter != NULL || convert != NULL) {
+      /* summary file has totals in currencies of records, so read
+       * records */
+      scan_records(ofm, convert, add_to_summary, &sum);
+      if (convert != NULL) {
+          rates_free(convert);
+      }
+  } else {
+      summary_open(&sum, ofm->dbfile, ofm->verbose);
+  }
+
+  end = sum.entries + sum.count;
+
+  /* entries of summary file may mix currencies */
+  plus = minus = 0LL;
+  for (entry = sum.entries; entry < end; entry++) {
+    if (entry->currency) {
+        rates_required();
+    }
+    plus  += entry->profit;
+    minus += entry->costs;
+  }
+
+  if (ofm->as_of_set &&
+      balance_as_of(ofm->dbfile, ofm->as_of, &plus, &minus, ofm->verbose)) {
+      fprintf(stderr, "%s\n",
+              _("Option --as-of cannot be used with currency codes"));
+      exit(EXIT_FAILURE);
+  }
+
+  if (ofm->output != OUTPUT_TEXT) {
+      write_statistics(ofm, &sum, plus, minus);
+      summary_free(&sum);
+      free(ofm->dbfile);
+      return;
+  }
+
+  switch (ofm->arg) {
+      case PROFIT:
+          print_amount(_("Profit:"), plus);
+          break;
+      case COST:
+          print_amount(_("Costs:"), minus);
+          break;
+      case BALANCE:
+          print_amount(_("Balance:"), plus - minus);
+          break;
+      case CATEGORY:
+          print_categories(&sum);
+          break;
+      case FULLSTAT:
+          print_entries_header(1);
+          for (entry = sum.entries; entry < end; entry++) {
+            print_entry(entry, 1);
+          }
+          break;
+      case TREND:
+      case FORECAST:
+          print_trend(ofm, &sum);
+          break;
+  }
+
+  summary_free(&sum);
+  free(ofm->dbfile);
+}
+
+
+/**
+ * Import bank statement.
+ *
+ * Function loads rules (if they are given) and calls \ref
+ * import_statement().
+ *
+ * @param ofm struct with program settings
+ **/
+static void
+import_datafile(const struct settings *ofm)
+{
+  struct rules rules;
+
+  assert(ofm != NULL);
+
+  if (ofm->rulesfile != NULL) {
+      rules_load(&rules, ofm->rulesfile);
+  }
+
+  import_statement(ofm->dbfile, ofm->params[0], &ofm->map,
+                   (ofm->rulesfile != NULL) ? &rules : NULL,
+                   ofm->jobs, ofm->checksum, ofm->verbose);
+
+  if (ofm->rulesfile != NULL) {
+      rules_free(&rules);
+  }
+  free(ofm->dbfile);
+}
+
+
+/**
+ * Assign categories to records of data file by rules.
+ *
+ * @param ofm struct with program settings
+ **/
+static void
+recategorize(const struct settings *ofm)
+{
+  struct rules rules;
+
+  assert(ofm != NULL);
+
+  if (ofm->rulesfile == NULL) {
+      fprintf(stderr, "%s \"recategorize\": --rules\n",
+              _("Option is needed for action"));
+      exit(EXIT_FAILURE);
+  }
+
+  rules_load(&rules, ofm->rulesfile);
+  recategorize_datafile(ofm->dbfile, &rules, ofm->verbose);
+  rules_free(&rules);
+  free(ofm->dbfile);
+}
+
+
+/**
+ * Print records whose comments contain all given words.
+ *
+ * Records are found with index of comments (see \ref index.h). After
+ * records short statistics about them is printed.
+ *
+ * @param ofm struct with program settings
+ **/
+static void
+search_records(const struct settings *ofm)
+{
+  struct totals tot;
+
+  assert(ofm != NULL);
+
+  tot.plus = tot.minus = 0LL;
+  tot.rates = NULL;
+
+  search_datafile(ofm->dbfile, ofm->params, ofm->nparams, ofm->verbose,
+                  print_record, &tot);
+
+  free(ofm->dbfile);
+
+  printf(_("Finance statistics:\n"
+         "Profit:  %8.2f\n"
+         "Costs:   %8.2f\n" /* eight because point belongs to digital */
+         "Balance: %8.2f\n"),
+         tot.plus / 100.0, tot.minus / 100.0, (tot.plus - tot.minus) / 100.0);
+}
+
+
+
+/**
+ * Write records to standard output.
+ *
+ * @param ofm struct with program settings
+ **/
+static void
+export_records(const struct settings *ofm)
+{
+  struct filter filter;
+
+  assert(ofm != NULL);
+
+  if (ofm->filter != NULL) {
+      filter_compile(&filter, ofm->filter);
+      export_datafile(ofm->dbfile, ofm->verbose, ofm->format, &filter);
+      filter_free(&filter);
+  } else {
+      export_datafile(ofm->dbfile, ofm->verbose, ofm->format, NULL);
+  }
+
+  free(ofm->dbfile);
+}
+
+
+/**
+ * Print statistics for each data file from list.
+ *
+ * If some data files can't be read then function will quit from program
+ * with failure exit code after all data files are processed.
+ *
+ * @param ofm struct with program settings
+ **/
+static void
+summarize_list(const struct settings *ofm)
+{
+  unsigned long failed;
+  struct rates rates, *convert;
+
+  assert(ofm != NULL);
+  assert(ofm->nparams >= 1);
+
+  convert = NULL;
+  if (ofm->ratesfile != NULL) {
+      rates_load(&rates, ofm->ratesfile);
+      convert = &rates;
+  }
+
+  failed = summarize_ledgers(ofm->params[0], ofm->jobs,
+                             ofm->output == OUTPUT_JSON, convert,
+                             ofm->verbose);
+  if (convert != NULL) {
+      rates_free(convert);
+  }
+  if (failed > 0) {
+      exit(EXIT_FAILURE);
+  }
+}
+
+
+
+/**
+ * Check checksums of records in data file.
+ *
+ * If corrupted records were found then function will quit from program
+ * with failure exit code.
+ *
+ * @param ofm struct with program settings
+ **/
+static void
+verify_records(const struct settings *ofm)
+{
+  unsigned long corrupted;
+
+  assert(ofm != NULL);
+
+  corrupted = verify_datafile(ofm->dbfile, ofm->verbose);
+  free(ofm->dbfile);
+
+  if (corrupted > 0) {
+      exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * @mainpage Open Finance Manager
+ * @section main
+ * This is a documentation for OpenFM
+ **/
+
+
+/**
+ * Append due recurring records to data file.
+ *
+ * Definitions are loaded with \ref schedule_load() and all occurrences
+ * up to --until (today by default) which were not added before are
+ * appended by \ref schedule_materialize().
+ *
+ * @param ofm struct with program settings
+ **/
+static void
+materialize_records(const struct settings *ofm)
+{
+  struct schedule sched;
+  unsigned long records;
+  time_t unix_time;
+  struct tm local_tm;
+  long today;
+
+  assert(ofm != NULL);
+
+  unix_time = time(NULL);
+  if (unix_time == (time_t)-1 || localtime_r(&unix_time, &local_tm) == NULL) {
+      fprintf(stderr, "localtime: %s\n", _("error occurs"));
+      exit(EXIT_FAILURE);
+  }
+  today = date_to_days((unsigned int)local_tm.tm_year + 1900,
+                       (unsigned int)local_tm.tm_mon + 1,
+                       (unsigned int)local_tm.tm_mday);
+
+  if (ofm->until_set && ofm->until > today) {
+      fprintf(stderr, "--until: %s\n", _("Date in future"));
+      exit(EXIT_FAILURE);
+  }
+
+  schedule_load(&sched, ofm->params[0]);
+  records = schedule_materialize(ofm->dbfile, &sched,
+                                 ofm->until_set ? ofm->until : today,
+                                 ofm->checksum, ofm->verbose);
+
+  if (ofm->verbose >= 1) {
+      printf(_("-> Materialized %lu records\n"), records);
+  }
+
+  schedule_free(&sched);
+  free(ofm->dbfile);
+}
+
+
+/**
+ * Remove snapshot of data file from shared memory.
+ *
+ * @param ofm struct with program settings
+ **/
+static void
+unshare_datafile(const struct settings *ofm)
+{
+  int removed;
+
+  assert(ofm != NULL);
+
+  removed = snapshot_remove(ofm->dbfile);
+  if (ofm->verbose >= 1) {
+      printf("-> %s\n", removed ? _("Shared snapshot was removed")
+                                 : _("There is no shared snapshot"));
+  }
+
+  free(ofm->dbfile);
+}
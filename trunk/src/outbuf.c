@@ -0,0 +1,438 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   outbuf.c contains buffered output functions
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for assert() */
+#include <assert.h>
+
+/* for write() */
+#include <unistd.h>
+
+/* for fprintf()
+ *     perror()
+ *     NULL constant
+ **/
+#include <stdio.h>
+
+/* for malloc()
+ *     realloc()
+ *     free()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memcpy()
+ *     memset()
+ *     strcspn()
+ **/
+#include <string.h>
+
+/* for gettext&co stuff */
+#include "common.h"
+#include "outbuf.h"
+
+
+/**
+ * Initialize buffered writer.
+ *
+ * If memory cannot be allocated then function will quit from program
+ * with failure exit code.
+ *
+ * @param ob buffered writer
+ * @param fd file descriptor for output
+ * @param size size of buffer
+ **/
+void
+outbuf_init(struct outbuf *ob, int fd, size_t size)
+{
+  assert(ob != NULL);
+  assert(size > 0);
+
+  ob->buf = malloc(size);
+  if (ob->buf == NULL) {
+      fprintf(stderr, "malloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+
+  ob->fd      = fd;
+  ob->len     = 0;
+  ob->size    = size;
+  ob->written = 0ULL;
+}
+
+
+/**
+ * Write all data to file descriptor.
+ *
+ * If error occurs then function will quit from program with failure
+ * exit code.
+ **/
+static void
+outbuf_write_fd(int fd, const char *data, size_t len)
+{
+  ssize_t wret; /* for storage write() return value */
+
+  while (len > 0) {
+    wret = write(fd, data, len);
+    if (wret == -1) {
+        perror("write");
+        exit(EXIT_FAILURE);
+    }
+    data += wret;
+    len  -= (size_t)wret;
+  }
+}
+
+
+/**
+ * Write content of buffer.
+ *
+ * @param ob buffered writer
+ **/
+void
+outbuf_flush(struct outbuf *ob)
+{
+  assert(ob != NULL);
+
+  outbuf_write_fd(ob->fd, ob->buf, ob->len);
+  ob->len = 0;
+}
+
+
+/**
+ * Make room in buffer.
+ *
+ * Buffer is flushed (and grown when it is too small), so next writes
+ * of len bytes in total stay in buffer and may be read from him.
+ *
+ * @param ob buffered writer
+ * @param len count of bytes
+ **/
+void
+outbuf_reserve(struct outbuf *ob, size_t len)
+{
+  assert(ob != NULL);
+
+  if (ob->size - ob->len >= len) {
+      return;
+  }
+
+  outbuf_flush(ob);
+
+  if (len > ob->size) {
+      ob->buf = realloc(ob->buf, len);
+      if (ob->buf == NULL) {
+          fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+          exit(EXIT_FAILURE);
+      }
+      ob->size = len;
+  }
+}
+
+
+/**
+ * Flush buffer and free memory.
+ *
+ * @param ob buffered writer
+ **/
+void
+outbuf_free(struct outbuf *ob)
+{
+  assert(ob != NULL);
+
+  outbuf_flush(ob);
+  free(ob->buf);
+  ob->buf  = NULL;
+  ob->size = 0;
+}
+
+
+/**
+ * Write data.
+ *
+ * Data which is larger than buffer is written directly.
+ *
+ * @param ob buffered writer
+ * @param data data
+ * @param len size of data
+ **/
+void
+outbuf_write(struct outbuf *ob, const void *data, size_t len)
+{
+  assert(ob != NULL);
+  assert(data != NULL || len == 0);
+
+  ob->written += len;
+
+  if (ob->len + len > ob->size) {
+      outbuf_flush(ob);
+      if (len >= ob->size) {
+          outbuf_write_fd(ob->fd, data, len);
+          return;
+      }
+  }
+
+  memcpy(ob->buf + ob->len, data, len);
+  ob->len += len;
+}
+
+
+/**
+ * Write zero bytes. Used for padding.
+ *
+ * @param ob buffered writer
+ * @param len count of bytes
+ **/
+void
+outbuf_zero(struct outbuf *ob, size_t len)
+{
+  static const char zeros[64];
+
+  while (len > sizeof(zeros)) {
+    outbuf_write(ob, zeros, sizeof(zeros));
+    len -= sizeof(zeros);
+  }
+  outbuf_write(ob, zeros, len);
+}
+
+
+/** Pairs of decimal digits for numbers 0-99 */
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+
+/**
+ * Write unsigned number in decimal form.
+ *
+ * Two digits are produced per division, using table of digit pairs.
+ * This is much faster than printf() and doesn't depend on locale.
+ *
+ * @param ob buffered writer
+ * @param value number
+ **/
+void
+outbuf_uint(struct outbuf *ob, unsigned long long value)
+{
+  char  digits[20]; /* enough for 64-bit number */
+  char *pos = digits + sizeof(digits);
+  unsigned idx;
+
+  while (value >= 100) {
+    idx = (unsigned)(value % 100) * 2;
+    value /= 100;
+    *--pos = digit_pairs[idx + 1];
+    *--pos = digit_pairs[idx];
+  }
+
+  if (value >= 10) {
+      idx = (unsigned)value * 2;
+      *--pos = digit_pairs[idx + 1];
+      *--pos = digit_pairs[idx];
+  } else {
+      *--pos = (char)('0' + value);
+  }
+
+  outbuf_write(ob, pos, (size_t)(digits + sizeof(digits) - pos));
+}
+
+
+/**
+ * Write amount in hundredths as decimal number with two digits after
+ * point.
+ *
+ * @param ob buffered writer
+ * @param amount amount in hundredths
+ **/
+void
+outbuf_money(struct outbuf *ob, long long amount)
+{
+  unsigned long long abs_amount;
+  char frac[3];
+
+  if (amount < 0) {
+      outbuf_putc(ob, '-');
+      abs_amount = -(unsigned long long)amount;
+  } else {
+      abs_amount = (unsigned long long)amount;
+  }
+
+  outbuf_uint(ob, abs_amount / 100);
+
+  frac[0] = '.';
+  frac[1] = digit_pairs[abs_amount % 100 * 2];
+  frac[2] = digit_pairs[abs_amount % 100 * 2 + 1];
+  outbuf_write(ob, frac, sizeof(frac));
+}
+
+
+/**
+ * Get length of valid UTF-8 at start of string.
+ *
+ * Overlong forms, surrogates and code points above U+10FFFF are not
+ * valid, as well as sequence which is cut by end of string.
+ *
+ * @param str string
+ * @param len length of string
+ *
+ * @return count of bytes before the first invalid one
+ **/
+size_t
+utf8_valid_len(const char *str, size_t len)
+{
+  const unsigned char *s = (const unsigned char *)str;
+  size_t i, k, n;
+  unsigned char c;
+
+  for (i = 0; i < len; i += n) {
+    c = s[i];
+    if (c < 0x80) {
+        n = 1;
+        continue;
+    }
+
+    if (c >= 0xC2 && c <= 0xDF) {
+        n = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        n = 3;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        n = 4;
+    } else {
+        return i;
+    }
+    if (len - i < n) {
+        return i;
+    }
+    for (k = 1; k < n; k++) {
+      if ((s[i + k] & 0xC0) != 0x80) {
+          return i;
+      }
+    }
+    if ((c == 0xE0 && s[i + 1] < 0xA0) || (c == 0xED && s[i + 1] > 0x9F) ||
+        (c == 0xF0 && s[i + 1] < 0x90) || (c == 0xF4 && s[i + 1] > 0x8F)) {
+        return i;
+    }
+  }
+
+  return len;
+}
+
+
+/**
+ * Copy string replacing each byte which is not valid UTF-8 by
+ * \ref UTF8_REPLACEMENT.
+ *
+ * @param dst output (up to \ref UTF8_REPLACEMENT_LEN * \p len bytes)
+ * @param src string
+ * @param len length of string
+ *
+ * @return length of output
+ **/
+size_t
+utf8_repair(char *dst, const char *src, size_t len)
+{
+  size_t valid, out;
+
+  for (out = 0; len > 0; src += valid + 1, len -= valid + 1) {
+    valid = utf8_valid_len(src, len);
+    memcpy(dst + out, src, valid);
+    out += valid;
+    if (valid == len) {
+        break;
+    }
+    memcpy(dst + out, UTF8_REPLACEMENT, UTF8_REPLACEMENT_LEN);
+    out += UTF8_REPLACEMENT_LEN;
+  }
+
+  return out;
+}
+
+
+/**
+ * Write UTF-8 string, each invalid byte is replaced by
+ * \ref UTF8_REPLACEMENT.
+ *
+ * @param ob buffered writer
+ * @param str string
+ * @param len length of string
+ **/
+static void
+outbuf_utf8(struct outbuf *ob, const char *str, size_t len)
+{
+  size_t valid;
+
+  for (; len > 0; str += valid + 1, len -= valid + 1) {
+    valid = utf8_valid_len(str, len);
+    outbuf_write(ob, str, valid);
+    if (valid == len) {
+        break;
+    }
+    outbuf_puts(ob, UTF8_REPLACEMENT);
+  }
+}
+
+
+/**
+ * Write string escaped for JSON (without quotes around him).
+ *
+ * Quotes, backslashes and control characters are escaped, bytes which
+ * are not valid UTF-8 (comments in KOI8-R or CP1251, for example) are
+ * replaced by U+FFFD, other bytes are written as is.
+ *
+ * @param ob buffered writer
+ * @param str string
+ **/
+void
+outbuf_json_string(struct outbuf *ob, const char *str)
+{
+  static const char hex[] = "0123456789abcdef";
+  static const char special[] =
+      "\"\\\001\002\003\004\005\006\007\010\011\012\013\014\015\016\017"
+      "\020\021\022\023\024\025\026\027\030\031\032\033\034\035\036\037";
+  size_t len;
+
+  assert(str != NULL);
+
+  for (; ; str += len + 1) {
+    len = strcspn(str, special);
+    outbuf_utf8(ob, str, len);
+    if (str[len] == '\0') {
+        break;
+    }
+    if (str[len] == '"' || str[len] == '\\') {
+        outbuf_putc(ob, '\\');
+        outbuf_putc(ob, str[len]);
+    } else {
+        outbuf_puts(ob, "\\u00");
+        outbuf_putc(ob, hex[(unsigned char)str[len] >> 4]);
+        outbuf_putc(ob, hex[(unsigned char)str[len] & 0xF]);
+    }
+  }
+}
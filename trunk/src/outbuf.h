@@ -0,0 +1,88 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   outbuf.h contains prototypes for buffered output functions
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+/* for size_t type */
+#include <stddef.h>
+
+
+/** Default size of output buffer */
+#define OUTBUF_SIZE (1024 * 1024)
+
+/** Replacement character U+FFFD in UTF-8 */
+#define UTF8_REPLACEMENT "\357\277\275"
+
+/** Length of \ref UTF8_REPLACEMENT */
+#define UTF8_REPLACEMENT_LEN 3
+
+/**
+ * Buffered writer.
+ *
+ * Used instead of stdio for output of many small pieces: data is
+ * collected in one large buffer and written by write() when buffer is
+ * full.
+ **/
+struct outbuf {
+  int                fd;      /**< file descriptor for output */
+  char              *buf;     /**< buffer */
+  size_t             len;     /**< count of bytes in buffer */
+  size_t             size;    /**< size of buffer */
+  unsigned long long written; /**< count of bytes passed to writer */
+};
+
+
+void outbuf_init(struct outbuf *ob, int fd, size_t size);
+void outbuf_flush(struct outbuf *ob);
+void outbuf_free(struct outbuf *ob);
+void outbuf_reserve(struct outbuf *ob, size_t len);
+void outbuf_write(struct outbuf *ob, const void *data, size_t len);
+void outbuf_zero(struct outbuf *ob, size_t len);
+void outbuf_uint(struct outbuf *ob, unsigned long long value);
+void outbuf_money(struct outbuf *ob, long long amount);
+void outbuf_json_string(struct outbuf *ob, const char *str);
+size_t utf8_valid_len(const char *str, size_t len);
+size_t utf8_repair(char *dst, const char *src, size_t len);
+
+/** Write one character to buffered writer */
+#define outbuf_putc(ob, c) \
+    do { \
+      if ((ob)->len == (ob)->size) \
+          outbuf_flush(ob); \
+      (ob)->buf[(ob)->len++] = (c); \
+      (ob)->written++; \
+    } while (0)
+
+/** Write string literal to buffered writer */
+#define outbuf_puts(ob, str) \
+    outbuf_write((ob), (str), sizeof(str) - 1)
+
+#endif /* OUTBUF_H */
+
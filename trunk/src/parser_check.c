@@ -0,0 +1,202 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   parser_check.c contains functions which compare fast and full checks of records
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for assert() */
+#include <assert.h>
+
+/* for printf()
+ *     fprintf()
+ *     putchar()
+ *     NULL constant
+ **/
+#include <stdio.h>
+
+/* for realloc()
+ *     free()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memcpy()
+ *     strlen()
+ **/
+#include <string.h>
+
+/* for checksum_strip() */
+#include "checksum.h"
+
+#include "parser_check.h"
+
+
+/**
+ * Print string with escaped unprintable characters.
+ *
+ * @param s string
+ * @param len length of string
+ **/
+static void
+print_escaped(const char *s, size_t len)
+{
+  size_t i;
+
+  putchar('\'');
+  for (i = 0; i < len; i++) {
+    if ((unsigned char)s[i] < 0x20 || (unsigned char)s[i] >= 0x7F ||
+        s[i] == '\\') {
+        printf("\\x%02x", (unsigned char)s[i]);
+    } else {
+        putchar(s[i]);
+    }
+  }
+  puts("'");
+}
+
+
+/**
+ * Prepare state of differential check.
+ *
+ * @param pc state (output)
+ **/
+void
+parser_check_init(struct parser_check *pc)
+{
+  assert(pc != NULL);
+
+  batch_scanner_init(&pc->scanner, 0);
+  pc->buf    = NULL;
+  pc->size   = 0;
+  pc->lineno = 0UL;
+}
+
+
+/**
+ * Free buffers of differential check.
+ *
+ * @param pc state
+ **/
+void
+parser_check_free(struct parser_check *pc)
+{
+  assert(pc != NULL);
+
+  batch_scanner_free(&pc->scanner);
+  free(pc->buf);
+  pc->buf  = NULL;
+  pc->size = 0;
+}
+
+
+/**
+ * Check string with fast path and with reference and compare results.
+ *
+ * String is prepared like in \ref batch_scan(): checksum suffix is
+ * stripped. Both checks work with null-terminated strings, so string
+ * ends at the first null byte. Mismatch is reported to stdout.
+ *
+ * @param pc state
+ * @param line string (without newline, may contain null bytes)
+ * @param len length of string
+ * @param rec decoded record when reference accepts string (output, may
+ * be NULL); comment points to internal buffer
+ *
+ * @return result of comparison
+ **/
+parser_result
+parser_check_line(struct parser_check *pc, const char *line, size_t len,
+                  struct record *rec)
+{
+  struct record_batch *b;
+  struct record ref;
+  char *s;
+  int fast, slow;
+
+  assert(pc != NULL);
+  assert(line != NULL || len == 0);
+
+  if (len + 1 > pc->size) {
+      s = realloc(pc->buf, len + 1);
+      if (s == NULL) {
+          fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+          exit(EXIT_FAILURE);
+      }
+      pc->buf  = s;
+      pc->size = len + 1;
+  }
+  s = pc->buf;
+  if (len > 0) {
+      memcpy(s, line, len);
+  }
+  s[len] = '\0';
+  len = checksum_strip(s, strlen(s));
+  pc->lineno++;
+
+  b = pc->scanner.batch;
+  fast = batch_decode_fast(s, len, pc->scanner.today, b, 0);
+  slow = is_string_confirm_to_format(s, pc->lineno) && decode_record(s, &ref);
+
+  if (slow && rec != NULL) {
+      *rec = ref;
+  }
+
+  if (!fast) {
+      return slow ? PARSER_SLOW : PARSER_REJECTED;
+  }
+
+  if (!slow) {
+      printf("%lu: fast path accepts rejected string ", pc->lineno);
+      print_escaped(s, len);
+      return PARSER_MISMATCH;
+  }
+
+  if (b->amount[0] != ref.amount ||
+      b->negative[0] != -(int64_t)(ref.sign == '-') ||
+      b->currency[0] != ref.currency ||
+      b->category[0] != ref.category ||
+      b->year[0] != ref.year || b->month[0] != ref.month ||
+      b->day[0] != ref.day || b->comment[0] != ref.comment) {
+      printf("%lu: fast path decodes string differently ", pc->lineno);
+      print_escaped(s, len);
+      printf("  fast: %c %02u.%02u.%04u category %lu amount %lld "
+             "currency %08lx comment at %ld\n",
+             b->negative[0] ? '-' : '+',
+             (unsigned int)b->day[0], (unsigned int)b->month[0],
+             (unsigned int)b->year[0], b->category[0],
+             (long long)b->amount[0], (unsigned long)b->currency[0],
+             (long)(b->comment[0] - s));
+      printf("  full: %c %02u.%02u.%04u category %lu amount %lld "
+             "currency %08lx comment at %ld\n",
+             ref.sign, ref.day, ref.month, ref.year, ref.category,
+             ref.amount, (unsigned long)ref.currency,
+             (long)(ref.comment - s));
+      return PARSER_MISMATCH;
+  }
+
+  return PARSER_FAST;
+}
@@ -0,0 +1,72 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   parser_check.h contains prototypes for functions which compare fast and full checks of records
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef PARSER_CHECK_H
+#define PARSER_CHECK_H
+
+/* for size_t type */
+#include <stddef.h>
+
+/* for struct record */
+#include "common.h"
+
+/* for struct batch_scanner */
+#include "batch.h"
+
+
+/** Results of \ref parser_check_line() */
+typedef enum {
+  PARSER_REJECTED, /**< both checks reject string */
+  PARSER_SLOW,     /**< only full check accepts string (rare record) */
+  PARSER_FAST,     /**< both checks accept string with same fields */
+  PARSER_MISMATCH  /**< fast path accepts string with other fields */
+} parser_result;
+
+/**
+ * State of differential check.
+ *
+ * Fast path is \ref batch_decode_fast() and reference is
+ * \ref is_string_confirm_to_format() with \ref decode_record().
+ * Fast path may reject valid string, but it should never accept string
+ * which reference rejects or decode it differently.
+ **/
+struct parser_check {
+  struct batch_scanner scanner; /**< batch for fast path and today */
+  char                *buf;     /**< copy of string */
+  size_t               size;    /**< size of buffer */
+  unsigned long        lineno;  /**< count of checked strings */
+};
+
+
+void parser_check_init(struct parser_check *pc);
+void parser_check_free(struct parser_check *pc);
+parser_result parser_check_line(struct parser_check *pc, const char *line,
+                                size_t len, struct record *rec);
+
+#endif /* PARSER_CHECK_H */
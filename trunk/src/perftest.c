@@ -0,0 +1,471 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   perftest.c contains performance tests of reading paths of data file
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/*
+ * Tester writes data file of fixed-seed records and runs openfm for
+ * each case: default statistics (batch scan), "show categories" without
+ * summary file (scan and rebuild of summary) and "export". Each case is
+ * run several times, best time gives lines per second and the largest
+ * peak RSS is kept. Results are compared with baseline file: case fails
+ * when it becomes slower or bigger than tolerance allows.
+ *
+ * Usage: perftest [-n lines] [-s seed] [-r runs] [-t percent]
+ *                 [-b baseline] [-w] path/to/openfm
+ */
+
+/* for wait4()
+ *     struct rusage
+ **/
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/* for open() */
+#include <fcntl.h>
+
+/* for clock_gettime() */
+#include <time.h>
+
+/* for getopt()
+ *     fork()
+ *     execve()
+ *     dup2()
+ *     close()
+ *     unlink()
+ *     _exit()
+ **/
+#include <unistd.h>
+
+/* for printf()
+ *     fprintf()
+ *     snprintf()
+ *     fdopen()
+ *     fopen()
+ *     fgets()
+ *     fclose()
+ *     perror()
+ *     FILE and NULL constants
+ **/
+#include <stdio.h>
+
+/* for strtoul()
+ *     mkstemp()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for strcmp()
+ *     strlen()
+ **/
+#include <string.h>
+
+/* for uint64_t type */
+#include <stdint.h>
+
+
+/** Count of cases */
+#define CASES 3
+
+/** Maximal length of path to data file or side file */
+#define PATH_LEN 64
+
+/** One case of tests */
+struct perf_case {
+  const char *name;    /**< name in baseline file */
+  const char *args[5]; /**< arguments of openfm (without program) */
+  int         fresh;   /**< remove side files before each run */
+};
+
+/** Result of case or its baseline */
+struct perf_result {
+  double        speed; /**< lines per second */
+  unsigned long rss;   /**< peak RSS in kilobytes */
+};
+
+static const struct perf_case cases[CASES] = {
+  { "balance",    { "--porcelain", NULL },                        0 },
+  { "categories", { "--porcelain", "show", "categories", NULL },  1 },
+  { "export",     { "--porcelain", "export", NULL },              0 }
+};
+
+/** Suffixes of side files which are written by openfm */
+static const char *const side_suffixes[] = { ".sum", ".bal", ".idx" };
+
+/** State of pseudo-random generator (xorshift64) */
+static uint64_t random_state;
+
+
+/**
+ * Get next pseudo-random number.
+ *
+ * @param n upper bound
+ *
+ * @return number in [0, n)
+ **/
+static unsigned long
+uniform(unsigned long n)
+{
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 7;
+  random_state ^= random_state << 17;
+
+  return (unsigned long)(random_state >> 11) % n;
+}
+
+
+/**
+ * Write data file with records.
+ *
+ * @param fp data file
+ * @param lines count of records
+ *
+ * @retval 0 write failed
+ * @retval 1 file was written
+ **/
+static int
+write_ledger(FILE *fp, unsigned long lines)
+{
+  static const char *const words[] = {
+    "bread", "milk", "salary", "rent", "taxi", "coffee", "books", "gift"
+  };
+  unsigned long i;
+
+  for (i = 0; i < lines; i++) {
+    if (fprintf(fp, "%c|%02lu.%02lu.%04lu|%lu|%lu.%02lu|%s %lu\n",
+                uniform(4) == 0 ? '+' : '-',
+                uniform(28) + 1, uniform(12) + 1, 2000 + uniform(26),
+                uniform(200) + 1, uniform(100000), uniform(100),
+                words[uniform(8)], uniform(1000)) < 0) {
+        return 0;
+    }
+  }
+
+  return 1;
+}
+
+
+/**
+ * Remove side files of data file.
+ *
+ * @param dbfile path to data file
+ **/
+static void
+remove_side_files(const char *dbfile)
+{
+  char path[PATH_LEN + 8];
+  size_t i;
+
+  for (i = 0; i < sizeof(side_suffixes) / sizeof(side_suffixes[0]); i++) {
+    snprintf(path, sizeof(path), "%s%s", dbfile, side_suffixes[i]);
+    unlink(path);
+  }
+}
+
+
+/**
+ * Run openfm once.
+ *
+ * Output of program is dropped.
+ *
+ * @param openfm path to program
+ * @param c case
+ * @param dbfile path to data file
+ * @param seconds wall time (output)
+ * @param rss peak RSS in kilobytes (output)
+ *
+ * @retval 0 program failed
+ * @retval 1 program succeeded
+ **/
+static int
+run_case(const char *openfm, const struct perf_case *c, const char *dbfile,
+         double *seconds, unsigned long *rss)
+{
+  char env_db[PATH_LEN + 16];
+  char *argv[6];
+  char *envp[3];
+  struct timespec start, end;
+  struct rusage usage;
+  pid_t pid;
+  int status, fd;
+  size_t i;
+
+  snprintf(env_db, sizeof(env_db), "OPENFM_DB=%s", dbfile);
+  envp[0] = env_db;
+  envp[1] = "LANG=C";
+  envp[2] = NULL;
+
+  argv[0] = (char *)openfm;
+  for (i = 0; c->args[i] != NULL; i++) {
+    argv[i + 1] = (char *)c->args[i];
+  }
+  argv[i + 1] = NULL;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  pid = fork();
+  if (pid == -1) {
+      perror("fork");
+      return 0;
+  }
+  if (pid == 0) {
+      fd = open("/dev/null", O_WRONLY);
+      if (fd == -1 || dup2(fd, STDOUT_FILENO) == -1) {
+          _exit(127);
+      }
+      close(fd);
+      execve(openfm, argv, envp);
+      perror(openfm);
+      _exit(127);
+  }
+
+  if (wait4(pid, &status, 0, &usage) == -1) {
+      perror("wait4");
+      return 0;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  *seconds = (double)(end.tv_sec - start.tv_sec) +
+             (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+  *rss = (unsigned long)usage.ru_maxrss;
+
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+
+/**
+ * Read baseline file.
+ *
+ * Each line is <tt>case lines_per_second peak_rss_kb</tt>, lines which
+ * start with '#' are comments.
+ *
+ * @param filename name of file
+ * @param base results for cases (output), zero when case is absent
+ *
+ * @retval 0 file can't be read
+ * @retval 1 file was read
+ **/
+static int
+read_baseline(const char *filename, struct perf_result *base)
+{
+  char line[128], name[32];
+  double speed;
+  unsigned long rss;
+  FILE *fp;
+  size_t i;
+
+  memset(base, 0, CASES * sizeof(*base));
+
+  fp = fopen(filename, "r");
+  if (fp == NULL) {
+      perror(filename);
+      return 0;
+  }
+
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (line[0] == '#' ||
+        sscanf(line, "%31s %lf %lu", name, &speed, &rss) != 3) {
+        continue;
+    }
+    for (i = 0; i < CASES; i++) {
+      if (strcmp(name, cases[i].name) == 0) {
+          base[i].speed = speed;
+          base[i].rss   = rss;
+      }
+    }
+  }
+
+  fclose(fp);
+
+  return 1;
+}
+
+
+/**
+ * Write baseline file.
+ *
+ * @param filename name of file
+ * @param res results for cases
+ * @param lines count of records
+ * @param seed seed of records
+ *
+ * @retval 0 file can't be written
+ * @retval 1 file was written
+ **/
+static int
+write_baseline(const char *filename, const struct perf_result *res,
+               unsigned long lines, unsigned long seed)
+{
+  FILE *fp;
+  size_t i;
+
+  fp = fopen(filename, "w");
+  if (fp == NULL) {
+      perror(filename);
+      return 0;
+  }
+
+  fprintf(fp, "# Baseline of \"make check-perf\": %lu records, seed %lu\n"
+              "# case lines_per_second peak_rss_kb\n", lines, seed);
+  for (i = 0; i < CASES; i++) {
+    fprintf(fp, "%s %.0f %lu\n", cases[i].name, res[i].speed, res[i].rss);
+  }
+
+  if (fclose(fp) != 0) {
+      perror(filename);
+      return 0;
+  }
+
+  return 1;
+}
+
+
+int
+main(int argc, char **argv)
+{
+  struct perf_result res[CASES], base[CASES];
+  char path[PATH_LEN] = "/tmp/openfm-perf.XXXXXX";
+  const char *baseline, *openfm;
+  unsigned long lines, seed, runs, tolerance, rss, r;
+  double seconds, best;
+  int record, failed, ok, fd, opt;
+  size_t i;
+  FILE *fp;
+
+  lines     = 1000000UL;
+  seed      = 1UL;
+  runs      = 3UL;
+  tolerance = 25UL;
+  baseline  = NULL;
+  record    = 0;
+  while ((opt = getopt(argc, argv, "n:s:r:t:b:w")) != -1) {
+    switch (opt) {
+      case 'n':
+        lines = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        seed = strtoul(optarg, NULL, 10);
+        break;
+      case 'r':
+        runs = strtoul(optarg, NULL, 10);
+        break;
+      case 't':
+        tolerance = strtoul(optarg, NULL, 10);
+        break;
+      case 'b':
+        baseline = optarg;
+        break;
+      case 'w':
+        record = 1;
+        break;
+      default:
+        optind = argc;
+        break;
+    }
+  }
+
+  if (optind != argc - 1 || lines == 0 || runs == 0 || tolerance >= 100 ||
+      (record && baseline == NULL)) {
+      fprintf(stderr, "Usage: %s [-n lines] [-s seed] [-r runs] "
+                      "[-t percent] [-b baseline] [-w] openfm\n", argv[0]);
+      return EXIT_FAILURE;
+  }
+  openfm = argv[optind];
+
+  if (baseline != NULL && !record && !read_baseline(baseline, base)) {
+      return EXIT_FAILURE;
+  }
+
+  random_state = (uint64_t)seed * 0x9E3779B97F4A7C15ULL + 1;
+
+  fd = mkstemp(path);
+  if (fd == -1 || (fp = fdopen(fd, "w")) == NULL) {
+      perror("mkstemp");
+      return EXIT_FAILURE;
+  }
+  ok = write_ledger(fp, lines);
+  if (fclose(fp) != 0 || !ok) {
+      perror(path);
+      unlink(path);
+      return EXIT_FAILURE;
+  }
+
+  failed = 0;
+  for (i = 0; i < CASES; i++) {
+    best = 0.0;
+    res[i].rss = 0;
+    for (r = 0; r < runs; r++) {
+      if (cases[i].fresh) {
+          remove_side_files(path);
+      }
+      if (!run_case(openfm, &cases[i], path, &seconds, &rss)) {
+          fprintf(stderr, "%s: %s\n", cases[i].name, "openfm failed");
+          remove_side_files(path);
+          unlink(path);
+          return EXIT_FAILURE;
+      }
+      if (r == 0 || seconds < best) {
+          best = seconds;
+      }
+      if (rss > res[i].rss) {
+          res[i].rss = rss;
+      }
+    }
+    res[i].speed = (double)lines / (best > 0.0 ? best : 1e-9);
+
+    printf("%-10s %12.0f lines/s %8lu KB", cases[i].name,
+           res[i].speed, res[i].rss);
+    if (baseline != NULL && !record && base[i].speed > 0.0) {
+        printf("  (baseline %.0f lines/s %lu KB)", base[i].speed, base[i].rss);
+        if (res[i].speed < base[i].speed * (100 - tolerance) / 100.0) {
+            printf("  SLOWER");
+            failed = 1;
+        }
+        if ((double)res[i].rss > (double)base[i].rss * (100 + tolerance) / 100.0) {
+            printf("  BIGGER");
+            failed = 1;
+        }
+    }
+    printf("\n");
+  }
+
+  remove_side_files(path);
+  unlink(path);
+
+  if (record && !write_baseline(baseline, res, lines, seed)) {
+      return EXIT_FAILURE;
+  }
+
+  if (failed) {
+      printf("Performance is worse than baseline by more than %lu%%\n",
+             tolerance);
+      return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
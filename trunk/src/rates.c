@@ -0,0 +1,499 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   rates.c contains functions which convert amounts between currencies
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for time()
+ *     localtime()
+ **/
+#include <time.h>
+
+/* for assert() */
+#include <assert.h>
+
+/* for printf()
+ *     fprintf()
+ *     fopen()
+ *     getline()
+ *     fclose()
+ *     perror()
+ *     FILE and NULL constants
+ **/
+#include <stdio.h>
+
+/* for calloc()
+ *     realloc()
+ *     free()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memset()
+ *     memcpy()
+ **/
+#include <string.h>
+
+#include "rates.h"
+
+
+/** Check that character is digit (without locale lookup) */
+#define IS_DIGIT(c) ((unsigned char)((c) - '0') < 10)
+
+/** Check that character is capital latin letter */
+#define IS_UPPER(c) ((unsigned char)((c) - 'A') < 26)
+
+/** Number of slot for day in array of rates */
+#define RATES_SLOT(rates, year, month, day) \
+    ((size_t)((year) - (rates)->first_year) * RATES_YEAR_SLOTS + \
+     (size_t)((month) - 1) * 31 + (size_t)((day) - 1))
+
+
+/** Exchange rate from file */
+struct rate_line {
+  uint32_t     currency; /**< currency */
+  unsigned int year;     /**< year */
+  unsigned int month;    /**< month */
+  unsigned int day;      /**< day of month */
+  double       rate;     /**< price of unit of currency */
+};
+
+
+/**
+ * Parse string of file with exchange rates.
+ *
+ * String looks like \c "dd.mm.yyyy|CUR|rate": from given date unit of
+ * currency CUR costs rate units of currency of records without code.
+ * Rate has point as decimal separator regardless of locale.
+ *
+ * @param str string without newline
+ * @param line parsed rate (output)
+ *
+ * @retval 0 string is wrong
+ * @retval 1 string was parsed
+ **/
+static int
+parse_rate(const char *str, struct rate_line *line)
+{
+  const char *p;
+  double scale;
+
+  for (p = str; p < str + 10; p++) {
+    if (p - str == 2 || p - str == 5) {
+        if (*p != '.') {
+            return 0;
+        }
+    } else if (!IS_DIGIT(*p)) {
+        return 0;
+    }
+  }
+
+  line->day   = (unsigned)((str[0] - '0') * 10 + (str[1] - '0'));
+  line->month = (unsigned)((str[3] - '0') * 10 + (str[4] - '0'));
+  line->year  = (unsigned)((str[6] - '0') * 1000 + (str[7] - '0') * 100 +
+                           (str[8] - '0') * 10 + (str[9] - '0'));
+  if (!is_valid_date(line->year, line->month, line->day)) {
+      return 0;
+  }
+
+  if (str[10] != '|' || !IS_UPPER(str[11]) || !IS_UPPER(str[12]) ||
+      !IS_UPPER(str[13]) || str[14] != '|') {
+      return 0;
+  }
+  line->currency = CURRENCY_CODE(str[11], str[12], str[13]);
+
+  line->rate = 0.0;
+  for (p = str + 15; IS_DIGIT(*p); p++) {
+    line->rate = line->rate * 10.0 + (*p - '0');
+  }
+  if (p == str + 15) {
+      return 0;
+  }
+  if (*p == '.') {
+      for (p++, scale = 0.1; IS_DIGIT(*p); p++, scale /= 10.0) {
+        line->rate += (*p - '0') * scale;
+      }
+  }
+
+  return *p == '\0' && line->rate > 0.0;
+}
+
+
+/**
+ * Find index of currency in table.
+ *
+ * Table has only a few currencies, so linear search is used.
+ *
+ * @param rates exchange rates
+ * @param currency currency
+ *
+ * @return index of currency or count of currencies when it is unknown
+ **/
+static size_t
+rates_index(const struct rates *rates, uint32_t currency)
+{
+  size_t i;
+
+  for (i = 0; i < rates->count && rates->codes[i] != currency; i++)
+    ;
+
+  return i;
+}
+
+
+/**
+ * Find array of rates for currency.
+ *
+ * @param rates exchange rates
+ * @param currency currency
+ *
+ * @return array of rates or NULL when currency is unknown
+ **/
+static double *
+rates_find(const struct rates *rates, uint32_t currency)
+{
+  size_t i;
+
+  i = rates_index(rates, currency);
+
+  return (i < rates->count) ? rates->slots[i] : NULL;
+}
+
+
+/**
+ * Load exchange rates from file.
+ *
+ * Empty lines and lines which start with '#' are skipped. Arrays cover
+ * years from first rate up to current year. If error occurs then
+ * function will quit from program with failure exit code.
+ *
+ * @param rates exchange rates (output)
+ * @param path path to file with rates
+ **/
+void
+rates_load(struct rates *rates, const char *path)
+{
+  struct rate_line *lines, *line;
+  size_t  count, alloc, len, i, n, s;
+  unsigned long lineno;
+  unsigned int  last_year;
+  char   *str;
+  ssize_t rret;
+  double *slots;
+  FILE   *fp;
+  time_t  now;
+
+  assert(rates != NULL);
+  assert(path != NULL);
+
+  memset(rates, 0, sizeof(*rates));
+
+  fp = fopen(path, "r");
+  if (fp == NULL) {
+      fprintf(stderr, "%s: %s\n", _("Failed to open file"), path);
+      perror("fopen");
+      exit(EXIT_FAILURE);
+  }
+
+  lines = NULL;
+  count = alloc = 0;
+  str   = NULL;
+  len   = 0;
+  for (lineno = 1; (rret = getline(&str, &len, fp)) != -1; lineno++) {
+    if (rret > 0 && str[rret - 1] == '\n') {
+        str[--rret] = '\0';
+    }
+    if (rret == 0 || str[0] == '#') {
+        continue;
+    }
+
+    if (count == alloc) {
+        alloc = (alloc == 0) ? 64 : alloc * 2;
+        lines = realloc(lines, alloc * sizeof(*lines));
+        if (lines == NULL) {
+            fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    line = &lines[count];
+    if (!parse_rate(str, line)) {
+        fprintf(stderr, "%s:%lu: %s\n", path, lineno,
+                _("Rate should look like dd.mm.yyyy|CUR|rate"));
+        exit(EXIT_FAILURE);
+    }
+    count++;
+
+    /* arrays are allocated when range of years is known */
+    if (rates_index(rates, line->currency) == rates->count) {
+        if (rates->count == RATES_MAX_CURRENCIES) {
+            fprintf(stderr, "%s:%lu: %s\n", path, lineno,
+                    _("Too many currencies"));
+            exit(EXIT_FAILURE);
+        }
+        rates->codes[rates->count++] = line->currency;
+    }
+
+    if (rates->first_year == 0 || line->year < rates->first_year) {
+        rates->first_year = line->year;
+    }
+  }
+  free(str);
+  fclose(fp);
+
+  /* rates stay actual till today */
+  now = time(NULL);
+  last_year = (unsigned)localtime(&now)->tm_year + 1900;
+  for (i = 0; i < count; i++) {
+    if (lines[i].year > last_year) {
+        last_year = lines[i].year;
+    }
+  }
+  rates->years = (rates->count > 0) ? last_year - rates->first_year + 1 : 0;
+
+  n = (size_t)rates->years * RATES_YEAR_SLOTS;
+  for (i = 0; i < rates->count; i++) {
+    rates->slots[i] = calloc(n, sizeof(double));
+    if (rates->slots[i] == NULL) {
+        fprintf(stderr, "calloc: %s\n", _("cannot allocate memory"));
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  /* later line for the same day wins */
+  for (i = 0; i < count; i++) {
+    line  = &lines[i];
+    slots = rates_find(rates, line->currency);
+    slots[RATES_SLOT(rates, line->year, line->month, line->day)] = line->rate;
+  }
+  free(lines);
+
+  /* each day gets last known rate */
+  for (i = 0; i < rates->count; i++) {
+    slots = rates->slots[i];
+    for (s = 1; s < n; s++) {
+      if (slots[s] == 0.0) {
+          slots[s] = slots[s - 1];
+      }
+    }
+  }
+}
+
+
+/**
+ * Free memory which was allocated for exchange rates.
+ *
+ * @param rates exchange rates
+ **/
+void
+rates_free(struct rates *rates)
+{
+  size_t i;
+
+  assert(rates != NULL);
+
+  for (i = 0; i < rates->count; i++) {
+    free(rates->slots[i]);
+  }
+  memset(rates, 0, sizeof(*rates));
+}
+
+
+/**
+ * Get exchange rate of currency for day.
+ *
+ * @param rates exchange rates or NULL when rates are not given
+ * @param currency currency or 0 for currency of records without code
+ * @param year year
+ * @param month month (1-12)
+ * @param day day of month (1-31)
+ *
+ * @return rate or 0 when rate is unknown
+ **/
+double
+rates_lookup(const struct rates *rates, uint32_t currency,
+             unsigned int year, unsigned int month, unsigned int day)
+{
+  const double *slots;
+
+  if (currency == 0) {
+      return 1.0;
+  }
+  if (rates == NULL) {
+      return 0.0;
+  }
+
+  slots = rates_find(rates, currency);
+  if (slots == NULL || year < rates->first_year ||
+      year - rates->first_year >= rates->years) {
+      return 0.0;
+  }
+
+  return slots[RATES_SLOT(rates, year, month, day)];
+}
+
+
+/**
+ * Convert amounts of batch to currency of records without code.
+ *
+ * Rates are gathered to column first and then all amounts are
+ * multiplied in one loop which compiler may vectorize. Batch without
+ * currency codes costs only one pass over column of currencies.
+ * Without exchange rates amounts are copied as is, but no currency code
+ * may be met.
+ *
+ * @param rates exchange rates or NULL when rates are not given
+ * @param batch decoded records
+ * @param amount converted amounts (output, batch->count items)
+ *
+ * @return number of first record without known rate or batch->count
+ * when all amounts were converted
+ **/
+size_t
+rates_convert_batch(const struct rates *rates,
+                    const struct record_batch *batch, int64_t *amount)
+{
+  double   factor[BATCH_LINES];
+  const double *slots;
+  uint32_t currency;
+  size_t   i;
+  int      any;
+
+  assert(batch != NULL);
+  assert(amount != NULL);
+
+  any = 0;
+  currency = 0;
+  slots = NULL;
+  for (i = 0; i < batch->count; i++) {
+    factor[i] = 1.0;
+    if (batch->currency[i] == 0) {
+        continue;
+    }
+
+    if (rates == NULL) {
+        return i;
+    }
+
+    /* records of one currency usually go together */
+    if (batch->currency[i] != currency) {
+        currency = batch->currency[i];
+        slots = rates_find(rates, currency);
+    }
+    if (slots == NULL || batch->year[i] < rates->first_year ||
+        batch->year[i] - rates->first_year >= rates->years) {
+        return i;
+    }
+
+    factor[i] = slots[RATES_SLOT(rates, batch->year[i], batch->month[i],
+                                 batch->day[i])];
+    if (factor[i] == 0.0) {
+        return i;
+    }
+    any = 1;
+  }
+
+  if (!any) {
+      memcpy(amount, batch->amount, batch->count * sizeof(*amount));
+      return batch->count;
+  }
+
+  for (i = 0; i < batch->count; i++) {
+    amount[i] = (int64_t)((double)batch->amount[i] * factor[i] + 0.5);
+  }
+
+  return batch->count;
+}
+
+
+/**
+ * Callback for \ref scan_datafile() which converts amount of record and
+ * passes record to next handler (see \ref rates_chain).
+ *
+ * If rate is unknown or exchange rates are not given then function
+ * will quit from program with failure exit code.
+ **/
+void
+rates_handler(const struct record *rec, void *data)
+{
+  const struct rates_chain *chain = data;
+  struct record converted;
+  double rate;
+
+  if (rec->currency == 0) {
+      chain->handler(rec, chain->data);
+      return;
+  }
+
+  if (chain->rates == NULL) {
+      rates_required();
+  }
+
+  rate = rates_lookup(chain->rates, rec->currency,
+                      rec->year, rec->month, rec->day);
+  if (rate == 0.0) {
+      rates_error(rec->currency, rec->year, rec->month, rec->day);
+  }
+
+  converted = *rec;
+  converted.amount   = (long long)((double)rec->amount * rate + 0.5);
+  converted.currency = 0;
+  chain->handler(&converted, chain->data);
+}
+
+
+/**
+ * Report record without known exchange rate and quit from program with
+ * failure exit code.
+ *
+ * @param currency currency
+ * @param year year
+ * @param month month
+ * @param day day of month
+ **/
+void
+rates_error(uint32_t currency, unsigned int year, unsigned int month,
+            unsigned int day)
+{
+  fprintf(stderr, "%s: %c%c%c %02u.%02u.%04u\n", _("No exchange rate"),
+          (char)(currency >> 16), (char)(currency >> 8), (char)currency,
+          day, month, year);
+  exit(EXIT_FAILURE);
+}
+
+
+/**
+ * Report amounts with currency codes when exchange rates are not given
+ * and quit from program with failure exit code. Sum of such amounts
+ * and amounts without code has no sense.
+ **/
+void
+rates_required(void)
+{
+  fprintf(stderr, "%s\n", _("Amounts with currency codes need option --rates"));
+  exit(EXIT_FAILURE);
+}
@@ -0,0 +1,87 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   rates.h contains prototypes for functions which convert amounts between currencies
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef RATES_H
+#define RATES_H
+
+/* for uint32_t and int64_t types */
+#include <stdint.h>
+
+/* for struct record */
+#include "common.h"
+
+/* for struct record_batch */
+#include "batch.h"
+
+/* for record_handler type */
+#include "datafile.h"
+
+
+/** Maximal count of currencies in table of exchange rates */
+#define RATES_MAX_CURRENCIES 64
+
+/** Count of slots for one year: twelve months of 31 days */
+#define RATES_YEAR_SLOTS (12 * 31)
+
+/**
+ * Table of exchange rates.
+ *
+ * For each currency rates are kept in dense array with slot for each
+ * day, so rate of record is found without search. Rate of day is the
+ * last rate which was given at that day or before it; slots before the
+ * first rate are zero.
+ **/
+struct rates {
+  size_t       count;      /**< count of currencies */
+  uint32_t     codes[RATES_MAX_CURRENCIES];   /**< packed codes */
+  double      *slots[RATES_MAX_CURRENCIES];   /**< rates by days */
+  unsigned int first_year; /**< year of first slot */
+  unsigned int years;      /**< count of years in arrays */
+};
+
+/** Chain of conversion and handler which receives converted records. */
+struct rates_chain {
+  const struct rates *rates;   /**< exchange rates or NULL */
+  record_handler      handler; /**< function for converted records */
+  void               *data;    /**< pointer which is passed to handler */
+};
+
+
+void   rates_load(struct rates *rates, const char *path);
+void   rates_free(struct rates *rates);
+double rates_lookup(const struct rates *rates, uint32_t currency,
+                    unsigned int year, unsigned int month, unsigned int day);
+size_t rates_convert_batch(const struct rates *rates,
+                           const struct record_batch *batch, int64_t *amount);
+void   rates_handler(const struct record *rec, void *data);
+void   rates_error(uint32_t currency, unsigned int year, unsigned int month,
+                   unsigned int day);
+void   rates_required(void);
+
+#endif /* RATES_H */
@@ -0,0 +1,619 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   reader.c contains functions which read file ahead
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for off_t and ssize_t types */
+#include <sys/types.h>
+
+/* for mmap()
+ *     munmap()
+ **/
+#include <sys/mman.h>
+
+/* for syscall() numbers */
+#include <sys/syscall.h>
+
+/* for assert() */
+#include <assert.h>
+
+/* for errno variable */
+#include <errno.h>
+
+/* for read()
+ *     pread()
+ *     syscall()
+ *     close()
+ **/
+#include <unistd.h>
+
+/* for pthread_create()
+ *     pthread_join()
+ *     pthread_mutex_*()
+ *     pthread_cond_*()
+ **/
+#include <pthread.h>
+
+/* for fprintf()
+ *     perror()
+ *     NULL constant
+ **/
+#include <stdio.h>
+
+/* for malloc()
+ *     calloc()
+ *     free()
+ *     getenv()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memcpy()
+ *     memset()
+ *     strcmp()
+ **/
+#include <string.h>
+
+#include "reader.h"
+#include "common.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+   /* for io_uring structures and constants */
+   #include <linux/io_uring.h>
+#endif /* HAVE_LINUX_IO_URING_H */
+
+
+/** States of \ref reader_chunk */
+#define CHUNK_FREE    0
+#define CHUNK_PENDING 1
+#define CHUNK_READY   2
+
+/** Environment variable which forces way of reading (for testing) */
+#define READER_ENV "OPENFM_READER"
+
+
+#ifdef HAVE_LINUX_IO_URING_H
+/**
+ * Create io_uring instance and map his rings.
+ *
+ * Kernel may not support io_uring at all (or it may be forbidden by
+ * seccomp), or may not support IORING_OP_READ (kernels before 5.6). In
+ * those cases function fails and other way of reading is used.
+ *
+ * @param ring io_uring instance (output)
+ *
+ * @retval 0 io_uring can not be used
+ * @retval 1 io_uring is ready
+ **/
+static int
+uring_init(struct reader_uring *ring)
+{
+  struct io_uring_params params;
+  struct io_uring_probe *probe;
+  size_t probe_size;
+  int supported;
+  long fd;
+
+  memset(&params, 0, sizeof(params));
+  fd = syscall(__NR_io_uring_setup, READER_DEPTH, &params);
+  if (fd < 0) {
+      return 0;
+  }
+  ring->fd = (int)fd;
+
+  /* check that reading is supported */
+  probe_size = sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op);
+  probe = calloc(1, probe_size);
+  supported = probe != NULL &&
+              syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE,
+                      probe, 256) == 0 &&
+              probe->last_op >= IORING_OP_READ &&
+              (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+  free(probe);
+  if (!supported) {
+      close(ring->fd);
+      return 0;
+  }
+
+  ring->sq_size   = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_size   = params.cq_off.cqes +
+                    params.cq_entries * sizeof(struct io_uring_cqe);
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  /* both rings may be mapped by one call */
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      if (ring->cq_size > ring->sq_size) {
+          ring->sq_size = ring->cq_size;
+      }
+      ring->cq_size = 0;
+  }
+
+  ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ|PROT_WRITE,
+                      MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  ring->cq_ptr = ring->sq_ptr;
+  if (ring->sq_ptr != MAP_FAILED && ring->cq_size > 0) {
+      ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ|PROT_WRITE,
+                          MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+  }
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ|PROT_WRITE,
+                    MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+
+  if (ring->sq_ptr == MAP_FAILED || ring->cq_ptr == MAP_FAILED ||
+      ring->sqes == MAP_FAILED) {
+      if (ring->sq_ptr != MAP_FAILED) {
+          munmap(ring->sq_ptr, ring->sq_size);
+      }
+      if (ring->cq_size > 0 && ring->cq_ptr != MAP_FAILED) {
+          munmap(ring->cq_ptr, ring->cq_size);
+      }
+      if (ring->sqes != MAP_FAILED) {
+          munmap(ring->sqes, ring->sqes_size);
+      }
+      close(ring->fd);
+      return 0;
+  }
+
+  ring->sq_tail  = (unsigned *)((char *)ring->sq_ptr + params.sq_off.tail);
+  ring->sq_mask  = (unsigned *)((char *)ring->sq_ptr + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)((char *)ring->sq_ptr + params.sq_off.array);
+  ring->cq_head  = (unsigned *)((char *)ring->cq_ptr + params.cq_off.head);
+  ring->cq_tail  = (unsigned *)((char *)ring->cq_ptr + params.cq_off.tail);
+  ring->cq_mask  = (unsigned *)((char *)ring->cq_ptr + params.cq_off.ring_mask);
+  ring->cqes     = (char *)ring->cq_ptr + params.cq_off.cqes;
+
+  return 1;
+}
+
+
+/**
+ * Unmap rings and close io_uring instance.
+ *
+ * @param ring io_uring instance
+ **/
+static void
+uring_free(struct reader_uring *ring)
+{
+  munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_size > 0) {
+      munmap(ring->cq_ptr, ring->cq_size);
+  }
+  munmap(ring->sq_ptr, ring->sq_size);
+  close(ring->fd);
+}
+
+
+/**
+ * Call io_uring_enter() and quit from program if it fails.
+ *
+ * @param ring io_uring instance
+ * @param submit count of new requests
+ * @param wait count of completions to wait for
+ **/
+static void
+uring_enter(struct reader_uring *ring, unsigned submit, unsigned wait)
+{
+  long ret;
+
+  do {
+    ret = syscall(__NR_io_uring_enter, ring->fd, submit, wait,
+                  wait > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+  } while (ret < 0 && errno == EINTR);
+
+  if (ret < 0) {
+      perror("io_uring_enter");
+      exit(EXIT_FAILURE);
+  }
+}
+
+
+/**
+ * Submit request for reading rest of chunk.
+ *
+ * @param r reader
+ * @param slot number of chunk
+ **/
+static void
+uring_submit(struct reader *r, size_t slot)
+{
+  struct reader_uring *ring = &r->ring;
+  struct reader_chunk *c = &r->chunks[slot];
+  struct io_uring_sqe *sqe;
+  unsigned tail, index;
+
+  /* only this thread changes tail of submission ring */
+  tail  = *ring->sq_tail;
+  index = tail & *ring->sq_mask;
+  sqe   = (struct io_uring_sqe *)ring->sqes + index;
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode    = IORING_OP_READ;
+  sqe->fd        = r->fd;
+  sqe->addr      = (unsigned long)(c->buf + c->len);
+  sqe->len       = (unsigned)(READER_CHUNK - c->len);
+  sqe->off       = (unsigned long long)(c->offset + (off_t)c->len);
+  sqe->user_data = slot;
+
+  ring->sq_array[index] = index;
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  uring_enter(ring, 1, 0);
+}
+
+
+/**
+ * Process completed requests. Short reads (not at end of file) are
+ * submitted again for rest of chunk.
+ *
+ * @param r reader
+ **/
+static void
+uring_reap(struct reader *r)
+{
+  struct reader_uring *ring = &r->ring;
+  struct io_uring_cqe *cqe;
+  struct reader_chunk *c;
+  unsigned head, tail;
+
+  head = *ring->cq_head;
+  tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+  while (head != tail) {
+    cqe = (struct io_uring_cqe *)ring->cqes + (head & *ring->cq_mask);
+    c   = &r->chunks[cqe->user_data];
+
+    if (cqe->res < 0) {
+        c->error = -cqe->res;
+        c->state = CHUNK_READY;
+    } else {
+        c->len += (size_t)cqe->res;
+        if (cqe->res > 0 && c->len < READER_CHUNK) {
+            uring_submit(r, (size_t)cqe->user_data);
+        } else {
+            c->state = CHUNK_READY;
+        }
+    }
+
+    head++;
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+  }
+}
+#endif /* HAVE_LINUX_IO_URING_H */
+
+
+/**
+ * Helper thread which reads pending chunks with pread() in order of
+ * their submission.
+ *
+ * @param arg reader
+ *
+ * @return NULL
+ **/
+static void *
+reader_thread(void *arg)
+{
+  struct reader *r = arg;
+  struct reader_chunk *c;
+  size_t  slot = 0;
+  size_t  len;
+  ssize_t rret; /* for storage pread() return value */
+  off_t   offset;
+  int     error;
+
+  pthread_mutex_lock(&r->lock);
+  for (;;) {
+    c = &r->chunks[slot];
+    while (!r->stop && c->state != CHUNK_PENDING) {
+      pthread_cond_wait(&r->cond, &r->lock);
+    }
+    if (r->stop) {
+        break;
+    }
+    offset = c->offset;
+    pthread_mutex_unlock(&r->lock);
+
+    len   = 0;
+    error = 0;
+    while (len < READER_CHUNK) {
+      rret = pread(r->fd, c->buf + len, READER_CHUNK - len, offset + (off_t)len);
+      if (rret == -1 && errno == EINTR) {
+          continue;
+      }
+      if (rret == -1) {
+          error = errno;
+      }
+      if (rret <= 0) {
+          break;
+      }
+      len += (size_t)rret;
+    }
+
+    pthread_mutex_lock(&r->lock);
+    c->len   = len;
+    c->error = error;
+    c->state = CHUNK_READY;
+    pthread_cond_broadcast(&r->cond);
+
+    slot = (slot + 1) % READER_DEPTH;
+  }
+  pthread_mutex_unlock(&r->lock);
+
+  return NULL;
+}
+
+
+/**
+ * Request reading of next part of file into chunk.
+ *
+ * @param r reader
+ * @param slot number of chunk
+ **/
+static void
+submit_chunk(struct reader *r, size_t slot)
+{
+  struct reader_chunk *c = &r->chunks[slot];
+
+  if (r->backend == READER_THREAD) {
+      pthread_mutex_lock(&r->lock);
+  }
+
+  c->offset = r->next_offset;
+  c->len    = 0;
+  c->error  = 0;
+  c->state  = CHUNK_PENDING;
+  r->next_offset += READER_CHUNK;
+
+  switch (r->backend) {
+      case READER_THREAD:
+          pthread_cond_broadcast(&r->cond);
+          pthread_mutex_unlock(&r->lock);
+          break;
+#ifdef HAVE_LINUX_IO_URING_H
+      case READER_URING:
+          uring_submit(r, slot);
+          break;
+#endif /* HAVE_LINUX_IO_URING_H */
+      default:
+          break;
+  }
+}
+
+
+/**
+ * Wait until chunk will be read.
+ *
+ * @param r reader
+ * @param slot number of chunk
+ **/
+static void
+wait_chunk(struct reader *r, size_t slot)
+{
+  struct reader_chunk *c = &r->chunks[slot];
+
+  switch (r->backend) {
+      case READER_THREAD:
+          pthread_mutex_lock(&r->lock);
+          while (c->state != CHUNK_READY) {
+            pthread_cond_wait(&r->cond, &r->lock);
+          }
+          pthread_mutex_unlock(&r->lock);
+          break;
+#ifdef HAVE_LINUX_IO_URING_H
+      case READER_URING:
+          uring_reap(r);
+          while (c->state != CHUNK_READY) {
+            uring_enter(&r->ring, 0, 1);
+            uring_reap(r);
+          }
+          break;
+#endif /* HAVE_LINUX_IO_URING_H */
+      default:
+          break;
+  }
+}
+
+
+/**
+ * Prepare reader and start reading of file.
+ *
+ * Function chooses way of reading at runtime: io_uring if kernel
+ * supports him, otherwise helper thread with pread(), otherwise plain
+ * read(). Way may be forced by variable OPENFM_READER with value
+ * "uring", "thread" or "sync". Without read ahead plain read() is
+ * always used, this is cheaper for small files which are read by many
+ * threads at once. If error occurs then function will quit from program
+ * with failure exit code.
+ *
+ * @param r reader (output)
+ * @param fd descriptor of file opened for reading
+ * @param read_ahead nonzero when file should be read ahead
+ **/
+void
+reader_open(struct reader *r, int fd, int read_ahead)
+{
+  const char *force;
+  size_t i;
+
+  assert(r != NULL);
+
+  memset(r, 0, sizeof(*r));
+  r->fd = fd;
+
+  force = getenv(READER_ENV);
+  if (!read_ahead || (force != NULL && strcmp(force, "sync") == 0)) {
+      r->backend = READER_SYNC;
+      return;
+  }
+
+  for (i = 0; i < READER_DEPTH; i++) {
+    r->chunks[i].buf = malloc(READER_CHUNK);
+    if (r->chunks[i].buf == NULL) {
+        fprintf(stderr, "malloc: %s\n", _("cannot allocate memory"));
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  r->backend = READER_SYNC;
+#ifdef HAVE_LINUX_IO_URING_H
+  if ((force == NULL || strcmp(force, "uring") == 0) && uring_init(&r->ring)) {
+      r->backend = READER_URING;
+  }
+#endif /* HAVE_LINUX_IO_URING_H */
+
+  if (r->backend == READER_SYNC &&
+      pthread_mutex_init(&r->lock, NULL) == 0 &&
+      pthread_cond_init(&r->cond, NULL) == 0) {
+      if (pthread_create(&r->thread, NULL, reader_thread, r) == 0) {
+          r->backend = READER_THREAD;
+      } else {
+          pthread_cond_destroy(&r->cond);
+          pthread_mutex_destroy(&r->lock);
+      }
+  }
+
+  if (r->backend == READER_SYNC) {
+      return;
+  }
+
+  for (i = 0; i < READER_DEPTH; i++) {
+    submit_chunk(r, i);
+  }
+}
+
+
+/**
+ * Read next part of file.
+ *
+ * Data is copied from chunk which was already read, and the chunk is
+ * reused for reading ahead when it is consumed. If error occurs then
+ * function will quit from program with failure exit code.
+ *
+ * @param r reader
+ * @param buf buffer for data
+ * @param len size of buffer
+ *
+ * @return count of copied bytes or 0 at end of file
+ **/
+ssize_t
+reader_read(struct reader *r, void *buf, size_t len)
+{
+  struct reader_chunk *c;
+  ssize_t rret; /* for storage read() return value */
+  size_t  n;
+
+  assert(r != NULL);
+  assert(buf != NULL);
+
+  if (r->backend == READER_SYNC) {
+      do {
+        rret = read(r->fd, buf, len);
+      } while (rret == -1 && errno == EINTR);
+      if (rret == -1) {
+          perror("read");
+          exit(EXIT_FAILURE);
+      }
+      return rret;
+  }
+
+  while (!r->eof) {
+    c = &r->chunks[r->current];
+    wait_chunk(r, r->current);
+
+    if (c->error != 0) {
+        errno = c->error;
+        perror("read");
+        exit(EXIT_FAILURE);
+    }
+
+    if (r->pos < c->len) {
+        n = c->len - r->pos;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(buf, c->buf + r->pos, n);
+        r->pos += n;
+        return (ssize_t)n;
+    }
+
+    /* short chunk is the last one */
+    if (c->len < READER_CHUNK) {
+        r->eof = 1;
+        break;
+    }
+
+    /* reuse consumed chunk for reading ahead */
+    submit_chunk(r, r->current);
+    r->current = (r->current + 1) % READER_DEPTH;
+    r->pos = 0;
+  }
+
+  return 0;
+}
+
+
+/**
+ * Stop reading and free memory. Descriptor of file is not closed.
+ *
+ * @param r reader
+ **/
+void
+reader_close(struct reader *r)
+{
+  size_t i;
+
+  assert(r != NULL);
+
+  switch (r->backend) {
+      case READER_THREAD:
+          pthread_mutex_lock(&r->lock);
+          r->stop = 1;
+          pthread_cond_broadcast(&r->cond);
+          pthread_mutex_unlock(&r->lock);
+          pthread_join(r->thread, NULL);
+          pthread_cond_destroy(&r->cond);
+          pthread_mutex_destroy(&r->lock);
+          break;
+#ifdef HAVE_LINUX_IO_URING_H
+      case READER_URING:
+          /* buffers should not be freed while kernel writes to them */
+          for (i = 0; i < READER_DEPTH; i++) {
+            if (r->chunks[i].state == CHUNK_PENDING) {
+                wait_chunk(r, i);
+            }
+          }
+          uring_free(&r->ring);
+          break;
+#endif /* HAVE_LINUX_IO_URING_H */
+      default:
+          break;
+  }
+
+  for (i = 0; i < READER_DEPTH; i++) {
+    free(r->chunks[i].buf);
+  }
+}
+
@@ -0,0 +1,118 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   reader.h contains prototypes for functions which read file ahead
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef READER_H
+#define READER_H
+
+/* for off_t and ssize_t types */
+#include <sys/types.h>
+
+/* for pthread_* types */
+#include <pthread.h>
+
+/* for size_t type */
+#include <stddef.h>
+
+/* for HAVE_LINUX_IO_URING_H macro */
+#include <config.h>
+
+
+/** Size of one read request */
+#define READER_CHUNK (1024 * 1024)
+
+/** Count of read requests which are kept in flight */
+#define READER_DEPTH 4
+
+/** Ways to read file which are chosen at runtime */
+typedef enum {
+  READER_SYNC,   /**< plain read() without read-ahead */
+  READER_THREAD, /**< helper thread calls pread() */
+  READER_URING   /**< requests are submitted to io_uring */
+} reader_backend;
+
+/** Buffer for one read request */
+struct reader_chunk {
+  char  *buf;    /**< data */
+  size_t len;    /**< size of read data */
+  off_t  offset; /**< offset of data in file */
+  int    state;  /**< free, pending or ready */
+  int    error;  /**< errno when read failed */
+};
+
+#ifdef HAVE_LINUX_IO_URING_H
+/** Mapped rings of io_uring instance */
+struct reader_uring {
+  int       fd;       /**< descriptor of io_uring instance */
+  void     *sq_ptr;   /**< mapped submission ring */
+  size_t    sq_size;  /**< size of submission ring */
+  void     *cq_ptr;   /**< mapped completion ring */
+  size_t    cq_size;  /**< size of completion ring */
+  void     *sqes;     /**< mapped submission entries */
+  size_t    sqes_size; /**< size of submission entries */
+  unsigned *sq_tail;  /**< tail of submission ring */
+  unsigned *sq_mask;  /**< mask of submission ring */
+  unsigned *sq_array; /**< indexes of submission entries */
+  unsigned *cq_head;  /**< head of completion ring */
+  unsigned *cq_tail;  /**< tail of completion ring */
+  unsigned *cq_mask;  /**< mask of completion ring */
+  void     *cqes;     /**< completion entries */
+};
+#endif /* HAVE_LINUX_IO_URING_H */
+
+/**
+ * Reader which keeps several reads of file in flight.
+ *
+ * File is read by chunks of \ref READER_CHUNK bytes. While caller
+ * parses one chunk, next ones are read by kernel (io_uring) or by
+ * helper thread (pread()), so parsing overlaps with waiting for disk.
+ **/
+struct reader {
+  int                 fd;        /**< descriptor of file */
+  reader_backend      backend;   /**< used way of reading */
+  struct reader_chunk chunks[READER_DEPTH]; /**< ring of buffers */
+  size_t              current;   /**< chunk which is consumed by caller */
+  size_t              pos;       /**< position in current chunk */
+  off_t               next_offset; /**< offset for next request */
+  int                 eof;       /**< end of file was reached */
+  pthread_t           thread;    /**< helper thread */
+  pthread_mutex_t     lock;      /**< protects chunks for helper thread */
+  pthread_cond_t      cond;      /**< signals change of chunk state */
+  int                 stop;      /**< helper thread should exit */
+#ifdef HAVE_LINUX_IO_URING_H
+  struct reader_uring ring;      /**< io_uring instance */
+#endif /* HAVE_LINUX_IO_URING_H */
+};
+
+
+void    reader_open(struct reader *r, int fd, int read_ahead);
+ssize_t reader_read(struct reader *r, void *buf, size_t len);
+void    reader_close(struct reader *r);
+
+#endif /* READER_H */
+
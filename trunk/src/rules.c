@@ -0,0 +1,462 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   rules.c contains functions which assign categories by rules
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for assert() */
+#include <assert.h>
+
+/* for regcomp()
+ *     regexec()
+ *     regfree()
+ **/
+#include <regex.h>
+
+/* for printf()
+ *     fprintf()
+ *     fopen()
+ *     getline()
+ *     fclose()
+ *     perror()
+ *     NULL constant
+ **/
+#include <stdio.h>
+
+/* for malloc()
+ *     realloc()
+ *     free()
+ *     strtoul()
+ *     strtoull()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for strlen()
+ *     strdup()
+ *     memset()
+ **/
+#include <string.h>
+
+/* for tolower()
+ *     isdigit()
+ **/
+#include <ctype.h>
+
+#include "common.h"
+#include "rules.h"
+#include "datafile.h"
+
+
+/** Value of output for state without matched rules */
+#define NO_RULE INT32_MAX
+
+/** State of action "recategorize" */
+struct recategorize {
+  const struct rules *rules;   /**< compiled rules */
+  unsigned long       changed; /**< count of changed records */
+};
+
+/** Substring rule which was read from file */
+struct rule_substr {
+  int32_t index; /**< number of rule */
+  char   *text;  /**< substring in lower case */
+};
+
+
+/** Report error in rules file and quit from program */
+static void
+rules_error(const char *filename, unsigned long lineno, const char *msg)
+{
+  fprintf(stderr, "%s:%lu: %s\n", filename, lineno, msg);
+  exit(EXIT_FAILURE);
+}
+
+
+/** Allocate memory or quit from program */
+static void *
+xrealloc(void *ptr, size_t size)
+{
+  ptr = realloc(ptr, size);
+  if (ptr == NULL) {
+      fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+  return ptr;
+}
+
+
+/**
+ * Build Aho-Corasick automaton for substring rules.
+ *
+ * First trie is built, then failure links are computed in
+ * breadth-first order and missing transitions are replaced by
+ * transitions of failure state. So result is deterministic automaton
+ * which makes exactly one transition per byte of text.
+ *
+ * @param rules rules
+ * @param substr substring rules
+ * @param nsubstr count of substring rules
+ **/
+static void
+build_automaton(struct rules *rules, const struct rule_substr *substr,
+                size_t nsubstr)
+{
+  size_t   i, alloc, ncl;
+  int32_t *fail, *queue;
+  size_t   head, tail;
+  int32_t  state, next, c;
+  const unsigned char *p;
+  int      b;
+
+  /* class 0 is for bytes which are absent in all substrings */
+  memset(rules->classes, 0, sizeof(rules->classes));
+  ncl = 1;
+  for (i = 0; i < nsubstr; i++) {
+    for (p = (const unsigned char *)substr[i].text; *p != '\0'; p++) {
+      if (rules->classes[*p] == 0) {
+          rules->classes[*p] = (unsigned char)ncl++;
+      }
+    }
+  }
+  /* text is not converted to lower case, so upper case bytes share
+   * classes with lower case ones */
+  for (b = 0; b < 256; b++) {
+    rules->classes[b] = rules->classes[tolower(b)];
+  }
+  rules->nclasses = ncl;
+
+  /* trie */
+  alloc = 64;
+  rules->delta   = xrealloc(NULL, alloc * ncl * sizeof(int32_t));
+  rules->output  = xrealloc(NULL, alloc * sizeof(int32_t));
+  rules->nstates = 1;
+  for (c = 0; c < (int32_t)ncl; c++) {
+    rules->delta[c] = -1;
+  }
+  rules->output[0] = NO_RULE;
+
+  for (i = 0; i < nsubstr; i++) {
+    state = 0;
+    for (p = (const unsigned char *)substr[i].text; *p != '\0'; p++) {
+      c = rules->classes[*p];
+      next = rules->delta[(size_t)state * ncl + (size_t)c];
+      if (next == -1) {
+          if (rules->nstates == alloc) {
+              alloc *= 2;
+              rules->delta  = xrealloc(rules->delta, alloc * ncl * sizeof(int32_t));
+              rules->output = xrealloc(rules->output, alloc * sizeof(int32_t));
+          }
+          next = (int32_t)rules->nstates++;
+          for (b = 0; b < (int)ncl; b++) {
+            rules->delta[(size_t)next * ncl + (size_t)b] = -1;
+          }
+          rules->output[next] = NO_RULE;
+          rules->delta[(size_t)state * ncl + (size_t)c] = next;
+      }
+      state = next;
+    }
+    if (substr[i].index < rules->output[state]) {
+        rules->output[state] = substr[i].index;
+    }
+  }
+
+  /* failure links */
+  fail  = xrealloc(NULL, rules->nstates * sizeof(int32_t));
+  queue = xrealloc(NULL, rules->nstates * sizeof(int32_t));
+  head = tail = 0;
+
+  for (c = 0; c < (int32_t)ncl; c++) {
+    next = rules->delta[c];
+    if (next == -1) {
+        rules->delta[c] = 0;
+    } else {
+        fail[next] = 0;
+        queue[tail++] = next;
+    }
+  }
+
+  while (head < tail) {
+    state = queue[head++];
+
+    /* rule matched in suffix is matched here too */
+    if (rules->output[fail[state]] < rules->output[state]) {
+        rules->output[state] = rules->output[fail[state]];
+    }
+
+    for (c = 0; c < (int32_t)ncl; c++) {
+      next = rules->delta[(size_t)state * ncl + (size_t)c];
+      if (next == -1) {
+          rules->delta[(size_t)state * ncl + (size_t)c] =
+              rules->delta[(size_t)fail[state] * ncl + (size_t)c];
+      } else {
+          fail[next] = rules->delta[(size_t)fail[state] * ncl + (size_t)c];
+          queue[tail++] = next;
+      }
+    }
+  }
+
+  free(fail);
+  free(queue);
+}
+
+
+/**
+ * Load and compile rules.
+ *
+ * Each line of rules file looks like \c "category|substring" or \c
+ * "category|~regex". Empty lines and lines which start with '#' are
+ * skipped. Substrings and extended regular expressions are matched
+ * without regard to case. When several rules match comment, the first
+ * of them wins. If error occurs then function will quit from program
+ * with failure exit code.
+ *
+ * @param rules rules (output)
+ * @param filename name of rules file
+ **/
+void
+rules_load(struct rules *rules, const char *filename)
+{
+  FILE   *fp;
+  char   *line = NULL;
+  size_t  line_size = 0;
+  ssize_t len;
+  unsigned long lineno;
+  struct rule_substr *substr = NULL;
+  size_t  nsubstr = 0;
+  char   *sep, *pattern, *p;
+  int     ret;
+  char    errbuf[256];
+  size_t  i;
+
+  assert(rules != NULL);
+  assert(filename != NULL);
+
+  memset(rules, 0, sizeof(*rules));
+
+  fp = fopen(filename, "r");
+  if (fp == NULL) {
+      fprintf(stderr, "%s: %s\n", _("Failed to open file"), filename);
+      perror("fopen");
+      exit(EXIT_FAILURE);
+  }
+
+  for (lineno = 1; (len = getline(&line, &line_size, fp)) != -1; lineno++) {
+    if (len > 0 && line[len - 1] == '\n') {
+        line[--len] = '\0';
+    }
+    if (len == 0 || line[0] == '#') {
+        continue;
+    }
+
+    sep = strchr(line, '|');
+    if (sep == NULL || sep == line) {
+        rules_error(filename, lineno, _("Rule should look like category|pattern"));
+    }
+    for (p = line; p < sep; p++) {
+      if (!isdigit((unsigned char)*p)) {
+          rules_error(filename, lineno, _("Category should consist of digitals only!"));
+      }
+    }
+    if (strtoull(line, NULL, 10) > CATEGORY_MAX) {
+        rules_error(filename, lineno, _("Category is too large!"));
+    }
+    pattern = sep + 1;
+    if (*pattern == '\0' || (pattern[0] == '~' && pattern[1] == '\0')) {
+        rules_error(filename, lineno, _("Empty pattern"));
+    }
+
+    rules->categories = xrealloc(rules->categories,
+                                 (rules->nrules + 1) * sizeof(unsigned long));
+    rules->categories[rules->nrules] = strtoul(line, NULL, 10);
+
+    if (pattern[0] == '~') {
+        rules->regexes = xrealloc(rules->regexes,
+                                  (rules->nregexes + 1) * sizeof(struct rule_regex));
+        rules->regexes[rules->nregexes].index = (int32_t)rules->nrules;
+        ret = regcomp(&rules->regexes[rules->nregexes].re, pattern + 1,
+                      REG_EXTENDED | REG_ICASE | REG_NOSUB);
+        if (ret != 0) {
+            regerror(ret, &rules->regexes[rules->nregexes].re, errbuf, sizeof(errbuf));
+            rules_error(filename, lineno, errbuf);
+        }
+        rules->nregexes++;
+    } else {
+        substr = xrealloc(substr, (nsubstr + 1) * sizeof(struct rule_substr));
+        substr[nsubstr].index = (int32_t)rules->nrules;
+        substr[nsubstr].text  = strdup(pattern);
+        if (substr[nsubstr].text == NULL) {
+            fprintf(stderr, "strdup: %s\n", _("cannot allocate memory"));
+            exit(EXIT_FAILURE);
+        }
+        for (p = substr[nsubstr].text; *p != '\0'; p++) {
+          *p = (char)tolower((unsigned char)*p);
+        }
+        nsubstr++;
+    }
+
+    rules->nrules++;
+  }
+
+  free(line);
+  if (fclose(fp) != 0) {
+      perror("fclose");
+  }
+
+  build_automaton(rules, substr, nsubstr);
+
+  for (i = 0; i < nsubstr; i++) {
+    free(substr[i].text);
+  }
+  free(substr);
+}
+
+
+/**
+ * Find category for text.
+ *
+ * Function is thread-safe: rules are not modified.
+ *
+ * @param rules compiled rules
+ * @param text text (usually comment of record)
+ *
+ * @return category of first matched rule or -1 if no rules match
+ **/
+long
+rules_match(const struct rules *rules, const char *text)
+{
+  const unsigned char *p;
+  const int32_t *delta  = rules->delta;
+  const int32_t *output = rules->output;
+  size_t  ncl = rules->nclasses;
+  int32_t state, best;
+  size_t  i;
+
+  assert(rules != NULL);
+  assert(text != NULL);
+
+  best  = NO_RULE;
+  state = 0;
+  for (p = (const unsigned char *)text; *p != '\0'; p++) {
+    state = delta[(size_t)state * ncl + rules->classes[*p]];
+    if (output[state] < best) {
+        best = output[state];
+    }
+  }
+
+  /* regular expressions are sorted by priority */
+  for (i = 0; i < rules->nregexes && rules->regexes[i].index < best; i++) {
+    if (regexec(&rules->regexes[i].re, text, 0, NULL, 0) == 0) {
+        best = rules->regexes[i].index;
+        break;
+    }
+  }
+
+  if (best == NO_RULE) {
+      return -1;
+  }
+
+  return (long)rules->categories[best];
+}
+
+
+/**
+ * Free memory which was allocated for rules.
+ *
+ * @param rules rules
+ **/
+void
+rules_free(struct rules *rules)
+{
+  size_t i;
+
+  assert(rules != NULL);
+
+  for (i = 0; i < rules->nregexes; i++) {
+    regfree(&rules->regexes[i].re);
+  }
+  free(rules->regexes);
+  free(rules->delta);
+  free(rules->output);
+  free(rules->categories);
+  memset(rules, 0, sizeof(*rules));
+}
+
+
+
+/** Callback for \ref rewrite_datafile() which replaces category */
+static void
+recategorize_record(const struct record *rec, const char *line,
+                    struct outbuf *ob, void *data)
+{
+  struct recategorize *state = data;
+  const char *rest;
+  long category;
+
+  category = rules_match(state->rules, rec->comment);
+  if (category < 0 || (unsigned long)category == rec->category) {
+      outbuf_write(ob, line, strlen(line));
+      return;
+  }
+
+  /* "s|dd.mm.yyyy|" + new category + rest of string */
+  rest = strchr(line + 13, '|');
+  outbuf_write(ob, line, 13);
+  outbuf_uint(ob, (unsigned long long)category);
+  outbuf_write(ob, rest, strlen(rest));
+
+  state->changed++;
+}
+
+
+/**
+ * Assign categories to all records of data file by rules.
+ *
+ * Records which are not matched by any rule keep their categories.
+ *
+ * @param dbfile path to data file
+ * @param rules compiled rules
+ * @param verbose level of verbose
+ **/
+void
+recategorize_datafile(const char *dbfile, const struct rules *rules,
+                      unsigned int verbose)
+{
+  struct recategorize state;
+
+  assert(dbfile != NULL);
+  assert(rules != NULL);
+
+  state.rules   = rules;
+  state.changed = 0UL;
+
+  rewrite_datafile(dbfile, verbose, recategorize_record, &state);
+
+  if (verbose >= 1) {
+      printf(_("-> Changed %lu records\n"), state.changed);
+  }
+}
@@ -0,0 +1,77 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   rules.h contains prototypes for functions which assign categories by rules
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef RULES_H
+#define RULES_H
+
+/* for size_t type */
+#include <stddef.h>
+
+/* for int32_t type */
+#include <stdint.h>
+
+/* for regex_t type */
+#include <regex.h>
+
+
+/** Rule with regular expression */
+struct rule_regex {
+  int32_t index; /**< number of rule (priority) */
+  regex_t re;    /**< compiled expression */
+};
+
+/**
+ * Compiled rules for assigning categories by comments.
+ *
+ * All substring rules are compiled into one Aho-Corasick automaton
+ * which finds first (by order in file) matched rule in one pass over
+ * comment. Regular expressions are checked only when they have higher
+ * priority than matched substring rule.
+ **/
+struct rules {
+  unsigned char      classes[256]; /**< classes of bytes for automaton */
+  size_t             nclasses;     /**< count of classes */
+  int32_t           *delta;        /**< transitions: state * nclasses + class */
+  int32_t           *output;       /**< first rule matched in state */
+  size_t             nstates;      /**< count of states */
+  struct rule_regex *regexes;      /**< rules with regular expressions */
+  size_t             nregexes;     /**< count of regular expressions */
+  unsigned long     *categories;   /**< categories for all rules */
+  size_t             nrules;       /**< count of rules */
+};
+
+
+void rules_load(struct rules *rules, const char *filename);
+long rules_match(const struct rules *rules, const char *text);
+void rules_free(struct rules *rules);
+void recategorize_datafile(const char *dbfile, const struct rules *rules,
+                           unsigned int verbose);
+
+#endif /* RULES_H */
+
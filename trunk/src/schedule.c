@@ -0,0 +1,864 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   schedule.c contains functions which materialize recurring records
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for open()
+ *     fstat()
+ *     stat()
+ **/
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* for flock() */
+#include <sys/file.h>
+
+/* for open() and O_* constants */
+#include <fcntl.h>
+
+/* for read()
+ *     write()
+ *     fsync()
+ *     close()
+ *     unlink()
+ **/
+#include <unistd.h>
+
+/* for assert() */
+#include <assert.h>
+
+/* for printf()
+ *     fprintf()
+ *     sprintf()
+ *     fopen()
+ *     getline()
+ *     fclose()
+ *     perror()
+ *     rename()
+ *     FILE and NULL constants
+ **/
+#include <stdio.h>
+
+/* for realloc()
+ *     free()
+ *     strtoul()
+ *     qsort()
+ *     bsearch()
+ *     mkstemp()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memset()
+ *     memchr()
+ *     memcpy()
+ *     strchr()
+ *     strcmp()
+ *     strdup()
+ *     strlen()
+ *     strncmp()
+ **/
+#include <string.h>
+
+/* for LONG_MAX and LONG_MIN constants */
+#include <limits.h>
+
+/* for is_string_confirm_to_format()
+ *     is_valid_date()
+ *     date_to_days()
+ *     days_to_date()
+ *     get_side_file_path()
+ **/
+#include "common.h"
+
+/* for append_to_datafile() */
+#include "datafile.h"
+
+/* for checksum_format() and CHECKSUM_SUFFIX_LEN constant */
+#include "checksum.h"
+
+#include "schedule.h"
+
+
+/** Check that character is digit (without locale lookup) */
+#define IS_DIGIT(c) ((unsigned char)((c) - '0') < 10)
+
+/** Length of "s|dd.mm.yyyy" */
+#define SCHEDULE_HEAD_LEN 12
+
+/** Count of separators in key of definition */
+#define SCHEDULE_KEY_SEPS 3
+
+/** Next occurrence of recurring record in \ref schedule_materialize() */
+struct due {
+  long          day;   /**< number of day */
+  size_t        entry; /**< number of definition */
+  unsigned long k;     /**< number of occurrence */
+};
+
+/** Named periods */
+static const struct {
+  const char   *name; /**< name */
+  schedule_unit unit; /**< unit */
+  unsigned long step; /**< count of units */
+} periods[] = {
+  { "daily",     SCHEDULE_DAYS,   1  },
+  { "weekly",    SCHEDULE_DAYS,   7  },
+  { "monthly",   SCHEDULE_MONTHS, 1  },
+  { "quarterly", SCHEDULE_MONTHS, 3  },
+  { "yearly",    SCHEDULE_MONTHS, 12 }
+};
+
+
+/**
+ * Print error in definitions file and quit from program.
+ *
+ * @param filename name of file
+ * @param lineno number of line
+ * @param msg message
+ **/
+static void
+schedule_error(const char *filename, unsigned long lineno, const char *msg)
+{
+  fprintf(stderr, "%s:%lu: %s\n", filename, lineno, msg);
+  exit(EXIT_FAILURE);
+}
+
+
+/** Allocate memory or quit from program */
+static void *
+xrealloc(void *ptr, size_t size)
+{
+  ptr = realloc(ptr, size);
+  if (ptr == NULL) {
+      fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+  return ptr;
+}
+
+
+/**
+ * Parse period of recurring record.
+ *
+ * @param str period (not null-terminated)
+ * @param len length of period
+ * @param e definition (output)
+ *
+ * @retval 0 unknown period
+ * @retval 1 period was parsed
+ **/
+static int
+parse_period(const char *str, size_t len, struct schedule_entry *e)
+{
+  unsigned long step;
+  size_t i;
+
+  for (i = 0; i < sizeof(periods) / sizeof(periods[0]); i++) {
+    if (strlen(periods[i].name) == len &&
+        strncmp(periods[i].name, str, len) == 0) {
+        e->unit = periods[i].unit;
+        e->step = periods[i].step;
+        return 1;
+    }
+  }
+
+  /* number with unit: up to 4 digits */
+  if (len < 2 || len > 5) {
+      return 0;
+  }
+  for (i = 0, step = 0; i < len - 1; i++) {
+    if (!IS_DIGIT(str[i])) {
+        return 0;
+    }
+    step = step * 10 + (unsigned long)(str[i] - '0');
+  }
+  if (step == 0) {
+      return 0;
+  }
+
+  switch (str[len - 1]) {
+      case 'd': e->unit = SCHEDULE_DAYS;   e->step = step;      break;
+      case 'w': e->unit = SCHEDULE_DAYS;   e->step = step * 7;  break;
+      case 'm': e->unit = SCHEDULE_MONTHS; e->step = step;      break;
+      case 'y': e->unit = SCHEDULE_MONTHS; e->step = step * 12; break;
+      default:  return 0;
+  }
+
+  return 1;
+}
+
+
+/**
+ * Make keys of definitions for file with state.
+ *
+ * Key is a beginning of definition up to amount. Definitions with the
+ * same beginning are numbered in order of definitions file.
+ *
+ * @param sched definitions
+ **/
+static void
+make_keys(struct schedule *sched)
+{
+  struct schedule_entry *e;
+  const char *end;
+  size_t i, j, len;
+  unsigned long n;
+
+  for (i = 0; i < sched->count; i++) {
+    e = &sched->entries[i];
+    end = strchr(e->tail + 1, '|');
+    assert(end != NULL);
+    len = (size_t)(end - e->text);
+
+    n = 1;
+    for (j = 0; j < i; j++) {
+      if (strncmp(sched->entries[j].text, e->text, len + 1) == 0) {
+          n++;
+      }
+    }
+
+    e->key = xrealloc(NULL, len + 22);
+    memcpy(e->key, e->text, len);
+    if (n > 1) {
+        sprintf(e->key + len, "#%lu", n);
+    } else {
+        e->key[len] = '\0';
+    }
+  }
+}
+
+
+/**
+ * Load definitions of recurring records.
+ *
+ * Empty lines and lines which start with '#' are skipped. Record of
+ * each definition is checked like strings of data file, except that
+ * date of the first occurrence may be in future. On error function
+ * quits from program.
+ *
+ * @param sched definitions (output)
+ * @param filename name of file
+ **/
+void
+schedule_load(struct schedule *sched, const char *filename)
+{
+  struct schedule_entry *e;
+  FILE   *fp;
+  char   *line = NULL;
+  size_t  line_size = 0;
+  ssize_t len;
+  unsigned long lineno;
+  const char *rec;
+  const char *format_msg;
+  char   *check;
+
+  assert(sched != NULL);
+  assert(filename != NULL);
+
+  format_msg = _("Definition should look like "
+                 "period|s|dd.mm.yyyy|category|amount|comment");
+
+  memset(sched, 0, sizeof(*sched));
+
+  fp = fopen(filename, "r");
+  if (fp == NULL) {
+      fprintf(stderr, "%s: %s\n", _("Failed to open file"), filename);
+      perror("fopen");
+      exit(EXIT_FAILURE);
+  }
+
+  for (lineno = 1; (len = getline(&line, &line_size, fp)) != -1; lineno++) {
+    if (len > 0 && line[len - 1] == '\n') {
+        line[--len] = '\0';
+    }
+    if (len == 0 || line[0] == '#') {
+        continue;
+    }
+
+    sched->entries = xrealloc(sched->entries,
+                              (sched->count + 1) * sizeof(*sched->entries));
+    e = &sched->entries[sched->count];
+
+    rec = strchr(line, '|');
+    if (rec == NULL || !parse_period(line, (size_t)(rec - line), e)) {
+        schedule_error(filename, lineno, format_msg);
+    }
+    rec++;
+
+    if (strlen(rec) < SCHEDULE_HEAD_LEN + 1 ||
+        !IS_DIGIT(rec[2]) || !IS_DIGIT(rec[3]) || rec[4] != '.' ||
+        !IS_DIGIT(rec[5]) || !IS_DIGIT(rec[6]) || rec[7] != '.' ||
+        !IS_DIGIT(rec[8]) || !IS_DIGIT(rec[9]) ||
+        !IS_DIGIT(rec[10]) || !IS_DIGIT(rec[11])) {
+        schedule_error(filename, lineno, format_msg);
+    }
+    e->day   = (unsigned int)((rec[2] - '0') * 10 + (rec[3] - '0'));
+    e->month = (unsigned int)((rec[5] - '0') * 10 + (rec[6] - '0'));
+    e->year  = (unsigned int)((rec[8] - '0') * 1000 + (rec[9] - '0') * 100 +
+                              (rec[10] - '0') * 10 + (rec[11] - '0'));
+    if (!is_valid_date(e->year, e->month, e->day)) {
+        schedule_error(filename, lineno, _("Date should look like dd.mm.yyyy"));
+    }
+
+    /* first occurrence may be in future, so record is checked with
+     * date in past */
+    check = strdup(rec);
+    if (check == NULL) {
+        fprintf(stderr, "strdup: %s\n", _("cannot allocate memory"));
+        exit(EXIT_FAILURE);
+    }
+    memcpy(check + 2, "01.01.1970", 10);
+    if (!is_string_confirm_to_format(check, lineno)) {
+        schedule_error(filename, lineno, _("Wrong record"));
+    }
+    free(check);
+
+    e->text = strdup(line);
+    if (e->text == NULL) {
+        fprintf(stderr, "strdup: %s\n", _("cannot allocate memory"));
+        exit(EXIT_FAILURE);
+    }
+    e->tail  = e->text + (rec - line) + SCHEDULE_HEAD_LEN;
+    e->sign  = rec[0];
+    e->start = date_to_days(e->year, e->month, e->day);
+    e->done  = LONG_MIN;
+    sched->count++;
+  }
+
+  make_keys(sched);
+
+  free(line);
+  if (fclose(fp) != 0) {
+      perror("fclose");
+  }
+}
+
+
+/**
+ * Free definitions of recurring records.
+ *
+ * @param sched definitions
+ **/
+void
+schedule_free(struct schedule *sched)
+{
+  size_t i;
+
+  assert(sched != NULL);
+
+  for (i = 0; i < sched->count; i++) {
+    free(sched->entries[i].text);
+    free(sched->entries[i].key);
+  }
+  free(sched->entries);
+  memset(sched, 0, sizeof(*sched));
+}
+
+
+/**
+ * Get day of occurrence of recurring record.
+ *
+ * Monthly records which start at the end of month stay at the end of
+ * shorter months (31.01, 28.02, 31.03, ...).
+ *
+ * @param e definition
+ * @param k number of occurrence (0 for the first one)
+ *
+ * @return number of day or LONG_MAX when year is too big
+ **/
+static long
+occurrence(const struct schedule_entry *e, unsigned long k)
+{
+  unsigned long months;
+  unsigned int year, month, day;
+
+  if (e->unit == SCHEDULE_DAYS) {
+      if (k > (unsigned long)(10000L * 366) / e->step) {
+          return LONG_MAX;
+      }
+      return e->start + (long)(k * e->step);
+  }
+
+  if (k > 10000UL * 12 / e->step) {
+      return LONG_MAX;
+  }
+  months = (unsigned long)e->year * 12 + e->month - 1 + k * e->step;
+  year   = (unsigned int)(months / 12);
+  month  = (unsigned int)(months % 12) + 1;
+  if (year > 9999) {
+      return LONG_MAX;
+  }
+  for (day = e->day; !is_valid_date(year, month, day); day--)
+    ;
+
+  return date_to_days(year, month, day);
+}
+
+
+/**
+ * Get number of the first occurrence which was not materialized.
+ *
+ * @param e definition
+ *
+ * @return number of occurrence
+ **/
+static unsigned long
+first_due(const struct schedule_entry *e)
+{
+  unsigned int year, month, day;
+  unsigned long k;
+
+  if (e->done < e->start) {
+      return 0;
+  }
+
+  if (e->unit == SCHEDULE_DAYS) {
+      return (unsigned long)(e->done - e->start) / e->step + 1;
+  }
+
+  /* estimate by months, then step over occurrences at done day */
+  days_to_date(e->done, &year, &month, &day);
+  k = ((unsigned long)year * 12 + month -
+       ((unsigned long)e->year * 12 + e->month)) / e->step;
+  k = (k > 0) ? k - 1 : 0;
+  while (occurrence(e, k) <= e->done) {
+    k++;
+  }
+
+  return k;
+}
+
+
+/** Order of \ref due: by day, then by order of definitions */
+static int
+due_less(const struct due *a, const struct due *b)
+{
+  return a->day < b->day || (a->day == b->day && a->entry < b->entry);
+}
+
+
+/**
+ * Restore order of heap after change of the first element.
+ *
+ * @param heap binary heap
+ * @param n count of elements
+ **/
+static void
+sift_down(struct due *heap, size_t n)
+{
+  struct due tmp;
+  size_t i, child;
+
+  for (i = 0; (child = 2 * i + 1) < n; i = child) {
+    if (child + 1 < n && due_less(&heap[child + 1], &heap[child])) {
+        child++;
+    }
+    if (!due_less(&heap[child], &heap[i])) {
+        break;
+    }
+    tmp = heap[i];
+    heap[i] = heap[child];
+    heap[child] = tmp;
+  }
+}
+
+
+/**
+ * Restore order of heap after addition of the last element.
+ *
+ * @param heap binary heap
+ * @param n count of elements
+ **/
+static void
+sift_up(struct due *heap, size_t n)
+{
+  struct due tmp;
+  size_t i, parent;
+
+  for (i = n - 1; i > 0; i = parent) {
+    parent = (i - 1) / 2;
+    if (!due_less(&heap[i], &heap[parent])) {
+        break;
+    }
+    tmp = heap[i];
+    heap[i] = heap[parent];
+    heap[parent] = tmp;
+  }
+}
+
+
+/** Order of definitions by key for bsearch() */
+static int
+compare_keys(const void *a, const void *b)
+{
+  return strcmp((*(const struct schedule_entry *const *)a)->key,
+                (*(const struct schedule_entry *const *)b)->key);
+}
+
+
+/**
+ * Find definition by line of state.
+ *
+ * State which was written before keys were introduced contains whole
+ * definition, so such line is looked up by text of definition.
+ *
+ * @param def definition part of line of state
+ * @param sorted definitions ordered by key
+ * @param count count of definitions
+ *
+ * @return definition or NULL
+ **/
+static struct schedule_entry *
+find_state_entry(char *def, struct schedule_entry **sorted, size_t count)
+{
+  struct schedule_entry key, *keyp, **found;
+  const char *p;
+  size_t i;
+  int seps;
+
+  for (p = def, seps = 0; *p != '\0' && seps <= SCHEDULE_KEY_SEPS; p++) {
+    if (*p == '|') {
+        seps++;
+    }
+  }
+
+  if (seps > SCHEDULE_KEY_SEPS) {
+      for (i = 0; i < count; i++) {
+        if (strcmp(sorted[i]->text, def) == 0) {
+            return sorted[i];
+        }
+      }
+      return NULL;
+  }
+
+  key.key = def;
+  keyp = &key;
+  found = bsearch(&keyp, sorted, count, sizeof(*sorted), compare_keys);
+
+  return (found != NULL) ? *found : NULL;
+}
+
+
+/**
+ * Read state of recurring records.
+ *
+ * Each line of state looks like <tt>dd.mm.yyyy|key</tt>, where date is
+ * the last day which was materialized for definition with this key
+ * (see \ref schedule_entry). Lines of definitions which are absent in
+ * \p sched are returned as is.
+ *
+ * @param fd file descriptor of state
+ * @param path path to state (for messages)
+ * @param sched definitions
+ * @param other_len length of unknown lines (output)
+ *
+ * @return unknown lines (should be freed)
+ **/
+static char *
+read_state(int fd, const char *path, struct schedule *sched, size_t *other_len)
+{
+  struct schedule_entry **sorted, *found;
+  struct stat st;
+  char *data, *line, *nl, *other;
+  size_t size, pos, len;
+  unsigned int year, month, day;
+  ssize_t n;
+
+  if (fstat(fd, &st) == -1) {
+      perror("fstat");
+      exit(EXIT_FAILURE);
+  }
+  size = (size_t)st.st_size;
+
+  data  = xrealloc(NULL, size + 1);
+  other = xrealloc(NULL, size + 1);
+  for (pos = 0; pos < size; pos += (size_t)n) {
+    n = read(fd, data + pos, size - pos);
+    if (n <= 0) {
+        fprintf(stderr, "%s: %s\n", _("Failed to open file"), path);
+        perror("read");
+        exit(EXIT_FAILURE);
+    }
+  }
+  data[size] = '\0';
+
+  sorted = xrealloc(NULL, (sched->count + 1) * sizeof(*sorted));
+  for (pos = 0; pos < sched->count; pos++) {
+    sorted[pos] = &sched->entries[pos];
+  }
+  qsort(sorted, sched->count, sizeof(*sorted), compare_keys);
+
+  *other_len = 0;
+  for (line = data; line < data + size; line = nl + 1) {
+    nl = memchr(line, '\n', (size_t)(data + size - line));
+    if (nl == NULL) {
+        nl = data + size;
+    }
+    *nl = '\0';
+    len = (size_t)(nl - line);
+
+    found = NULL;
+    if (len > 11 && line[10] == '|' &&
+        sscanf(line, "%2u.%2u.%4u", &day, &month, &year) == 3 &&
+        is_valid_date(year, month, day)) {
+        found = find_state_entry(line + 11, sorted, sched->count);
+    }
+
+    if (found != NULL) {
+        found->done = date_to_days(year, month, day);
+    } else if (len > 0) {
+        memcpy(other + *other_len, line, len);
+        other[*other_len + len] = '\n';
+        *other_len += len + 1;
+    }
+  }
+
+  free(sorted);
+  free(data);
+
+  return other;
+}
+
+
+/**
+ * Write state of recurring records.
+ *
+ * State is written to temporary file, which replaces old state by
+ * rename() after fsync(), so old state stays untouched if program
+ * crashes while state is written. State is written after records were
+ * appended to data file: if program crashes between those steps, then
+ * next run appends the same occurrences again, so crash may duplicate
+ * records, but never loses them.
+ *
+ * @param path path to state
+ * @param sched definitions
+ * @param other lines of unknown definitions
+ * @param other_len length of unknown lines
+ **/
+static void
+write_state(const char *path, const struct schedule *sched,
+            const char *other, size_t other_len)
+{
+  unsigned int year, month, day;
+  char  *out, *tmppath;
+  size_t i, len, size;
+  ssize_t n;
+  int tmpfd;
+
+  size = other_len + 1;
+  for (i = 0; i < sched->count; i++) {
+    size += 12 + strlen(sched->entries[i].key);
+  }
+  out = xrealloc(NULL, size);
+
+  memcpy(out, other, other_len);
+  len = other_len;
+  for (i = 0; i < sched->count; i++) {
+    if (sched->entries[i].done == LONG_MIN) {
+        continue;
+    }
+    days_to_date(sched->entries[i].done, &year, &month, &day);
+    len += (size_t)sprintf(out + len, "%02u.%02u.%04u|%s\n",
+                           day, month, year, sched->entries[i].key);
+  }
+
+  tmppath = get_side_file_path(path, ".XXXXXX");
+  if (tmppath == NULL) {
+      exit(EXIT_FAILURE);
+  }
+  tmpfd = mkstemp(tmppath);
+  if (tmpfd == -1) {
+      fprintf(stderr, "%s: %s\n", _("Failed to open file"), tmppath);
+      perror("mkstemp");
+      exit(EXIT_FAILURE);
+  }
+
+  for (i = 0; i < len; i += (size_t)n) {
+    n = write(tmpfd, out + i, len - i);
+    if (n <= 0) {
+        fprintf(stderr, "%s: %s\n", _("Failed to open file"), tmppath);
+        perror("write");
+        unlink(tmppath);
+        exit(EXIT_FAILURE);
+    }
+  }
+  if (fsync(tmpfd) == -1 || close(tmpfd) == -1) {
+      perror("fsync");
+      unlink(tmppath);
+      exit(EXIT_FAILURE);
+  }
+
+  if (rename(tmppath, path) == -1) {
+      perror("rename");
+      unlink(tmppath);
+      exit(EXIT_FAILURE);
+  }
+
+  free(tmppath);
+  free(out);
+}
+
+
+/**
+ * Append all due occurrences of recurring records to data file.
+ *
+ * Occurrences after the last materialized day of each definition (see
+ * \ref SCHEDULE_SUFFIX file) and up to \p until are taken from priority
+ * queue ordered by day, so records are appended in order of dates with
+ * one call of \ref append_to_datafile(). File with state is locked
+ * during whole operation, so concurrent runs don't duplicate records.
+ *
+ * @param dbfile path to data file
+ * @param sched definitions
+ * @param until last day for occurrences (see \ref date_to_days())
+ * @param checksum nonzero to add checksums to records
+ * @param verbose level of verbose
+ *
+ * @return count of appended records
+ **/
+unsigned long
+schedule_materialize(const char *dbfile, struct schedule *sched, long until,
+                     int checksum, unsigned int verbose)
+{
+  const struct schedule_entry *e;
+  struct stat st, path_st;
+  struct due *heap;
+  char  *path, *other, *out;
+  size_t n, i, len, size, need, other_len;
+  unsigned int year, month, day;
+  unsigned long records;
+  int fd;
+
+  assert(dbfile != NULL);
+  assert(sched != NULL);
+
+  path = get_side_file_path(dbfile, SCHEDULE_SUFFIX);
+  if (path == NULL) {
+      exit(EXIT_FAILURE);
+  }
+
+  /* state is replaced by rename(), so lock is valid only if locked
+   * file is still at its path */
+  for (;;) {
+    fd = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        fprintf(stderr, "%s: %s\n", _("Failed to open file"), path);
+        perror("open");
+        exit(EXIT_FAILURE);
+    }
+    if (flock(fd, LOCK_EX) == -1) {
+        fprintf(stderr, "flock: %s\n", _("cannot lock file for writing"));
+        perror("flock");
+        exit(EXIT_FAILURE);
+    }
+    if (fstat(fd, &st) == -1) {
+        perror("fstat");
+        exit(EXIT_FAILURE);
+    }
+    if (stat(path, &path_st) == 0 &&
+        path_st.st_dev == st.st_dev && path_st.st_ino == st.st_ino) {
+        break;
+    }
+    close(fd);
+  }
+
+  other = read_state(fd, path, sched, &other_len);
+
+  /* the first due occurrence of each definition */
+  heap = xrealloc(NULL, (sched->count + 1) * sizeof(*heap));
+  n = 0;
+  for (i = 0; i < sched->count; i++) {
+    heap[n].entry = i;
+    heap[n].k     = first_due(&sched->entries[i]);
+    heap[n].day   = occurrence(&sched->entries[i], heap[n].k);
+    if (heap[n].day <= until) {
+        n++;
+        sift_up(heap, n);
+    }
+  }
+
+  out = NULL;
+  len = size = 0;
+  records = 0UL;
+  while (n > 0) {
+    e = &sched->entries[heap[0].entry];
+
+    /* "s|dd.mm.yyyy" + tail + checksum + "\n" */
+    need = SCHEDULE_HEAD_LEN + strlen(e->tail) + CHECKSUM_SUFFIX_LEN + 2;
+    if (size - len < need) {
+        size = (size == 0) ? 4096 : size * 2;
+        if (size - len < need) {
+            size = len + need;
+        }
+        out = xrealloc(out, size);
+    }
+
+    days_to_date(heap[0].day, &year, &month, &day);
+    i = (size_t)sprintf(out + len, "%c|%02u.%02u.%04u%s",
+                        e->sign, day, month, year, e->tail);
+    if (checksum) {
+        checksum_format(out + len + i, out + len, i);
+        i += CHECKSUM_SUFFIX_LEN;
+    }
+    out[len + i] = '\n';
+    len += i + 1;
+    records++;
+
+    /* next occurrence replaces this one */
+    heap[0].k++;
+    heap[0].day = occurrence(e, heap[0].k);
+    if (heap[0].day > until) {
+        heap[0] = heap[--n];
+    }
+    sift_down(heap, n);
+  }
+
+  if (len > 0) {
+      append_to_datafile(dbfile, out, len, verbose);
+  }
+
+  for (i = 0; i < sched->count; i++) {
+    if (sched->entries[i].done < until) {
+        sched->entries[i].done = until;
+    }
+  }
+  write_state(path, sched, other, other_len);
+
+  /* closing of old state drops lock */
+  if (close(fd) == -1) {
+      perror("close");
+  }
+
+  free(heap);
+  free(out);
+  free(other);
+  free(path);
+
+  return records;
+}
@@ -0,0 +1,86 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   schedule.h contains prototypes for functions which materialize recurring records
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+/* for size_t type */
+#include <stddef.h>
+
+
+/** Suffix of file with state of recurring records */
+#define SCHEDULE_SUFFIX ".sched"
+
+/** Units of period */
+typedef enum {
+  SCHEDULE_DAYS,  /**< period is a count of days */
+  SCHEDULE_MONTHS /**< period is a count of months */
+} schedule_unit;
+
+/**
+ * Recurring record.
+ *
+ * Definition looks like <tt>period|s|dd.mm.yyyy|category|amount|comment</tt>,
+ * where rest after period is a record of data file with date of the
+ * first occurrence. Period is one of \c daily, \c weekly, \c monthly,
+ * \c quarterly, \c yearly or a number with unit \c d, \c w, \c m or \c y
+ * (like \c 2w).
+ *
+ * State of definition is kept by key <tt>period|s|dd.mm.yyyy|category</tt>,
+ * so change of amount or comment doesn't materialize the past again.
+ * Second and next definitions with the same key get suffix \c "#n".
+ **/
+struct schedule_entry {
+  char         *text;  /**< definition */
+  char         *key;   /**< key in file with state */
+  const char   *tail;  /**< "|category|amount|comment" inside text */
+  char          sign;  /**< '+' or '-' */
+  unsigned int  year;  /**< year of first occurrence */
+  unsigned int  month; /**< month of first occurrence */
+  unsigned int  day;   /**< day of first occurrence */
+  long          start; /**< number of day of first occurrence */
+  schedule_unit unit;  /**< unit of period */
+  unsigned long step;  /**< count of units in period */
+  long          done;  /**< last day which was materialized */
+};
+
+/** Recurring records from definitions file */
+struct schedule {
+  struct schedule_entry *entries; /**< definitions */
+  size_t                 count;   /**< count of definitions */
+};
+
+
+void schedule_load(struct schedule *sched, const char *filename);
+void schedule_free(struct schedule *sched);
+unsigned long schedule_materialize(const char *dbfile, struct schedule *sched,
+                                   long until, int checksum,
+                                   unsigned int verbose);
+
+#endif /* SCHEDULE_H */
@@ -0,0 +1,958 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   snapshot.c contains functions which share decoded records between processes
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for stat()
+ *     fstat()
+ *     ino_t and dev_t types
+ **/
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* for shm_open()
+ *     shm_unlink()
+ *     mmap()
+ *     munmap()
+ **/
+#include <sys/mman.h>
+
+/* for flock() */
+#include <sys/file.h>
+
+/* for assert() */
+#include <assert.h>
+
+/* for errno variable */
+#include <errno.h>
+
+/* for O_* constants */
+#include <fcntl.h>
+
+/* for sched_yield() */
+#include <sched.h>
+
+/* for ftruncate()
+ *     geteuid()
+ *     close()
+ **/
+#include <unistd.h>
+
+/* for printf()
+ *     fprintf()
+ *     snprintf()
+ *     perror()
+ **/
+#include <stdio.h>
+
+/* for malloc()
+ *     realloc()
+ *     free()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memcmp()
+ *     memcpy()
+ *     memset()
+ *     strlen()
+ **/
+#include <string.h>
+
+#include "snapshot.h"
+#include "common.h"
+
+
+/** Magic string at start of control object */
+#define SNAPSHOT_CONTROL_MAGIC "OFMC"
+
+/** Magic string at start of data object */
+#define SNAPSHOT_MAGIC "OFMS"
+
+/** Current version of format of both objects */
+#define SNAPSHOT_VERSION 2
+
+/** Attempts to read control object while writer changes him */
+#define SNAPSHOT_TRIES 1000
+
+/** Maximal length of names of shared memory objects */
+#define SNAPSHOT_NAME_SIZE 96
+
+/** Round size up to multiple of 8, so each column is aligned */
+#define ALIGN8(n) (((n) + 7) & ~(size_t)7)
+
+
+/** Offsets of columns in data object. */
+struct snapshot_layout {
+  size_t amount;   /**< int64_t amounts in hundredths */
+  size_t negative; /**< int64_t -1 for costs and 0 for profits */
+  size_t category; /**< uint64_t numbers of categories */
+  size_t offset;   /**< int64_t offsets of strings in data file */
+  size_t comment;  /**< uint64_t offsets of comments in heap */
+  size_t currency; /**< uint32_t currencies or 0 */
+  size_t year;     /**< uint16_t years */
+  size_t month;    /**< uint8_t months */
+  size_t day;      /**< uint8_t days of month */
+  size_t heap;     /**< null-terminated comments */
+  size_t size;     /**< size of whole object */
+};
+
+/** Columns which are collected while data file is read. */
+struct snapshot_builder {
+  int64_t  *amount;   /**< amounts */
+  int64_t  *negative; /**< signs as masks */
+  uint64_t *category; /**< categories */
+  int64_t  *offset;   /**< offsets of strings */
+  uint64_t *comment;  /**< offsets of comments in heap */
+  uint32_t *currency; /**< currencies */
+  uint16_t *year;     /**< years */
+  uint8_t  *month;    /**< months */
+  uint8_t  *day;      /**< days */
+  size_t    count;    /**< count of records */
+  size_t    alloc;    /**< count of allocated records */
+  char     *heap;     /**< comments */
+  size_t    heaplen;  /**< size of comments */
+  size_t    heapsize; /**< size of allocated memory for comments */
+  int64_t   profit;   /**< sum of profits */
+  int64_t   costs;    /**< sum of costs */
+  uint64_t  currencies; /**< count of records with currency codes */
+};
+
+
+/**
+ * Compute offsets of columns in data object.
+ *
+ * @param count count of records
+ * @param heapsize size of comments
+ * @param l offsets (output)
+ *
+ * @retval 0 object would be too big
+ * @retval 1 offsets were computed
+ **/
+static int
+snapshot_layout(uint64_t count, uint64_t heapsize, struct snapshot_layout *l)
+{
+  size_t pos;
+
+  /* columns take less than 64 bytes for each record */
+  if (count > ((size_t)-1 - heapsize) / 64) {
+      return 0;
+  }
+
+  pos = ALIGN8(sizeof(struct snapshot_header));
+  l->amount   = pos;  pos += (size_t)count * sizeof(int64_t);
+  l->negative = pos;  pos += (size_t)count * sizeof(int64_t);
+  l->category = pos;  pos += (size_t)count * sizeof(uint64_t);
+  l->offset   = pos;  pos += (size_t)count * sizeof(int64_t);
+  l->comment  = pos;  pos += (size_t)count * sizeof(uint64_t);
+  l->currency = pos;  pos = ALIGN8(pos + (size_t)count * sizeof(uint32_t));
+  l->year     = pos;  pos = ALIGN8(pos + (size_t)count * sizeof(uint16_t));
+  l->month    = pos;  pos = ALIGN8(pos + (size_t)count);
+  l->day      = pos;  pos = ALIGN8(pos + (size_t)count);
+  l->heap     = pos;
+  l->size     = pos + (size_t)heapsize;
+
+  return 1;
+}
+
+
+/**
+ * Make name of shared memory object for data file.
+ *
+ * Names contain user, device and inode of data file, so different
+ * paths to one file share one snapshot.
+ *
+ * @param name buffer for name of \ref SNAPSHOT_NAME_SIZE bytes
+ * @param st statistics about data file
+ * @param generation number of data object or 0 for control object
+ **/
+static void
+snapshot_name(char *name, const struct stat *st, uint64_t generation)
+{
+  int len;
+
+  len = snprintf(name, SNAPSHOT_NAME_SIZE, "%s.%lu.%lu.%lu", SNAPSHOT_PREFIX,
+                 (unsigned long)geteuid(), (unsigned long)st->st_dev,
+                 (unsigned long)st->st_ino);
+  if (generation != 0) {
+      snprintf(name + len, SNAPSHOT_NAME_SIZE - (size_t)len, ".%lu",
+               (unsigned long)generation);
+  }
+}
+
+
+/**
+ * Check that shared memory object can be trusted.
+ *
+ * Object should belong to current user and nobody else may write to
+ * him, otherwise other user could substitute records.
+ *
+ * @param fd descriptor of object
+ * @param size size of object (output)
+ *
+ * @retval 0 object is foreign
+ * @retval 1 object is ours
+ **/
+static int
+snapshot_trusted(int fd, size_t *size)
+{
+  struct stat st;
+
+  if (fstat(fd, &st) == -1 ||
+      st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+      return 0;
+  }
+
+  *size = (size_t)st.st_size;
+
+  return 1;
+}
+
+
+/**
+ * Copy fields of control object which are protected by seqlock.
+ *
+ * @param ctl control object
+ * @param copy copy of fields (output)
+ *
+ * @retval 0 writer didn't finish in time
+ * @retval 1 copy is consistent
+ **/
+static int
+snapshot_read_control(const struct snapshot_control *ctl,
+                      struct snapshot_control *copy)
+{
+  uint32_t seq;
+  int      tries;
+
+  for (tries = 0; tries < SNAPSHOT_TRIES; tries++) {
+    seq = __atomic_load_n(&ctl->seq, __ATOMIC_ACQUIRE);
+    if ((seq & 1) == 0) {
+        copy->generation = __atomic_load_n(&ctl->generation, __ATOMIC_RELAXED);
+        copy->dbsize     = __atomic_load_n(&ctl->dbsize, __ATOMIC_RELAXED);
+        copy->dbmtime    = __atomic_load_n(&ctl->dbmtime, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&ctl->seq, __ATOMIC_RELAXED) == seq) {
+            return 1;
+        }
+    }
+    sched_yield();
+  }
+
+  return 0;
+}
+
+
+/**
+ * Change fields of control object which are protected by seqlock.
+ *
+ * Caller should hold lock of control object, so there is only one
+ * writer. Odd counter which was left by crashed writer is fixed.
+ *
+ * @param ctl control object
+ * @param generation number of data object
+ * @param st statistics about data file or NULL
+ **/
+static void
+snapshot_write_control(struct snapshot_control *ctl, uint64_t generation,
+                       const struct stat *st)
+{
+  uint32_t seq;
+
+  seq = __atomic_load_n(&ctl->seq, __ATOMIC_RELAXED) | 1;
+  __atomic_store_n(&ctl->seq, seq, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  __atomic_store_n(&ctl->generation, generation, __ATOMIC_RELAXED);
+  __atomic_store_n(&ctl->dbsize,
+                   st != NULL ? (int64_t)st->st_size : 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&ctl->dbmtime,
+                   st != NULL ? (int64_t)st->st_mtime : 0, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&ctl->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Attach to data object which describes data file.
+ *
+ * @param snap snapshot (output)
+ * @param st statistics about data file
+ *
+ * @retval 0 there is no actual snapshot
+ * @retval 1 snapshot was attached
+ **/
+static int
+snapshot_attach(struct snapshot *snap, const struct stat *st)
+{
+  char name[SNAPSHOT_NAME_SIZE];
+  struct snapshot_control copy;
+  const struct snapshot_control *ctl;
+  const struct snapshot_header *hdr;
+  struct snapshot_layout layout;
+  size_t size;
+  void  *map;
+  int    fd, ok;
+
+  snapshot_name(name, st, 0);
+  fd = shm_open(name, O_RDONLY, 0);
+  if (fd == -1) {
+      return 0;
+  }
+
+  ok = 0;
+  if (snapshot_trusted(fd, &size) && size == sizeof(*ctl)) {
+      map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+      if (map != MAP_FAILED) {
+          ctl = map;
+          ok = memcmp(ctl->magic, SNAPSHOT_CONTROL_MAGIC, sizeof(ctl->magic)) == 0 &&
+               ctl->version == SNAPSHOT_VERSION &&
+               snapshot_read_control(ctl, &copy) &&
+               copy.generation != 0 &&
+               copy.dbsize  == (int64_t)st->st_size &&
+               copy.dbmtime == (int64_t)st->st_mtime;
+          munmap(map, size);
+      }
+  }
+  close(fd);
+
+  if (!ok) {
+      return 0;
+  }
+
+  /* object may be replaced by writer after we read control object,
+   * then file is read again */
+  snapshot_name(name, st, copy.generation);
+  fd = shm_open(name, O_RDONLY, 0);
+  if (fd == -1) {
+      return 0;
+  }
+
+  map = MAP_FAILED;
+  if (snapshot_trusted(fd, &size) && size >= sizeof(*hdr)) {
+      map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+      return 0;
+  }
+
+  hdr = map;
+  if (memcmp(hdr->magic, SNAPSHOT_MAGIC, sizeof(hdr->magic)) != 0 ||
+      hdr->version    != SNAPSHOT_VERSION ||
+      hdr->generation != copy.generation ||
+      hdr->dbsize     != copy.dbsize ||
+      hdr->dbmtime    != copy.dbmtime ||
+      !snapshot_layout(hdr->count, hdr->heapsize, &layout) ||
+      layout.size != size) {
+      munmap(map, size);
+      return 0;
+  }
+
+  snap->hdr  = hdr;
+  snap->map  = map;
+  snap->size = size;
+
+  return 1;
+}
+
+
+/**
+ * Reserve memory for records in builder.
+ *
+ * @param b builder
+ * @param count count of records which should fit
+ **/
+static void
+snapshot_reserve(struct snapshot_builder *b, size_t count)
+{
+  if (count <= b->alloc) {
+      return;
+  }
+
+  b->alloc = b->alloc == 0 ? BATCH_LINES : b->alloc;
+  while (b->alloc < count) {
+    b->alloc *= 2;
+  }
+
+  b->amount   = realloc(b->amount,   b->alloc * sizeof(*b->amount));
+  b->negative = realloc(b->negative, b->alloc * sizeof(*b->negative));
+  b->category = realloc(b->category, b->alloc * sizeof(*b->category));
+  b->offset   = realloc(b->offset,   b->alloc * sizeof(*b->offset));
+  b->comment  = realloc(b->comment,  b->alloc * sizeof(*b->comment));
+  b->currency = realloc(b->currency, b->alloc * sizeof(*b->currency));
+  b->year     = realloc(b->year,     b->alloc * sizeof(*b->year));
+  b->month    = realloc(b->month,    b->alloc * sizeof(*b->month));
+  b->day      = realloc(b->day,      b->alloc * sizeof(*b->day));
+  if (b->amount == NULL || b->negative == NULL || b->category == NULL ||
+      b->offset == NULL || b->comment == NULL || b->currency == NULL ||
+      b->year == NULL || b->month == NULL || b->day == NULL) {
+      fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+}
+
+
+/** Callback for \ref batch_scan() which copies columns to builder. */
+static void
+snapshot_build_batch(const struct record_batch *batch, void *data)
+{
+  struct snapshot_builder *b = data;
+  size_t i, len, n;
+
+  snapshot_reserve(b, b->count + batch->count);
+
+  n = b->count;
+  memcpy(b->amount + n, batch->amount, batch->count * sizeof(int64_t));
+  memcpy(b->negative + n, batch->negative, batch->count * sizeof(int64_t));
+  memcpy(b->currency + n, batch->currency, batch->count * sizeof(uint32_t));
+  memcpy(b->year + n, batch->year, batch->count * sizeof(uint16_t));
+  memcpy(b->month + n, batch->month, batch->count);
+  memcpy(b->day + n, batch->day, batch->count);
+
+  for (i = 0; i < batch->count; i++) {
+    b->category[n + i] = batch->category[i];
+    b->offset[n + i]   = batch->offset[i];
+    b->costs  += batch->amount[i] & batch->negative[i];
+    b->profit += batch->amount[i] & ~batch->negative[i];
+    b->currencies += (batch->currency[i] != 0);
+
+    len = strlen(batch->comment[i]) + 1;
+    if (b->heaplen + len > b->heapsize) {
+        b->heapsize = b->heapsize == 0 ? BATCH_LINES * 32 : b->heapsize;
+        while (b->heaplen + len > b->heapsize) {
+          b->heapsize *= 2;
+        }
+        b->heap = realloc(b->heap, b->heapsize);
+        if (b->heap == NULL) {
+            fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+            exit(EXIT_FAILURE);
+        }
+    }
+    b->comment[n + i] = b->heaplen;
+    memcpy(b->heap + b->heaplen, batch->comment[i], len);
+    b->heaplen += len;
+  }
+
+  b->count += batch->count;
+}
+
+
+/**
+ * Read data file and make image of data object in memory.
+ *
+ * If file can't be opened or too many wrong lines was found then
+ * function will quit from program with failure exit code, like \ref
+ * scan_datafile_batch().
+ *
+ * @param snap snapshot (output)
+ * @param dbfile path to data file
+ * @param verbose level of verbose
+ *
+ * @return count of wrong lines in data file
+ **/
+static unsigned long
+snapshot_build(struct snapshot *snap, const char *dbfile, unsigned int verbose)
+{
+  struct batch_scanner s;
+  struct snapshot_builder b;
+  struct snapshot_header *hdr;
+  struct snapshot_layout layout;
+  unsigned long record_count, fails;
+  batch_status status;
+  char *image;
+
+  memset(&b, 0, sizeof(b));
+
+  batch_scanner_init(&s, 1);
+  status = batch_scan(&s, dbfile, verbose, snapshot_build_batch, &b,
+                      &record_count);
+  fails = s.fails;
+  batch_scanner_free(&s);
+
+  switch (status) {
+      case BATCH_OPEN_FAILED:
+          fprintf(stderr, "%s: %s\n", _("Failed to open file"), dbfile);
+          errno = s.error;
+          perror("open");
+          exit(EXIT_FAILURE);
+      case BATCH_WRONG_LINES:
+          fprintf(stderr, _("Too many wrong lines in database. Exit.\n"));
+          exit(EXIT_FAILURE);
+      default:
+          break;
+  }
+
+  if (!snapshot_layout(b.count, b.heaplen, &layout) ||
+      (image = calloc(1, layout.size)) == NULL) {
+      fprintf(stderr, "calloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+
+  hdr = (struct snapshot_header *)image;
+  memcpy(hdr->magic, SNAPSHOT_MAGIC, sizeof(hdr->magic));
+  hdr->version  = SNAPSHOT_VERSION;
+  hdr->count    = b.count;
+  hdr->heapsize = b.heaplen;
+  hdr->profit   = b.profit;
+  hdr->costs    = b.costs;
+  hdr->currencies = b.currencies;
+
+  if (b.count > 0) {
+      memcpy(image + layout.amount,   b.amount,   b.count * sizeof(int64_t));
+      memcpy(image + layout.negative, b.negative, b.count * sizeof(int64_t));
+      memcpy(image + layout.category, b.category, b.count * sizeof(uint64_t));
+      memcpy(image + layout.offset,   b.offset,   b.count * sizeof(int64_t));
+      memcpy(image + layout.comment,  b.comment,  b.count * sizeof(uint64_t));
+      memcpy(image + layout.currency, b.currency, b.count * sizeof(uint32_t));
+      memcpy(image + layout.year,     b.year,     b.count * sizeof(uint16_t));
+      memcpy(image + layout.month,    b.month,    b.count);
+      memcpy(image + layout.day,      b.day,      b.count);
+      memcpy(image + layout.heap,     b.heap,     b.heaplen);
+  }
+
+  free(b.amount);
+  free(b.negative);
+  free(b.category);
+  free(b.offset);
+  free(b.comment);
+  free(b.currency);
+  free(b.year);
+  free(b.month);
+  free(b.day);
+  free(b.heap);
+
+  snap->hdr  = hdr;
+  snap->own  = image;
+  snap->size = layout.size;
+
+  return fails;
+}
+
+
+/**
+ * Create data object with copy of image.
+ *
+ * @param name name of object
+ * @param image image of data object
+ * @param size size of image
+ *
+ * @retval 0 object was not created
+ * @retval 1 object was created
+ **/
+static int
+snapshot_create(const char *name, const void *image, size_t size)
+{
+  void *map;
+  int   fd;
+
+  fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+  if (fd == -1 && errno == EEXIST) {
+      /* it was left by crashed writer */
+      shm_unlink(name);
+      fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+  }
+  if (fd == -1) {
+      perror("shm_open");
+      return 0;
+  }
+
+  if (ftruncate(fd, (off_t)size) == -1) {
+      perror("ftruncate");
+      close(fd);
+      shm_unlink(name);
+      return 0;
+  }
+
+  map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+      perror("mmap");
+      shm_unlink(name);
+      return 0;
+  }
+
+  memcpy(map, image, size);
+  munmap(map, size);
+
+  return 1;
+}
+
+
+/**
+ * Open and lock control object of data file.
+ *
+ * Object is created when it does not exist.
+ *
+ * @param st statistics about data file
+ * @param fd descriptor of object (output)
+ *
+ * @return mapped control object or NULL on failure
+ **/
+static struct snapshot_control *
+snapshot_lock_control(const struct stat *st, int *fd)
+{
+  char name[SNAPSHOT_NAME_SIZE];
+  struct snapshot_control *ctl;
+  size_t size;
+  void  *map;
+
+  snapshot_name(name, st, 0);
+  *fd = shm_open(name, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+  if (*fd == -1) {
+      perror("shm_open");
+      return NULL;
+  }
+
+  if (!snapshot_trusted(*fd, &size)) {
+      fprintf(stderr, "%s: %s\n", name, _("Foreign shared snapshot"));
+      close(*fd);
+      return NULL;
+  }
+
+  if (flock(*fd, LOCK_EX) == -1 ||
+      (size < sizeof(*ctl) && ftruncate(*fd, sizeof(*ctl)) == -1)) {
+      perror(name);
+      close(*fd);
+      return NULL;
+  }
+
+  map = mmap(NULL, sizeof(*ctl), PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+  if (map == MAP_FAILED) {
+      perror("mmap");
+      close(*fd);
+      return NULL;
+  }
+
+  ctl = map;
+  if (memcmp(ctl->magic, SNAPSHOT_CONTROL_MAGIC, sizeof(ctl->magic)) != 0 ||
+      ctl->version != SNAPSHOT_VERSION) {
+      /* new object, readers don't trust him until magic is written */
+      memset(ctl, 0, sizeof(*ctl));
+      ctl->version = SNAPSHOT_VERSION;
+      memcpy(ctl->magic, SNAPSHOT_CONTROL_MAGIC, sizeof(ctl->magic));
+  }
+
+  return ctl;
+}
+
+
+/**
+ * Publish built image as new data object of data file.
+ *
+ * New object is filled before it is announced in control object, and
+ * old object is only unlinked, so readers which attached to him keep
+ * their mapping. If publishing fails then snapshot still may be used by
+ * this process.
+ *
+ * @param snap snapshot with built image
+ * @param st statistics about data file before reading
+ * @param verbose level of verbose
+ **/
+static void
+snapshot_publish(struct snapshot *snap, const struct stat *st,
+                 unsigned int verbose)
+{
+  char name[SNAPSHOT_NAME_SIZE];
+  struct snapshot_control *ctl;
+  struct snapshot_header *hdr;
+  uint64_t old;
+  int fd;
+
+  if (verbose >= 2) {
+      printf("--> %s\n", _("Publishing shared snapshot"));
+  }
+
+  ctl = snapshot_lock_control(st, &fd);
+  if (ctl == NULL) {
+      return;
+  }
+
+  old = ctl->generation;
+  if (old == 0 ||
+      ctl->dbsize != (int64_t)st->st_size ||
+      ctl->dbmtime != (int64_t)st->st_mtime) {
+      /* other process didn't publish the same file while we read him */
+      hdr = snap->own;
+      hdr->generation = old + 1;
+      hdr->dbsize     = (int64_t)st->st_size;
+      hdr->dbmtime    = (int64_t)st->st_mtime;
+
+      snapshot_name(name, st, old + 1);
+      if (snapshot_create(name, snap->own, snap->size)) {
+          snapshot_write_control(ctl, old + 1, st);
+          if (old != 0) {
+              snapshot_name(name, st, old);
+              shm_unlink(name);
+          }
+      }
+  }
+
+  munmap(ctl, sizeof(*ctl));
+  close(fd);
+}
+
+
+/**
+ * Get decoded records of data file.
+ *
+ * When other process already published snapshot of data file with the
+ * same size and modification time, it is attached and file isn't read
+ * at all. Otherwise file is read with \ref batch_scan() and records are
+ * published in POSIX shared memory for later processes, if file has no
+ * wrong lines. If file can't be opened or too many wrong lines was
+ * found then function will quit from program with failure exit code.
+ *
+ * @param snap snapshot (output), free him with \ref snapshot_close()
+ * @param dbfile path to data file
+ * @param verbose level of verbose
+ **/
+void
+snapshot_open(struct snapshot *snap, const char *dbfile, unsigned int verbose)
+{
+  struct stat before, after;
+  unsigned long fails;
+  int known;
+
+  assert(snap != NULL);
+  assert(dbfile != NULL);
+
+  snap->hdr  = NULL;
+  snap->map  = NULL;
+  snap->own  = NULL;
+  snap->size = 0;
+
+  known = (stat(dbfile, &before) == 0);
+  if (known && snapshot_attach(snap, &before)) {
+      if (verbose >= 1) {
+          printf("-> %s\n", _("Using shared snapshot"));
+      }
+      return;
+  }
+
+  fails = snapshot_build(snap, dbfile, verbose);
+
+  /* file which was changed while it was read may not match his size */
+  if (known && fails == 0 && stat(dbfile, &after) == 0 &&
+      after.st_ino   == before.st_ino &&
+      after.st_size  == before.st_size &&
+      after.st_mtime == before.st_mtime) {
+      snapshot_publish(snap, &before, verbose);
+  }
+}
+
+
+/**
+ * Detach from snapshot or free built image.
+ *
+ * @param snap snapshot
+ **/
+void
+snapshot_close(struct snapshot *snap)
+{
+  assert(snap != NULL);
+
+  if (snap->map != NULL) {
+      munmap(snap->map, snap->size);
+  }
+  free(snap->own);
+
+  snap->hdr = NULL;
+  snap->map = NULL;
+  snap->own = NULL;
+}
+
+
+/**
+ * Pass records of snapshot to handler by batches.
+ *
+ * Batches look like batches of \ref batch_scan(), so the same handlers
+ * may be used for data file and for snapshot.
+ *
+ * @param snap snapshot
+ * @param handler function which will be called for each batch
+ * @param data pointer which will be passed to handler
+ **/
+void
+snapshot_scan(const struct snapshot *snap, batch_handler handler, void *data)
+{
+  struct snapshot_layout layout;
+  struct record_batch *batch;
+  const char *base;
+  const uint64_t *category, *comment;
+  size_t start, i, n;
+
+  assert(snap != NULL);
+  assert(snap->hdr != NULL);
+  assert(handler != NULL);
+
+  batch = malloc(sizeof(*batch));
+  if (batch == NULL) {
+      fprintf(stderr, "malloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+
+  base = (const char *)snap->hdr;
+  snapshot_layout(snap->hdr->count, snap->hdr->heapsize, &layout);
+  category = (const uint64_t *)(base + layout.category);
+  comment  = (const uint64_t *)(base + layout.comment);
+
+  for (start = 0; start < snap->hdr->count; start += n) {
+    n = (size_t)snap->hdr->count - start;
+    if (n > BATCH_LINES) {
+        n = BATCH_LINES;
+    }
+
+    memcpy(batch->amount, base + layout.amount + start * sizeof(int64_t),
+           n * sizeof(int64_t));
+    memcpy(batch->negative, base + layout.negative + start * sizeof(int64_t),
+           n * sizeof(int64_t));
+    memcpy(batch->offset, base + layout.offset + start * sizeof(int64_t),
+           n * sizeof(int64_t));
+    memcpy(batch->currency, base + layout.currency + start * sizeof(uint32_t),
+           n * sizeof(uint32_t));
+    memcpy(batch->year, base + layout.year + start * sizeof(uint16_t),
+           n * sizeof(uint16_t));
+    memcpy(batch->month, base + layout.month + start, n);
+    memcpy(batch->day, base + layout.day + start, n);
+    for (i = 0; i < n; i++) {
+      batch->category[i] = (unsigned long)category[start + i];
+      batch->comment[i]  = base + layout.heap + comment[start + i];
+    }
+
+    batch->count = n;
+    handler(batch, data);
+  }
+
+  free(batch);
+}
+
+
+/** State of \ref snapshot_scan_records(). */
+struct snapshot_records {
+  record_handler handler; /**< function for each record */
+  void          *data;    /**< pointer for handler */
+};
+
+/** Callback for \ref snapshot_scan() which passes records one by one. */
+static void
+snapshot_records_batch(const struct record_batch *batch, void *data)
+{
+  const struct snapshot_records *sr = data;
+  struct record rec;
+  size_t i;
+
+  for (i = 0; i < batch->count; i++) {
+    rec.sign     = batch->negative[i] ? '-' : '+';
+    rec.day      = batch->day[i];
+    rec.month    = batch->month[i];
+    rec.year     = batch->year[i];
+    rec.category = batch->category[i];
+    rec.amount   = batch->amount[i];
+    rec.currency = batch->currency[i];
+    rec.comment  = batch->comment[i];
+    rec.offset   = batch->offset[i];
+    sr->handler(&rec, sr->data);
+  }
+}
+
+
+/**
+ * Pass records of snapshot to handler one by one.
+ *
+ * Records are the same as records of \ref scan_datafile().
+ *
+ * @param snap snapshot
+ * @param handler function which will be called for each record
+ * @param data pointer which will be passed to handler
+ **/
+void
+snapshot_scan_records(const struct snapshot *snap, record_handler handler,
+                      void *data)
+{
+  struct snapshot_records sr;
+
+  assert(handler != NULL);
+
+  sr.handler = handler;
+  sr.data    = data;
+  snapshot_scan(snap, snapshot_records_batch, &sr);
+}
+
+
+/**
+ * Remove snapshot of data file from shared memory.
+ *
+ * Processes which are attached to snapshot keep using him.
+ *
+ * @param dbfile path to data file
+ *
+ * @retval 0 there was no snapshot
+ * @retval 1 snapshot was removed
+ **/
+int
+snapshot_remove(const char *dbfile)
+{
+  char name[SNAPSHOT_NAME_SIZE];
+  struct snapshot_control *ctl;
+  struct stat st;
+  int fd;
+
+  assert(dbfile != NULL);
+
+  if (stat(dbfile, &st) == -1) {
+      return 0;
+  }
+
+  /* don't create control object only to remove him */
+  snapshot_name(name, &st, 0);
+  fd = shm_open(name, O_RDONLY, 0);
+  if (fd == -1) {
+      return 0;
+  }
+  close(fd);
+
+  ctl = snapshot_lock_control(&st, &fd);
+  if (ctl == NULL) {
+      return 0;
+  }
+
+  if (ctl->generation != 0) {
+      snapshot_name(name, &st, ctl->generation);
+      shm_unlink(name);
+  }
+  snapshot_write_control(ctl, 0, NULL);
+
+  snapshot_name(name, &st, 0);
+  shm_unlink(name);
+
+  munmap(ctl, sizeof(*ctl));
+  close(fd);
+
+  return 1;
+}
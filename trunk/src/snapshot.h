@@ -0,0 +1,106 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   snapshot.h contains prototypes for functions which share decoded records between processes
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/* for size_t type */
+#include <stddef.h>
+
+/* for uint*_t and int64_t types */
+#include <stdint.h>
+
+/* for batch_handler type */
+#include "batch.h"
+
+/* for record_handler type */
+#include "datafile.h"
+
+
+/** Prefix of names of shared memory objects */
+#define SNAPSHOT_PREFIX "/openfm"
+
+/**
+ * Control object of snapshot.
+ *
+ * It has fixed size and is never removed by readers. Fields after \ref
+ * seq are protected by seqlock: writer makes \ref seq odd, changes
+ * fields and makes it even again, so reader which saw the same even
+ * value before and after reading has consistent copy.
+ **/
+struct snapshot_control {
+  char     magic[4];   /**< always "OFMC" */
+  uint32_t version;    /**< version of format */
+  uint32_t seq;        /**< sequence counter, odd while fields are changed */
+  uint32_t reserved;   /**< not used, always zero */
+  uint64_t generation; /**< number of current data object or 0 */
+  int64_t  dbsize;     /**< size of data file described by data object */
+  int64_t  dbmtime;    /**< modification time of that data file */
+};
+
+/**
+ * Header of data object.
+ *
+ * Data object is filled before it is announced in \ref
+ * snapshot_control and is never changed later, so readers don't need
+ * locks. After header go columns of records (see \ref
+ * snapshot_layout()) and null-terminated comments.
+ **/
+struct snapshot_header {
+  char     magic[4];   /**< always "OFMS" */
+  uint32_t version;    /**< version of format */
+  uint64_t generation; /**< number of data object */
+  int64_t  dbsize;     /**< size of data file */
+  int64_t  dbmtime;    /**< modification time of data file */
+  uint64_t count;      /**< count of records */
+  uint64_t heapsize;   /**< size of comments in bytes */
+  int64_t  profit;     /**< sum of profits in currencies of records */
+  int64_t  costs;      /**< sum of costs in currencies of records */
+  uint64_t currencies; /**< count of records with currency codes */
+};
+
+/** Decoded records of data file which are attached or built. */
+struct snapshot {
+  const struct snapshot_header *hdr; /**< header, columns follow him */
+  void                         *map; /**< mapped data object or NULL */
+  void                         *own; /**< built image or NULL */
+  size_t                        size; /**< size of data object or image */
+};
+
+
+void snapshot_open(struct snapshot *snap, const char *dbfile,
+                   unsigned int verbose);
+void snapshot_close(struct snapshot *snap);
+void snapshot_scan(const struct snapshot *snap, batch_handler handler,
+                   void *data);
+void snapshot_scan_records(const struct snapshot *snap,
+                           record_handler handler, void *data);
+int  snapshot_remove(const char *dbfile);
+
+#endif /* SNAPSHOT_H */
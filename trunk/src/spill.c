@@ -0,0 +1,613 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   spill.c contains functions which aggregate totals in bounded memory
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for pread() */
+#include <unistd.h>
+
+/* for assert() */
+#include <assert.h>
+
+/* for printf()
+ *     fprintf()
+ *     perror()
+ *     tmpfile()
+ *     fwrite()
+ *     fflush()
+ *     fileno()
+ *     fclose()
+ **/
+#include <stdio.h>
+
+/* for malloc()
+ *     realloc()
+ *     free()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memmove()
+ *     memset()
+ **/
+#include <string.h>
+
+#include "spill.h"
+
+
+/** Count of entries which are read at once from each run while merging */
+#define SPILL_BUFFER 256
+
+/** Make key of entry for aggregation by months */
+#define SPILL_MONTH_KEY(entry) \
+    (((uint64_t)(entry)->year << 40) | ((uint64_t)(entry)->month << 32) | \
+     (uint64_t)(entry)->category)
+
+
+/** Position in run while merging. */
+struct spill_cursor {
+  struct summary_entry *buf;    /**< entries which were read */
+  size_t                pos;    /**< current entry in buffer */
+  size_t                len;    /**< count of entries in buffer */
+  long long             offset; /**< offset of next entry in file */
+  size_t                left;   /**< count of entries which are not read */
+};
+
+/** Receiver of merged entries which writes them as new run. */
+struct spill_writer {
+  struct spill *sp;   /**< table which owns new runs */
+  FILE         *file; /**< file for new runs */
+  struct spill_run *run; /**< run which is written now */
+};
+
+
+/**
+ * Allocate memory or quit from program.
+ *
+ * @param ptr memory which was allocated before or NULL
+ * @param size new size of memory
+ *
+ * @return pointer to memory
+ **/
+static void *
+xrealloc(void *ptr, size_t size)
+{
+  ptr = realloc(ptr, size);
+  if (ptr == NULL) {
+      fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+
+  return ptr;
+}
+
+
+/**
+ * Initialize empty table.
+ *
+ * Memory limit covers table of entries and buffers for merging of
+ * runs. Limit is never less than memory for two runs.
+ *
+ * @param sp table
+ * @param key key of aggregation
+ * @param limit memory limit in bytes
+ * @param verbose level of verbose
+ **/
+void
+spill_init(struct spill *sp, spill_key key, size_t limit,
+           unsigned int verbose)
+{
+  assert(sp != NULL);
+
+  memset(sp, 0, sizeof(*sp));
+  sp->key      = key;
+  sp->verbose  = verbose;
+  sp->capacity = limit / sizeof(struct summary_entry);
+  if (sp->capacity < 2) {
+      sp->capacity = 2;
+  }
+  sp->fanin = limit / (SPILL_BUFFER * sizeof(struct summary_entry));
+  if (sp->fanin < 2) {
+      sp->fanin = 2;
+  }
+}
+
+
+/**
+ * Free memory and temporary file of table.
+ *
+ * @param sp table
+ **/
+void
+spill_free(struct spill *sp)
+{
+  assert(sp != NULL);
+
+  if (sp->file != NULL) {
+      fclose(sp->file);
+  }
+  free(sp->entries);
+  free(sp->runs);
+
+  sp->file    = NULL;
+  sp->entries = NULL;
+  sp->runs    = NULL;
+  sp->count   = sp->alloc = 0;
+  sp->nruns   = sp->runs_alloc = 0;
+  sp->size    = 0;
+}
+
+
+/**
+ * Get key of entry.
+ *
+ * @param sp table
+ * @param entry entry
+ *
+ * @return key for comparing entries
+ **/
+static uint64_t
+spill_key_of(const struct spill *sp, const struct summary_entry *entry)
+{
+  return (sp->key == SPILL_BY_MONTH) ? SPILL_MONTH_KEY(entry) : entry->category;
+}
+
+
+/**
+ * Add totals of one entry to another entry with the same key.
+ *
+ * @param sp table
+ * @param dst entry which will be changed
+ * @param src entry which is added
+ **/
+static void
+spill_combine(const struct spill *sp, struct summary_entry *dst,
+              const struct summary_entry *src)
+{
+  dst->profit += src->profit;
+  dst->costs  += src->costs;
+
+  if (sp->key == SPILL_BY_CATEGORY &&
+      (src->year < dst->year ||
+       (src->year == dst->year && src->month < dst->month))) {
+      dst->year  = src->year;
+      dst->month = src->month;
+  }
+}
+
+
+/**
+ * Create temporary file for runs.
+ *
+ * @return opened file
+ **/
+static FILE *
+spill_tmpfile(void)
+{
+  FILE *file;
+
+  file = tmpfile();
+  if (file == NULL) {
+      perror("tmpfile");
+      exit(EXIT_FAILURE);
+  }
+
+  return file;
+}
+
+
+/**
+ * Start new run at the end of temporary file.
+ *
+ * @param sp table
+ *
+ * @return new empty run
+ **/
+static struct spill_run *
+spill_new_run(struct spill *sp)
+{
+  struct spill_run *run;
+
+  if (sp->nruns == sp->runs_alloc) {
+      sp->runs_alloc = (sp->runs_alloc == 0) ? 16 : sp->runs_alloc * 2;
+      sp->runs = xrealloc(sp->runs, sp->runs_alloc * sizeof(*sp->runs));
+  }
+
+  run = &sp->runs[sp->nruns++];
+  run->offset = sp->size;
+  run->count  = 0;
+
+  return run;
+}
+
+
+/**
+ * Write entries to the end of file.
+ *
+ * @param file file
+ * @param entries entries
+ * @param n count of entries
+ **/
+static void
+spill_write(FILE *file, const struct summary_entry *entries, size_t n)
+{
+  if (n > 0 && fwrite(entries, sizeof(*entries), n, file) != n) {
+      perror("fwrite");
+      exit(EXIT_FAILURE);
+  }
+}
+
+
+/**
+ * Write table as sorted run to temporary file and empty table.
+ *
+ * @param sp table
+ **/
+static void
+spill_flush(struct spill *sp)
+{
+  struct spill_run *run;
+
+  if (sp->verbose >= 2) {
+      printf("--> %s (%lu)\n", _("Spilling totals to disk"),
+             (unsigned long)sp->count);
+  }
+
+  if (sp->file == NULL) {
+      sp->file = spill_tmpfile();
+  }
+
+  run = spill_new_run(sp);
+  run->count = sp->count;
+  spill_write(sp->file, sp->entries, sp->count);
+  sp->size += (long long)(sp->count * sizeof(struct summary_entry));
+
+  sp->count = 0;
+}
+
+
+/**
+ * Add entry to table.
+ *
+ * Function finds entry with the same key with binary search and
+ * creates new one if it does not exist. Full table is spilled to disk
+ * before new entry is created.
+ *
+ * @param sp table
+ * @param entry entry
+ **/
+void
+spill_add(struct spill *sp, const struct summary_entry *entry)
+{
+  struct summary_entry *cur;
+  uint64_t key;
+  size_t   low, high, mid;
+
+  assert(sp != NULL);
+  assert(entry != NULL);
+
+  key = spill_key_of(sp, entry);
+
+  /* search first entry which is not less than key */
+  low  = 0;
+  high = sp->count;
+  while (low < high) {
+    mid = low + (high - low) / 2;
+    if (spill_key_of(sp, &sp->entries[mid]) < key) {
+        low = mid + 1;
+    } else {
+        high = mid;
+    }
+  }
+
+  if (low < sp->count && spill_key_of(sp, &sp->entries[low]) == key) {
+      spill_combine(sp, &sp->entries[low], entry);
+      return;
+  }
+
+  if (sp->count == sp->capacity) {
+      spill_flush(sp);
+      low = 0;
+  }
+
+  if (sp->count == sp->alloc) {
+      sp->alloc = (sp->alloc == 0) ? 64 : sp->alloc * 2;
+      if (sp->alloc > sp->capacity) {
+          sp->alloc = sp->capacity;
+      }
+      sp->entries = xrealloc(sp->entries, sp->alloc * sizeof(*sp->entries));
+  }
+
+  cur = &sp->entries[low];
+  memmove(cur + 1, cur, (sp->count - low) * sizeof(*cur));
+  sp->count++;
+
+  *cur = *entry;
+}
+
+
+/**
+ * Add record to table.
+ *
+ * @param sp table
+ * @param rec record
+ **/
+void
+spill_add_record(struct spill *sp, const struct record *rec)
+{
+  struct summary_entry entry;
+
+  assert(rec != NULL);
+
+  memset(&entry, 0, sizeof(entry));
+  entry.year     = (uint16_t)rec->year;
+  entry.month    = (uint8_t)rec->month;
+  entry.category = (uint32_t)rec->category;
+  if (rec->sign == '-') {
+      entry.costs  = rec->amount;
+  } else {
+      entry.profit = rec->amount;
+  }
+
+  spill_add(sp, &entry);
+}
+
+
+/**
+ * Read next entries of run to buffer of cursor.
+ *
+ * @param fd descriptor of temporary file
+ * @param cur cursor
+ **/
+static void
+spill_fill(int fd, struct spill_cursor *cur)
+{
+  size_t  n;
+  ssize_t rret; /* for storage pread() return value */
+
+  n = (cur->left < SPILL_BUFFER) ? cur->left : SPILL_BUFFER;
+  rret = pread(fd, cur->buf, n * sizeof(*cur->buf), (off_t)cur->offset);
+  if (rret != (ssize_t)(n * sizeof(*cur->buf))) {
+      perror("pread");
+      exit(EXIT_FAILURE);
+  }
+
+  cur->pos     = 0;
+  cur->len     = n;
+  cur->left   -= n;
+  cur->offset += (long long)(n * sizeof(*cur->buf));
+}
+
+
+/**
+ * Restore order of heap of cursors from given position down.
+ *
+ * @param sp table
+ * @param heap cursors ordered by key of current entry
+ * @param n count of cursors in heap
+ * @param i position
+ **/
+static void
+spill_sift_down(const struct spill *sp, struct spill_cursor **heap,
+                size_t n, size_t i)
+{
+  struct spill_cursor *tmp;
+  size_t child;
+
+  for (; (child = 2 * i + 1) < n; i = child) {
+    if (child + 1 < n &&
+        spill_key_of(sp, &heap[child + 1]->buf[heap[child + 1]->pos]) <
+        spill_key_of(sp, &heap[child]->buf[heap[child]->pos])) {
+        child++;
+    }
+    if (spill_key_of(sp, &heap[i]->buf[heap[i]->pos]) <=
+        spill_key_of(sp, &heap[child]->buf[heap[child]->pos])) {
+        break;
+    }
+    tmp = heap[i];
+    heap[i] = heap[child];
+    heap[child] = tmp;
+  }
+}
+
+
+/**
+ * Merge runs and pass entries with different keys to handler.
+ *
+ * @param sp table
+ * @param runs runs in temporary file
+ * @param n count of runs
+ * @param handler function which will be called for each entry
+ * @param data pointer which will be passed to handler
+ **/
+static void
+spill_merge_runs(const struct spill *sp, const struct spill_run *runs,
+                 size_t n, summary_handler handler, void *data)
+{
+  struct spill_cursor  *cursors, **heap, *top;
+  struct summary_entry *bufs, pending;
+  size_t i, nheap;
+  int    fd, have;
+
+  fd = fileno(sp->file);
+
+  cursors = xrealloc(NULL, n * sizeof(*cursors));
+  heap    = xrealloc(NULL, n * sizeof(*heap));
+  bufs    = xrealloc(NULL, n * SPILL_BUFFER * sizeof(*bufs));
+
+  nheap = 0;
+  for (i = 0; i < n; i++) {
+    if (runs[i].count == 0) {
+        continue;
+    }
+    cursors[i].buf    = bufs + i * SPILL_BUFFER;
+    cursors[i].offset = runs[i].offset;
+    cursors[i].left   = runs[i].count;
+    spill_fill(fd, &cursors[i]);
+    heap[nheap++] = &cursors[i];
+  }
+  for (i = nheap / 2; i-- > 0; ) {
+    spill_sift_down(sp, heap, nheap, i);
+  }
+
+  have = 0;
+  while (nheap > 0) {
+    top = heap[0];
+
+    /* entries with the same key may come from several runs */
+    if (have && spill_key_of(sp, &pending) == spill_key_of(sp, &top->buf[top->pos])) {
+        spill_combine(sp, &pending, &top->buf[top->pos]);
+    } else {
+        if (have) {
+            handler(&pending, data);
+        }
+        pending = top->buf[top->pos];
+        have = 1;
+    }
+
+    if (++top->pos == top->len) {
+        if (top->left > 0) {
+            spill_fill(fd, top);
+        } else {
+            heap[0] = heap[--nheap];
+        }
+    }
+    spill_sift_down(sp, heap, nheap, 0);
+  }
+
+  if (have) {
+      handler(&pending, data);
+  }
+
+  free(bufs);
+  free(heap);
+  free(cursors);
+}
+
+
+/** Callback for \ref spill_merge_runs() which appends entry to new run. */
+static void
+spill_write_handler(const struct summary_entry *entry, void *data)
+{
+  struct spill_writer *w = data;
+
+  spill_write(w->file, entry, 1);
+  w->run->count++;
+  w->sp->size += (long long)sizeof(*entry);
+}
+
+
+/**
+ * Merge runs by groups until they can be merged at once.
+ *
+ * Each pass writes new runs to new temporary file, so disk space is
+ * used at most twice.
+ *
+ * @param sp table
+ **/
+static void
+spill_reduce(struct spill *sp)
+{
+  struct spill_run   *old;
+  struct spill_writer w;
+  size_t nold, i, n;
+
+  while (sp->nruns > sp->fanin) {
+    if (sp->verbose >= 2) {
+        printf("--> %s (%lu)\n", _("Merging runs of totals"),
+               (unsigned long)sp->nruns);
+    }
+
+    old  = sp->runs;
+    nold = sp->nruns;
+    sp->runs  = NULL;
+    sp->nruns = sp->runs_alloc = 0;
+    sp->size  = 0;
+
+    w.sp   = sp;
+    w.file = spill_tmpfile();
+    for (i = 0; i < nold; i += n) {
+      n = (nold - i < sp->fanin) ? nold - i : sp->fanin;
+      w.run = spill_new_run(sp);
+      spill_merge_runs(sp, old + i, n, spill_write_handler, &w);
+    }
+
+    if (fflush(w.file) == EOF) {
+        perror("fflush");
+        exit(EXIT_FAILURE);
+    }
+    fclose(sp->file);
+    sp->file = w.file;
+    free(old);
+  }
+}
+
+
+/**
+ * Pass all entries of table to handler in order of keys.
+ *
+ * When nothing was spilled, entries are taken right from memory.
+ * Otherwise table is spilled too and all runs are merged. Table is
+ * empty after that.
+ *
+ * @param sp table
+ * @param handler function which will be called for each entry
+ * @param data pointer which will be passed to handler
+ **/
+void
+spill_merge(struct spill *sp, summary_handler handler, void *data)
+{
+  size_t i;
+
+  assert(sp != NULL);
+  assert(handler != NULL);
+
+  if (sp->nruns == 0) {
+      for (i = 0; i < sp->count; i++) {
+        handler(&sp->entries[i], data);
+      }
+      sp->count = 0;
+      return;
+  }
+
+  spill_flush(sp);
+
+  /* memory of table is needed for buffers of runs */
+  free(sp->entries);
+  sp->entries = NULL;
+  sp->alloc   = 0;
+
+  if (fflush(sp->file) == EOF) {
+      perror("fflush");
+      exit(EXIT_FAILURE);
+  }
+
+  spill_reduce(sp);
+  spill_merge_runs(sp, sp->runs, sp->nruns, handler, data);
+  sp->nruns = 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   spill.h contains prototypes for functions which aggregate totals in bounded memory
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef SPILL_H
+#define SPILL_H
+
+/* for size_t type */
+#include <stddef.h>
+
+/* for FILE type */
+#include <stdio.h>
+
+/* for struct summary_entry and summary_handler type */
+#include "summary.h"
+
+
+/** Keys by which entries are aggregated */
+typedef enum {
+  SPILL_BY_MONTH,   /**< by (year, month, category), totals are summed */
+  SPILL_BY_CATEGORY /**< by category, earliest year and month are kept */
+} spill_key;
+
+/** Sorted run of entries in temporary file. */
+struct spill_run {
+  long long offset; /**< offset of first entry in file */
+  size_t    count;  /**< count of entries */
+};
+
+/**
+ * Table of totals which does not exceed given size.
+ *
+ * When table is full, his entries are written to temporary file as
+ * sorted run and table becomes empty. At the end all runs are merged.
+ **/
+struct spill {
+  spill_key             key;      /**< key of aggregation */
+  struct summary_entry *entries;  /**< table sorted by key */
+  size_t                count;    /**< count of used entries */
+  size_t                alloc;    /**< count of allocated entries */
+  size_t                capacity; /**< maximal count of entries in table */
+  size_t                fanin;    /**< maximal count of runs merged at once */
+  FILE                 *file;     /**< temporary file with runs or NULL */
+  long long             size;     /**< size of temporary file */
+  struct spill_run     *runs;     /**< runs in temporary file */
+  size_t                nruns;    /**< count of runs */
+  size_t                runs_alloc; /**< count of allocated runs */
+  unsigned int          verbose;  /**< level of verbose */
+};
+
+
+void spill_init(struct spill *sp, spill_key key, size_t limit,
+                unsigned int verbose);
+void spill_free(struct spill *sp);
+void spill_add(struct spill *sp, const struct summary_entry *entry);
+void spill_add_record(struct spill *sp, const struct record *rec);
+void spill_merge(struct spill *sp, summary_handler handler, void *data);
+
+#endif /* SPILL_H */
@@ -0,0 +1,612 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   summary.c contains functions which maintain summary file
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for open()
+ *     fstat()
+ **/
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* for flock() */
+#include <sys/file.h>
+
+/* for assert() */
+#include <assert.h>
+
+/* for open() */
+#include <fcntl.h>
+
+/* for read()
+ *     write()
+ *     fsync()
+ *     close()
+ *     unlink()
+ **/
+#include <unistd.h>
+
+/* for printf()
+ *     fprintf()
+ *     perror()
+ *     rename()
+ *     NULL constant
+ **/
+#include <stdio.h>
+
+/* for mkstemp()
+ *     realloc()
+ *     free()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memcmp()
+ *     memcpy()
+ *     memmove()
+ *     memset()
+ **/
+#include <string.h>
+
+#include "summary.h"
+#include "datafile.h"
+
+
+/** Magic string at start of summary file */
+#define SUMMARY_MAGIC "OFMS"
+
+/** Current version of summary file format */
+#define SUMMARY_VERSION 3
+
+/** Suffix of temporary file which will be renamed to summary file */
+#define SUMMARY_TMP_SUFFIX ".sum.XXXXXX"
+
+/** Count of entries which are read at once by \ref summary_scan() */
+#define SUMMARY_PAGE 512
+
+/** Make key for comparing entries of summary */
+#define SUMMARY_KEY(year, month, category) \
+    (((uint64_t)(year) << 40) | ((uint64_t)(month) << 32) | (uint64_t)(category))
+
+
+/**
+ * Initialize empty summary.
+ *
+ * @param sum summary
+ **/
+void
+summary_init(struct summary *sum)
+{
+  assert(sum != NULL);
+
+  sum->entries = NULL;
+  sum->count   = 0;
+  sum->alloc   = 0;
+}
+
+
+/**
+ * Free memory which was allocated for summary.
+ *
+ * @param sum summary
+ **/
+void
+summary_free(struct summary *sum)
+{
+  assert(sum != NULL);
+
+  free(sum->entries);
+  summary_init(sum);
+}
+
+
+/**
+ * Read whole buffer from file descriptor.
+ *
+ * @param fd file descriptor
+ * @param buf buffer for data
+ * @param len size of data
+ *
+ * @retval 0 error occurs or file is too short
+ * @retval 1 all data was read
+ **/
+static int
+read_all(int fd, void *buf, size_t len)
+{
+  ssize_t rret; /* for storage read() return value */
+  char   *pos = buf;
+
+  while (len > 0) {
+    rret = read(fd, pos, len);
+    if (rret <= 0) {
+        return 0;
+    }
+    pos += rret;
+    len -= (size_t)rret;
+  }
+
+  return 1;
+}
+
+
+/**
+ * Open summary file and read his header.
+ *
+ * Function checks that summary file describes data file with given
+ * statistics. Summary which was written for data file with another
+ * size, modification time (with nanoseconds where system keeps them)
+ * or inode is considered as stale.
+ *
+ * @param dbfile path to data file
+ * @param st statistics about data file
+ * @param hdr header (output)
+ *
+ * @return descriptor positioned at first entry or -1 when summary file
+ * does not exist, is broken or stale
+ **/
+static int
+summary_open_file(const char *dbfile, const struct stat *st,
+                  struct summary_header *hdr)
+{
+  struct stat sum_st;
+  char *path;
+  int   fd;
+  int   ok;
+
+  path = get_side_file_path(dbfile, SUMMARY_SUFFIX);
+  if (path == NULL) {
+      return -1;
+  }
+
+  fd = open(path, O_RDONLY);
+  free(path);
+  if (fd == -1) {
+      return -1;
+  }
+
+  ok = read_all(fd, hdr, sizeof(*hdr)) &&
+       memcmp(hdr->magic, SUMMARY_MAGIC, sizeof(hdr->magic)) == 0 &&
+       hdr->version == SUMMARY_VERSION &&
+       hdr->dbsize  == (int64_t)st->st_size &&
+       hdr->dbmtime == (int64_t)st->st_mtime &&
+       hdr->dbnsec  == STAT_MTIME_NSEC(st) &&
+       hdr->dbino   == (int64_t)st->st_ino &&
+       fstat(fd, &sum_st) == 0 &&
+       (size_t)sum_st.st_size == sizeof(*hdr) + hdr->count * sizeof(struct summary_entry);
+
+  if (!ok) {
+      close(fd);
+      return -1;
+  }
+
+  return fd;
+}
+
+
+/**
+ * Load summary file.
+ *
+ * Function reads summary file if it describes data file with given
+ * statistics (see \ref summary_open_file()).
+ *
+ * @param sum summary, should be empty
+ * @param dbfile path to data file
+ * @param st statistics about data file
+ *
+ * @retval 0 summary file does not exist, is broken or stale
+ * @retval 1 summary was loaded
+ **/
+int
+summary_load(struct summary *sum, const char *dbfile, const struct stat *st)
+{
+  struct summary_header hdr;
+  int   fd;
+  int   ok;
+
+  assert(sum != NULL);
+  assert(dbfile != NULL);
+  assert(st != NULL);
+
+  fd = summary_open_file(dbfile, st, &hdr);
+  if (fd == -1) {
+      return 0;
+  }
+
+  ok = 1;
+  if (hdr.count > 0) {
+      sum->entries = malloc(hdr.count * sizeof(struct summary_entry));
+      if (sum->entries == NULL) {
+          fprintf(stderr, "malloc: %s\n", _("cannot allocate memory"));
+          exit(EXIT_FAILURE);
+      }
+      sum->alloc = sum->count = hdr.count;
+      ok = read_all(fd, sum->entries, hdr.count * sizeof(struct summary_entry));
+      if (!ok) {
+          summary_free(sum);
+      }
+  }
+
+  close(fd);
+
+  return ok;
+}
+
+
+/**
+ * Read summary file page by page.
+ *
+ * Unlike \ref summary_load() function keeps in memory only one page of
+ * entries, so it can be used for summary of any size. Entries are
+ * passed to handler in order of keys.
+ *
+ * @param dbfile path to data file
+ * @param st statistics about data file
+ * @param handler function which will be called for each entry
+ * @param data pointer which will be passed to handler
+ *
+ * @retval 0 summary file does not exist, is broken or stale
+ * @retval 1 all entries were passed to handler
+ **/
+int
+summary_scan(const char *dbfile, const struct stat *st,
+             summary_handler handler, void *data)
+{
+  struct summary_header hdr;
+  struct summary_entry *page;
+  size_t left, n, i;
+  int    fd;
+
+  assert(dbfile != NULL);
+  assert(st != NULL);
+  assert(handler != NULL);
+
+  fd = summary_open_file(dbfile, st, &hdr);
+  if (fd == -1) {
+      return 0;
+  }
+
+  page = malloc(SUMMARY_PAGE * sizeof(*page));
+  if (page == NULL) {
+      fprintf(stderr, "malloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+
+  for (left = hdr.count; left > 0; left -= n) {
+    n = (left < SUMMARY_PAGE) ? left : SUMMARY_PAGE;
+    /* size of file was checked, so entries were partly passed to
+     * handler only on I/O error */
+    if (!read_all(fd, page, n * sizeof(*page))) {
+        perror("read");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < n; i++) {
+      handler(&page[i], data);
+    }
+  }
+
+  free(page);
+  close(fd);
+
+  return 1;
+}
+
+
+/** Callback for \ref scan_datafile() which accounts each record. */
+static void
+summary_rebuild_handler(const struct record *rec, void *data)
+{
+  summary_add((struct summary *)data, rec);
+}
+
+
+/**
+ * Build summary from scratch.
+ *
+ * Function scans whole data file. Used only when summary file is
+ * absent or stale.
+ *
+ * @param sum summary, should be empty
+ * @param dbfile path to data file
+ * @param verbose level of verbose
+ **/
+void
+summary_rebuild(struct summary *sum, const char *dbfile, unsigned int verbose)
+{
+  assert(sum != NULL);
+  assert(dbfile != NULL);
+
+  if (verbose >= 1) {
+      printf("-> %s\n", _("Rebuilding summary..."));
+  }
+
+  scan_datafile(dbfile, verbose, summary_rebuild_handler, sum);
+}
+
+
+/**
+ * Save summary to summary file.
+ *
+ * Summary is written to temporary file which then renamed to summary
+ * file. So readers always see old or new summary but never a mix of
+ * them. Errors are not fatal because summary will be rebuilt when it
+ * is absent or stale.
+ *
+ * @param sum summary
+ * @param dbfile path to data file
+ * @param st statistics about data file which is described by summary
+ * @param verbose level of verbose
+ *
+ * @retval 0 error occurs
+ * @retval 1 summary was saved
+ **/
+int
+summary_save(const struct summary *sum, const char *dbfile,
+             const struct stat *st, unsigned int verbose)
+{
+  struct summary_header hdr;
+  char   *tmppath, *path;
+  int     fd;
+  int     ok;
+  ssize_t wret;
+
+  assert(sum != NULL);
+  assert(dbfile != NULL);
+  assert(st != NULL);
+
+  if (verbose >= 2) {
+      printf("--> %s\n", _("Writing summary"));
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, SUMMARY_MAGIC, sizeof(hdr.magic));
+  hdr.version = SUMMARY_VERSION;
+  hdr.count   = (uint32_t)sum->count;
+  hdr.dbsize  = (int64_t)st->st_size;
+  hdr.dbmtime = (int64_t)st->st_mtime;
+  hdr.dbnsec  = STAT_MTIME_NSEC(st);
+  hdr.dbino   = (int64_t)st->st_ino;
+
+  path    = get_side_file_path(dbfile, SUMMARY_SUFFIX);
+  tmppath = get_side_file_path(dbfile, SUMMARY_TMP_SUFFIX);
+  if (path == NULL || tmppath == NULL) {
+      free(path);
+      free(tmppath);
+      return 0;
+  }
+
+  fd = mkstemp(tmppath);
+  if (fd == -1) {
+      perror("mkstemp");
+      free(path);
+      free(tmppath);
+      return 0;
+  }
+
+  /* both of writes are small, so we don't repeat them */
+  wret = write(fd, &hdr, sizeof(hdr));
+  ok = (wret == (ssize_t)sizeof(hdr));
+  if (ok && sum->count > 0) {
+      wret = write(fd, sum->entries, sum->count * sizeof(struct summary_entry));
+      ok = (wret == (ssize_t)(sum->count * sizeof(struct summary_entry)));
+  }
+  if (!ok) {
+      perror("write");
+  }
+
+  if (ok && fsync(fd) == -1) {
+      perror("fsync");
+      ok = 0;
+  }
+
+  if (close(fd) == -1) {
+      perror("close");
+      ok = 0;
+  }
+
+  if (ok && rename(tmppath, path) == -1) {
+      perror("rename");
+      ok = 0;
+  }
+
+  if (!ok) {
+      unlink(tmppath);
+  }
+
+  free(path);
+  free(tmppath);
+
+  return ok;
+}
+
+
+/**
+ * Get actual summary for data file.
+ *
+ * Function loads summary file and rebuilds him if it is absent or
+ * stale. Data file is locked for reading, so records can't be appended
+ * while summary is rebuilt and saved summary describes exactly the
+ * records which were read. If data file cannot be accessed then
+ * function will quit from program with failure exit code.
+ *
+ * @param sum summary, should be empty
+ * @param dbfile path to data file
+ * @param verbose level of verbose
+ **/
+void
+summary_open(struct summary *sum, const char *dbfile, unsigned int verbose)
+{
+  struct stat st;
+  int fd;
+
+  assert(sum != NULL);
+  assert(dbfile != NULL);
+
+  fd = open(dbfile, O_RDONLY);
+  if (fd == -1) {
+      fprintf(stderr, "%s: %s\n", _("Failed to open file"), dbfile);
+      perror("open");
+      exit(EXIT_FAILURE);
+  }
+
+  /* data file should not be changed while summary is rebuilt */
+  if (flock(fd, LOCK_SH) == -1 || fstat(fd, &st) == -1) {
+      perror("flock");
+      exit(EXIT_FAILURE);
+  }
+
+  if (!summary_load(sum, dbfile, &st)) {
+      summary_rebuild(sum, dbfile, verbose);
+      summary_save(sum, dbfile, &st, verbose);
+  }
+
+  /* closing of file also drops lock */
+  close(fd);
+}
+
+
+/**
+ * Find position of the first entry which is not less than key.
+ *
+ * @param sum summary
+ * @param key key (see \ref SUMMARY_KEY())
+ *
+ * @return position in array of entries
+ **/
+static size_t
+summary_search(const struct summary *sum, uint64_t key)
+{
+  const struct summary_entry *entry;
+  size_t low, high, mid;
+
+  low  = 0;
+  high = sum->count;
+  while (low < high) {
+    mid = low + (high - low) / 2;
+    entry = &sum->entries[mid];
+    if (SUMMARY_KEY(entry->year, entry->month, entry->category) < key) {
+        low = mid + 1;
+    } else {
+        high = mid;
+    }
+  }
+
+  return low;
+}
+
+
+/**
+ * Find running totals for month and category.
+ *
+ * @param sum summary
+ * @param year year
+ * @param month month
+ * @param category number of category
+ *
+ * @return entry or NULL when there are no records
+ **/
+const struct summary_entry *
+summary_find(const struct summary *sum, unsigned int year, unsigned int month,
+             unsigned long category)
+{
+  const struct summary_entry *entry;
+  uint64_t key;
+  size_t   pos;
+
+  assert(sum != NULL);
+
+  key = SUMMARY_KEY(year, month, (uint32_t)category);
+  pos = summary_search(sum, key);
+  if (pos == sum->count) {
+      return NULL;
+  }
+
+  entry = &sum->entries[pos];
+  if (SUMMARY_KEY(entry->year, entry->month, entry->category) != key) {
+      return NULL;
+  }
+
+  return entry;
+}
+
+
+/**
+ * Add record to running totals.
+ *
+ * Function finds entry for month and category of record with binary
+ * search and creates new one if it does not exist.
+ *
+ * @param sum summary
+ * @param rec record
+ **/
+void
+summary_add(struct summary *sum, const struct record *rec)
+{
+  uint64_t key;
+  size_t   low;
+  struct summary_entry *entry;
+
+  assert(sum != NULL);
+  assert(rec != NULL);
+
+  key = SUMMARY_KEY(rec->year, rec->month, (uint32_t)rec->category);
+  low = summary_search(sum, key);
+
+  entry = &sum->entries[low];
+  if (low == sum->count ||
+      SUMMARY_KEY(entry->year, entry->month, entry->category) != key) {
+
+      if (sum->count == sum->alloc) {
+          sum->alloc = (sum->alloc == 0) ? 64 : sum->alloc * 2;
+          sum->entries = realloc(sum->entries,
+                                 sum->alloc * sizeof(struct summary_entry));
+          if (sum->entries == NULL) {
+              fprintf(stderr, "realloc: %s\n", _("cannot allocate memory"));
+              exit(EXIT_FAILURE);
+          }
+      }
+
+      entry = &sum->entries[low];
+      memmove(entry + 1, entry, (sum->count - low) * sizeof(struct summary_entry));
+      sum->count++;
+
+      memset(entry, 0, sizeof(*entry));
+      entry->year     = (uint16_t)rec->year;
+      entry->month    = (uint8_t)rec->month;
+      entry->category = (uint32_t)rec->category;
+  }
+
+  if (rec->sign == '-') {
+      entry->costs  += rec->amount;
+  } else {
+      entry->profit += rec->amount;
+  }
+  if (rec->currency != 0) {
+      entry->currency = 1;
+  }
+}
+
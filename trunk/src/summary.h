@@ -0,0 +1,108 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   summary.h contains prototypes for functions which maintain summary file
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+/* for struct stat */
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* for size_t type */
+#include <stddef.h>
+
+/* for uint*_t and int64_t types */
+#include <stdint.h>
+
+/* for struct record */
+#include "common.h"
+
+
+/** Suffix of summary file. It lives near data file. */
+#define SUMMARY_SUFFIX ".sum"
+
+/**
+ * Running totals for one month and one category.
+ *
+ * Array of those entries sorted by (year, month, category) is stored
+ * in summary file as is, after \ref summary_header.
+ **/
+struct summary_entry {
+  uint16_t year;     /**< year */
+  uint8_t  month;    /**< month (1-12) */
+  uint8_t  currency; /**< nonzero if some records have currency codes */
+  uint32_t category; /**< number of category */
+  int64_t  profit;   /**< sum of profits in hundredths */
+  int64_t  costs;    /**< sum of costs in hundredths */
+};
+
+/** Header of summary file. */
+struct summary_header {
+  char     magic[4]; /**< always "OFMS" */
+  uint32_t version;  /**< version of file format */
+  uint32_t count;    /**< count of entries after header */
+  uint32_t reserved; /**< not used, always zero */
+  int64_t  dbsize;   /**< size of data file described by summary */
+  int64_t  dbmtime;  /**< modification time of that data file */
+  int64_t  dbnsec;   /**< nanoseconds of that modification time */
+  int64_t  dbino;    /**< inode of that data file */
+};
+
+/** Summary loaded to memory. */
+struct summary {
+  struct summary_entry *entries; /**< entries sorted by key */
+  size_t                count;   /**< count of used entries */
+  size_t                alloc;   /**< count of allocated entries */
+};
+
+/**
+ * Type of function which is called for each entry of summary.
+ *
+ * @param entry entry of summary
+ * @param data pointer which was passed to \ref summary_scan()
+ **/
+typedef void (*summary_handler)(const struct summary_entry *entry, void *data);
+
+
+void summary_init(struct summary *sum);
+void summary_free(struct summary *sum);
+int  summary_load(struct summary *sum, const char *dbfile, const struct stat *st);
+void summary_rebuild(struct summary *sum, const char *dbfile, unsigned int verbose);
+int  summary_save(const struct summary *sum, const char *dbfile,
+                  const struct stat *st, unsigned int verbose);
+void summary_open(struct summary *sum, const char *dbfile, unsigned int verbose);
+void summary_add(struct summary *sum, const struct record *rec);
+const struct summary_entry *summary_find(const struct summary *sum,
+                                         unsigned int year, unsigned int month,
+                                         unsigned long category);
+int  summary_scan(const char *dbfile, const struct stat *st,
+                  summary_handler handler, void *data);
+
+#endif /* SUMMARY_H */
+
@@ -0,0 +1,301 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   trend.c contains functions which compute rolling averages and forecasts
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+/* for assert() */
+#include <assert.h>
+
+/* for fprintf()
+ *     NULL constant
+ **/
+#include <stdio.h>
+
+/* for malloc()
+ *     calloc()
+ *     free()
+ *     qsort()
+ *     bsearch()
+ *     exit()
+ *     EXIT_* constants
+ **/
+#include <stdlib.h>
+
+/* for memset() */
+#include <string.h>
+
+#include "trend.h"
+#include "common.h"
+
+
+/** Number of month counted from 01.0000 */
+#define MONTH_INDEX(year, month) ((size_t)(year) * 12 + (month) - 1)
+
+
+/** Compare numbers of categories for qsort() and bsearch(). */
+static int
+trend_compare(const void *a, const void *b)
+{
+  unsigned long x = *(const unsigned long *)a;
+  unsigned long y = *(const unsigned long *)b;
+
+  return (x > y) - (x < y);
+}
+
+
+/**
+ * Divide amount and round half away from zero.
+ *
+ * @param amount amount in hundredths
+ * @param n divisor, more then 0
+ *
+ * @return rounded quotient
+ **/
+static long long
+trend_divide(long long amount, long long n)
+{
+  return (amount >= 0 ? amount + n / 2 : amount - n / 2) / n;
+}
+
+
+/**
+ * Fill matrix of monthly amounts from summary.
+ *
+ * Summary is read once: each entry is added to cell of its month and
+ * category. Then rows of matrix are turned into prefix sums in place.
+ *
+ * @param t matrix (output), free him with \ref trend_free()
+ * @param sum summary
+ **/
+void
+trend_build(struct trend *t, const struct summary *sum)
+{
+  const struct summary_entry *entry, *end;
+  const unsigned long *found;
+  unsigned long category;
+  long long *row, *moment;
+  size_t first, stride, c, i, m;
+
+  assert(t != NULL);
+  assert(sum != NULL);
+
+  memset(t, 0, sizeof(*t));
+  if (sum->count == 0) {
+      return;
+  }
+
+  /* summary is sorted by month, so first and last entries are bounds */
+  entry = sum->entries;
+  end   = sum->entries + sum->count;
+  t->year    = entry->year;
+  t->month   = entry->month;
+  first      = MONTH_INDEX(entry->year, entry->month);
+  t->nmonths = MONTH_INDEX(end[-1].year, end[-1].month) - first + 1;
+
+  t->categories = malloc(sum->count * sizeof(*t->categories));
+  if (t->categories == NULL) {
+      fprintf(stderr, "malloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+  for (i = 0; i < sum->count; i++) {
+    t->categories[i] = sum->entries[i].category;
+  }
+  qsort(t->categories, sum->count, sizeof(*t->categories), trend_compare);
+  for (i = 1, t->ncat = 1; i < sum->count; i++) {
+    if (t->categories[i] != t->categories[t->ncat - 1]) {
+        t->categories[t->ncat++] = t->categories[i];
+    }
+  }
+
+  stride = t->nmonths + 1;
+  if (t->ncat > (size_t)-1 / sizeof(long long) / stride) {
+      fprintf(stderr, "calloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+  t->sums    = calloc(t->ncat * stride, sizeof(*t->sums));
+  t->moments = calloc(t->ncat * stride, sizeof(*t->moments));
+  if (t->sums == NULL || t->moments == NULL) {
+      fprintf(stderr, "calloc: %s\n", _("cannot allocate memory"));
+      exit(EXIT_FAILURE);
+  }
+
+  /* cell of month m is at position m + 1, position 0 stays zero */
+  for (; entry < end; entry++) {
+    category = entry->category;
+    found = bsearch(&category, t->categories, t->ncat,
+                    sizeof(*t->categories), trend_compare);
+    c = (size_t)(found - t->categories);
+    m = MONTH_INDEX(entry->year, entry->month) - first;
+    t->sums[c * stride + m + 1] += entry->profit - entry->costs;
+  }
+
+  for (c = 0; c < t->ncat; c++) {
+    row    = t->sums + c * stride;
+    moment = t->moments + c * stride;
+    for (m = 1; m <= t->nmonths; m++) {
+      moment[m] = moment[m - 1] + (long long)(m - 1) * row[m];
+      row[m]   += row[m - 1];
+    }
+  }
+}
+
+
+/**
+ * Free memory of matrix.
+ *
+ * @param t matrix
+ **/
+void
+trend_free(struct trend *t)
+{
+  assert(t != NULL);
+
+  free(t->categories);
+  free(t->sums);
+  free(t->moments);
+  memset(t, 0, sizeof(*t));
+}
+
+
+/**
+ * Get year and month of month of matrix.
+ *
+ * Month after last one may be asked too, it is month of forecast.
+ *
+ * @param t matrix
+ * @param m number of month in matrix
+ * @param year year (output)
+ * @param month month (output)
+ **/
+void
+trend_date(const struct trend *t, size_t m,
+           unsigned int *year, unsigned int *month)
+{
+  size_t index;
+
+  assert(t != NULL);
+
+  index  = MONTH_INDEX(t->year, t->month) + m;
+  *year  = (unsigned int)(index / 12);
+  *month = (unsigned int)(index % 12) + 1;
+}
+
+
+/**
+ * Get amount of category in month.
+ *
+ * @param t matrix
+ * @param c number of category in \ref trend::categories
+ * @param m number of month in matrix
+ *
+ * @return profit minus costs in hundredths
+ **/
+long long
+trend_total(const struct trend *t, size_t c, size_t m)
+{
+  const long long *row;
+
+  assert(t != NULL);
+  assert(c < t->ncat && m < t->nmonths);
+
+  row = t->sums + c * (t->nmonths + 1);
+
+  return row[m + 1] - row[m];
+}
+
+
+/**
+ * Get average amount of category over months which end in month.
+ *
+ * Months without records count as zero. At start of matrix window has
+ * only months which exist.
+ *
+ * @param t matrix
+ * @param c number of category in \ref trend::categories
+ * @param m number of last month of window
+ * @param window count of months in window
+ *
+ * @return average in hundredths
+ **/
+long long
+trend_average(const struct trend *t, size_t c, size_t m, size_t window)
+{
+  const long long *row;
+  size_t low;
+
+  assert(t != NULL);
+  assert(c < t->ncat && m < t->nmonths && window > 0);
+
+  row = t->sums + c * (t->nmonths + 1);
+  low = (m + 1 > window) ? m + 1 - window : 0;
+
+  return trend_divide(row[m + 1] - row[low], (long long)(m + 1 - low));
+}
+
+
+/**
+ * Forecast amount of category for month after last one.
+ *
+ * Line is fitted by least squares to last \ref TREND_FIT_MONTHS months
+ * and is continued by one month. Sums for fit are taken from prefix
+ * sums, so forecast doesn't depend on count of months.
+ *
+ * @param t matrix
+ * @param c number of category in \ref trend::categories
+ *
+ * @return forecast in hundredths
+ **/
+long long
+trend_forecast(const struct trend *t, size_t c)
+{
+  const long long *row, *moment;
+  double k, sx, sxx, sy, sxy, slope, value;
+  size_t low;
+
+  assert(t != NULL);
+  assert(c < t->ncat);
+
+  row    = t->sums + c * (t->nmonths + 1);
+  moment = t->moments + c * (t->nmonths + 1);
+  low    = (t->nmonths > TREND_FIT_MONTHS) ? t->nmonths - TREND_FIT_MONTHS : 0;
+
+  /* months of window are numbered from zero */
+  k   = (double)(t->nmonths - low);
+  sy  = (double)(row[t->nmonths] - row[low]);
+  sxy = (double)(moment[t->nmonths] - moment[low]) - (double)low * sy;
+  sx  = k * (k - 1) / 2;
+  sxx = (k - 1) * k * (2 * k - 1) / 6;
+
+  if (k < 2) {
+      return row[t->nmonths] - row[low];
+  }
+
+  slope = (k * sxy - sx * sy) / (k * sxx - sx * sx);
+  value = (sy - slope * sx) / k + slope * k;
+
+  return value >= 0 ? (long long)(value + 0.5) : -(long long)(-value + 0.5);
+}
@@ -0,0 +1,72 @@
+/*
+ * OpenFM - Open Financial Manager
+ * Copyright (C) 2006 Slava Semushin <php-coder at altlinux.ru>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * $Id$
+ *
+ **/
+
+/**
+ * @file   trend.h contains prototypes for functions which compute rolling averages and forecasts
+ * @author Slava Semushin <php-coder at altlinux.ru>
+ * @since  18.10.2026
+ **/
+
+#ifndef TREND_H
+#define TREND_H
+
+/* for size_t type */
+#include <stddef.h>
+
+/* for struct summary */
+#include "summary.h"
+
+
+/** Count of last months which are used for forecast */
+#define TREND_FIT_MONTHS 12
+
+/**
+ * Monthly amounts of categories.
+ *
+ * Amount of category in month is profit minus costs. Months go without
+ * gaps from first to last month of summary, so matrix is dense. For
+ * each category matrix keeps prefix sums of amounts and of amounts
+ * multiplied by number of month, so sum over any window of months is
+ * two lookups.
+ **/
+struct trend {
+  unsigned int   year;       /**< year of first month */
+  unsigned int   month;      /**< first month */
+  size_t         nmonths;    /**< count of months */
+  unsigned long *categories; /**< sorted numbers of categories */
+  size_t         ncat;       /**< count of categories */
+  long long     *sums;       /**< prefix sums, nmonths + 1 for category */
+  long long     *moments;    /**< prefix sums of month * amount */
+};
+
+
+void      trend_build(struct trend *t, const struct summary *sum);
+void      trend_free(struct trend *t);
+void      trend_date(const struct trend *t, size_t m,
+                     unsigned int *year, unsigned int *month);
+long long trend_total(const struct trend *t, size_t c, size_t m);
+long long trend_average(const struct trend *t, size_t c, size_t m,
+                        size_t window);
+long long trend_forecast(const struct trend *t, size_t c);
+
+#endif /* TREND_H */
@@ -125,6 +125,414 @@ case $1 in
       print_message "'openfm add category' command"
       ($OPENFM add category 2>&1; echo rc=$?) >"$1.txt"
       ;;
+    12)
+      print_message "'openfm add (cost|profit)' command"
+      (export HOME=.
+       $OPENFM add cost 12,50 3 lunch at cafe 2>&1; echo rc=$?
+       $OPENFM add profit 1000 1 salary 2>&1; echo rc=$?
+       $OPENFM add cost 1x 3 wrong amount 2>&1; echo rc=$?
+       $OPENFM show balance 2>&1; echo rc=$?
+       $OPENFM show categories 2>&1; echo rc=$?
+       $OPENFM 2>&1; echo rc=$?
+       rm -f finance.db finance.db.sum) >"$1.txt"
+      ;;
+    13)
+      print_message "'openfm show fullstat' command"
+      (export HOME=.
+       cp "$1.in" finance.db
+       $OPENFM show fullstat 2>&1; echo rc=$?
+       echo '-|01.02.2006|7|3.50|appended by hand' >>finance.db
+       $OPENFM show fullstat 2>&1; echo rc=$?
+       rm -f finance.db finance.db.sum) >"$1.txt"
+      ;;
+    14)
+      print_message "datafile with long lines"
+      ($OPENFM "$1.in" 2>&1; echo rc=$?) >"$1.txt"
+      ;;
+    15)
+      print_message "'openfm export' command"
+      ($OPENFM export "$1.in" 2>&1; echo rc=$?
+       $OPENFM --format jsonl export "$1.in" 2>&1; echo rc=$?
+       $OPENFM --format xml export "$1.in" 2>&1; echo rc=$?) >"$1.txt"
+      ;;
+    16)
+      print_message "'openfm import' command"
+      (export HOME=.
+       $OPENFM --map 'date=1,comment=2,amount=3,category=4,skip=1,sep=;' \
+               import "$1.in" 2>&1; echo rc=$?
+       cat finance.db
+       $OPENFM show categories 2>&1; echo rc=$?
+       rm -f finance.db finance.db.sum) >"$1.txt"
+      ;;
+    17)
+      print_message "'openfm import' with wrong lines"
+      (export HOME=.
+       $OPENFM --map 'date=1,amount=2,comment=3,skip=1' import "$1.in" 2>&1; echo rc=$?
+       $OPENFM --map 'amount=2' import "$1.in" 2>&1; echo rc=$?
+       test -f finance.db; echo rc=$?) >"$1.txt"
+      ;;
+    18)
+      print_message "rules for categories"
+      (export HOME=.
+       $OPENFM --rules "$1.in" --map 'date=1,comment=2,amount=3,skip=1,sep=;' \
+               import 16.in 2>&1; echo rc=$?
+       cat finance.db
+       rm -f finance.db finance.db.sum
+       cp 13.in finance.db
+       $OPENFM recategorize 2>&1; echo rc=$?
+       $OPENFM --rules "$1.in" recategorize 2>&1; echo rc=$?
+       cat finance.db
+       $OPENFM show categories 2>&1; echo rc=$?
+       rm -f finance.db finance.db.sum) >"$1.txt"
+      ;;
+    19)
+      print_message "'openfm search' command"
+      (export HOME=.
+       cp 13.in finance.db
+       $OPENFM search LUNCH 2>&1; echo rc=$?
+       $OPENFM import "$1.in" 2>&1; echo rc=$?
+       $OPENFM search lunch 2>&1; echo rc=$?
+       $OPENFM import "$1.in" 2>&1; echo rc=$?
+       $OPENFM search team lunch 2>&1; echo rc=$?
+       echo '+|01.03.2006|1|10|team bonus' >>finance.db
+       $OPENFM search team 2>&1; echo rc=$?
+       $OPENFM search salary lunch 2>&1; echo rc=$?
+       $OPENFM search '!' 2>&1; echo rc=$?
+       $OPENFM search 2>&1; echo rc=$?
+       rm -f finance.db finance.db.sum finance.db.idx) >"$1.txt"
+      ;;
+    20)
+      print_message "--filter option"
+      (export HOME=.
+       cp "$1.in" finance.db
+       $OPENFM --filter 'category in (12,14) and amount > 500 and date >= 01.02.2006' \
+               show fullstat 2>&1; echo rc=$?
+       $OPENFM --filter 'sign = + or not (month != 1 or category = 1)' show balance 2>&1; echo rc=$?
+       $OPENFM --filter 'amount <= 12.5 OR day = 14' show categories 2>&1; echo rc=$?
+       $OPENFM --filter 'year = 2006 and (category = 12 or comment > 1)' show costs 2>&1; echo rc=$?
+       $OPENFM --filter 'sign = - and category in (3, 14)' export 2>&1; echo rc=$?
+       $OPENFM --filter 'date > 31.13.2006' show balance 2>&1; echo rc=$?
+       $OPENFM --filter 'amount > 1 and' show balance 2>&1; echo rc=$?
+       $OPENFM --filter 'amount > 1)' export 2>&1; echo rc=$?
+       rm -f finance.db finance.db.sum) >"$1.txt"
+      ;;
+    21)
+      print_message "ways of reading data file"
+      (export HOME=.
+       awk 'BEGIN { for (i = 0; i < 200000; i++)
+                      printf "%s|01.01.2006|%d|%d.%02d|record %d\n",
+                             (i % 3 ? "-" : "+"), i % 7, i % 1000, i % 100, i }' >finance.db
+       for way in uring thread sync; do
+         OPENFM_READER=$way $OPENFM 2>&1; echo rc=$?
+       done
+       rm -f finance.db) >"$1.txt"
+      ;;
+    22)
+      print_message "--porcelain option and OPENFM_DB variable"
+      (cp 20.in ledger.db
+       OPENFM_DB=ledger.db $OPENFM --porcelain show balance 2>&1; echo rc=$?
+       OPENFM_DB=ledger.db HOME=/nonexistent $OPENFM 2>&1; echo rc=$?
+       env -u HOME OPENFM_DB= $OPENFM --porcelain 2>&1; echo rc=$?
+       rm -f ledger.db ledger.db.sum) >"$1.txt"
+      ;;
+    23)
+      print_message "--output option"
+      (cp 20.in ledger.db
+       for fmt in json tsv; do
+         OPENFM_DB=ledger.db $OPENFM --output $fmt 2>&1
+         for arg in profits costs balance categories fullstat; do
+           OPENFM_DB=ledger.db $OPENFM --output $fmt show $arg 2>&1
+         done
+       done
+       OPENFM_DB=ledger.db $OPENFM --output json --filter 'sign = -' show categories 2>&1
+       OPENFM_DB=ledger.db $OPENFM --output xml show balance 2>&1; echo rc=$?
+       rm -f ledger.db ledger.db.sum) >"$1.txt"
+      ;;
+    24)
+      print_message "'openfm batch' command"
+      (cp 20.in ledger1.db
+       cp 13.in ledger2.db
+       printf 'junk\njunk\njunk\njunk\njunk\njunk\n' >ledger3.db
+       printf 'ledger1.db\n\nledger2.db\nledger3.db\nmissing.db\nledger1.db\n' >ledgers.lst
+       $OPENFM -j 2 batch ledgers.lst 2>errors.txt; echo rc=$?
+       grep -v '^[0-9]*:' errors.txt
+       $OPENFM -j 3 --output json batch ledgers.lst 2>/dev/null
+       printf 'ledger1.db\n' >ledgers.lst
+       $OPENFM batch ledgers.lst; echo rc=$?
+       $OPENFM batch 2>&1; echo rc=$?
+       rm -f ledger1.db ledger2.db ledger3.db ledgers.lst errors.txt) >"$1.txt"
+      ;;
+    25)
+      print_message "checksums and 'openfm verify' command"
+      (printf '05.01.2006,-12.50,coffee shop\n06.01.2006,100,salary\n' >statement.csv
+       printf '07.01.2006,-3,bus ticket\n08.01.2006,-40,books\n' >>statement.csv
+       printf '+|09.01.2006|1|7|old record\n' >ledger.db
+       OPENFM_DB=ledger.db $OPENFM --checksum --map 'date=1,amount=2,comment=3' import statement.csv
+       cat ledger.db
+       OPENFM_DB=ledger.db $OPENFM verify; echo rc=$?
+       OPENFM_DB=ledger.db $OPENFM export
+       sed -i -e 's/coffee/toffee/' -e 's/|100|/|900|/' -e 's/bus/bun/' ledger.db
+       $OPENFM verify ledger.db; echo rc=$?
+       OPENFM_CRC32C=table $OPENFM verify ledger.db; echo rc=$?
+       printf '3|books\n' >rules.txt
+       OPENFM_DB=ledger.db $OPENFM --rules rules.txt recategorize
+       cat ledger.db
+       OPENFM_DB=ledger.db $OPENFM --checksum add cost 5 2 tea
+       sed -i -e '2s/|~\(.......\).$/|~\1g/' -e '3s/|~/|-/' \
+              -e '4s/|~.*$/|~ruined!!/' ledger.db
+       $OPENFM verify ledger.db; echo rc=$?
+       rm -f statement.csv rules.txt ledger.db ledger.db.sum) >"$1.txt"
+      ;;
+    26)
+      print_message "'openfm show --as-of' command"
+      (printf '+|10.03.2006|1|100|march\n-|05.01.2006|2|30|january\n' >ledger.db
+       printf '+|20.02.2006|1|50|february\n-|10.03.2006|2|5|march\n' >>ledger.db
+       OPENFM_DB=ledger.db $OPENFM -v --as-of 31.12.2005 show balance
+       OPENFM_DB=ledger.db $OPENFM --as-of 05.01.2006 show costs
+       OPENFM_DB=ledger.db $OPENFM --as-of 28.02.2006 show balance
+       OPENFM_DB=ledger.db $OPENFM -v --as-of 10.03.2006 show profits
+       OPENFM_DB=ledger.db $OPENFM --as-of 01.01.2007 show balance
+       printf '+|01.02.2006|1|7|bonus\n' >>ledger.db
+       OPENFM_DB=ledger.db $OPENFM -v --as-of 01.02.2006 show profits
+       OPENFM_DB=ledger.db $OPENFM add profit 2.50 1 gift
+       OPENFM_DB=ledger.db $OPENFM -v --as-of 01.02.2006 show profits
+       OPENFM_DB=ledger.db $OPENFM --output json --as-of 01.01.2100 show balance
+       echo
+       OPENFM_DB=ledger.db $OPENFM --as-of 01.01.2100 show balance
+       OPENFM_DB=ledger.db $OPENFM --as-of 01.01.2006 show categories 2>&1; echo rc=$?
+       OPENFM_DB=ledger.db $OPENFM --as-of 1.13.2006 show balance 2>&1; echo rc=$?
+       rm -f ledger.db ledger.db.sum ledger.db.bal) >"$1.txt"
+      ;;
+    27)
+      print_message "--memory-limit option"
+      (awk 'BEGIN { for (i = 0; i < 400; i++)
+                      printf "%s|%02d.%02d.%d|%d|%d.%02d|r%d\n", (i % 3) ? "-" : "+",
+                             i % 28 + 1, i * 7 % 12 + 1, 2000 + i * 13 % 5,
+                             i * 37 % 23 + 1, i % 90, i % 100, i }' >ledger.db
+       export OPENFM_DB=ledger.db
+       for arg in profits costs balance categories fullstat; do
+         $OPENFM show $arg >expected.txt
+         $OPENFM --memory-limit 1K show $arg | cmp - expected.txt && echo "$arg: summary ok"
+         rm -f ledger.db.sum
+         $OPENFM --memory-limit 1K show $arg | cmp - expected.txt && echo "$arg: records ok"
+       done
+       $OPENFM --output tsv --filter 'sign = -' show categories >expected.txt
+       $OPENFM --memory-limit 2k --output tsv --filter 'sign = -' show categories |
+           cmp - expected.txt && echo "filter: ok"
+       $OPENFM -vv --memory-limit 1K show categories | grep -c 'Spilling'
+       $OPENFM --memory-limit 1K --output json show fullstat | head -c 60; echo
+       $OPENFM --memory-limit 0 show balance 2>&1; echo rc=$?
+       $OPENFM --memory-limit 12X show balance 2>&1; echo rc=$?
+       rm -f ledger.db ledger.db.sum expected.txt) >"$1.txt"
+      ;;
+    28)
+      print_message "amounts with currency codes and --rates option"
+      (printf '+|10.01.2006|1|1000|salary\n-|12.01.2006|2|10 EUR|lunch\n' >ledger.db
+       printf '%s\n' '-|20.01.2006|2|20.50 EUR|dinner' '-|03.02.2006|3|100 USD|book' \
+              '+|04.02.2006|1|10.01 EUR|refund' >>ledger.db
+       printf '# rates to base currency\n01.01.2006|EUR|1.5\n' >rates.txt
+       printf '15.01.2006|EUR|2\n\n01.02.2006|USD|1.25\n' >>rates.txt
+       export OPENFM_DB=ledger.db
+       $OPENFM 2>&1; echo rc=$?
+       $OPENFM --rates rates.txt 2>&1; echo rc=$?
+       $OPENFM --rates rates.txt show categories 2>&1; echo rc=$?
+       $OPENFM --rates rates.txt --filter 'amount > 100' show costs 2>&1; echo rc=$?
+       $OPENFM --rates rates.txt --memory-limit 1K --output tsv show fullstat 2>&1; echo rc=$?
+       printf 'ledger.db\n' >ledgers.lst
+       $OPENFM --rates rates.txt batch ledgers.lst 2>&1; echo rc=$?
+       printf '01.01.2006|EUR|2\n' >rates.txt
+       $OPENFM --rates rates.txt 2>&1; echo rc=$?
+       $OPENFM --rates rates.txt batch ledgers.lst 2>&1; echo rc=$?
+       printf '01.01.2006|EUR|2\n01.01.2006|usd|1\n' >rates.txt
+       $OPENFM --rates rates.txt 2>&1; echo rc=$?
+       $OPENFM --rates rates.txt --as-of 01.01.2007 show balance 2>&1; echo rc=$?
+       $OPENFM add cost '5 eur' 1 wrong currency 2>&1; echo rc=$?
+       $OPENFM add cost '5 GBP' 1 right currency 2>&1; echo rc=$?
+       tail -n 1 ledger.db | cut -d '|' -f 1,3-5
+       printf '%s\n' '-|05.02.2006|2|5 EURO|wrong' >>ledger.db
+       $OPENFM 2>&1 | head -n 1
+       rm -f ledger.db ledger.db.sum rates.txt ledgers.lst) >"$1.txt"
+      ;;
+    29)
+      print_message "days of months and leap years"
+      (export OPENFM_DB=ledger.db
+       cp "$1.in" ledger.db
+       $OPENFM show fullstat 2>&1; echo rc=$?
+       $OPENFM --as-of 29.02.2004 show balance 2>&1; echo rc=$?
+       $OPENFM --as-of 31.04.2004 show balance 2>&1; echo rc=$?
+       $OPENFM --filter 'date >= 29.02.2000 and date < 01.03.2004' show costs 2>&1; echo rc=$?
+       $OPENFM --filter 'date < 29.02.2001' show costs 2>&1; echo rc=$?
+       rm -f ledger.db ledger.db.sum ledger.db.bal) >"$1.txt"
+      ;;
+    30)
+      print_message "'openfm materialize' command"
+      (export OPENFM_DB=ledger.db
+       : >ledger.db
+       $OPENFM -v --until 31.03.2006 materialize "$1.in" 2>&1 | tail -n 1; echo rc=$?
+       cat ledger.db
+       cat ledger.db.sched
+       $OPENFM --until 31.03.2006 materialize "$1.in" 2>&1; echo rc=$?
+       $OPENFM --until 15.04.2006 --checksum materialize "$1.in" 2>&1; echo rc=$?
+       tail -n 3 ledger.db
+       $OPENFM show fullstat 2>&1; echo rc=$?
+       $OPENFM verify 2>&1; echo rc=$?
+       printf 'fortnightly|-|01.01.2006|1|5|x\n' >recurring.txt
+       $OPENFM --until 31.03.2006 materialize recurring.txt 2>&1; echo rc=$?
+       printf 'daily|-|01.01.2006|1|5 eur|x\n' >recurring.txt
+       $OPENFM --until 31.03.2006 materialize recurring.txt 2>&1; echo rc=$?
+       $OPENFM --until 01.01.9999 materialize "$1.in" 2>&1; echo rc=$?
+       $OPENFM materialize 2>&1; echo rc=$?
+       : >ledger.db
+       rm -f ledger.db.sum ledger.db.sched
+       printf 'monthly|-|10.01.2006|4|50|phone\nmonthly|-|10.01.2006|4|20|tv\n' \
+              >recurring.txt
+       $OPENFM --until 28.02.2006 materialize recurring.txt 2>&1; echo rc=$?
+       cat ledger.db.sched
+       printf 'monthly|-|10.01.2006|4|55|new phone\nmonthly|-|10.01.2006|4|20|tv\n' \
+              >recurring.txt
+       $OPENFM --until 31.03.2006 materialize recurring.txt 2>&1; echo rc=$?
+       cat ledger.db
+       printf '28.02.2006|weekly|+|01.01.2006|2|10|old state\n' >ledger.db.sched
+       printf 'weekly|+|01.01.2006|2|10|old state\n' >recurring.txt
+       $OPENFM --until 10.03.2006 materialize recurring.txt 2>&1; echo rc=$?
+       tail -n 2 ledger.db
+       cat ledger.db.sched
+       rm -f ledger.db ledger.db.sum ledger.db.sched recurring.txt) >"$1.txt"
+      ;;
+    31)
+      print_message "budgets for action 'add'"
+      (export OPENFM_DB=ledger.db
+       month=$(date +%m.%Y)
+       cp "$1.in" budgets.txt
+       echo "$month|4|700" >>budgets.txt
+       printf '%s\n' '-|01.01.2006|4|900|old month' >ledger.db
+       $OPENFM --budgets budgets.txt add cost 600 4 rent 2>&1; echo rc=$?
+       $OPENFM --budgets budgets.txt add cost 150 4 more rent 2>&1; echo rc=$?
+       $OPENFM --budgets budgets.txt --over-budget refuse add cost 1 4 refused 2>&1; echo rc=$?
+       $OPENFM --budgets budgets.txt --over-budget refuse add cost 100,50 5 fits 2>&1; echo rc=$?
+       $OPENFM --budgets budgets.txt --over-budget refuse add cost 0.01 5 refused 2>&1; echo rc=$?
+       $OPENFM --budgets budgets.txt --over-budget refuse add profit 1000 5 profit 2>&1; echo rc=$?
+       $OPENFM --budgets budgets.txt --over-budget refuse add cost 1000 6 no budget 2>&1; echo rc=$?
+       cut -d '|' -f 1,3- ledger.db
+       printf '4|500\n4|600\n' >budgets.txt
+       $OPENFM --budgets budgets.txt add cost 1 4 twice 2>&1; echo rc=$?
+       printf '4|5x\n' >budgets.txt
+       $OPENFM --budgets budgets.txt add cost 1 4 wrong 2>&1; echo rc=$?
+       $OPENFM --over-budget maybe show balance 2>&1; echo rc=$?
+       rm -f ledger.db ledger.db.sum ledger.db.bal budgets.txt) 2>&1 |
+       sed "s/$(date +%m.%Y)/mm.yyyy/" >"$1.txt"
+      ;;
+    32)
+      print_message "snapshot in shared memory (--shared)"
+      (export OPENFM_DB=ledger.db
+       cp "$1.in" ledger.db
+       printf '01.01.2006|EUR|2\n' >rates.txt
+       $OPENFM -v unshare 2>&1; echo rc=$?
+       $OPENFM -v --shared 2>&1; echo rc=$?
+       $OPENFM -v --shared 2>&1; echo rc=$?
+       $OPENFM --shared --rates rates.txt 2>&1; echo rc=$?
+       $OPENFM -v --shared --filter 'category = 3' show costs 2>&1; echo rc=$?
+       $OPENFM --shared --rates rates.txt show fullstat 2>&1; echo rc=$?
+       $OPENFM add cost 5 3 tea >/dev/null 2>&1
+       $OPENFM -v --shared 2>&1; echo rc=$?
+       $OPENFM -v --shared 2>&1; echo rc=$?
+       echo '-|32.01.2006|3|1|wrong' >>ledger.db
+       $OPENFM -v --shared 2>&1; echo rc=$?
+       $OPENFM -v --shared 2>&1; echo rc=$?
+       $OPENFM -v unshare 2>&1; echo rc=$?
+       $OPENFM -v unshare 2>&1; echo rc=$?
+       grep -v EUR "$1.in" >ledger.db
+       $OPENFM --shared 2>&1; echo rc=$?
+       $OPENFM unshare 2>&1; echo rc=$?
+       rm -f ledger.db ledger.db.sum rates.txt) >"$1.txt"
+      ;;
+    33)
+      print_message "'openfm show trend' and 'openfm show forecast' commands"
+      (export OPENFM_DB=ledger.db
+       cp "$1.in" ledger.db
+       $OPENFM show trend 2>&1; echo rc=$?
+       $OPENFM show forecast 2>&1; echo rc=$?
+       $OPENFM --output tsv show trend 2>&1; echo rc=$?
+       $OPENFM --output json show forecast 2>&1; echo rc=$?
+       $OPENFM --filter 'category = 3' show forecast 2>&1; echo rc=$?
+       $OPENFM --memory-limit 1M show trend 2>&1; echo rc=$?
+       : >ledger.db
+       $OPENFM show trend 2>&1; echo rc=$?
+       $OPENFM --output json show forecast 2>&1; echo rc=$?
+       rm -f ledger.db ledger.db.sum) >"$1.txt"
+      ;;
+    34)
+      print_message "'openfm export' command with Arrow format"
+      ($OPENFM --format arrow export "$1.in" 2>&1 | od -A d -t x1 -v; echo rc=$?
+       : >empty.db
+       $OPENFM --format arrow export empty.db 2>&1 | od -A d -t x1 -v; echo rc=$?
+       rm -f empty.db) >"$1.txt"
+      ;;
+    35)
+      print_message "amounts with currency codes without --rates option"
+      (export OPENFM_DB=ledger.db
+       cp "$1.in" ledger.db
+       $OPENFM 2>&1; echo rc=$?
+       $OPENFM show balance 2>&1; echo rc=$?
+       $OPENFM show categories 2>&1; echo rc=$?
+       $OPENFM --memory-limit 1K show fullstat 2>&1; echo rc=$?
+       rm -f ledger.db.sum
+       $OPENFM --memory-limit 1K show categories 2>&1; echo rc=$?
+       $OPENFM --as-of 31.12.2020 show balance 2>&1; echo rc=$?
+       $OPENFM --shared 2>&1; echo rc=$?
+       $OPENFM unshare >/dev/null 2>&1
+       $OPENFM --filter 'category = 1' show balance 2>&1; echo rc=$?
+       $OPENFM --filter 'amount > 7' show balance 2>&1; echo rc=$?
+       $OPENFM --filter 'amount > 7' export 2>&1; echo rc=$?
+       $OPENFM --filter 'category = 1' export 2>&1; echo rc=$?
+       $OPENFM search pay 2>&1; echo rc=$?
+       $OPENFM search food 2>&1; echo rc=$?
+       printf 'ledger.db\n' >ledgers.lst
+       $OPENFM batch ledgers.lst 2>&1; echo rc=$?
+       printf '2|100\n' >budgets.txt
+       $OPENFM --budgets budgets.txt add cost '5 EUR' 2 food 2>&1; echo rc=$?
+       wc -l <ledger.db
+       rm -f ledger.db ledger.db.sum ledger.db.bal ledger.db.idx ledgers.lst \
+             budgets.txt) 2>&1 |
+       sed "s/$(date +%m.%Y)/mm.yyyy/" >"$1.txt"
+      ;;
+    36)
+      print_message "too large categories and amounts"
+      (export OPENFM_DB=ledger.db
+       cp "$1.in" ledger.db
+       $OPENFM 2>&1; echo rc=$?
+       head -n 1 "$1.in" >ledger.db
+       $OPENFM show categories 2>&1; echo rc=$?
+       $OPENFM add cost 5 4294967296 food 2>&1; echo rc=$?
+       $OPENFM add cost 5 04294967295 food 2>&1; echo rc=$?
+       $OPENFM add cost 1000000000000000 1 car 2>&1; echo rc=$?
+       $OPENFM add cost 000999999999999999 1 car 2>&1; echo rc=$?
+       $OPENFM show categories 2>&1; echo rc=$?
+       printf '4294967296|food\n' >rules.txt
+       $OPENFM --rules rules.txt recategorize 2>&1; echo rc=$?
+       rm -f ledger.db ledger.db.sum ledger.db.idx ledger.db.bal rules.txt) 2>&1 |
+       sed "s/$(date +%d.%m.%Y)/dd.mm.yyyy/" >"$1.txt"
+      ;;
+    37)
+      print_message "side files of replaced data file"
+      (export OPENFM_DB=ledger.db
+       printf '+|01.01.2006|1|100|a\n' >ledger.db
+       $OPENFM show balance 2>&1; echo rc=$?
+       $OPENFM --as-of 31.12.2006 show balance 2>&1; echo rc=$?
+       printf '+|01.01.2006|1|900|a\n' >new.db
+       touch -r ledger.db new.db
+       mv new.db ledger.db
+       $OPENFM show balance 2>&1; echo rc=$?
+       $OPENFM --as-of 31.12.2006 show balance 2>&1; echo rc=$?
+       rm -f ledger.db ledger.db.sum ledger.db.bal) >"$1.txt"
+      ;;
+    38)
+      print_message "export of comments which are not UTF-8"
+      ($OPENFM --format jsonl export "$1.in" 2>&1; echo rc=$?
+       $OPENFM --format arrow export "$1.in" >ledger.arrow; echo rc=$?
+       grep -a -o "$(printf '\357\277\275')" ledger.arrow | wc -l
+       rm -f ledger.arrow) >"$1.txt"
+      ;;
     *)
       echo "Wrong number for test: $1" >&2
       exit 3